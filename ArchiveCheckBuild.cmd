@@ -0,0 +1,5 @@
+@echo off
+REM Build the offline archive spell-check tool as a console application
+REM Usage: ArchiveCheckBuild  then  ArchiveCheck [-t threads] [-o report.txt] [WorkLog_*.txt]
+
+powershell -NoProfile -ExecutionPolicy Bypass -Command "& './build.ps1' -Source 'archivecheck.c' -Output 'ArchiveCheck.exe'"
@@ -0,0 +1,5 @@
+@echo off
+REM Build the structured work log export tool as a console application
+REM Usage: LogExportBuild  then  LogExport [-f ndjson|binary] [-d directory] [-o output] [WorkLog_*.txt]
+
+powershell -NoProfile -ExecutionPolicy Bypass -Command "& './build.ps1' -Source 'logexport.c' -Output 'LogExport.exe'"
@@ -0,0 +1,5 @@
+@echo off
+REM Build the work log search tool as a console application
+REM Usage: LogGrepBuild  then  LogGrep [-i] [-t threads] [-c chunkMB] [-d directory] [-o output] expression [WorkLog_*.txt]
+
+powershell -NoProfile -ExecutionPolicy Bypass -Command "& './build.ps1' -Source 'loggrep.c' -Output 'LogGrep.exe'"
@@ -0,0 +1,5 @@
+@echo off
+REM Build the log ingestion client and load generator as a console application
+REM Usage: LogIngestBuild  then  LogIngest "entry text"  or  LogIngest -bench [-c connections] [-n entries]
+
+powershell -NoProfile -ExecutionPolicy Bypass -Command "& './build.ps1' -Source 'logingest.c' -Output 'LogIngest.exe'"
@@ -0,0 +1,5 @@
+@echo off
+REM Build the work log summary tool as a console application
+REM Usage: LogSummaryBuild  then  LogSummary [-d directory] [-w] [-k count] [-rebuild] [-t threads]
+
+powershell -NoProfile -ExecutionPolicy Bypass -Command "& './build.ps1' -Source 'logsummary.c' -Output 'LogSummary.exe'"
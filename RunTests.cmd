@@ -0,0 +1,42 @@
+@echo off
+REM Build and run the tests in tests\ with MinGW gcc (must be in PATH)
+REM Usage: RunTests  (exits nonzero if any test fails to build or pass)
+
+setlocal
+if not exist tests\bin mkdir tests\bin
+set FAILED=0
+
+call :test spans_test spans.c
+call :test iojob_test iojob.c
+call :test logstore_stress logstore.c logtotals.c utf8.c
+
+if %FAILED% neq 0 (
+    echo %FAILED% test^(s^) failed
+    exit /b 1
+)
+echo All tests passed
+exit /b 0
+
+REM :test name sources... builds tests\name.c with the sources and runs it
+:test
+set NAME=%1
+shift
+set SOURCES=
+:collect
+if "%~1"=="" goto build
+set SOURCES=%SOURCES% %1
+shift
+goto collect
+:build
+echo == %NAME%
+gcc -O2 -I. -o tests\bin\%NAME%.exe tests\%NAME%.c %SOURCES%
+if errorlevel 1 (
+    echo %NAME%: build failed
+    set /a FAILED+=1
+    goto :eof
+)
+pushd tests\bin
+%NAME%.exe
+if errorlevel 1 set /a FAILED+=1
+popd
+goto :eof
@@ -0,0 +1,654 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "spellchecker.h"
+#include "logarchive.h"
+
+// Offline spell-check report over the WorkLog archive.
+//
+// Usage: ArchiveCheck [-t threads] [-c chunkMB] [-d dictionary] [-u userdict]
+//                     [-b array|dawg] [-o report] [-a days] [pattern]
+//
+// Every file matching the pattern (default WorkLog_*.txt) is memory-mapped
+// and cut into line-aligned chunks. Each day packed into the monthly
+// archives (WorkLog_YYYY-MM.wla) beside the pattern is one more chunk,
+// decompressed by the worker that takes it and freed once checked, so at
+// most one day per worker is held in memory; -a first packs exports older
+// than 'days' days.
+// Chunks are dealt round-robin onto one deque per worker; a worker pops
+// from the back of its own deque and steals from the front of the others
+// once it runs dry. All workers share a single loaded SpellChecker, which
+// SpellChecker_CheckRange only reads.
+//
+// A file, archive or archived day that can't be read is reported as such
+// rather than as clean, and makes the exit code 1.
+
+#define DEFAULT_PATTERN "WorkLog_*.txt"
+#define DEFAULT_CHUNK_MB 4
+#define MAX_WORKERS 64
+#define MAX_DAY_BYTES (2048ULL * 1024 * 1024)     // Chunk lengths are DWORDs
+
+typedef struct {
+    char path[MAX_PATH];
+    HANDLE hFile;
+    HANDLE hMapping;
+    const char *data;
+    ULONGLONG size;
+    int archiveIndex;           // Of the archive holding the day, or -1 for a mapped file
+    DWORD day;                  // YYYYMMDD of an archived day
+    const char *failure;        // Why it couldn't be checked, or NULL; set by a worker for a day
+    int firstItem;
+    int itemCount;
+} ArchiveFile;
+
+// The archives open for the workers to read days from
+typedef struct {
+    LogArchive **archives;
+    int count;
+    int capacity;
+} ArchiveSet;
+
+typedef struct {
+    int archiveCount;
+    int dayCount;
+    ULONGLONG rawBytes;
+    ULONGLONG compressedBytes;
+    double seconds;
+} DecodeStats;
+
+typedef struct {
+    int fileIndex;
+    ULONGLONG offset;           // Chunk start within the file
+    DWORD length;               // Chunk length in bytes; set by the worker for an archived day
+    DWORD lineCount;            // Newlines inside the chunk
+    MisspelledWordList found;   // Positions are relative to 'offset'
+    DWORD *lines;               // Chunk-relative line of each hit
+    DWORD *columns;             // 1-based column of each hit
+} WorkItem;
+
+typedef struct {
+    CRITICAL_SECTION lock;
+    int *items;
+    int head;                   // Thieves take from here
+    int tail;                   // Owner pops from here
+} WorkDeque;
+
+typedef struct {
+    SpellChecker *checker;
+    ArchiveFile *files;
+    LogArchive **archives;
+    WorkItem *items;
+    WorkDeque *deques;
+    int workerCount;
+} ArchiveJob;
+
+typedef struct {
+    ArchiveJob *job;
+    int index;
+    int stolen;
+    double decodeSeconds;       // Spent decompressing archived days
+} WorkerContext;
+
+// Pop from the owner's end of a deque; -1 when empty
+static int DequePopBack(WorkDeque *dq) {
+    int item = -1;
+    EnterCriticalSection(&dq->lock);
+    if (dq->tail > dq->head) {
+        item = dq->items[--dq->tail];
+    }
+    LeaveCriticalSection(&dq->lock);
+    return item;
+}
+
+// Steal from the opposite end of another worker's deque; -1 when empty
+static int DequeStealFront(WorkDeque *dq) {
+    int item = -1;
+    EnterCriticalSection(&dq->lock);
+    if (dq->tail > dq->head) {
+        item = dq->items[dq->head++];
+    }
+    LeaveCriticalSection(&dq->lock);
+    return item;
+}
+
+// Spell-check one chunk and resolve hit positions to line/column
+static void CheckChunk(ArchiveJob *job, WorkItem *item, const char *text) {
+    SpellChecker_CheckRange(job->checker, text, item->length, 0, &item->found);
+
+    if (item->found.count > 0) {
+        item->lines = (DWORD *)malloc(item->found.count * sizeof(DWORD));
+        item->columns = (DWORD *)malloc(item->found.count * sizeof(DWORD));
+    }
+
+    // Hits come back in ascending order, so one sweep over the chunk
+    // assigns every line/column and counts the chunk's newlines.
+    DWORD line = 0, lineStart = 0, pos = 0;
+    int hit = 0;
+    for (pos = 0; pos < item->length; pos++) {
+        while (hit < item->found.count && item->found.words[hit].startPos == pos) {
+            if (item->lines && item->columns) {
+                item->lines[hit] = line;
+                item->columns[hit] = pos - lineStart + 1;
+            }
+            hit++;
+        }
+        if (text[pos] == '\n') {
+            line++;
+            lineStart = pos + 1;
+        }
+    }
+    item->lineCount = line;
+}
+
+static void ProcessItem(WorkerContext *ctx, WorkItem *item) {
+    ArchiveJob *job = ctx->job;
+    ArchiveFile *file = &job->files[item->fileIndex];
+    if (file->archiveIndex < 0) {
+        CheckChunk(job, item, file->data + item->offset);
+        return;
+    }
+
+    LARGE_INTEGER freq, start, stop;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    size_t length;
+    char *text = LogArchive_ReadDay(job->archives[file->archiveIndex], file->day, 0, 24 * 60 - 1, &length);
+    QueryPerformanceCounter(&stop);
+    ctx->decodeSeconds += (double)(stop.QuadPart - start.QuadPart) / (double)freq.QuadPart;
+
+    if (!text) {
+        file->failure = "day could not be decompressed";
+        return;
+    }
+    if (length >= MAX_DAY_BYTES) {
+        file->failure = "day too large to check";
+        free(text);
+        return;
+    }
+    item->length = (DWORD)length;
+    file->size = length;
+    CheckChunk(job, item, text);
+    free(text);
+}
+
+static DWORD WINAPI WorkerThread(LPVOID param) {
+    WorkerContext *ctx = (WorkerContext *)param;
+    ArchiveJob *job = ctx->job;
+
+    for (;;) {
+        int item = DequePopBack(&job->deques[ctx->index]);
+
+        // Own deque is empty: sweep the others once before giving up.
+        // No work is produced after start-up, so an empty sweep means done.
+        for (int v = 1; item < 0 && v < job->workerCount; v++) {
+            item = DequeStealFront(&job->deques[(ctx->index + v) % job->workerCount]);
+            if (item >= 0) ctx->stolen++;
+        }
+        if (item < 0) break;
+
+        ProcessItem(ctx, &job->items[item]);
+    }
+    return 0;
+}
+
+// Map a file read-only; empty files are kept with a NULL view
+static BOOL MapArchiveFile(ArchiveFile *file) {
+    file->hFile = CreateFile(file->path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file->hFile == INVALID_HANDLE_VALUE) return FALSE;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->hFile, &size)) {
+        CloseHandle(file->hFile);
+        return FALSE;
+    }
+    file->size = (ULONGLONG)size.QuadPart;
+    if (file->size == 0) return TRUE;
+
+    file->hMapping = CreateFileMapping(file->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!file->hMapping) {
+        CloseHandle(file->hFile);
+        return FALSE;
+    }
+    file->data = (const char *)MapViewOfFile(file->hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->data) {
+        CloseHandle(file->hMapping);
+        CloseHandle(file->hFile);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void UnmapArchiveFile(ArchiveFile *file) {
+    if (file->data) UnmapViewOfFile(file->data);
+    if (file->hMapping) CloseHandle(file->hMapping);
+    if (file->hFile && file->hFile != INVALID_HANDLE_VALUE) CloseHandle(file->hFile);
+}
+
+static WorkItem* AddWorkItem(WorkItem **items, int *itemCount, int *itemCapacity, int fileIndex) {
+    if (*itemCount >= *itemCapacity) {
+        int newCapacity = *itemCapacity > 0 ? *itemCapacity * 2 : 64;
+        WorkItem *newItems = (WorkItem *)realloc(*items, newCapacity * sizeof(WorkItem));
+        if (!newItems) return NULL;
+        *items = newItems;
+        *itemCapacity = newCapacity;
+    }
+    WorkItem *item = &(*items)[(*itemCount)++];
+    memset(item, 0, sizeof(WorkItem));
+    item->fileIndex = fileIndex;
+    return item;
+}
+
+// Cut a mapped file into chunks of roughly chunkSize bytes, ending each
+// chunk just after a newline so no word or line straddles two chunks
+static int SplitArchiveFile(ArchiveFile *file, int fileIndex, ULONGLONG chunkSize,
+                            WorkItem **items, int *itemCount, int *itemCapacity) {
+    ULONGLONG offset = 0;
+    file->firstItem = *itemCount;
+
+    while (offset < file->size) {
+        ULONGLONG end = offset + chunkSize;
+        if (end >= file->size) {
+            end = file->size;
+        } else {
+            const char *nl = (const char *)memchr(file->data + end, '\n', (size_t)(file->size - end));
+            end = nl ? (ULONGLONG)(nl - file->data) + 1 : file->size;
+        }
+
+        WorkItem *item = AddWorkItem(items, itemCount, itemCapacity, fileIndex);
+        if (!item) return FALSE;
+        item->offset = offset;
+        item->length = (DWORD)(end - offset);
+
+        offset = end;
+    }
+
+    file->itemCount = *itemCount - file->firstItem;
+    return TRUE;
+}
+
+// Directory prefix of a pattern including its separator, or "" if none
+static void PatternDirectory(const char *pattern, char *dir, size_t dirSize) {
+    dir[0] = '\0';
+    const char *slash = strrchr(pattern, '\\');
+    const char *fwd = strrchr(pattern, '/');
+    if (fwd > slash) slash = fwd;
+    if (slash && (size_t)(slash - pattern + 1) < dirSize) {
+        memcpy(dir, pattern, slash - pattern + 1);
+        dir[slash - pattern + 1] = '\0';
+    }
+}
+
+static ArchiveFile* AddArchiveFile(ArchiveFile **files, int *count, int *capacity) {
+    if (*count >= *capacity) {
+        int newCapacity = *capacity > 0 ? *capacity * 2 : 32;
+        ArchiveFile *newFiles = (ArchiveFile *)realloc(*files, newCapacity * sizeof(ArchiveFile));
+        if (!newFiles) return NULL;
+        *files = newFiles;
+        *capacity = newCapacity;
+    }
+    ArchiveFile *file = &(*files)[(*count)++];
+    memset(file, 0, sizeof(ArchiveFile));
+    file->archiveIndex = -1;
+    return file;
+}
+
+// Open an archive and add each day in its index; nothing is decompressed
+// until a worker claims the day
+static void AddArchivedDays(const char *path, ArchiveFile **files, int *count, int *capacity,
+                            ArchiveSet *set, DecodeStats *stats) {
+    LogArchive *archive = LogArchive_Open(path);
+    if (archive && set->count >= set->capacity) {
+        int newCapacity = set->capacity > 0 ? set->capacity * 2 : 16;
+        LogArchive **newArchives = (LogArchive **)realloc(set->archives, newCapacity * sizeof(LogArchive *));
+        if (newArchives) {
+            set->archives = newArchives;
+            set->capacity = newCapacity;
+        }
+    }
+    if (!archive || set->count >= set->capacity) {
+        LogArchive_Close(archive);
+        ArchiveFile *file = AddArchiveFile(files, count, capacity);
+        if (file) {
+            snprintf(file->path, MAX_PATH, "%s", path);
+            file->failure = "archive could not be read";
+        }
+        return;
+    }
+    int archiveIndex = set->count++;
+    set->archives[archiveIndex] = archive;
+    stats->archiveCount++;
+
+    for (DWORD i = 0; i < archive->blockCount; i++) {
+        stats->rawBytes += archive->blocks[i].rawSize;
+        stats->compressedBytes += archive->blocks[i].compressedSize;
+
+        DWORD day = archive->blocks[i].day;
+        if (i > 0 && archive->blocks[i - 1].day == day) continue;
+
+        ArchiveFile *file = AddArchiveFile(files, count, capacity);
+        if (!file) break;
+        snprintf(file->path, MAX_PATH, "%s:%04lu-%02lu-%02lu", path, (unsigned long)(day / 10000),
+                 (unsigned long)(day / 100 % 100), (unsigned long)(day % 100));
+        file->archiveIndex = archiveIndex;
+        file->day = day;
+        stats->dayCount++;
+    }
+}
+
+// Collect matching files, then the archived days in the pattern's
+// directory; the directory prefix is kept for opening
+static int FindArchiveFiles(const char *pattern, ArchiveFile **files, ArchiveSet *set, DecodeStats *stats) {
+    char dir[MAX_PATH];
+    PatternDirectory(pattern, dir, sizeof(dir));
+
+    int count = 0, capacity = 0;
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(pattern, &findData);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+            ArchiveFile *file = AddArchiveFile(files, &count, &capacity);
+            if (!file) break;
+            snprintf(file->path, MAX_PATH, "%s%s", dir, findData.cFileName);
+        } while (FindNextFile(hFind, &findData));
+        FindClose(hFind);
+    }
+
+    char archivePattern[MAX_PATH];
+    snprintf(archivePattern, MAX_PATH, "%s%s", dir, LOGARCHIVE_PATTERN);
+    hFind = FindFirstFile(archivePattern, &findData);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+            char path[MAX_PATH];
+            snprintf(path, MAX_PATH, "%s%s", dir, findData.cFileName);
+            AddArchivedDays(path, files, &count, &capacity, set, stats);
+        } while (FindNextFile(hFind, &findData));
+        FindClose(hFind);
+    }
+
+    return count;
+}
+
+// Returns the number of files that couldn't be checked
+static int WriteReport(FILE *out, ArchiveFile *files, int fileCount, WorkItem *items) {
+    long long total = 0;
+    int failed = 0;
+
+    for (int f = 0; f < fileCount; f++) {
+        if (files[f].failure) {
+            fprintf(out, "%s: not checked, %s\n", files[f].path, files[f].failure);
+            failed++;
+            continue;
+        }
+
+        long long fileTotal = 0;
+        for (int i = 0; i < files[f].itemCount; i++) {
+            fileTotal += items[files[f].firstItem + i].found.count;
+        }
+        total += fileTotal;
+
+        fprintf(out, "%s: %lld misspelling(s)\n", files[f].path, fileTotal);
+
+        // Chunks of a file are in order, so a running sum of their
+        // newline counts rebases chunk-relative lines onto the file
+        DWORD lineBase = 1;
+        for (int i = 0; i < files[f].itemCount; i++) {
+            WorkItem *item = &items[files[f].firstItem + i];
+            for (int w = 0; w < item->found.count; w++) {
+                if (item->lines && item->columns) {
+                    fprintf(out, "  %lu:%lu  %s\n",
+                            (unsigned long)(lineBase + item->lines[w]),
+                            (unsigned long)item->columns[w],
+                            item->found.words[w].word);
+                }
+            }
+            lineBase += item->lineCount;
+        }
+    }
+
+    fprintf(out, "\nTotal: %lld misspelling(s) in %d file(s)\n", total, fileCount - failed);
+    if (failed > 0) {
+        fprintf(out, "%d file(s) could not be checked\n", failed);
+    }
+    return failed;
+}
+
+static void PrintUsage(void) {
+    fprintf(stderr,
+            "Usage: ArchiveCheck [-t threads] [-c chunkMB] [-d dictionary] [-u userdict]\n"
+            "                    [-b array|dawg] [-o report] [-a days] [pattern]\n"
+            "Default pattern is " DEFAULT_PATTERN ". Archives beside it are read too;\n"
+            "-a first archives exports older than the given number of days.\n");
+}
+
+int main(int argc, char **argv) {
+    const char *pattern = DEFAULT_PATTERN;
+    const char *dictPath = "dictionary.txt";
+    const char *userDictPath = "user_dictionary.txt";
+    const char *reportPath = NULL;
+    int workerCount = 0;
+    int chunkMB = DEFAULT_CHUNK_MB;
+    int archiveDays = -1;
+    SpellCheckBackend backend = SPELLCHECK_BACKEND_SORTED_ARRAY;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            workerCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            chunkMB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            dictPath = argv[++i];
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            userDictPath = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "dawg") == 0) {
+                backend = SPELLCHECK_BACKEND_DAWG;
+            } else if (strcmp(name, "array") != 0) {
+                PrintUsage();
+                return 2;
+            }
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            reportPath = argv[++i];
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            archiveDays = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            PrintUsage();
+            return 2;
+        } else {
+            pattern = argv[i];
+        }
+    }
+
+    if (workerCount <= 0) {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        workerCount = (int)si.dwNumberOfProcessors;
+    }
+    if (workerCount > MAX_WORKERS) workerCount = MAX_WORKERS;
+    if (chunkMB <= 0) chunkMB = DEFAULT_CHUNK_MB;
+
+    // In embedded builds the dictionary file is an optional overlay
+    SpellChecker *checker = SpellChecker_Create();
+    if (!checker || (!SpellChecker_LoadDictionary(checker, dictPath) && !SpellChecker_HasEmbeddedDictionary())) {
+        fprintf(stderr, "Could not load dictionary '%s'\n", dictPath);
+        SpellChecker_Destroy(checker);
+        return 1;
+    }
+    SpellChecker_LoadUserDictionary(checker, userDictPath);
+    SpellChecker_SetBackend(checker, backend);
+
+    DictionaryStats stats;
+    SpellChecker_GetDictionaryStats(checker, &stats);
+    fprintf(stderr, "Dictionary: %d words in %.1f KB (%s)\n", stats.wordCount, stats.bytes / 1024.0,
+            stats.backend == SPELLCHECK_BACKEND_DAWG ? "DAWG" : "sorted array");
+
+    if (archiveDays >= 0) {
+        char dir[MAX_PATH];
+        PatternDirectory(pattern, dir, sizeof(dir));
+        size_t dirLength = strlen(dir);
+        if (dirLength > 0) {
+            dir[dirLength - 1] = '\0';
+        } else {
+            strcpy(dir, ".");
+        }
+
+        LogArchiveStats packed;
+        if (!LogArchive_PackExports(dir, archiveDays, &packed)) {
+            fprintf(stderr, "Archiving exports in '%s' failed\n", dir);
+        } else if (packed.filesPacked > 0) {
+            fprintf(stderr, "Archived %d export(s): %.1f KB -> %.1f KB (%.2fx)\n", packed.filesPacked,
+                    packed.rawBytes / 1024.0, packed.compressedBytes / 1024.0,
+                    packed.compressedBytes > 0 ? (double)packed.rawBytes / packed.compressedBytes : 0.0);
+        }
+    }
+
+    ArchiveFile *files = NULL;
+    ArchiveSet archives = {0};
+    DecodeStats decode = {0};
+    int fileCount = FindArchiveFiles(pattern, &files, &archives, &decode);
+    if (fileCount == 0) {
+        fprintf(stderr, "No files match '%s'\n", pattern);
+        SpellChecker_Destroy(checker);
+        return 1;
+    }
+
+    // A mapped file is cut into chunks; an archived day is one chunk, its
+    // length known once a worker has decompressed it
+    WorkItem *items = NULL;
+    int itemCount = 0, itemCapacity = 0;
+    for (int f = 0; f < fileCount; f++) {
+        if (files[f].failure) continue;
+        BOOL planned;
+        if (files[f].archiveIndex >= 0) {
+            files[f].firstItem = itemCount;
+            files[f].itemCount = 1;
+            planned = AddWorkItem(&items, &itemCount, &itemCapacity, f) != NULL;
+        } else if (!MapArchiveFile(&files[f])) {
+            files[f].failure = "file could not be read";
+            files[f].hFile = NULL;
+            continue;
+        } else {
+            planned = SplitArchiveFile(&files[f], f, (ULONGLONG)chunkMB * 1024 * 1024,
+                                       &items, &itemCount, &itemCapacity);
+        }
+        if (!planned) {
+            fprintf(stderr, "Out of memory while planning work\n");
+            return 1;
+        }
+    }
+
+    if (workerCount > itemCount) workerCount = itemCount > 0 ? itemCount : 1;
+
+    // Deal chunks round-robin so every worker starts with a share of each
+    // file; stealing evens out whatever imbalance is left
+    ArchiveJob job = {0};
+    job.checker = checker;
+    job.files = files;
+    job.archives = archives.archives;
+    job.items = items;
+    job.workerCount = workerCount;
+    job.deques = (WorkDeque *)calloc(workerCount, sizeof(WorkDeque));
+    WorkerContext *contexts = (WorkerContext *)calloc(workerCount, sizeof(WorkerContext));
+    HANDLE *threads = (HANDLE *)calloc(workerCount, sizeof(HANDLE));
+    if (!job.deques || !contexts || !threads) {
+        fprintf(stderr, "Out of memory while starting workers\n");
+        return 1;
+    }
+
+    for (int w = 0; w < workerCount; w++) {
+        InitializeCriticalSection(&job.deques[w].lock);
+        job.deques[w].items = (int *)malloc((itemCount / workerCount + 1) * sizeof(int));
+    }
+    for (int i = 0; i < itemCount; i++) {
+        WorkDeque *dq = &job.deques[i % workerCount];
+        dq->items[dq->tail++] = i;
+    }
+
+    LARGE_INTEGER freq, start, stop;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    int started = 0;
+    for (int w = 0; w < workerCount; w++) {
+        contexts[w].job = &job;
+        contexts[w].index = w;
+        threads[w] = CreateThread(NULL, 0, WorkerThread, &contexts[w], 0, NULL);
+        if (!threads[w]) break;
+        started++;
+    }
+
+    // Run inline if no thread could be started
+    if (started == 0) {
+        WorkerThread(&contexts[0]);
+    }
+    for (int w = 0; w < started; w++) {
+        WaitForSingleObject(threads[w], INFINITE);
+        CloseHandle(threads[w]);
+    }
+
+    QueryPerformanceCounter(&stop);
+    double seconds = (double)(stop.QuadPart - start.QuadPart) / (double)freq.QuadPart;
+
+    FILE *out = stdout;
+    if (reportPath) {
+        out = fopen(reportPath, "w");
+        if (!out) {
+            fprintf(stderr, "Could not create report '%s'\n", reportPath);
+            out = stdout;
+        }
+    }
+    int failed = WriteReport(out, files, fileCount, items);
+    if (out != stdout) fclose(out);
+    if (failed > 0) {
+        fprintf(stderr, "%d file(s) could not be checked\n", failed);
+    }
+
+    int stolen = 0;
+    for (int w = 0; w < workerCount; w++) {
+        stolen += contexts[w].stolen;
+        decode.seconds += contexts[w].decodeSeconds;
+    }
+    ULONGLONG totalBytes = 0;
+    for (int f = 0; f < fileCount; f++) totalBytes += files[f].size;
+    if (decode.archiveCount > 0) {
+        // Decoding time is summed over the workers
+        fprintf(stderr, "Archives: %d day(s) from %d file(s), %.1f MB -> %.1f MB (%.2fx), decoded in %.3f s (%.1f MB/s)\n",
+                decode.dayCount, decode.archiveCount, decode.compressedBytes / (1024.0 * 1024.0),
+                decode.rawBytes / (1024.0 * 1024.0),
+                decode.compressedBytes > 0 ? (double)decode.rawBytes / decode.compressedBytes : 0.0,
+                decode.seconds, decode.seconds > 0 ? decode.rawBytes / (1024.0 * 1024.0) / decode.seconds : 0.0);
+    }
+    fprintf(stderr, "Checked %.1f MB in %d chunk(s) with %d thread(s) in %.3f s (%.1f MB/s, %d stolen)\n",
+            totalBytes / (1024.0 * 1024.0), itemCount, workerCount, seconds,
+            seconds > 0 ? totalBytes / (1024.0 * 1024.0) / seconds : 0.0, stolen);
+
+    for (int i = 0; i < itemCount; i++) {
+        SpellChecker_FreeMisspelledList(&items[i].found);
+        free(items[i].lines);
+        free(items[i].columns);
+    }
+    for (int w = 0; w < workerCount; w++) {
+        DeleteCriticalSection(&job.deques[w].lock);
+        free(job.deques[w].items);
+    }
+    for (int f = 0; f < fileCount; f++) {
+        UnmapArchiveFile(&files[f]);
+    }
+    for (int a = 0; a < archives.count; a++) {
+        LogArchive_Close(archives.archives[a]);
+    }
+    free(archives.archives);
+    free(threads);
+    free(contexts);
+    free(job.deques);
+    free(items);
+    free(files);
+    SpellChecker_Destroy(checker);
+    return failed > 0 ? 1 : 0;
+}
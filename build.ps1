@@ -9,13 +9,15 @@ Run from project root (where main.c and Logger_icon.ico live):
     .\build.ps1
 .\Logger = normal build/run
 .\Logger -Gui = GUI build/run
+.\build.ps1 -Embedded = compile dictionary.txt into the EXE (no dictionary file needed at runtime)
 #>
 
 param(
     [ValidateNotNullOrEmpty()][string]$Output = "Logger.exe",
     [ValidateNotNullOrEmpty()][string]$Source = "main.c",
     [ValidateNotNullOrEmpty()][string]$Resource = "Logger.rc",
-    [switch]$Gui
+    [switch]$Gui,
+    [switch]$Embedded
 )
 function Invoke-BuildWithMinGW {
     param()
@@ -46,9 +48,21 @@ function Invoke-BuildWithMinGW {
     if ($LASTEXITCODE -ne 0) { throw "windres failed with exit code $LASTEXITCODE" }
 
     # Compile and link the program with the resource
-    $gccArgs = @($Source, "spellchecker.c", $resFile, '-o', $Output)
+    $gccArgs = @($Source, "spellchecker.c", "spans.c", "dawg.c", "suggestindex.c", "utf8.c", "logstore.c", "logarchive.c", "ingest.c", "logtotals.c", "iojob.c", "pattern.c", $resFile, '-o', $Output)
     if ($Gui) { $gccArgs += '-mwindows' }
 
+    # Optionally generate a perfect-hash dictionary and link it in
+    if ($Embedded) {
+        if (-not (Test-Path -Path "dictionary.txt")) {
+            throw "dictionary.txt not found; it is required for -Embedded builds."
+        }
+        & $gccCmd.Path dictgen.c utf8.c -o dictgen.exe
+        if ($LASTEXITCODE -ne 0) { throw "building dictgen failed with exit code $LASTEXITCODE" }
+        & .\dictgen.exe dictionary.txt dictionary_embedded.c
+        if ($LASTEXITCODE -ne 0) { throw "dictgen failed with exit code $LASTEXITCODE" }
+        $gccArgs += @('dictionary_embedded.c', '-DSPELLCHECK_EMBEDDED_DICTIONARY')
+    }
+
     & $gccCmd.Path @gccArgs
     if ($LASTEXITCODE -ne 0) { throw "gcc failed with exit code $LASTEXITCODE" }
 
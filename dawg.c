@@ -0,0 +1,433 @@
+#include "dawg.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define DAWG_MAX_WORD 256
+
+// Construction uses the incremental algorithm for sorted input (Daciuk et
+// al.): only the path of the previous word is still mutable, and once the
+// next word diverges from it, the nodes below the divergence point are
+// either merged with an equivalent registered node or registered
+// themselves. The result is minimal without ever building the full trie.
+
+typedef struct {
+    unsigned char label;
+    int child;
+} BuildEdge;
+
+typedef struct {
+    BuildEdge *edges;
+    int edgeCount;
+    int edgeCapacity;
+    BOOL final;
+} BuildNode;
+
+typedef struct {
+    BuildNode *nodes;
+    int nodeCount;
+    int nodeCapacity;
+    int *freeNodes;
+    int freeCount;
+    int freeCapacity;
+    int *table;               // Register: open addressing over node ids
+    unsigned int tableSize;
+    unsigned int registered;
+} DawgBuilder;
+
+static unsigned int HashNode(const BuildNode *node) {
+    unsigned int h = node->final ? 0x9E3779B9u : 0x7F4A7C15u;
+    for (int i = 0; i < node->edgeCount; i++) {
+        h = (h ^ node->edges[i].label) * 16777619u;
+        h = (h ^ (unsigned int)node->edges[i].child) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+static BOOL NodesEqual(const BuildNode *a, const BuildNode *b) {
+    if (a->final != b->final || a->edgeCount != b->edgeCount) return FALSE;
+    for (int i = 0; i < a->edgeCount; i++) {
+        if (a->edges[i].label != b->edges[i].label || a->edges[i].child != b->edges[i].child) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static int NewNode(DawgBuilder *b) {
+    int id;
+    if (b->freeCount > 0) {
+        id = b->freeNodes[--b->freeCount];
+    } else {
+        if (b->nodeCount >= b->nodeCapacity) {
+            int newCapacity = b->nodeCapacity > 0 ? b->nodeCapacity * 2 : 1024;
+            BuildNode *newNodes = (BuildNode *)realloc(b->nodes, newCapacity * sizeof(BuildNode));
+            if (!newNodes) return -1;
+            b->nodes = newNodes;
+            b->nodeCapacity = newCapacity;
+        }
+        id = b->nodeCount++;
+        b->nodes[id].edges = NULL;
+        b->nodes[id].edgeCapacity = 0;
+    }
+    b->nodes[id].edgeCount = 0;
+    b->nodes[id].final = FALSE;
+    return id;
+}
+
+static BOOL FreeNode(DawgBuilder *b, int id) {
+    if (b->freeCount >= b->freeCapacity) {
+        int newCapacity = b->freeCapacity > 0 ? b->freeCapacity * 2 : 256;
+        int *newFree = (int *)realloc(b->freeNodes, newCapacity * sizeof(int));
+        if (!newFree) return FALSE;
+        b->freeNodes = newFree;
+        b->freeCapacity = newCapacity;
+    }
+    b->freeNodes[b->freeCount++] = id;
+    return TRUE;
+}
+
+static BOOL AddEdge(DawgBuilder *b, int from, unsigned char label, int to) {
+    BuildNode *node = &b->nodes[from];
+    if (node->edgeCount >= node->edgeCapacity) {
+        int newCapacity = node->edgeCapacity > 0 ? node->edgeCapacity * 2 : 2;
+        BuildEdge *newEdges = (BuildEdge *)realloc(node->edges, newCapacity * sizeof(BuildEdge));
+        if (!newEdges) return FALSE;
+        node->edges = newEdges;
+        node->edgeCapacity = newCapacity;
+    }
+    node->edges[node->edgeCount].label = label;
+    node->edges[node->edgeCount].child = to;
+    node->edgeCount++;
+    return TRUE;
+}
+
+static BOOL GrowRegister(DawgBuilder *b) {
+    unsigned int newSize = b->tableSize > 0 ? b->tableSize * 2 : 4096;
+    int *newTable = (int *)malloc(newSize * sizeof(int));
+    if (!newTable) return FALSE;
+    for (unsigned int i = 0; i < newSize; i++) newTable[i] = -1;
+
+    for (unsigned int i = 0; i < b->tableSize; i++) {
+        int id = b->table[i];
+        if (id < 0) continue;
+        unsigned int slot = HashNode(&b->nodes[id]) & (newSize - 1);
+        while (newTable[slot] >= 0) slot = (slot + 1) & (newSize - 1);
+        newTable[slot] = id;
+    }
+
+    free(b->table);
+    b->table = newTable;
+    b->tableSize = newSize;
+    return TRUE;
+}
+
+// Merge the parent's last child with an equivalent registered node, or
+// register it. Returns FALSE only on allocation failure.
+static BOOL ReplaceOrRegister(DawgBuilder *b, int parent) {
+    BuildEdge *edge = &b->nodes[parent].edges[b->nodes[parent].edgeCount - 1];
+    int child = edge->child;
+
+    if ((b->registered + 1) * 2 > b->tableSize && !GrowRegister(b)) return FALSE;
+
+    unsigned int mask = b->tableSize - 1;
+    unsigned int slot = HashNode(&b->nodes[child]) & mask;
+    while (b->table[slot] >= 0) {
+        int candidate = b->table[slot];
+        if (NodesEqual(&b->nodes[candidate], &b->nodes[child])) {
+            edge->child = candidate;
+            return FreeNode(b, child);
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    b->table[slot] = child;
+    b->registered++;
+    return TRUE;
+}
+
+static void DestroyBuilder(DawgBuilder *b) {
+    for (int i = 0; i < b->nodeCount; i++) {
+        free(b->nodes[i].edges);
+    }
+    free(b->nodes);
+    free(b->freeNodes);
+    free(b->table);
+}
+
+// Lay out reachable nodes as contiguous edge runs, root first
+static Dawg* PackDawg(DawgBuilder *b, int root, int wordCount) {
+    Dawg *dawg = (Dawg *)calloc(1, sizeof(Dawg));
+    unsigned int *blockStart = (unsigned int *)calloc(b->nodeCount, sizeof(unsigned int));
+    BOOL *visited = (BOOL *)calloc(b->nodeCount, sizeof(BOOL));
+    int *stack = (int *)malloc((b->nodeCount + 1) * sizeof(int));
+    int *order = (int *)malloc((b->nodeCount + 1) * sizeof(int));
+    if (!dawg || !blockStart || !visited || !stack || !order) goto fail;
+
+    // Assign runs in depth-first order and count edges
+    unsigned int next = 1;
+    int top = 0, orderCount = 0;
+    stack[top++] = root;
+    visited[root] = TRUE;
+    while (top > 0) {
+        int id = stack[--top];
+        BuildNode *node = &b->nodes[id];
+        order[orderCount++] = id;
+        if (node->edgeCount > 0) {
+            blockStart[id] = next;
+            next += node->edgeCount;
+        }
+        for (int i = node->edgeCount - 1; i >= 0; i--) {
+            int child = node->edges[i].child;
+            if (!visited[child]) {
+                visited[child] = TRUE;
+                stack[top++] = child;
+            }
+        }
+    }
+
+    dawg->edgeCount = next;
+    dawg->labels = (unsigned char *)malloc(next);
+    dawg->flags = (unsigned char *)malloc(next);
+    dawg->children = (unsigned int *)malloc(next * sizeof(unsigned int));
+    if (!dawg->labels || !dawg->flags || !dawg->children) goto fail;
+    dawg->labels[0] = 0;
+    dawg->flags[0] = DAWG_EDGE_LAST;
+    dawg->children[0] = 0;
+
+    for (int o = 0; o < orderCount; o++) {
+        BuildNode *node = &b->nodes[order[o]];
+        unsigned int start = blockStart[order[o]];
+        for (int i = 0; i < node->edgeCount; i++) {
+            int child = node->edges[i].child;
+            dawg->labels[start + i] = node->edges[i].label;
+            dawg->flags[start + i] = (b->nodes[child].final ? DAWG_EDGE_WORD : 0) |
+                                     (i == node->edgeCount - 1 ? DAWG_EDGE_LAST : 0);
+            dawg->children[start + i] = blockStart[child];
+        }
+    }
+
+    dawg->root = blockStart[root];
+    dawg->wordCount = wordCount;
+
+    free(blockStart);
+    free(visited);
+    free(stack);
+    free(order);
+    return dawg;
+
+fail:
+    free(blockStart);
+    free(visited);
+    free(stack);
+    free(order);
+    Dawg_Destroy(dawg);
+    return NULL;
+}
+
+// Build a minimized DAWG from words in case-insensitive sorted order
+Dawg* Dawg_Build(char * const *words, int count) {
+    DawgBuilder b;
+    memset(&b, 0, sizeof(b));
+
+    int path[DAWG_MAX_WORD + 1];
+    unsigned char prev[DAWG_MAX_WORD];
+    int prevLen = 0;
+    int wordCount = 0;
+    BOOL ok = TRUE;
+
+    int root = NewNode(&b);
+    if (root < 0) return NULL;
+    path[0] = root;
+
+    for (int w = 0; ok && w < count; w++) {
+        unsigned char folded[DAWG_MAX_WORD];
+        int len = 0;
+        for (const char *p = words[w]; *p && len < DAWG_MAX_WORD - 1; p++) {
+            folded[len++] = (unsigned char)tolower((unsigned char)*p);
+        }
+        if (len == 0) continue;
+
+        int common = 0;
+        while (common < len && common < prevLen && folded[common] == prev[common]) common++;
+        if (common == len && common == prevLen) continue; // Duplicate once folded
+
+        // Everything below the divergence point is final now
+        for (int d = prevLen; ok && d > common; d--) {
+            ok = ReplaceOrRegister(&b, path[d - 1]);
+        }
+
+        for (int d = common; ok && d < len; d++) {
+            int node = NewNode(&b);
+            ok = node >= 0 && AddEdge(&b, path[d], folded[d], node);
+            path[d + 1] = node;
+        }
+        if (!ok) break;
+        b.nodes[path[len]].final = TRUE;
+
+        memcpy(prev, folded, len);
+        prevLen = len;
+        wordCount++;
+    }
+
+    for (int d = prevLen; ok && d > 0; d--) {
+        ok = ReplaceOrRegister(&b, path[d - 1]);
+    }
+
+    Dawg *dawg = ok ? PackDawg(&b, root, wordCount) : NULL;
+    DestroyBuilder(&b);
+    return dawg;
+}
+
+void Dawg_Destroy(Dawg *dawg) {
+    if (!dawg) return;
+    free(dawg->labels);
+    free(dawg->flags);
+    free(dawg->children);
+    free(dawg);
+}
+
+// Find the edge labelled 'c' in the run starting at 'block'; 0 if none
+static unsigned int FindEdge(const Dawg *dawg, unsigned int block, unsigned char c) {
+    if (block == 0) return 0;
+    for (unsigned int i = block; ; i++) {
+        if (dawg->labels[i] == c) return i;
+        if (dawg->flags[i] & DAWG_EDGE_LAST) return 0;
+    }
+}
+
+BOOL Dawg_Contains(const Dawg *dawg, const char *word) {
+    if (!dawg || !word || !*word) return FALSE;
+
+    unsigned int block = dawg->root;
+    for (const char *p = word; *p; p++) {
+        unsigned int edge = FindEdge(dawg, block, (unsigned char)tolower((unsigned char)*p));
+        if (edge == 0) return FALSE;
+        if (p[1] == '\0') return (dawg->flags[edge] & DAWG_EDGE_WORD) != 0;
+        block = dawg->children[edge];
+    }
+    return FALSE;
+}
+
+// Depth-first walk emitting every word below 'block'
+static BOOL EnumerateFrom(const Dawg *dawg, unsigned int block, char *buffer, int depth,
+                          DawgWordCallback callback, void *context) {
+    if (block == 0 || depth >= DAWG_MAX_WORD - 1) return TRUE;
+
+    for (unsigned int i = block; ; i++) {
+        buffer[depth] = (char)dawg->labels[i];
+        if (dawg->flags[i] & DAWG_EDGE_WORD) {
+            buffer[depth + 1] = '\0';
+            if (!callback(buffer, 0, context)) return FALSE;
+        }
+        if (!EnumerateFrom(dawg, dawg->children[i], buffer, depth + 1, callback, context)) return FALSE;
+        if (dawg->flags[i] & DAWG_EDGE_LAST) break;
+    }
+    return TRUE;
+}
+
+void Dawg_EnumeratePrefix(const Dawg *dawg, const char *prefix, DawgWordCallback callback, void *context) {
+    if (!dawg || !prefix || !callback) return;
+
+    char buffer[DAWG_MAX_WORD];
+    int depth = 0;
+    unsigned int block = dawg->root;
+
+    for (const char *p = prefix; *p; p++) {
+        if (depth >= DAWG_MAX_WORD - 1) return;
+        unsigned int edge = FindEdge(dawg, block, (unsigned char)tolower((unsigned char)*p));
+        if (edge == 0) return;
+        buffer[depth++] = (char)dawg->labels[edge];
+
+        // The prefix itself may be a word
+        if (p[1] == '\0' && (dawg->flags[edge] & DAWG_EDGE_WORD)) {
+            buffer[depth] = '\0';
+            if (!callback(buffer, 0, context)) return;
+        }
+        block = dawg->children[edge];
+    }
+
+    EnumerateFrom(dawg, block, buffer, depth, callback, context);
+}
+
+typedef struct {
+    const Dawg *dawg;
+    const unsigned char *query;
+    int queryLen;
+    int maxDistance;
+    int maxDepth;
+    int *rows;                // (maxDepth + 1) rows of (queryLen + 1)
+    char buffer[DAWG_MAX_WORD];
+    DawgWordCallback callback;
+    void *context;
+} DistanceWalk;
+
+static BOOL WalkWithinDistance(DistanceWalk *walk, unsigned int block, int depth) {
+    const Dawg *dawg = walk->dawg;
+    int width = walk->queryLen + 1;
+    const int *prev = walk->rows + depth * width;
+    int *cur = walk->rows + (depth + 1) * width;
+
+    for (unsigned int i = block; ; i++) {
+        unsigned char c = dawg->labels[i];
+        int rowMin;
+
+        cur[0] = depth + 1;
+        rowMin = cur[0];
+        for (int j = 1; j <= walk->queryLen; j++) {
+            int cost = (walk->query[j - 1] == c) ? 0 : 1;
+            int best = prev[j] + 1;
+            if (cur[j - 1] + 1 < best) best = cur[j - 1] + 1;
+            if (prev[j - 1] + cost < best) best = prev[j - 1] + cost;
+            cur[j] = best;
+            if (best < rowMin) rowMin = best;
+        }
+
+        walk->buffer[depth] = (char)c;
+        if ((dawg->flags[i] & DAWG_EDGE_WORD) && cur[walk->queryLen] <= walk->maxDistance) {
+            walk->buffer[depth + 1] = '\0';
+            if (!walk->callback(walk->buffer, cur[walk->queryLen], walk->context)) return FALSE;
+        }
+
+        // No extension of this prefix can get back under the limit
+        if (rowMin <= walk->maxDistance && dawg->children[i] && depth + 1 < walk->maxDepth) {
+            if (!WalkWithinDistance(walk, dawg->children[i], depth + 1)) return FALSE;
+        }
+
+        if (dawg->flags[i] & DAWG_EDGE_LAST) break;
+    }
+    return TRUE;
+}
+
+void Dawg_FindWithinDistance(const Dawg *dawg, const char *word, int maxDistance,
+                             DawgWordCallback callback, void *context) {
+    if (!dawg || !word || !callback || dawg->root == 0) return;
+
+    unsigned char query[DAWG_MAX_WORD];
+    int len = 0;
+    for (const char *p = word; *p && len < DAWG_MAX_WORD - 1; p++) {
+        query[len++] = (unsigned char)tolower((unsigned char)*p);
+    }
+
+    DistanceWalk walk;
+    walk.dawg = dawg;
+    walk.query = query;
+    walk.queryLen = len;
+    walk.maxDistance = maxDistance;
+    walk.maxDepth = len + maxDistance;
+    if (walk.maxDepth > DAWG_MAX_WORD - 1) walk.maxDepth = DAWG_MAX_WORD - 1;
+    walk.callback = callback;
+    walk.context = context;
+    walk.rows = (int *)malloc((walk.maxDepth + 1) * (len + 1) * sizeof(int));
+    if (!walk.rows) return;
+
+    for (int j = 0; j <= len; j++) walk.rows[j] = j;
+    WalkWithinDistance(&walk, dawg->root, 0);
+
+    free(walk.rows);
+}
+
+size_t Dawg_MemoryUsage(const Dawg *dawg) {
+    if (!dawg) return 0;
+    return sizeof(Dawg) + (size_t)dawg->edgeCount * (2 * sizeof(unsigned char) + sizeof(unsigned int));
+}
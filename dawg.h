@@ -0,0 +1,46 @@
+#ifndef DAWG_H
+#define DAWG_H
+
+#include <windows.h>
+
+// Minimized directed acyclic word graph over case-folded words.
+//
+// Each node is a contiguous run of outgoing edges sorted by label; an
+// edge records its label, whether the path so far is a word, whether it
+// is the node's last edge, and where the child node's run starts (0 when
+// the child has no edges). Edges are stored as parallel arrays so the
+// sibling scan only touches the label bytes.
+
+#define DAWG_EDGE_WORD 0x01   // Path ending with this edge is a word
+#define DAWG_EDGE_LAST 0x02   // Last edge of its node
+
+typedef struct {
+    unsigned char *labels;
+    unsigned char *flags;
+    unsigned int *children;
+    unsigned int edgeCount;   // Edge 0 is unused so 0 can mean "no child"
+    unsigned int root;        // First edge of the root node (0 if empty)
+    int wordCount;
+} Dawg;
+
+// Return FALSE to stop the enumeration
+typedef BOOL (*DawgWordCallback)(const char *word, int distance, void *context);
+
+// 'words' must be sorted with the case-insensitive dictionary order;
+// case-insensitive duplicates are collapsed
+Dawg* Dawg_Build(char * const *words, int count);
+void Dawg_Destroy(Dawg *dawg);
+
+BOOL Dawg_Contains(const Dawg *dawg, const char *word);
+
+// Every word starting with 'prefix', in folded alphabetical order
+void Dawg_EnumeratePrefix(const Dawg *dawg, const char *prefix, DawgWordCallback callback, void *context);
+
+// Every word within 'maxDistance' edits of 'word', found by walking the
+// graph with one Levenshtein row per depth and pruning dead branches
+void Dawg_FindWithinDistance(const Dawg *dawg, const char *word, int maxDistance,
+                             DawgWordCallback callback, void *context);
+
+size_t Dawg_MemoryUsage(const Dawg *dawg);
+
+#endif // DAWG_H
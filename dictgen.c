@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "embeddeddict.h"
+#include "utf8.h"
+
+// Build step: turn a word list into a C source file holding a minimal
+// perfect hash and a packed string pool as const data.
+//
+// Usage: dictgen dictionary.txt dictionary_embedded.c
+//
+// Words are read with the same rules as SpellChecker_LoadDictionary
+// (UTF-8 byte order mark dropped, trailing whitespace trimmed, blank lines
+// and '#' comments skipped) and de-duplicated on their folded form, which
+// is what the hash and the sorted order are on.
+
+#define WORDS_PER_BUCKET 4
+#define MAX_SEED 0x00FFFFFF
+
+typedef struct {
+    char *word;           // As written
+    char *folded;         // Utf8_Fold of word, same length
+    int len;
+    unsigned int bucket;
+    unsigned int rank;    // Position in folded order
+} GenWord;
+
+typedef struct {
+    unsigned int first;   // Index into the bucket-sorted word array
+    unsigned int size;
+} GenBucket;
+
+static int CompareFolded(const void *a, const void *b) {
+    return strcmp(((const GenWord *)a)->folded, ((const GenWord *)b)->folded);
+}
+
+static int CompareBucket(const void *a, const void *b) {
+    const GenWord *w1 = (const GenWord *)a;
+    const GenWord *w2 = (const GenWord *)b;
+    if (w1->bucket != w2->bucket) return w1->bucket < w2->bucket ? -1 : 1;
+    return 0;
+}
+
+static unsigned int *g_bucketOrderSizes;
+
+// Largest buckets first: they are the hardest to place
+static int CompareBucketSize(const void *a, const void *b) {
+    unsigned int s1 = g_bucketOrderSizes[*(const unsigned int *)a];
+    unsigned int s2 = g_bucketOrderSizes[*(const unsigned int *)b];
+    if (s1 != s2) return s1 > s2 ? -1 : 1;
+    return 0;
+}
+
+static int ReadWords(const char *path, GenWord **outWords) {
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    int count = 0, capacity = 1024;
+    GenWord *words = (GenWord *)malloc(capacity * sizeof(GenWord));
+    char line[256];
+    int firstLine = 1;
+
+    while (words && fgets(line, sizeof(line), file)) {
+        char *word = line;
+        if (firstLine && memcmp(word, "\xEF\xBB\xBF", 3) == 0) word += 3;
+        firstLine = 0;
+
+        int len = strlen(word);
+        while (len > 0 && isspace((unsigned char)word[len - 1])) {
+            word[--len] = '\0';
+        }
+        if (len == 0 || word[0] == '#') continue;
+
+        if (count >= capacity) {
+            capacity *= 2;
+            GenWord *newWords = (GenWord *)realloc(words, capacity * sizeof(GenWord));
+            if (!newWords) {
+                free(words);
+                words = NULL;
+                break;
+            }
+            words = newWords;
+        }
+        words[count].word = (char *)malloc(2 * (len + 1));
+        if (!words[count].word) break;
+        memcpy(words[count].word, word, len + 1);
+        words[count].folded = words[count].word + len + 1;
+        Utf8_Fold(word, len, words[count].folded);
+        words[count].len = len;
+        count++;
+    }
+
+    fclose(file);
+    if (!words) return -1;
+
+    // Drop duplicates by folded form, keeping the first spelling
+    qsort(words, count, sizeof(GenWord), CompareFolded);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique > 0 && CompareFolded(&words[unique - 1], &words[i]) == 0) {
+            free(words[i].word);
+            continue;
+        }
+        words[unique++] = words[i];
+    }
+
+    *outWords = words;
+    return unique;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: dictgen <dictionary.txt> <output.c>\n");
+        return 2;
+    }
+
+    GenWord *words = NULL;
+    int count = ReadWords(argv[1], &words);
+    if (count <= 0) {
+        fprintf(stderr, "dictgen: no words read from '%s'\n", argv[1]);
+        return 1;
+    }
+
+    unsigned int n = (unsigned int)count;
+    unsigned int bucketCount = (n + WORDS_PER_BUCKET - 1) / WORDS_PER_BUCKET;
+
+    for (unsigned int i = 0; i < n; i++) {
+        words[i].bucket = EmbeddedDictHash(words[i].folded, words[i].len, 0) % bucketCount;
+    }
+    // Remember alphabetical rank before regrouping by bucket, so the output
+    // can also list slots in word order for prefix queries
+    for (unsigned int i = 0; i < n; i++) {
+        words[i].rank = i;
+    }
+    qsort(words, n, sizeof(GenWord), CompareBucket);
+
+    GenBucket *buckets = (GenBucket *)calloc(bucketCount, sizeof(GenBucket));
+    unsigned int *bucketSizes = (unsigned int *)calloc(bucketCount, sizeof(unsigned int));
+    unsigned int *order = (unsigned int *)malloc(bucketCount * sizeof(unsigned int));
+    unsigned int *seeds = (unsigned int *)calloc(bucketCount, sizeof(unsigned int));
+    int *slotWord = (int *)malloc(n * sizeof(int));
+    unsigned int *trial = (unsigned int *)malloc(n * sizeof(unsigned int));
+    if (!buckets || !bucketSizes || !order || !seeds || !slotWord || !trial) {
+        fprintf(stderr, "dictgen: out of memory\n");
+        return 1;
+    }
+
+    for (unsigned int i = 0; i < n; i++) {
+        GenBucket *b = &buckets[words[i].bucket];
+        if (b->size == 0) b->first = i;
+        b->size++;
+    }
+    for (unsigned int b = 0; b < bucketCount; b++) {
+        bucketSizes[b] = buckets[b].size;
+        order[b] = b;
+    }
+    g_bucketOrderSizes = bucketSizes;
+    qsort(order, bucketCount, sizeof(unsigned int), CompareBucketSize);
+
+    for (unsigned int i = 0; i < n; i++) slotWord[i] = -1;
+
+    // Place each bucket with the first seed that sends all its words to
+    // distinct free slots
+    for (unsigned int o = 0; o < bucketCount; o++) {
+        GenBucket *b = &buckets[order[o]];
+        if (b->size == 0) continue;
+
+        unsigned int seed;
+        for (seed = 1; seed <= MAX_SEED; seed++) {
+            unsigned int k;
+            for (k = 0; k < b->size; k++) {
+                GenWord *w = &words[b->first + k];
+                unsigned int slot = EmbeddedDictHash(w->folded, w->len, seed) % n;
+                if (slotWord[slot] >= 0) break;
+
+                unsigned int j;
+                for (j = 0; j < k && trial[j] != slot; j++) {}
+                if (j < k) break;
+                trial[k] = slot;
+            }
+            if (k == b->size) break;
+        }
+        if (seed > MAX_SEED) {
+            fprintf(stderr, "dictgen: could not place bucket %u\n", order[o]);
+            return 1;
+        }
+
+        seeds[order[o]] = seed;
+        for (unsigned int k = 0; k < b->size; k++) {
+            slotWord[trial[k]] = (int)(b->first + k);
+        }
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out) {
+        fprintf(stderr, "dictgen: could not create '%s'\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by dictgen from %s - do not edit.\n", argv[1]);
+    fprintf(out, "// %u words, %u buckets.\n\n", n, bucketCount);
+    fprintf(out, "#include \"embeddeddict.h\"\n\n");
+
+    // Pool in slot order, so slot i's word starts at offsets[i]
+    fprintf(out, "static const char s_pool[] = {");
+    unsigned long poolSize = 0;
+    for (unsigned int s = 0; s < n; s++) {
+        GenWord *w = &words[slotWord[s]];
+        for (int c = 0; c <= w->len; c++) {
+            if (poolSize % 16 == 0) fprintf(out, "\n   ");
+            fprintf(out, " %d,", (unsigned char)w->word[c]);
+            poolSize++;
+        }
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const unsigned int s_offsets[] = {");
+    unsigned long offset = 0;
+    for (unsigned int s = 0; s < n; s++) {
+        if (s % 8 == 0) fprintf(out, "\n   ");
+        fprintf(out, " %lu,", offset);
+        offset += words[slotWord[s]].len + 1;
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const unsigned char s_lengths[] = {");
+    for (unsigned int s = 0; s < n; s++) {
+        if (s % 16 == 0) fprintf(out, "\n   ");
+        fprintf(out, " %d,", words[slotWord[s]].len);
+    }
+    fprintf(out, "\n};\n\n");
+
+    unsigned int *sortedSlots = (unsigned int *)malloc(n * sizeof(unsigned int));
+    if (!sortedSlots) {
+        fprintf(stderr, "dictgen: out of memory\n");
+        return 1;
+    }
+    for (unsigned int s = 0; s < n; s++) {
+        sortedSlots[words[slotWord[s]].rank] = s;
+    }
+    fprintf(out, "static const unsigned int s_sorted[] = {");
+    for (unsigned int i = 0; i < n; i++) {
+        if (i % 8 == 0) fprintf(out, "\n   ");
+        fprintf(out, " %u,", sortedSlots[i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const unsigned int s_seeds[] = {");
+    for (unsigned int b = 0; b < bucketCount; b++) {
+        if (b % 8 == 0) fprintf(out, "\n   ");
+        fprintf(out, " %u,", seeds[b]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "const EmbeddedDictionary g_embeddedDictionary = {\n");
+    fprintf(out, "    %u, %u, s_seeds, s_offsets, s_lengths, s_sorted, s_pool\n", n, bucketCount);
+    fprintf(out, "};\n");
+
+    fclose(out);
+    fprintf(stderr, "dictgen: %u words -> %s (%lu byte pool)\n", n, argv[2], poolSize);
+    return 0;
+}
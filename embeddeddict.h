@@ -0,0 +1,36 @@
+#ifndef EMBEDDEDDICT_H
+#define EMBEDDEDDICT_H
+
+// Compile-time dictionary produced by dictgen from dictionary.txt.
+//
+// Words are placed with a hash-and-displace minimal perfect hash: a word
+// picks a bucket with seed 0, and the bucket's stored seed sends it to its
+// own slot. Words are hashed and ordered on their case-folded form (see
+// utf8.h), so a lookup is two hashes over the folded query and one compare.
+
+typedef struct {
+    unsigned int wordCount;          // Also the slot count (minimal)
+    unsigned int bucketCount;
+    const unsigned int *seeds;       // Per bucket
+    const unsigned int *offsets;     // Per slot, into pool
+    const unsigned char *lengths;    // Per slot
+    const unsigned int *sortedSlots; // Slots in folded word order
+    const char *pool;                // NUL-separated words, original case
+} EmbeddedDictionary;
+
+// FNV-1a over a folded word, mixed with a seed. Shared by the generator
+// and the runtime lookup so both agree on every slot.
+static unsigned int EmbeddedDictHash(const char *word, int len, unsigned int seed) {
+    unsigned int h = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)word[i];
+        h *= 16777619u;
+    }
+    // Final avalanche so nearby seeds give unrelated slots
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+#endif // EMBEDDEDDICT_H
@@ -0,0 +1,470 @@
+#include "ingest.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Older SDK headers only define this for Vista and later
+#ifndef PIPE_REJECT_REMOTE_CLIENTS
+#define PIPE_REJECT_REMOTE_CLIENTS 0x00000008
+#endif
+
+typedef struct {
+    IngestServer *server;
+    HANDLE pipe;
+    HANDLE readEvent;           // Used only by the reader thread
+    HANDLE writeEvent;          // Used only by the committer
+    volatile LONG references;   // The reader plus each of its batches not yet acked
+    BOOL broken;                // An ack couldn't be delivered; committer only
+} IngestConnection;
+
+struct IngestBatch {
+    IngestBatch *next;
+    IngestConnection *connection;
+    DWORD batchId;
+    DWORD status;
+    DWORD count;
+    DWORD bytes;
+    char *payload;
+    LogRecord *records;         // Bodies point into payload
+};
+
+static void ReleaseConnection(IngestConnection *connection) {
+    if (InterlockedDecrement(&connection->references) != 0) return;
+    CloseHandle(connection->pipe);
+    if (connection->readEvent) CloseHandle(connection->readEvent);
+    if (connection->writeEvent) CloseHandle(connection->writeEvent);
+    free(connection);
+}
+
+static void FreeBatch(IngestBatch *batch) {
+    ReleaseConnection(batch->connection);
+    free(batch->payload);
+    free(batch->records);
+    free(batch);
+}
+
+// Wait for overlapped I/O this thread started. It is cancelled if 'stop'
+// (optional) is set or 'timeoutMs' passes first.
+static BOOL FinishIo(HANDLE pipe, OVERLAPPED *overlapped, HANDLE stop, DWORD timeoutMs, DWORD *transferred) {
+    HANDLE handles[2] = { overlapped->hEvent, stop };
+    DWORD result = WaitForMultipleObjects(stop ? 2 : 1, handles, FALSE, timeoutMs);
+    if (result != WAIT_OBJECT_0) {
+        CancelIo(pipe);
+        GetOverlappedResult(pipe, overlapped, transferred, TRUE);
+        return FALSE;
+    }
+    return GetOverlappedResult(pipe, overlapped, transferred, FALSE);
+}
+
+// Read exactly 'size' bytes; FALSE once the client is gone or the server stops
+static BOOL ReadPipe(IngestConnection *connection, void *buffer, DWORD size) {
+    DWORD done = 0;
+    while (done < size) {
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.hEvent = connection->readEvent;
+
+        DWORD got = 0;
+        if (!ReadFile(connection->pipe, (char *)buffer + done, size - done, NULL, &overlapped) &&
+            GetLastError() != ERROR_IO_PENDING) return FALSE;
+        if (!FinishIo(connection->pipe, &overlapped, connection->server->stopEvent, INFINITE, &got) || got == 0) return FALSE;
+        done += got;
+    }
+    return TRUE;
+}
+
+static BOOL WriteAck(IngestConnection *connection, const IngestAck *ack) {
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = connection->writeEvent;
+
+    DWORD written = 0;
+    if (!WriteFile(connection->pipe, ack, sizeof(*ack), NULL, &overlapped) &&
+        GetLastError() != ERROR_IO_PENDING) return FALSE;
+    return FinishIo(connection->pipe, &overlapped, NULL, INGEST_ACK_TIMEOUT_MS, &written) && written == sizeof(*ack);
+}
+
+// Point the batch's records into its payload. FALSE unless the entries
+// fill the payload exactly and every timestamp is one the store accepts.
+static BOOL ParseBatch(IngestBatch *batch, LONGLONG now) {
+    size_t pos = 0;
+    for (DWORD i = 0; i < batch->count; i++) {
+        IngestEntryHeader entry;
+        if (batch->bytes - pos < sizeof(entry)) return FALSE;
+        memcpy(&entry, batch->payload + pos, sizeof(entry));
+        pos += sizeof(entry);
+        if (entry.length > LOGSTORE_MAX_BODY || entry.length > batch->bytes - pos) return FALSE;
+        if (entry.timestamp < 0 || entry.timestamp >= LOGSTORE_MAX_TIMESTAMP) return FALSE;
+
+        LogRecord *record = &batch->records[i];
+        record->timestamp = entry.timestamp != 0 ? entry.timestamp : now;
+        record->flags = LOGSTORE_FLAG_INGESTED;
+        record->sequence = 0;
+        record->length = entry.length;
+        record->body = batch->payload + pos;
+        pos += entry.length;
+    }
+    return pos == batch->bytes;
+}
+
+// Queue a batch for the committer, waiting while the queue is full (a
+// batch always fits into an empty one). FALSE if the server stops first.
+static BOOL EnqueueBatch(IngestServer *server, IngestBatch *batch) {
+    for (;;) {
+        EnterCriticalSection(&server->lock);
+        if (server->queuedBytes == 0 || server->queuedBytes + batch->bytes <= INGEST_MAX_QUEUED_BYTES) {
+            if (server->queueTail) server->queueTail->next = batch;
+            else server->queueHead = batch;
+            server->queueTail = batch;
+            server->queuedBytes += batch->bytes;
+            LeaveCriticalSection(&server->lock);
+            SetEvent(server->queueEvent);
+            return TRUE;
+        }
+        ResetEvent(server->spaceEvent);
+        LeaveCriticalSection(&server->lock);
+
+        HANDLE handles[2] = { server->spaceEvent, server->stopEvent };
+        if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0) return FALSE;
+    }
+}
+
+// Read batches off one connection until the client leaves or the server
+// stops. Nothing past a malformed batch can be trusted, so it ends the
+// connection once its ack has gone out.
+static DWORD WINAPI ReaderThread(LPVOID param) {
+    IngestConnection *connection = (IngestConnection *)param;
+    IngestServer *server = connection->server;
+
+    for (;;) {
+        IngestBatchHeader header;
+        if (!ReadPipe(connection, &header, sizeof(header))) break;
+
+        IngestBatch *batch = (IngestBatch *)calloc(1, sizeof(IngestBatch));
+        if (!batch) break;
+        InterlockedIncrement(&connection->references);
+        batch->connection = connection;
+        batch->batchId = header.batchId;
+        batch->status = INGEST_STATUS_MALFORMED;
+
+        if (header.magic == INGEST_MAGIC && header.count <= INGEST_MAX_BATCH_ENTRIES &&
+            header.bytes <= INGEST_MAX_BATCH_BYTES) {
+            batch->payload = (char *)malloc(header.bytes > 0 ? header.bytes : 1);
+            batch->records = (LogRecord *)malloc((header.count > 0 ? header.count : 1) * sizeof(LogRecord));
+            if (!batch->payload || !batch->records || !ReadPipe(connection, batch->payload, header.bytes)) {
+                FreeBatch(batch);
+                break;
+            }
+            batch->count = header.count;
+            batch->bytes = header.bytes;
+            if (ParseBatch(batch, LogStore_Now())) batch->status = INGEST_STATUS_OK;
+        }
+
+        DWORD status = batch->status;
+        if (!EnqueueBatch(server, batch)) {
+            FreeBatch(batch);
+            break;
+        }
+        if (status != INGEST_STATUS_OK) break;
+    }
+
+    ReleaseConnection(connection);
+    return 0;
+}
+
+// Append every well-formed batch of a group with one write and one
+// flush, then ack the whole group in order
+static void CommitGroup(IngestServer *server, IngestBatch *group, LogRecord **records, DWORD *capacity) {
+    DWORD total = 0;
+    size_t bytes = 0;
+    for (IngestBatch *batch = group; batch; batch = batch->next) {
+        bytes += batch->bytes;
+        if (batch->status == INGEST_STATUS_OK) total += batch->count;
+    }
+
+    BOOL stored = TRUE;
+    if (total > 0) {
+        if (total > *capacity) {
+            LogRecord *grown = (LogRecord *)realloc(*records, total * sizeof(LogRecord));
+            if (grown) {
+                *records = grown;
+                *capacity = total;
+            } else {
+                stored = FALSE;
+            }
+        }
+        if (stored) {
+            DWORD count = 0;
+            for (IngestBatch *batch = group; batch; batch = batch->next) {
+                if (batch->status != INGEST_STATUS_OK) continue;
+                memcpy(*records + count, batch->records, batch->count * sizeof(LogRecord));
+                count += batch->count;
+            }
+            stored = LogStore_AppendBatch(server->store, *records, (int)count) && LogStore_Flush(server->store);
+        }
+        if (stored) server->groupsCommitted++;
+    }
+
+    EnterCriticalSection(&server->lock);
+    server->queuedBytes -= bytes;
+    SetEvent(server->spaceEvent);
+    LeaveCriticalSection(&server->lock);
+
+    while (group) {
+        IngestBatch *batch = group;
+        group = group->next;
+
+        if (batch->status == INGEST_STATUS_OK && !stored) batch->status = INGEST_STATUS_FAILED;
+        IngestAck ack;
+        memset(&ack, 0, sizeof(ack));
+        ack.batchId = batch->batchId;
+        ack.status = batch->status;
+        if (batch->status == INGEST_STATUS_OK) {
+            ack.accepted = batch->count;
+            server->batchesCommitted++;
+            server->entriesCommitted += batch->count;
+        } else {
+            server->batchesRejected++;
+        }
+
+        // A client that stopped reading acks is cut off, which also ends
+        // its reader
+        IngestConnection *connection = batch->connection;
+        if (!connection->broken && !WriteAck(connection, &ack)) {
+            connection->broken = TRUE;
+            DisconnectNamedPipe(connection->pipe);
+        }
+        FreeBatch(batch);
+    }
+}
+
+static DWORD WINAPI CommitThread(LPVOID param) {
+    IngestServer *server = (IngestServer *)param;
+    LogRecord *records = NULL;
+    DWORD capacity = 0;
+    HANDLE handles[2] = { server->queueEvent, server->commitStopEvent };
+
+    for (;;) {
+        // The readers are gone by the time the stop is signalled, so one
+        // more pass commits everything they queued
+        BOOL stopping = WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0;
+
+        EnterCriticalSection(&server->lock);
+        IngestBatch *group = server->queueHead;
+        server->queueHead = NULL;
+        server->queueTail = NULL;
+        LeaveCriticalSection(&server->lock);
+
+        if (group) CommitGroup(server, group, &records, &capacity);
+        if (stopping) break;
+    }
+
+    free(records);
+    return 0;
+}
+
+static HANDLE CreatePipeInstance(const char *pipeName, BOOL first) {
+    return CreateNamedPipe(pipeName, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                           PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                           PIPE_UNLIMITED_INSTANCES, INGEST_PIPE_BUFFER, INGEST_PIPE_BUFFER, 0, NULL);
+}
+
+// Hand a connected pipe to a new reader thread
+static void StartReader(IngestServer *server, HANDLE pipe) {
+    // Forget readers whose clients have left
+    int kept = 0;
+    for (int i = 0; i < server->readerCount; i++) {
+        if (WaitForSingleObject(server->readerThreads[i], 0) == WAIT_OBJECT_0) {
+            CloseHandle(server->readerThreads[i]);
+        } else {
+            server->readerThreads[kept++] = server->readerThreads[i];
+        }
+    }
+    server->readerCount = kept;
+
+    if (server->readerCount == server->readerCapacity) {
+        int newCapacity = server->readerCapacity ? server->readerCapacity * 2 : 8;
+        HANDLE *grown = (HANDLE *)realloc(server->readerThreads, newCapacity * sizeof(HANDLE));
+        if (!grown) {
+            CloseHandle(pipe);
+            return;
+        }
+        server->readerThreads = grown;
+        server->readerCapacity = newCapacity;
+    }
+
+    IngestConnection *connection = (IngestConnection *)calloc(1, sizeof(IngestConnection));
+    if (!connection) {
+        CloseHandle(pipe);
+        return;
+    }
+    connection->server = server;
+    connection->pipe = pipe;
+    connection->references = 1;
+    connection->readEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    connection->writeEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    HANDLE thread = NULL;
+    if (connection->readEvent && connection->writeEvent) {
+        thread = CreateThread(NULL, 0, ReaderThread, connection, 0, NULL);
+    }
+    if (!thread) {
+        ReleaseConnection(connection);
+        return;
+    }
+    server->readerThreads[server->readerCount++] = thread;
+}
+
+// Accept clients until the server stops, a fresh pipe instance for each
+static DWORD WINAPI ListenThread(LPVOID param) {
+    IngestServer *server = (IngestServer *)param;
+    HANDLE connectEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!connectEvent) return 0;
+
+    while (server->pipe != INVALID_HANDLE_VALUE) {
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.hEvent = connectEvent;
+
+        BOOL connected = ConnectNamedPipe(server->pipe, &overlapped);
+        if (!connected) {
+            DWORD error = GetLastError();
+            if (error == ERROR_PIPE_CONNECTED) {
+                connected = TRUE;
+            } else if (error == ERROR_IO_PENDING) {
+                DWORD unused;
+                connected = FinishIo(server->pipe, &overlapped, server->stopEvent, INFINITE, &unused);
+            }
+        }
+        if (WaitForSingleObject(server->stopEvent, 0) == WAIT_OBJECT_0) break;
+
+        // A client that left before being accepted just costs the instance
+        if (connected) StartReader(server, server->pipe);
+        else CloseHandle(server->pipe);
+        server->pipe = CreatePipeInstance(server->pipeName, FALSE);
+    }
+
+    CloseHandle(connectEvent);
+    return 0;
+}
+
+IngestServer* Ingest_Start(LogStore *store, const char *pipeName) {
+    if (!store || !pipeName || strlen(pipeName) >= MAX_PATH) return NULL;
+
+    IngestServer *server = (IngestServer *)calloc(1, sizeof(IngestServer));
+    if (!server) return NULL;
+    server->store = store;
+    strcpy(server->pipeName, pipeName);
+    InitializeCriticalSection(&server->lock);
+
+    // Creating the first instance fails if another process serves the name
+    server->pipe = CreatePipeInstance(pipeName, TRUE);
+    server->stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    server->commitStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    server->queueEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    server->spaceEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+    if (server->pipe != INVALID_HANDLE_VALUE && server->stopEvent && server->commitStopEvent &&
+        server->queueEvent && server->spaceEvent) {
+        server->commitThread = CreateThread(NULL, 0, CommitThread, server, 0, NULL);
+        if (server->commitThread) {
+            server->listenThread = CreateThread(NULL, 0, ListenThread, server, 0, NULL);
+        }
+    }
+
+    if (!server->listenThread) {
+        Ingest_Stop(server);
+        return NULL;
+    }
+    return server;
+}
+
+void Ingest_Stop(IngestServer *server) {
+    if (!server) return;
+
+    if (server->stopEvent) SetEvent(server->stopEvent);
+    if (server->listenThread) {
+        WaitForSingleObject(server->listenThread, INFINITE);
+        CloseHandle(server->listenThread);
+    }
+
+    // With the listener gone the reader list no longer changes
+    for (int i = 0; i < server->readerCount; i++) {
+        WaitForSingleObject(server->readerThreads[i], INFINITE);
+        CloseHandle(server->readerThreads[i]);
+    }
+    free(server->readerThreads);
+
+    if (server->commitThread) {
+        SetEvent(server->commitStopEvent);
+        WaitForSingleObject(server->commitThread, INFINITE);
+        CloseHandle(server->commitThread);
+    }
+
+    if (server->pipe != INVALID_HANDLE_VALUE) CloseHandle(server->pipe);
+    if (server->stopEvent) CloseHandle(server->stopEvent);
+    if (server->commitStopEvent) CloseHandle(server->commitStopEvent);
+    if (server->queueEvent) CloseHandle(server->queueEvent);
+    if (server->spaceEvent) CloseHandle(server->spaceEvent);
+    DeleteCriticalSection(&server->lock);
+    free(server);
+}
+
+HANDLE Ingest_Connect(const char *pipeName, DWORD timeoutMs) {
+    DWORD start = GetTickCount();
+    for (;;) {
+        HANDLE pipe = CreateFile(pipeName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (pipe != INVALID_HANDLE_VALUE) return pipe;
+
+        // Every instance is taken until the server creates the next one
+        DWORD elapsed = GetTickCount() - start;
+        if (GetLastError() != ERROR_PIPE_BUSY || elapsed >= timeoutMs) return INVALID_HANDLE_VALUE;
+        WaitNamedPipe(pipeName, timeoutMs - elapsed);
+    }
+}
+
+BOOL Ingest_SendBatch(HANDLE pipe, DWORD batchId, const LogRecord *entries, DWORD count) {
+    if (count > INGEST_MAX_BATCH_ENTRIES || (!entries && count > 0)) return FALSE;
+
+    size_t bytes = 0;
+    for (DWORD i = 0; i < count; i++) {
+        if (entries[i].length > LOGSTORE_MAX_BODY) return FALSE;
+        bytes += sizeof(IngestEntryHeader) + entries[i].length;
+    }
+    if (bytes > INGEST_MAX_BATCH_BYTES) return FALSE;
+
+    // Header and entries go out in one write
+    size_t total = sizeof(IngestBatchHeader) + bytes;
+    char *buffer = (char *)malloc(total);
+    if (!buffer) return FALSE;
+
+    IngestBatchHeader header;
+    header.magic = INGEST_MAGIC;
+    header.batchId = batchId;
+    header.count = count;
+    header.bytes = (DWORD)bytes;
+    memcpy(buffer, &header, sizeof(header));
+    size_t pos = sizeof(header);
+    for (DWORD i = 0; i < count; i++) {
+        IngestEntryHeader entry;
+        entry.timestamp = entries[i].timestamp;
+        entry.length = entries[i].length;
+        entry.reserved = 0;
+        memcpy(buffer + pos, &entry, sizeof(entry));
+        if (entries[i].length > 0) memcpy(buffer + pos + sizeof(entry), entries[i].body, entries[i].length);
+        pos += sizeof(entry) + entries[i].length;
+    }
+
+    DWORD written = 0;
+    BOOL ok = WriteFile(pipe, buffer, (DWORD)total, &written, NULL) && written == total;
+    free(buffer);
+    return ok;
+}
+
+BOOL Ingest_ReadAck(HANDLE pipe, IngestAck *ack) {
+    DWORD done = 0;
+    while (done < sizeof(*ack)) {
+        DWORD got = 0;
+        if (!ReadFile(pipe, (char *)ack + done, sizeof(*ack) - done, &got, NULL) || got == 0) return FALSE;
+        done += got;
+    }
+    return TRUE;
+}
@@ -0,0 +1,101 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <windows.h>
+#include "logstore.h"
+
+// Local ingestion endpoint for programmatic log entries.
+//
+// Scripts and tools on this machine connect to a named pipe and write
+// batches: an IngestBatchHeader, then 'count' entries, each an
+// IngestEntryHeader followed by its UTF-8 body. Clients may keep several
+// batches in flight; every batch is answered with an IngestAck, in the
+// order the connection sent them.
+//
+// One reader thread per connection parses batches onto a shared queue. A
+// single committer thread takes everything queued at once, appends it to
+// the store in one batch and flushes once, then acks each batch. Under
+// load many batches share one write and one flush (group commit), so the
+// flush cost is spread over all of them. Readers stop taking batches while
+// more than INGEST_MAX_QUEUED_BYTES wait to be committed.
+
+#define INGEST_PIPE_NAME "\\\\.\\pipe\\WorkLogIngest"
+#define INGEST_MAGIC 0x42474C57                 // "WLGB"
+#define INGEST_MAX_BATCH_ENTRIES 4096
+#define INGEST_MAX_BATCH_BYTES (4 * 1024 * 1024)
+#define INGEST_MAX_QUEUED_BYTES (16 * 1024 * 1024)
+#define INGEST_PIPE_BUFFER 65536
+#define INGEST_ACK_TIMEOUT_MS 5000              // A client that stops reading acks is dropped
+
+#define INGEST_STATUS_OK        0
+#define INGEST_STATUS_MALFORMED 1   // The connection is closed after this ack
+#define INGEST_STATUS_FAILED    2   // The store rejected the write; part may be stored
+
+typedef struct {
+    DWORD magic;
+    DWORD batchId;          // Echoed in the ack
+    DWORD count;            // Entries that follow
+    DWORD bytes;            // Size of the entries, headers included
+} IngestBatchHeader;
+
+typedef struct {
+    LONGLONG timestamp;     // Nanoseconds since 1970-01-01 UTC, 0 for the arrival time;
+                            // below LOGSTORE_MAX_TIMESTAMP or the batch is malformed
+    DWORD length;           // Body bytes that follow
+    DWORD reserved;
+} IngestEntryHeader;
+
+typedef struct {
+    DWORD batchId;
+    DWORD status;
+    DWORD accepted;         // Entries stored (all or none when status is OK or MALFORMED)
+    DWORD reserved;
+} IngestAck;
+
+typedef struct IngestBatch IngestBatch;
+
+typedef struct {
+    LogStore *store;
+    char pipeName[MAX_PATH];
+    HANDLE pipe;                // Instance waiting for the next client
+    HANDLE stopEvent;           // Stops the listener and readers
+    HANDLE commitStopEvent;     // Stops the committer once the readers are gone
+    HANDLE listenThread;
+    HANDLE commitThread;
+    CRITICAL_SECTION lock;      // Guards the queue
+    IngestBatch *queueHead;
+    IngestBatch *queueTail;
+    size_t queuedBytes;         // Includes the group being committed
+    HANDLE queueEvent;          // Batches are waiting
+    HANDLE spaceEvent;          // The queue is below INGEST_MAX_QUEUED_BYTES
+    HANDLE *readerThreads;      // Owned by the listener until it exits
+    int readerCount;
+    int readerCapacity;
+
+    // Committer totals
+    ULONGLONG entriesCommitted;
+    DWORD batchesCommitted;
+    DWORD batchesRejected;
+    DWORD groupsCommitted;      // Store writes (and flushes)
+} IngestServer;
+
+// Listen on 'pipeName' and append what arrives to 'store'. Returns NULL
+// if the pipe is already served (another instance owns it) or on failure.
+IngestServer* Ingest_Start(LogStore *store, const char *pipeName);
+
+// Stop accepting, commit and ack what was already received, and close
+// every connection. The store stays open.
+void Ingest_Stop(IngestServer *server);
+
+// Client side, on a synchronous handle.
+// Connect, waiting up to 'timeoutMs' for a free pipe instance.
+HANDLE Ingest_Connect(const char *pipeName, DWORD timeoutMs);
+
+// Send 'count' entries as one batch; only the records' timestamp, length
+// and body are used
+BOOL Ingest_SendBatch(HANDLE pipe, DWORD batchId, const LogRecord *entries, DWORD count);
+
+// Wait for the next ack
+BOOL Ingest_ReadAck(HANDLE pipe, IngestAck *ack);
+
+#endif // INGEST_H
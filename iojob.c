@@ -0,0 +1,159 @@
+#include "iojob.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARTIAL_SUFFIX ".partial"
+
+static DWORD WINAPI JobThread(LPVOID param) {
+    IoJob *job = (IoJob *)param;
+    job->succeeded = job->proc(job);
+    job->cancelled = IoJob_IsCancelled(job);
+
+    // Posted after any progress, so it is dispatched last
+    PostMessage(job->hwnd, job->message, IOJOB_COMPLETE, (LPARAM)job);
+    return 0;
+}
+
+IoJob* IoJob_Start(HWND hwnd, UINT message, IoJobProc proc, IoJobCallback onComplete,
+                   IoJobCallback onProgress, void *context) {
+    if (!hwnd || !proc || !onComplete) return NULL;
+
+    IoJob *job = (IoJob *)calloc(1, sizeof(IoJob));
+    if (!job) return NULL;
+    job->proc = proc;
+    job->onComplete = onComplete;
+    job->onProgress = onProgress;
+    job->context = context;
+    job->hwnd = hwnd;
+    job->message = message;
+
+    job->cancelEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (job->cancelEvent) job->thread = CreateThread(NULL, 0, JobThread, job, 0, NULL);
+    if (!job->thread) {
+        if (job->cancelEvent) CloseHandle(job->cancelEvent);
+        free(job);
+        return NULL;
+    }
+    return job;
+}
+
+void IoJob_Cancel(IoJob *job) {
+    if (job) SetEvent(job->cancelEvent);
+}
+
+BOOL IoJob_IsCancelled(IoJob *job) {
+    return job && WaitForSingleObject(job->cancelEvent, 0) == WAIT_OBJECT_0;
+}
+
+void IoJob_Wait(IoJob *job) {
+    if (job) WaitForSingleObject(job->thread, INFINITE);
+}
+
+void IoJob_ReportProgress(IoJob *job, ULONGLONG done, ULONGLONG total) {
+    if (!job) return;
+    InterlockedExchange64(&job->total, (LONGLONG)total);
+    InterlockedExchange64(&job->done, (LONGLONG)done);
+
+    // One message at a time; the UI reads the latest numbers when it runs
+    if (job->onProgress && InterlockedExchange(&job->progressPosted, 1) == 0) {
+        if (!PostMessage(job->hwnd, job->message, IOJOB_PROGRESS, (LPARAM)job)) job->progressPosted = 0;
+    }
+}
+
+void IoJob_Dispatch(WPARAM wParam, LPARAM lParam) {
+    IoJob *job = (IoJob *)lParam;
+    if (!job) return;
+
+    if (wParam == IOJOB_PROGRESS) {
+        InterlockedExchange(&job->progressPosted, 0);
+        if (job->onProgress) job->onProgress(job);
+        return;
+    }
+
+    // The thread posted this just before returning
+    WaitForSingleObject(job->thread, INFINITE);
+    job->onComplete(job);
+    IoJob_Free(job);
+}
+
+void IoJob_Free(IoJob *job) {
+    if (!job) return;
+    CloseHandle(job->thread);
+    CloseHandle(job->cancelEvent);
+    free(job->result);
+    free(job);
+}
+
+// Write through a queue of overlapped writes, waiting on the oldest one
+// or the cancel event. The data goes to path.partial, which replaces
+// 'path' once every byte is written.
+BOOL IoJob_WriteFile(IoJob *job, const char *path, const void *data, size_t length) {
+    char partial[MAX_PATH];
+    if (!job || !path || (!data && length > 0)) return FALSE;
+    if (snprintf(partial, sizeof(partial), "%s%s", path, PARTIAL_SUFFIX) >= (int)sizeof(partial)) return FALSE;
+
+    HANDLE hFile = CreateFile(partial, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return FALSE;
+
+    OVERLAPPED slots[IOJOB_MAX_IN_FLIGHT];
+    DWORD sizes[IOJOB_MAX_IN_FLIGHT];
+    memset(slots, 0, sizeof(slots));
+    BOOL ok = TRUE;
+    for (int i = 0; i < IOJOB_MAX_IN_FLIGHT; i++) {
+        slots[i].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (!slots[i].hEvent) ok = FALSE;
+    }
+
+    const char *bytes = (const char *)data;
+    size_t issued = 0, completed = 0;
+    int head = 0, inFlight = 0;     // Oldest write and how many are outstanding
+    while (ok && completed < length) {
+        while (inFlight < IOJOB_MAX_IN_FLIGHT && issued < length) {
+            int slot = (head + inFlight) % IOJOB_MAX_IN_FLIGHT;
+            DWORD chunk = length - issued < IOJOB_CHUNK_BYTES ? (DWORD)(length - issued) : IOJOB_CHUNK_BYTES;
+            slots[slot].Offset = (DWORD)issued;
+            slots[slot].OffsetHigh = (DWORD)((ULONGLONG)issued >> 32);
+            ResetEvent(slots[slot].hEvent);
+            if (!WriteFile(hFile, bytes + issued, chunk, NULL, &slots[slot]) && GetLastError() != ERROR_IO_PENDING) {
+                ok = FALSE;
+                break;
+            }
+            sizes[slot] = chunk;
+            issued += chunk;
+            inFlight++;
+        }
+        if (!ok) break;
+
+        HANDLE waits[2] = { slots[head].hEvent, job->cancelEvent };
+        DWORD written = 0;
+        if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0 ||
+            !GetOverlappedResult(hFile, &slots[head], &written, FALSE) || written != sizes[head]) {
+            ok = FALSE;
+            break;
+        }
+        completed += written;
+        head = (head + 1) % IOJOB_MAX_IN_FLIGHT;
+        inFlight--;
+        IoJob_ReportProgress(job, completed, length);
+    }
+
+    // Writes still outstanding must be finished with before their
+    // OVERLAPPED blocks go away
+    if (inFlight > 0) {
+        CancelIoEx(hFile, NULL);
+        for (int i = 0; i < inFlight; i++) {
+            DWORD written;
+            GetOverlappedResult(hFile, &slots[(head + i) % IOJOB_MAX_IN_FLIGHT], &written, TRUE);
+        }
+    }
+    for (int i = 0; i < IOJOB_MAX_IN_FLIGHT; i++) {
+        if (slots[i].hEvent) CloseHandle(slots[i].hEvent);
+    }
+    CloseHandle(hFile);
+
+    if (ok) ok = MoveFileEx(partial, path, MOVEFILE_REPLACE_EXISTING);
+    if (!ok) DeleteFile(partial);
+    return ok;
+}
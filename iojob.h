@@ -0,0 +1,75 @@
+#ifndef IOJOB_H
+#define IOJOB_H
+
+#include <windows.h>
+
+// Background jobs for the UI thread.
+//
+// A job runs its work function on its own thread while the window keeps
+// pumping messages. Progress and the end of the job come back as a window
+// message; the window hands it to IoJob_Dispatch, which runs the job's
+// callbacks on the UI thread. Progress messages are coalesced, so a job
+// may report as often as it likes.
+//
+// Cancelling sets a flag the work function polls between steps and
+// aborts any IoJob_WriteFile in flight. Files are written with
+// overlapped I/O, several chunks at a time, into a temporary file that
+// replaces the target only once complete, so a cancelled or failed
+// write never leaves a truncated file behind.
+
+#define IOJOB_CHUNK_BYTES (256 * 1024)
+#define IOJOB_MAX_IN_FLIGHT 4           // Overlapped writes outstanding per file
+
+#define IOJOB_PROGRESS 0                // wParam of the job's message
+#define IOJOB_COMPLETE 1
+
+typedef struct IoJob IoJob;
+
+// Runs on the job thread; FALSE when the job failed
+typedef BOOL (*IoJobProc)(IoJob *job);
+
+// Runs on the UI thread, from IoJob_Dispatch
+typedef void (*IoJobCallback)(IoJob *job);
+
+struct IoJob {
+    IoJobProc proc;
+    IoJobCallback onProgress;       // Optional
+    IoJobCallback onComplete;
+    void *context;
+    HWND hwnd;                      // Receives 'message'
+    UINT message;
+    HANDLE thread;
+    HANDLE cancelEvent;
+    volatile LONG progressPosted;   // A progress message is waiting
+    volatile LONGLONG done;         // Progress in whatever unit the job uses
+    volatile LONGLONG total;        // 0 while unknown
+    BOOL succeeded;                 // Valid in onComplete
+    BOOL cancelled;                 // Valid in onComplete
+    void *result;                   // Set by the job; freed after onComplete unless taken
+    size_t resultLength;
+};
+
+// Start 'proc' on a new thread. NULL if the thread couldn't be started.
+IoJob* IoJob_Start(HWND hwnd, UINT message, IoJobProc proc, IoJobCallback onComplete,
+                   IoJobCallback onProgress, void *context);
+
+// Ask the job to stop; it still completes, with 'cancelled' set
+void IoJob_Cancel(IoJob *job);
+BOOL IoJob_IsCancelled(IoJob *job);
+
+// Handle the job's window message. After a completion the job is freed.
+void IoJob_Dispatch(WPARAM wParam, LPARAM lParam);
+
+// Wait for the job thread to finish (at shutdown, when the completion
+// message will no longer be dispatched)
+void IoJob_Wait(IoJob *job);
+
+// Free a job that was waited for and whose completion will never be
+// dispatched. The context is left to the caller.
+void IoJob_Free(IoJob *job);
+
+// On the job thread
+void IoJob_ReportProgress(IoJob *job, ULONGLONG done, ULONGLONG total);
+BOOL IoJob_WriteFile(IoJob *job, const char *path, const void *data, size_t length);
+
+#endif // IOJOB_H
@@ -0,0 +1,524 @@
+#include "logarchive.h"
+#include "logstore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ARCHIVE_VERSION 1
+#define MINUTES_PER_DAY (24 * 60)
+
+// LZ77 codec. A block is a run of sequences, each a token byte (literal
+// count in the high nibble, match length - LZ_MIN_MATCH in the low one, 15
+// meaning "more length bytes follow"), the literals, then a 2-byte offset
+// and any extra match length bytes. The last sequence is literals only.
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 14
+#define LZ_MAX_OFFSET 65535
+#define LZ_LAST_LITERALS 5      // Block tails are always literals
+
+static DWORD LzHash(const unsigned char *p) {
+    DWORD v;
+    memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static BOOL LzPutLength(unsigned char *dst, size_t capacity, size_t *op, size_t length) {
+    while (length >= 255) {
+        if (*op >= capacity) return FALSE;
+        dst[(*op)++] = 255;
+        length -= 255;
+    }
+    if (*op >= capacity) return FALSE;
+    dst[(*op)++] = (unsigned char)length;
+    return TRUE;
+}
+
+// One sequence; matchLength 0 marks the final, literals-only one
+static BOOL LzPutSequence(unsigned char *dst, size_t capacity, size_t *op, const unsigned char *literals,
+                          size_t literalLength, size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+    if (*op >= capacity) return FALSE;
+    dst[(*op)++] = (unsigned char)(((literalLength < 15 ? literalLength : 15) << 4) |
+                                   (matchCode < 15 ? matchCode : 15));
+    if (literalLength >= 15 && !LzPutLength(dst, capacity, op, literalLength - 15)) return FALSE;
+
+    if (*op + literalLength > capacity) return FALSE;
+    memcpy(dst + *op, literals, literalLength);
+    *op += literalLength;
+    if (matchLength == 0) return TRUE;
+
+    if (*op + 2 > capacity) return FALSE;
+    dst[(*op)++] = (unsigned char)(offset & 0xFF);
+    dst[(*op)++] = (unsigned char)(offset >> 8);
+    return matchCode < 15 || LzPutLength(dst, capacity, op, matchCode - 15);
+}
+
+// Returns the compressed size, or 0 if it doesn't fit in 'capacity'
+static size_t LzCompress(const unsigned char *src, size_t length, unsigned char *dst, size_t capacity) {
+    DWORD *table = (DWORD *)calloc((size_t)1 << LZ_HASH_BITS, sizeof(DWORD));
+    if (!table) return 0;
+
+    size_t ip = 0, anchor = 0, op = 0;
+    size_t matchLimit = length > LZ_LAST_LITERALS ? length - LZ_LAST_LITERALS : 0;
+    BOOL ok = TRUE;
+
+    while (ok && ip + LZ_MIN_MATCH <= matchLimit) {
+        DWORD h = LzHash(src + ip);
+        size_t candidate = table[h];   // Position + 1, 0 when unused
+        table[h] = (DWORD)(ip + 1);
+
+        if (candidate == 0 || ip - (candidate - 1) > LZ_MAX_OFFSET ||
+            memcmp(src + candidate - 1, src + ip, LZ_MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+
+        size_t ref = candidate - 1;
+        size_t matchLength = LZ_MIN_MATCH;
+        while (ip + matchLength < matchLimit && src[ref + matchLength] == src[ip + matchLength]) {
+            matchLength++;
+        }
+
+        ok = LzPutSequence(dst, capacity, &op, src + anchor, ip - anchor, ip - ref, matchLength);
+        ip += matchLength;
+        anchor = ip;
+    }
+    if (ok) ok = LzPutSequence(dst, capacity, &op, src + anchor, length - anchor, 0, 0);
+
+    free(table);
+    return ok ? op : 0;
+}
+
+static BOOL LzGetLength(const unsigned char *src, size_t length, size_t *ip, size_t *value) {
+    unsigned char b;
+    do {
+        if (*ip >= length) return FALSE;
+        b = src[(*ip)++];
+        *value += b;
+    } while (b == 255);
+    return TRUE;
+}
+
+// Decode exactly 'rawLength' bytes; FALSE on any malformed input
+static BOOL LzDecompress(const unsigned char *src, size_t length, unsigned char *dst, size_t rawLength) {
+    size_t ip = 0, op = 0;
+
+    while (ip < length) {
+        unsigned char token = src[ip++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !LzGetLength(src, length, &ip, &literalLength)) return FALSE;
+        if (literalLength > length - ip || literalLength > rawLength - op) return FALSE;
+        memcpy(dst + op, src + ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+        if (ip == length) break;
+
+        if (length - ip < 2) return FALSE;
+        size_t offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !LzGetLength(src, length, &ip, &matchLength)) return FALSE;
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || matchLength > rawLength - op) return FALSE;
+
+        // Byte by byte: the match may overlap what it is producing
+        const unsigned char *match = dst + op - offset;
+        for (size_t i = 0; i < matchLength; i++) {
+            dst[op + i] = match[i];
+        }
+        op += matchLength;
+    }
+    return op == rawLength;
+}
+
+// Reading
+
+LogArchive* LogArchive_Open(const char *path) {
+    LogArchive *archive = (LogArchive *)calloc(1, sizeof(LogArchive));
+    if (!archive) return NULL;
+
+    archive->hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, NULL);
+    if (archive->hFile == INVALID_HANDLE_VALUE) {
+        free(archive);
+        return NULL;
+    }
+
+    LARGE_INTEGER size;
+    BOOL ok = GetFileSizeEx(archive->hFile, &size) && size.QuadPart >= (LONGLONG)sizeof(LogArchiveHeader);
+    if (ok) {
+        archive->size = (ULONGLONG)size.QuadPart;
+        archive->hMapping = CreateFileMapping(archive->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (archive->hMapping) {
+            archive->data = (const unsigned char *)MapViewOfFile(archive->hMapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        ok = archive->data != NULL;
+    }
+
+    LogArchiveHeader header;
+    if (ok) {
+        memcpy(&header, archive->data, sizeof(header));
+        ok = memcmp(header.magic, "WLAR", 4) == 0 && header.version == ARCHIVE_VERSION &&
+             header.indexOffset <= archive->size &&
+             (archive->size - header.indexOffset) / sizeof(LogArchiveBlock) >= header.blockCount;
+    }
+    if (ok && header.blockCount > 0) {
+        archive->blocks = (LogArchiveBlock *)malloc(header.blockCount * sizeof(LogArchiveBlock));
+        ok = archive->blocks != NULL;
+        if (ok) {
+            memcpy(archive->blocks, archive->data + header.indexOffset, header.blockCount * sizeof(LogArchiveBlock));
+            archive->blockCount = header.blockCount;
+        }
+    }
+    for (DWORD i = 0; ok && i < archive->blockCount; i++) {
+        const LogArchiveBlock *block = &archive->blocks[i];
+        ok = block->offset <= header.indexOffset && block->compressedSize <= header.indexOffset - block->offset &&
+             block->compressedSize <= block->rawSize;
+    }
+
+    if (!ok) {
+        LogArchive_Close(archive);
+        return NULL;
+    }
+    return archive;
+}
+
+void LogArchive_Close(LogArchive *archive) {
+    if (!archive) return;
+    if (archive->data) UnmapViewOfFile(archive->data);
+    if (archive->hMapping) CloseHandle(archive->hMapping);
+    if (archive->hFile != INVALID_HANDLE_VALUE) CloseHandle(archive->hFile);
+    free(archive->blocks);
+    free(archive);
+}
+
+BOOL LogArchive_DecodeBlock(const LogArchive *archive, DWORD block, char *out) {
+    if (!archive || block >= archive->blockCount) return FALSE;
+
+    const LogArchiveBlock *info = &archive->blocks[block];
+    const unsigned char *src = archive->data + info->offset;
+    if (info->compressedSize == info->rawSize) {
+        memcpy(out, src, info->rawSize);
+    } else if (!LzDecompress(src, info->compressedSize, (unsigned char *)out, info->rawSize)) {
+        return FALSE;
+    }
+    return LogStore_Crc32(out, info->rawSize) == info->checksum;
+}
+
+// Keep the lines of 'text' whose entry time is within [fromMinute,
+// toMinute]; lines without a time prefix go with the entry above them
+static size_t FilterLines(char *text, size_t length, int minute, int fromMinute, int toMinute) {
+    size_t pos = 0, kept = 0;
+    while (pos < length) {
+        size_t end = pos;
+        while (end < length && text[end] != '\n') end++;
+        if (end < length) end++;
+
+        int lineMinute;
+        if (LogStore_ParseTimePrefix(text + pos, end - pos, &lineMinute) > 0) minute = lineMinute;
+        if (minute >= fromMinute && minute <= toMinute) {
+            memmove(text + kept, text + pos, end - pos);
+            kept += end - pos;
+        }
+        pos = end;
+    }
+    return kept;
+}
+
+char* LogArchive_ReadDay(const LogArchive *archive, DWORD day, int fromMinute, int toMinute, size_t *length) {
+    if (!archive) return NULL;
+    BOOL wholeDay = fromMinute <= 0 && toMinute >= MINUTES_PER_DAY - 1;
+
+    // Size the result from the index before decoding anything
+    size_t total = 0;
+    BOOL found = FALSE;
+    for (DWORD i = 0; i < archive->blockCount; i++) {
+        const LogArchiveBlock *block = &archive->blocks[i];
+        if (block->day != day) continue;
+        found = TRUE;
+        if (block->lastMinute < fromMinute || block->firstMinute > toMinute) continue;
+        total += block->rawSize;
+    }
+    if (!found) return NULL;
+
+    char *text = (char *)malloc(total + 1);
+    if (!text) return NULL;
+
+    size_t used = 0;
+    for (DWORD i = 0; i < archive->blockCount; i++) {
+        const LogArchiveBlock *block = &archive->blocks[i];
+        if (block->day != day || block->lastMinute < fromMinute || block->firstMinute > toMinute) continue;
+
+        if (!LogArchive_DecodeBlock(archive, i, text + used)) {
+            free(text);
+            return NULL;
+        }
+        size_t blockLength = block->rawSize;
+        if (!wholeDay) {
+            blockLength = FilterLines(text + used, blockLength, block->startMinute, fromMinute, toMinute);
+        }
+        used += blockLength;
+    }
+
+    text[used] = '\0';
+    if (length) *length = used;
+    return text;
+}
+
+// Packing
+
+typedef struct {
+    HANDLE hFile;
+    ULONGLONG offset;
+    LogArchiveBlock *blocks;
+    DWORD blockCount;
+    DWORD blockCapacity;
+} ArchiveWriter;
+
+static BOOL WriteAll(ArchiveWriter *writer, const void *data, DWORD length) {
+    DWORD written;
+    if (!WriteFile(writer->hFile, data, length, &written, NULL) || written != length) return FALSE;
+    writer->offset += length;
+    return TRUE;
+}
+
+static BOOL AddBlock(ArchiveWriter *writer, const LogArchiveBlock *block, const void *data) {
+    if (writer->blockCount >= writer->blockCapacity) {
+        DWORD newCapacity = writer->blockCapacity > 0 ? writer->blockCapacity * 2 : 64;
+        LogArchiveBlock *newBlocks = (LogArchiveBlock *)realloc(writer->blocks, newCapacity * sizeof(LogArchiveBlock));
+        if (!newBlocks) return FALSE;
+        writer->blocks = newBlocks;
+        writer->blockCapacity = newCapacity;
+    }
+
+    LogArchiveBlock *entry = &writer->blocks[writer->blockCount];
+    *entry = *block;
+    entry->offset = writer->offset;
+    if (!WriteAll(writer, data, block->compressedSize)) return FALSE;
+    writer->blockCount++;
+    return TRUE;
+}
+
+// Compress one day's export into blocks cut after a newline
+static BOOL WriteDay(ArchiveWriter *writer, DWORD day, const char *text, size_t length, LogArchiveStats *stats) {
+    unsigned char *compressed = (unsigned char *)malloc(LOGARCHIVE_BLOCK_BYTES);
+    if (!compressed) return FALSE;
+
+    int minute = 0;             // Entry the next line belongs to
+    size_t pos = 0;
+    BOOL ok = TRUE;
+    while (ok && pos < length) {
+        size_t end = pos + LOGARCHIVE_BLOCK_BYTES < length ? pos + LOGARCHIVE_BLOCK_BYTES : length;
+        if (end < length) {
+            size_t cut = end;
+            while (cut > pos && text[cut - 1] != '\n') cut--;
+            if (cut > pos) end = cut;
+        }
+
+        LogArchiveBlock block;
+        memset(&block, 0, sizeof(block));
+        block.day = day;
+        block.startMinute = (WORD)minute;
+        block.firstMinute = block.lastMinute = (WORD)minute;
+        for (size_t line = pos; line < end; ) {
+            size_t next = line;
+            while (next < end && text[next] != '\n') next++;
+            int lineMinute;
+            if (LogStore_ParseTimePrefix(text + line, next - line, &lineMinute) > 0) minute = lineMinute;
+            if (minute < block.firstMinute) block.firstMinute = (WORD)minute;
+            if (minute > block.lastMinute) block.lastMinute = (WORD)minute;
+            line = next + 1;
+        }
+
+        block.rawSize = (DWORD)(end - pos);
+        block.checksum = LogStore_Crc32(text + pos, end - pos);
+        size_t compressedSize = LzCompress((const unsigned char *)text + pos, end - pos,
+                                           compressed, end - pos - 1);
+        if (compressedSize > 0) {
+            block.compressedSize = (DWORD)compressedSize;
+            ok = AddBlock(writer, &block, compressed);
+        } else {
+            // Incompressible: store as is
+            block.compressedSize = block.rawSize;
+            ok = AddBlock(writer, &block, text + pos);
+        }
+        if (ok && stats) {
+            stats->rawBytes += block.rawSize;
+            stats->compressedBytes += block.compressedSize;
+        }
+        pos = end;
+    }
+
+    free(compressed);
+    return ok;
+}
+
+static char* ReadWholeFile(const char *path, size_t *length) {
+    HANDLE hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER size;
+    char *data = NULL;
+    DWORD bytesRead = 0;
+    if (GetFileSizeEx(hFile, &size) && size.QuadPart < 0x7FFFFFFF) {
+        data = (char *)malloc((size_t)size.QuadPart + 1);
+        if (data && (!ReadFile(hFile, data, (DWORD)size.QuadPart, &bytesRead, NULL) ||
+                     bytesRead != (DWORD)size.QuadPart)) {
+            free(data);
+            data = NULL;
+        }
+    }
+    CloseHandle(hFile);
+    if (data) *length = bytesRead;
+    return data;
+}
+
+typedef struct {
+    DWORD day;
+    char path[MAX_PATH];
+} ExportFile;
+
+static int CompareExports(const void *a, const void *b) {
+    DWORD d1 = ((const ExportFile *)a)->day;
+    DWORD d2 = ((const ExportFile *)b)->day;
+    return d1 < d2 ? -1 : d1 > d2;
+}
+
+// Merge a month's exports (sorted by day) with its archive. The new
+// archive is written beside the old one and swapped in once complete;
+// the exports are deleted only after that.
+static BOOL PackMonth(const char *directory, DWORD month, ExportFile *exports, int count, LogArchiveStats *stats) {
+    char archivePath[MAX_PATH], tempPath[MAX_PATH];
+    snprintf(archivePath, MAX_PATH, "%s\\WorkLog_%04lu-%02lu.wla", directory,
+             (unsigned long)(month / 100), (unsigned long)(month % 100));
+    snprintf(tempPath, MAX_PATH, "%s.tmp", archivePath);
+
+    // An archive that exists but can't be read is left alone rather than
+    // replaced with one missing its days
+    LogArchive *old = LogArchive_Open(archivePath);
+    if (!old && GetFileAttributes(archivePath) != INVALID_FILE_ATTRIBUTES) return FALSE;
+
+    ArchiveWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.hFile = CreateFile(tempPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (writer.hFile == INVALID_HANDLE_VALUE) {
+        LogArchive_Close(old);
+        return FALSE;
+    }
+
+    LogArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    BOOL ok = WriteAll(&writer, &header, sizeof(header));
+
+    // Days in order; an export replaces the archived copy of its day
+    DWORD oldBlock = 0;
+    int next = 0;
+    while (ok && ((old && oldBlock < old->blockCount) || next < count)) {
+        DWORD oldDay = old && oldBlock < old->blockCount ? old->blocks[oldBlock].day : 0xFFFFFFFFu;
+        DWORD exportDay = next < count ? exports[next].day : 0xFFFFFFFFu;
+
+        if (exportDay <= oldDay) {
+            size_t length;
+            char *text = ReadWholeFile(exports[next].path, &length);
+            ok = text && WriteDay(&writer, exportDay, text, length, stats);
+            free(text);
+            next++;
+            while (old && oldBlock < old->blockCount && old->blocks[oldBlock].day == exportDay) oldBlock++;
+        } else {
+            for (; ok && oldBlock < old->blockCount && old->blocks[oldBlock].day == oldDay; oldBlock++) {
+                const LogArchiveBlock *block = &old->blocks[oldBlock];
+                ok = AddBlock(&writer, block, old->data + block->offset);
+            }
+        }
+    }
+
+    if (ok) {
+        header.indexOffset = writer.offset;
+        ok = WriteAll(&writer, writer.blocks, writer.blockCount * sizeof(LogArchiveBlock));
+    }
+    if (ok) {
+        memcpy(header.magic, "WLAR", 4);
+        header.version = ARCHIVE_VERSION;
+        header.blockCount = writer.blockCount;
+
+        LARGE_INTEGER start;
+        start.QuadPart = 0;
+        DWORD written;
+        ok = SetFilePointerEx(writer.hFile, start, NULL, FILE_BEGIN) &&
+             WriteFile(writer.hFile, &header, sizeof(header), &written, NULL) && written == sizeof(header) &&
+             FlushFileBuffers(writer.hFile);
+    }
+    CloseHandle(writer.hFile);
+    free(writer.blocks);
+    LogArchive_Close(old);
+
+    if (!ok || !MoveFileEx(tempPath, archivePath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFile(tempPath);
+        return FALSE;
+    }
+
+    for (int i = 0; i < count; i++) {
+        DeleteFile(exports[i].path);
+    }
+    if (stats) stats->filesPacked += count;
+    return TRUE;
+}
+
+BOOL LogArchive_PackExports(const char *directory, int olderThanDays, LogArchiveStats *stats) {
+    if (!directory) return FALSE;
+    if (stats) memset(stats, 0, sizeof(LogArchiveStats));
+
+    time_t cutoffTime = time(NULL) - (time_t)olderThanDays * 86400;
+    struct tm *t = localtime(&cutoffTime);
+    DWORD cutoff = (t->tm_year + 1900) * 10000 + (t->tm_mon + 1) * 100 + t->tm_mday;
+
+    char pattern[MAX_PATH];
+    snprintf(pattern, MAX_PATH, "%s\\%s", directory, LOGARCHIVE_EXPORT_PATTERN);
+
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(pattern, &findData);
+    if (hFind == INVALID_HANDLE_VALUE) return TRUE;
+
+    ExportFile *exports = NULL;
+    int count = 0, capacity = 0;
+    BOOL ok = TRUE;
+    do {
+        unsigned int year, month, dayOfMonth;
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        if (strlen(findData.cFileName) != strlen("WorkLog_YYYY-MM-DD.txt")) continue;
+        if (sscanf(findData.cFileName, "WorkLog_%4u-%2u-%2u.txt", &year, &month, &dayOfMonth) != 3) continue;
+
+        DWORD day = year * 10000 + month * 100 + dayOfMonth;
+        if (day >= cutoff) continue;
+
+        if (count >= capacity) {
+            int newCapacity = capacity > 0 ? capacity * 2 : 32;
+            ExportFile *newExports = (ExportFile *)realloc(exports, newCapacity * sizeof(ExportFile));
+            if (!newExports) {
+                ok = FALSE;
+                break;
+            }
+            exports = newExports;
+            capacity = newCapacity;
+        }
+        exports[count].day = day;
+        snprintf(exports[count].path, MAX_PATH, "%s\\%s", directory, findData.cFileName);
+        count++;
+    } while (FindNextFile(hFind, &findData));
+    FindClose(hFind);
+
+    qsort(exports, count, sizeof(ExportFile), CompareExports);
+    for (int first = 0; ok && first < count; ) {
+        int last = first;
+        while (last < count && exports[last].day / 100 == exports[first].day / 100) last++;
+        if (!PackMonth(directory, exports[first].day / 100, exports + first, last - first, stats)) ok = FALSE;
+        first = last;
+    }
+
+    free(exports);
+    return ok;
+}
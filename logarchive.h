@@ -0,0 +1,72 @@
+#ifndef LOGARCHIVE_H
+#define LOGARCHIVE_H
+
+#include <windows.h>
+
+// Cold storage for daily exports.
+//
+// Exports (WorkLog_YYYY-MM-DD.txt) older than a cut-off are packed into one
+// archive per month, WorkLog_YYYY-MM.wla, and removed. Each day's text is
+// cut at line boundaries into blocks of up to LOGARCHIVE_BLOCK_BYTES that
+// are compressed independently with a small LZ77 codec. An index at the
+// end of the file lists every block with its day, the minutes its entries
+// span, its offsets and a CRC of the raw text, so reading one day or time
+// range decompresses only the blocks that cover it.
+
+#define LOGARCHIVE_BLOCK_BYTES (64 * 1024)
+#define LOGARCHIVE_DEFAULT_AGE_DAYS 30
+#define LOGARCHIVE_EXPORT_PATTERN "WorkLog_*-*-*.txt"
+#define LOGARCHIVE_PATTERN "WorkLog_*.wla"
+
+typedef struct {
+    char magic[4];              // "WLAR"
+    DWORD version;
+    DWORD blockCount;
+    DWORD reserved;
+    ULONGLONG indexOffset;
+} LogArchiveHeader;
+
+typedef struct {
+    DWORD day;                  // YYYYMMDD
+    WORD firstMinute;           // Minutes of the day its entries span
+    WORD lastMinute;
+    DWORD rawSize;
+    DWORD compressedSize;       // Equal to rawSize when stored uncompressed
+    DWORD checksum;             // CRC-32 of the raw text
+    WORD startMinute;           // Time of the entry the first line belongs to
+    WORD reserved;
+    ULONGLONG offset;
+} LogArchiveBlock;
+
+typedef struct {
+    HANDLE hFile;
+    HANDLE hMapping;
+    const unsigned char *data;
+    ULONGLONG size;
+    LogArchiveBlock *blocks;    // In day order, a day's blocks in text order
+    DWORD blockCount;
+} LogArchive;
+
+typedef struct {
+    int filesPacked;
+    ULONGLONG rawBytes;
+    ULONGLONG compressedBytes;
+} LogArchiveStats;
+
+LogArchive* LogArchive_Open(const char *path);
+void LogArchive_Close(LogArchive *archive);
+
+// Decompress one block into 'out' (rawSize bytes); FALSE if it is corrupt
+BOOL LogArchive_DecodeBlock(const LogArchive *archive, DWORD block, char *out);
+
+// The entries of 'day' whose time falls in [fromMinute, toMinute], as
+// malloc'd NUL-terminated text. Only blocks overlapping the range are
+// decompressed. Returns NULL if the day isn't archived or on failure.
+char* LogArchive_ReadDay(const LogArchive *archive, DWORD day, int fromMinute, int toMinute, size_t *length);
+
+// Pack the exports in 'directory' dated more than 'olderThanDays' days ago
+// into their monthly archives, merging with what those already hold, then
+// delete the packed exports. 'stats' (optional) receives the totals.
+BOOL LogArchive_PackExports(const char *directory, int olderThanDays, LogArchiveStats *stats);
+
+#endif // LOGARCHIVE_H
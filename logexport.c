@@ -0,0 +1,817 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <io.h>
+#include <fcntl.h>
+#include "logstore.h"
+#include "logarchive.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LOGEXPORT_SSE2
+#endif
+
+// Structured export of the work log for analytics.
+//
+// Usage: LogExport [-f ndjson|binary] [-d directory] [-o output] [pattern]
+//
+// The entries of the segment store in 'directory' (default WorkLog) are
+// read through LogStore_Scan, a day at a time. Files matching the pattern
+// (default WorkLog_*.txt) and the days packed into the monthly archives
+// beside it are extra inputs: they are exported only for days the store
+// holds nothing for, such as logs kept before it existed. Everything goes
+// out in date order. Files are memory-mapped and archives decoded one
+// block at a time, so memory use doesn't grow with the log.
+//
+// Text is parsed in one pass that looks 16 bytes at a time for the next
+// byte that ends a line or, for NDJSON, needs escaping; everything in
+// between is copied out as is. Lines without a time prefix continue the
+// entry before them, as in the store's import, and are joined with "\n".
+// Text before the first time of a file takes the start of its day.
+//
+// NDJSON (-f ndjson, the default) writes one object per entry:
+//
+//     {"ts":1761556500000000000,"local":"2025-10-27T09:15","text":"..."}
+//
+// 'ts' is nanoseconds since 1970-01-01 UTC like the store's timestamps,
+// exact for stored entries and to the minute for text; 'local' is the day
+// and minute. Bytes that aren't valid UTF-8 become U+FFFD in the text.
+//
+// Binary (-f binary), little-endian: a LogExportHeader, then groups of up
+// to LOGEXPORT_GROUP_ENTRIES entries, each a LogExportGroup followed by
+// its columns:
+//
+//     LONGLONG timestamps[count]      // As 'ts' above
+//     DWORD offsets[count + 1]        // Into text; offsets[count] == textBytes
+//     char text[textBytes]            // As stored, then zeros to a multiple of 8
+//
+// A group with count 0 ends the file.
+
+#define DEFAULT_PATTERN "WorkLog_*.txt"
+#define DEFAULT_DIRECTORY "WorkLog"
+#define OUTPUT_BUFFER (1024 * 1024)
+#define LOGEXPORT_GROUP_ENTRIES 65536
+#define LOGEXPORT_GROUP_TEXT (4 * 1024 * 1024)
+#define LOGEXPORT_VERSION 1
+#define NS_PER_MINUTE (60LL * 1000000000LL)
+#define NOT_LINE_END ((size_t)-1)
+
+typedef struct {
+    char magic[4];              // "WLEX"
+    DWORD version;
+    DWORD groupEntries;         // Most entries in one group
+    DWORD reserved;
+} LogExportHeader;
+
+typedef struct {
+    DWORD count;
+    DWORD textBytes;            // Before padding
+} LogExportGroup;
+
+typedef enum {
+    EXPORT_NDJSON,
+    EXPORT_BINARY
+} ExportFormat;
+
+// In the order a day's sources are exported
+typedef enum {
+    SOURCE_STORED,
+    SOURCE_ARCHIVED,
+    SOURCE_FILE
+} ExportSourceKind;
+
+typedef struct {
+    char path[MAX_PATH];        // The export, the archive holding the day, or the store
+    DWORD day;                  // YYYYMMDD
+    ExportSourceKind kind;
+} ExportSource;
+
+typedef struct {
+    FILE *file;
+    char *buffer;
+    size_t used;
+    ULONGLONG written;
+    BOOL failed;
+} ExportOutput;
+
+typedef struct {
+    ExportFormat format;
+    ExportOutput out;
+
+    // Local day being exported, with the timestamp each of its hours
+    // starts at (clocks change on the hour)
+    DWORD day;
+    LONGLONG hourStart[24];
+
+    // Entry being written
+    BOOL entryOpen;
+    int pendingBlankLines;      // Written only if the entry continues after them
+
+    // Binary: the group being filled; the open entry is at 'count'
+    LONGLONG *timestamps;
+    DWORD *offsets;
+    char *text;
+    size_t textUsed;
+    size_t textCapacity;
+    int count;
+
+    ULONGLONG entries;
+    ULONGLONG inputBytes;
+    BOOL outOfMemory;           // While exporting stored records
+} Exporter;
+
+static BOOL FlushOutput(ExportOutput *out) {
+    if (out->used > 0 && !out->failed) {
+        if (fwrite(out->buffer, 1, out->used, out->file) != out->used) out->failed = TRUE;
+        out->written += out->used;
+    }
+    out->used = 0;
+    return !out->failed;
+}
+
+static void WriteOutput(ExportOutput *out, const void *data, size_t length) {
+    if (out->used + length > OUTPUT_BUFFER) {
+        FlushOutput(out);
+        if (length >= OUTPUT_BUFFER) {
+            if (!out->failed && fwrite(data, 1, length, out->file) != length) out->failed = TRUE;
+            out->written += length;
+            return;
+        }
+    }
+    memcpy(out->buffer + out->used, data, length);
+    out->used += length;
+}
+
+// Decimal digits of 'value' zero-padded to 'width', returning the length
+static int FormatNumber(char *out, ULONGLONG value, int width) {
+    char digits[24];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count < width) digits[count++] = '0';
+    for (int i = 0; i < count; i++) out[i] = digits[count - 1 - i];
+    return count;
+}
+
+// Timestamp of each local hour of a YYYYMMDD day
+static void SetExportDay(Exporter *ex, DWORD day) {
+    if (ex->day == day) return;
+    ex->day = day;
+
+    for (int hour = 0; hour < 24; hour++) {
+        SYSTEMTIME local = {0}, utc;
+        local.wYear = (WORD)(day / 10000);
+        local.wMonth = (WORD)(day / 100 % 100);
+        local.wDay = (WORD)(day % 100);
+        local.wHour = (WORD)hour;
+
+        FILETIME ft;
+        if (!TzSpecificLocalTimeToSystemTime(NULL, &local, &utc) || !SystemTimeToFileTime(&utc, &ft)) {
+            ex->hourStart[hour] = hour > 0 ? ex->hourStart[hour - 1] + 60 * NS_PER_MINUTE : 0;
+            continue;
+        }
+        ex->hourStart[hour] = LogStore_FromFileTime(&ft);
+    }
+}
+
+// Write out the finished entries of the binary group. The open entry, if
+// any, moves to the front of the next one.
+static void FlushGroup(Exporter *ex) {
+    if (ex->count == 0) return;
+
+    LogExportGroup group;
+    group.count = (DWORD)ex->count;
+    group.textBytes = ex->offsets[ex->count];
+    WriteOutput(&ex->out, &group, sizeof(group));
+    WriteOutput(&ex->out, ex->timestamps, ex->count * sizeof(LONGLONG));
+    WriteOutput(&ex->out, ex->offsets, (ex->count + 1) * sizeof(DWORD));
+    WriteOutput(&ex->out, ex->text, group.textBytes);
+    static const char padding[8] = {0};
+    WriteOutput(&ex->out, padding, (8 - group.textBytes % 8) % 8);
+
+    size_t openBytes = ex->textUsed - group.textBytes;
+    memmove(ex->text, ex->text + group.textBytes, openBytes);
+    ex->textUsed = openBytes;
+    if (ex->entryOpen) ex->timestamps[0] = ex->timestamps[ex->count];
+    ex->offsets[0] = 0;
+    ex->count = 0;
+}
+
+// Room for 'length' more bytes of the open entry's text
+static BOOL ReserveText(Exporter *ex, size_t length) {
+    if (ex->textUsed + length <= ex->textCapacity) return TRUE;
+    FlushGroup(ex);
+    if (ex->textUsed + length <= ex->textCapacity) return TRUE;
+
+    // One entry longer than a whole group
+    size_t newCapacity = ex->textCapacity * 2;
+    while (newCapacity < ex->textUsed + length) newCapacity *= 2;
+    char *newText = (char *)realloc(ex->text, newCapacity);
+    if (!newText) return FALSE;
+    ex->text = newText;
+    ex->textCapacity = newCapacity;
+    return TRUE;
+}
+
+static BOOL AppendText(Exporter *ex, const char *text, size_t length) {
+    if (ex->format == EXPORT_NDJSON) {
+        WriteOutput(&ex->out, text, length);
+        return TRUE;
+    }
+    if (!ReserveText(ex, length)) return FALSE;
+    memcpy(ex->text + ex->textUsed, text, length);
+    ex->textUsed += length;
+    return TRUE;
+}
+
+// A byte FindSpecial stopped at that isn't a line ending
+static BOOL AppendSpecial(Exporter *ex, unsigned char c) {
+    if (ex->format == EXPORT_BINARY) return AppendText(ex, (const char *)&c, 1);
+
+    char escaped[8];
+    switch (c) {
+    case '"':  memcpy(escaped, "\\\"", 2); break;
+    case '\\': memcpy(escaped, "\\\\", 2); break;
+    case '\t': memcpy(escaped, "\\t", 2); break;
+    case '\r': memcpy(escaped, "\\r", 2); break;
+    case '\n': memcpy(escaped, "\\n", 2); break;
+    default:
+        {
+            static const char hex[] = "0123456789abcdef";
+            memcpy(escaped, "\\u00", 4);
+            escaped[4] = hex[c >> 4];
+            escaped[5] = hex[c & 15];
+            WriteOutput(&ex->out, escaped, 6);
+            return TRUE;
+        }
+    }
+    WriteOutput(&ex->out, escaped, 2);
+    return TRUE;
+}
+
+// Replace the invalid UTF-8 sequence at 's' with U+FFFD, or copy the
+// valid one. Returns the bytes consumed: the whole sequence, or for an
+// invalid one the longest start of a valid sequence, at least one byte.
+static size_t AppendUtf8(Exporter *ex, const char *s, size_t length) {
+    const unsigned char *u = (const unsigned char *)s;
+    size_t need = 0;
+    unsigned char low = 0x80, high = 0xBF;     // Allowed range of the second byte
+    if (u[0] >= 0xC2 && u[0] <= 0xDF) {
+        need = 2;
+    } else if (u[0] >= 0xE0 && u[0] <= 0xEF) {
+        need = 3;
+        if (u[0] == 0xE0) low = 0xA0;           // Overlong
+        if (u[0] == 0xED) high = 0x9F;          // Surrogates
+    } else if (u[0] >= 0xF0 && u[0] <= 0xF4) {
+        need = 4;
+        if (u[0] == 0xF0) low = 0x90;           // Overlong
+        if (u[0] == 0xF4) high = 0x8F;          // Above U+10FFFF
+    }
+
+    size_t valid = need > 0 ? 1 : 0;
+    while (valid > 0 && valid < need && valid < length) {
+        unsigned char c = u[valid];
+        if (c < (valid == 1 ? low : 0x80) || c > (valid == 1 ? high : 0xBF)) break;
+        valid++;
+    }
+    if (need > 0 && valid == need) {
+        AppendText(ex, s, need);
+        return need;
+    }
+    AppendText(ex, "\xEF\xBF\xBD", 3);
+    return valid > 0 ? valid : 1;
+}
+
+static void BeginEntryAt(Exporter *ex, LONGLONG timestamp, int minuteOfDay) {
+    if (ex->format == EXPORT_BINARY && ex->count >= LOGEXPORT_GROUP_ENTRIES) FlushGroup(ex);
+    ex->entryOpen = TRUE;
+    ex->pendingBlankLines = 0;
+
+    if (ex->format == EXPORT_BINARY) {
+        ex->timestamps[ex->count] = timestamp;
+        ex->offsets[ex->count] = (DWORD)ex->textUsed;
+        return;
+    }
+
+    // {"ts":<ns>,"local":"YYYY-MM-DDThh:mm","text":"
+    char line[96];
+    int n = 6;
+    memcpy(line, "{\"ts\":", 6);
+    if (timestamp < 0) {
+        line[n++] = '-';
+        n += FormatNumber(line + n, (ULONGLONG)-timestamp, 1);
+    } else {
+        n += FormatNumber(line + n, (ULONGLONG)timestamp, 1);
+    }
+    memcpy(line + n, ",\"local\":\"", 10);
+    n += 10;
+    n += FormatNumber(line + n, ex->day / 10000, 4);
+    line[n++] = '-';
+    n += FormatNumber(line + n, ex->day / 100 % 100, 2);
+    line[n++] = '-';
+    n += FormatNumber(line + n, ex->day % 100, 2);
+    line[n++] = 'T';
+    n += FormatNumber(line + n, (ULONGLONG)(minuteOfDay / 60), 2);
+    line[n++] = ':';
+    n += FormatNumber(line + n, (ULONGLONG)(minuteOfDay % 60), 2);
+    memcpy(line + n, "\",\"text\":\"", 10);
+    n += 10;
+    WriteOutput(&ex->out, line, n);
+}
+
+// An entry from text, timed to the minute on the day being exported
+static void BeginEntry(Exporter *ex, int minuteOfDay) {
+    if (minuteOfDay < 0) minuteOfDay = 0;
+    BeginEntryAt(ex, ex->hourStart[minuteOfDay / 60] + (minuteOfDay % 60) * NS_PER_MINUTE, minuteOfDay);
+}
+
+static void EndEntry(Exporter *ex) {
+    if (!ex->entryOpen) return;
+    ex->entryOpen = FALSE;
+    ex->entries++;
+
+    if (ex->format == EXPORT_BINARY) {
+        ex->count++;
+        ex->offsets[ex->count] = (DWORD)ex->textUsed;
+    } else {
+        WriteOutput(&ex->out, "\"}\n", 3);
+    }
+}
+
+// Offset of the first byte at or after 'pos' that is a line feed or
+// carriage return, or for NDJSON anything else JSON strings can't hold
+// as is: control bytes, '"' and '\\', and non-ASCII bytes, which must be
+// checked for valid UTF-8. 'length' if there is none.
+static size_t FindSpecial(const char *text, size_t pos, size_t length, BOOL json) {
+#ifdef LOGEXPORT_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lastControl = _mm_set1_epi8(0x1F);
+    for (; pos + 16 <= length; pos += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(text + pos));
+        __m128i special;
+        if (json) {
+            // Unsigned block <= 0x1F exactly when max(block, 0x1F) == 0x1F
+            special = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(block, lastControl), lastControl),
+                                   _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)));
+        } else {
+            special = _mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, carriageReturn));
+        }
+        int mask = _mm_movemask_epi8(special);
+        if (json) mask |= _mm_movemask_epi8(block);
+        if (mask) break; // The loop below finds which of the 16 it is
+    }
+#endif
+    for (; pos < length; pos++) {
+        unsigned char c = (unsigned char)text[pos];
+        if (c == '\n' || c == '\r' || (json && (c < 0x20 || c >= 0x80 || c == '"' || c == '\\'))) return pos;
+    }
+    return length;
+}
+
+// Start of the next line if one ends at 'pos' (a line feed, or carriage
+// returns up to one or the end of the text), else NOT_LINE_END
+static size_t LineEndAt(const char *text, size_t pos, size_t length) {
+    size_t i = pos;
+    while (i < length && text[i] == '\r') i++;
+    if (i >= length) return i > pos ? length : NOT_LINE_END;
+    return text[i] == '\n' ? i + 1 : NOT_LINE_END;
+}
+
+// Export the entries in a block of whole lines. An entry left open at the
+// end continues into the next block of the same day.
+static BOOL ExportText(Exporter *ex, const char *text, size_t length) {
+    BOOL json = ex->format == EXPORT_NDJSON;
+    size_t pos = 0;
+    ex->inputBytes += length;
+
+    while (pos < length) {
+        size_t next = LineEndAt(text, pos, length);
+        if (next != NOT_LINE_END) {
+            // Blank lines stay in an entry only if text follows them
+            if (ex->entryOpen) ex->pendingBlankLines++;
+            pos = next;
+            continue;
+        }
+
+        int minuteOfDay;
+        size_t prefix = text[pos] == '[' ? LogStore_ParseTimePrefix(text + pos, length - pos, &minuteOfDay) : 0;
+        if (prefix > 0 || !ex->entryOpen) {
+            EndEntry(ex);
+            BeginEntry(ex, prefix > 0 ? minuteOfDay : -1);
+            pos += prefix;
+        } else {
+            for (int i = 0; i <= ex->pendingBlankLines; i++) {
+                if (!(json ? AppendText(ex, "\\n", 2) : AppendText(ex, "\n", 1))) return FALSE;
+            }
+            ex->pendingBlankLines = 0;
+        }
+
+        // The rest of the line, a run at a time
+        for (;;) {
+            size_t special = FindSpecial(text, pos, length, json);
+            if (special > pos && !AppendText(ex, text + pos, special - pos)) return FALSE;
+            if (special >= length) {
+                pos = length;
+                break;
+            }
+            next = LineEndAt(text, special, length);
+            if (next != NOT_LINE_END) {
+                pos = next;
+                break;
+            }
+            if ((unsigned char)text[special] >= 0x80) {
+                pos = special + AppendUtf8(ex, text + special, length - special);
+                continue;
+            }
+            if (!AppendSpecial(ex, (unsigned char)text[special])) return FALSE;
+            pos = special + 1;
+        }
+    }
+    return !ex->out.failed;
+}
+
+// Day of the last "YYYY-MM-DD" in a path, as YYYYMMDD; 0 if none
+static DWORD DayFromPath(const char *path) {
+    DWORD day = 0;
+    for (const char *p = path; strlen(p) >= 10; p++) {
+        unsigned int year, month, dayOfMonth;
+        char tail;
+        if (p[4] == '-' && p[7] == '-' &&
+            sscanf(p, "%4u-%2u-%2u%c", &year, &month, &dayOfMonth, &tail) >= 3 &&
+            month >= 1 && month <= 12 && dayOfMonth >= 1 && dayOfMonth <= 31) {
+            day = year * 10000 + month * 100 + dayOfMonth;
+        }
+    }
+    return day;
+}
+
+// Local day a file was last written, for exports named without a date
+static DWORD DayFromWriteTime(const FILETIME *lastWrite) {
+    SYSTEMTIME utc, local;
+    if (!FileTimeToSystemTime(lastWrite, &utc) || !SystemTimeToTzSpecificLocalTime(NULL, &utc, &local)) return 19700101;
+    return local.wYear * 10000 + local.wMonth * 100 + local.wDay;
+}
+
+// Directory prefix of a pattern including its separator, or "" if none
+static void PatternDirectory(const char *pattern, char *dir, size_t dirSize) {
+    dir[0] = '\0';
+    const char *slash = strrchr(pattern, '\\');
+    const char *fwd = strrchr(pattern, '/');
+    if (fwd > slash) slash = fwd;
+    if (slash && (size_t)(slash - pattern + 1) < dirSize) {
+        memcpy(dir, pattern, slash - pattern + 1);
+        dir[slash - pattern + 1] = '\0';
+    }
+}
+
+static ExportSource* AddSource(ExportSource **sources, int *count, int *capacity) {
+    if (*count >= *capacity) {
+        int newCapacity = *capacity > 0 ? *capacity * 2 : 32;
+        ExportSource *newSources = (ExportSource *)realloc(*sources, newCapacity * sizeof(ExportSource));
+        if (!newSources) return NULL;
+        *sources = newSources;
+        *capacity = newCapacity;
+    }
+    ExportSource *source = &(*sources)[(*count)++];
+    memset(source, 0, sizeof(ExportSource));
+    return source;
+}
+
+static int CompareSources(const void *a, const void *b) {
+    const ExportSource *sa = (const ExportSource *)a;
+    const ExportSource *sb = (const ExportSource *)b;
+    if (sa->day != sb->day) return sa->day < sb->day ? -1 : 1;
+    if (sa->kind != sb->kind) return sa->kind < sb->kind ? -1 : 1;
+    return strcmp(sa->path, sb->path);
+}
+
+// Every day of the store (if any), then the matching exports and the
+// archived days beside them for the days it doesn't hold, oldest first
+static int FindSources(const char *pattern, LogStore *store, const char *directory, ExportSource **sources) {
+    char dir[MAX_PATH];
+    PatternDirectory(pattern, dir, sizeof(dir));
+
+    int count = 0, capacity = 0;
+    for (int i = 0; store && i < store->segmentCount; i++) {
+        ExportSource *source = AddSource(sources, &count, &capacity);
+        if (!source) break;
+        snprintf(source->path, MAX_PATH, "%s", directory);
+        source->day = store->segments[i].day;
+        source->kind = SOURCE_STORED;
+    }
+
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(pattern, &findData);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+            ExportSource *source = AddSource(sources, &count, &capacity);
+            if (!source) break;
+            snprintf(source->path, MAX_PATH, "%s%s", dir, findData.cFileName);
+            source->day = DayFromPath(findData.cFileName);
+            if (!source->day) source->day = DayFromWriteTime(&findData.ftLastWriteTime);
+            source->kind = SOURCE_FILE;
+        } while (FindNextFile(hFind, &findData));
+        FindClose(hFind);
+    }
+
+    char archivePattern[MAX_PATH];
+    snprintf(archivePattern, MAX_PATH, "%s%s", dir, LOGARCHIVE_PATTERN);
+    hFind = FindFirstFile(archivePattern, &findData);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+            char path[MAX_PATH];
+            snprintf(path, MAX_PATH, "%s%s", dir, findData.cFileName);
+            LogArchive *archive = LogArchive_Open(path);
+            if (!archive) {
+                fprintf(stderr, "Skipping unreadable archive '%s'\n", path);
+                continue;
+            }
+            for (DWORD i = 0; i < archive->blockCount; i++) {
+                if (i > 0 && archive->blocks[i - 1].day == archive->blocks[i].day) continue;
+                ExportSource *source = AddSource(sources, &count, &capacity);
+                if (!source) break;
+                snprintf(source->path, MAX_PATH, "%s", path);
+                source->day = archive->blocks[i].day;
+                source->kind = SOURCE_ARCHIVED;
+            }
+            LogArchive_Close(archive);
+        } while (FindNextFile(hFind, &findData));
+        FindClose(hFind);
+    }
+
+    qsort(*sources, count, sizeof(ExportSource), CompareSources);
+
+    // A stored day sorts first among its sources; it is exported once,
+    // and in place of any text of the same day
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        const ExportSource *source = &(*sources)[i];
+        if (kept > 0) {
+            const ExportSource *previous = &(*sources)[kept - 1];
+            if (previous->day == source->day && previous->kind == SOURCE_STORED) continue;
+        }
+        (*sources)[kept++] = *source;
+    }
+    return kept;
+}
+
+// Export one file through a read-only mapping
+static BOOL ExportFile(Exporter *ex, const char *path) {
+    HANDLE hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return FALSE;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size)) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(hFile);
+        return TRUE;
+    }
+
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    const char *data = hMapping ? (const char *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    BOOL ok = data != NULL;
+    if (ok) {
+        ok = ExportText(ex, data, (size_t)size.QuadPart);
+        UnmapViewOfFile(data);
+    }
+    if (hMapping) CloseHandle(hMapping);
+    CloseHandle(hFile);
+    return ok;
+}
+
+// Export one archived day, decoding a block at a time into 'buffer'
+static BOOL ExportArchivedDay(Exporter *ex, const LogArchive *archive, const char *path, DWORD day,
+                              char **buffer, size_t *bufferSize) {
+    for (DWORD i = 0; i < archive->blockCount; i++) {
+        const LogArchiveBlock *block = &archive->blocks[i];
+        if (block->day != day) continue;
+
+        if (block->rawSize > *bufferSize) {
+            char *newBuffer = (char *)realloc(*buffer, block->rawSize);
+            if (!newBuffer) return FALSE;
+            *buffer = newBuffer;
+            *bufferSize = block->rawSize;
+        }
+        if (!LogArchive_DecodeBlock(archive, i, *buffer)) {
+            fprintf(stderr, "Skipping corrupt block of day %lu in '%s'\n", (unsigned long)day, path);
+            continue;
+        }
+        if (!ExportText(ex, *buffer, block->rawSize)) return FALSE;
+    }
+    return TRUE;
+}
+
+// A stored record's body as the entry's text. CRLF line breaks become
+// LF, like those between the lines of exported text.
+static BOOL AppendBody(Exporter *ex, const char *body, size_t length) {
+    BOOL json = ex->format == EXPORT_NDJSON;
+    size_t pos = 0;
+    while (pos < length) {
+        size_t special = FindSpecial(body, pos, length, json);
+        if (special > pos && !AppendText(ex, body + pos, special - pos)) return FALSE;
+        if (special >= length) break;
+
+        unsigned char c = (unsigned char)body[special];
+        if (c >= 0x80) {
+            pos = special + AppendUtf8(ex, body + special, length - special);
+            continue;
+        }
+        pos = special + 1;
+        if (c == '\r' && pos < length && body[pos] == '\n') continue;
+        if (!AppendSpecial(ex, c)) return FALSE;
+    }
+    return TRUE;
+}
+
+// LogRecordCallback: one record is one entry, at its exact time
+static BOOL ExportRecord(const LogRecord *record, void *context) {
+    Exporter *ex = (Exporter *)context;
+    EndEntry(ex);
+    BeginEntryAt(ex, record->timestamp, LogStore_LocalMinute(record->timestamp));
+    if (!AppendBody(ex, record->body, record->length)) {
+        ex->outOfMemory = TRUE;
+        return FALSE;
+    }
+    EndEntry(ex);
+    ex->inputBytes += record->length;
+    return !ex->out.failed;
+}
+
+static BOOL ExportStoredDay(Exporter *ex, LogStore *store, DWORD day) {
+    LONGLONG from, to;
+    ex->outOfMemory = FALSE;
+    return LogStore_DayRange(day, &from, &to) && LogStore_Scan(store, from, to, ExportRecord, ex) && !ex->outOfMemory;
+}
+
+static void PrintUsage(void) {
+    fprintf(stderr,
+            "Usage: LogExport [-f ndjson|binary] [-d directory] [-o output] [pattern]\n"
+            "Exports the entries of the log store in 'directory' (default " DEFAULT_DIRECTORY "), and of\n"
+            DEFAULT_PATTERN " (or the pattern) and the archives beside it for days the store\n"
+            "doesn't hold, as NDJSON or a columnar binary file.\n");
+}
+
+int main(int argc, char **argv) {
+    const char *pattern = DEFAULT_PATTERN;
+    const char *directory = DEFAULT_DIRECTORY;
+    const char *outputPath = NULL;
+    ExportFormat format = EXPORT_NDJSON;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "ndjson") == 0) {
+                format = EXPORT_NDJSON;
+            } else if (strcmp(argv[i], "binary") == 0) {
+                format = EXPORT_BINARY;
+            } else {
+                PrintUsage();
+                return 2;
+            }
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            PrintUsage();
+            return 2;
+        } else {
+            pattern = argv[i];
+        }
+    }
+
+    // Opening creates a store, so only open one that is already there
+    LogStore *store = NULL;
+    DWORD attributes = GetFileAttributes(directory);
+    if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        store = LogStore_Open(directory);
+        if (!store) fprintf(stderr, "Skipping unreadable log store '%s'\n", directory);
+    }
+
+    ExportSource *sources = NULL;
+    int sourceCount = FindSources(pattern, store, directory, &sources);
+    if (sourceCount == 0) {
+        fprintf(stderr, "No entries in '%s' and no files match '%s'\n", directory, pattern);
+        LogStore_Close(store);
+        free(sources);
+        return 2;
+    }
+
+    Exporter ex;
+    memset(&ex, 0, sizeof(ex));
+    ex.format = format;
+    ex.out.file = stdout;
+    if (outputPath) {
+        ex.out.file = fopen(outputPath, "wb");
+        if (!ex.out.file) {
+            fprintf(stderr, "Could not create '%s'\n", outputPath);
+            LogStore_Close(store);
+            free(sources);
+            return 2;
+        }
+    } else {
+        // Text mode would turn every "\n" written into "\r\n"
+        _setmode(_fileno(stdout), _O_BINARY);
+    }
+    ex.out.buffer = (char *)malloc(OUTPUT_BUFFER);
+    if (format == EXPORT_BINARY) {
+        ex.timestamps = (LONGLONG *)malloc(LOGEXPORT_GROUP_ENTRIES * sizeof(LONGLONG));
+        ex.offsets = (DWORD *)malloc((LOGEXPORT_GROUP_ENTRIES + 1) * sizeof(DWORD));
+        ex.textCapacity = LOGEXPORT_GROUP_TEXT;
+        ex.text = (char *)malloc(ex.textCapacity);
+    }
+    if (!ex.out.buffer || (format == EXPORT_BINARY && (!ex.timestamps || !ex.offsets || !ex.text))) {
+        fprintf(stderr, "Out of memory\n");
+        if (ex.out.file != stdout) fclose(ex.out.file);
+        free(ex.out.buffer);
+        free(ex.timestamps);
+        free(ex.offsets);
+        free(ex.text);
+        LogStore_Close(store);
+        free(sources);
+        return 2;
+    }
+
+    LARGE_INTEGER freq, start, stop;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    if (format == EXPORT_BINARY) {
+        LogExportHeader header = {{'W', 'L', 'E', 'X'}, LOGEXPORT_VERSION, LOGEXPORT_GROUP_ENTRIES, 0};
+        WriteOutput(&ex.out, &header, sizeof(header));
+    }
+
+    LogArchive *archive = NULL;
+    char archivePath[MAX_PATH] = "";
+    char *block = NULL;
+    size_t blockSize = 0;
+    BOOL ok = TRUE;
+    for (int s = 0; ok && s < sourceCount; s++) {
+        const ExportSource *source = &sources[s];
+        SetExportDay(&ex, source->day);
+
+        BOOL read;
+        if (source->kind == SOURCE_STORED) {
+            read = ExportStoredDay(&ex, store, source->day);
+        } else if (source->kind == SOURCE_ARCHIVED) {
+            // An archive's days sort next to each other, so it stays open for all of them
+            if (!archive || strcmp(archivePath, source->path) != 0) {
+                LogArchive_Close(archive);
+                archive = LogArchive_Open(source->path);
+                snprintf(archivePath, MAX_PATH, "%s", source->path);
+            }
+            read = archive && ExportArchivedDay(&ex, archive, source->path, source->day, &block, &blockSize);
+        } else {
+            read = ExportFile(&ex, source->path);
+        }
+        EndEntry(&ex);
+
+        if (ex.out.failed) {
+            fprintf(stderr, "Could not write the export\n");
+            ok = FALSE;
+        } else if (!read) {
+            fprintf(stderr, "Skipping unreadable '%s'\n", source->path);
+        }
+    }
+    LogArchive_Close(archive);
+    free(block);
+
+    if (format == EXPORT_BINARY) {
+        FlushGroup(&ex);
+        LogExportGroup end = {0, 0};
+        WriteOutput(&ex.out, &end, sizeof(end));
+    }
+    ok = FlushOutput(&ex.out) && ok;
+    if (fflush(ex.out.file) != 0) ok = FALSE;
+
+    QueryPerformanceCounter(&stop);
+    double seconds = (double)(stop.QuadPart - start.QuadPart) / (double)freq.QuadPart;
+    if (ex.out.file != stdout) fclose(ex.out.file);
+
+    fprintf(stderr, "Exported %llu entries from %.1f MB in %d file(s) and day(s) to %.1f MB of %s in %.3f s (%.1f MB/s)\n",
+            (unsigned long long)ex.entries, ex.inputBytes / (1024.0 * 1024.0), sourceCount,
+            ex.out.written / (1024.0 * 1024.0), format == EXPORT_BINARY ? "binary" : "NDJSON", seconds,
+            seconds > 0 ? ex.inputBytes / (1024.0 * 1024.0) / seconds : 0.0);
+
+    free(ex.out.buffer);
+    free(ex.timestamps);
+    free(ex.offsets);
+    free(ex.text);
+    free(sources);
+    LogStore_Close(store);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,753 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pattern.h"
+#include "logstore.h"
+#include "logarchive.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LOGGREP_SSE2
+#endif
+
+// Regular-expression search over the WorkLog exports, archives and store.
+//
+// Usage: LogGrep [-i] [-t threads] [-c chunkMB] [-d directory] [-o output] expression [pattern]
+//
+// Every file matching the pattern (default WorkLog_*.txt) is memory-mapped
+// and cut into line-aligned chunks of about chunkMB. Each day packed into
+// the monthly archives beside the pattern, and each day of the segment
+// store in 'directory' (default WorkLog, if it exists), is one more work
+// item; the worker that claims it decompresses the day, or renders its
+// records through LogStore_Scan as "[h:mmam] text" lines, searches it and
+// keeps only the matching lines. So at most one day per worker is held in
+// memory, however many are archived.
+//
+// Workers claim items in order. Within one, the pattern's required
+// literal is looked for 16 bytes at a time, and only the lines holding
+// one are run through the matcher. Each match is printed as
+//
+//     path:line:column: [YYYY-MM-DD h:mmam] text
+//
+// with the time of the entry the line belongs to; for archived and stored
+// days the path ends in ":YYYY-MM-DD" and lines count from the start of
+// that day. Matches are printed as soon as every item before theirs is
+// done, in the same order a single-threaded search would give.
+
+#define DEFAULT_PATTERN "WorkLog_*.txt"
+#define DEFAULT_DIRECTORY "WorkLog"
+#define DEFAULT_CHUNK_MB 4
+#define MAX_CHUNK_MB 1024
+#define MAX_ITEM_BYTES (2048ULL * 1024 * 1024)     // Chunk offsets and lengths are DWORDs
+#define MAX_WORKERS 64
+#define OUTPUT_BUFFER (1024 * 1024)
+
+typedef enum {
+    GREP_MAPPED,                // A file matching the pattern
+    GREP_ARCHIVED_DAY,          // A day in one of the archives
+    GREP_STORED_DAY             // A day of the segment store
+} GrepSource;
+
+typedef struct {
+    char path[MAX_PATH];        // As printed
+    GrepSource source;
+    HANDLE hFile;               // GREP_MAPPED only, like the three below
+    HANDLE hMapping;
+    const char *data;
+    ULONGLONG size;
+    int archiveIndex;           // GREP_ARCHIVED_DAY: which of the job's archives
+    DWORD day;                  // YYYYMMDD, 0 for a file without one in its name
+} GrepFile;
+
+typedef struct {
+    DWORD lineStart;            // Chunk-relative
+    DWORD lineLength;           // Without the line ending
+    DWORD line;                 // Chunk-relative line
+    DWORD column;               // 1-based byte column of the match
+    int minute;                 // Entry time, -1 if it began in an earlier chunk
+} GrepHit;
+
+typedef struct {
+    int fileIndex;
+    ULONGLONG offset;           // Chunk start within a mapped file
+    DWORD length;               // Set by the worker for a day it loads
+    DWORD lineCount;            // Newlines inside the chunk
+    int lastMinute;             // Time of the chunk's last entry, -1 if none starts in it
+    GrepHit *hits;
+    int hitCount;
+    int hitCapacity;
+    char *lines;                // A loaded day's matching lines, which the hits point into
+    volatile LONG done;
+} WorkItem;
+
+typedef struct {
+    const Pattern *pattern;
+    GrepFile *files;
+    int fileCount;
+    int fileCapacity;
+    LogArchive **archives;
+    int archiveCount;
+    int archiveCapacity;
+    LogStore *store;            // NULL if there is none
+    WorkItem *items;
+    int itemCount;
+    volatile LONG nextItem;
+    HANDLE itemDone;            // Auto-reset; set whenever a chunk finishes
+} GrepJob;
+
+static DWORD CountNewlines(const char *text, size_t length) {
+    DWORD count = 0;
+    size_t i = 0;
+#ifdef LOGGREP_SSE2
+    // Each byte lane counts its newlines (a match is -1) for up to 255
+    // blocks, then _mm_sad_epu8 sums the lanes into two 64-bit halves
+    __m128i newline = _mm_set1_epi8('\n');
+    __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= length) {
+        __m128i lanes = zero;
+        for (int blocks = 0; blocks < 255 && i + 16 <= length; blocks++, i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *)(text + i));
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(block, newline));
+        }
+        __m128i sums = _mm_sad_epu8(lanes, zero);
+        count += (DWORD)(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+    }
+#endif
+    for (; i < length; i++) {
+        if (text[i] == '\n') count++;
+    }
+    return count;
+}
+
+// Time of the latest entry starting on a line from 'lineStart' back to
+// 'floor' (both line starts), or -1 if none does
+static int FindEntryMinute(const char *text, size_t floor, size_t lineStart, size_t length) {
+    for (;;) {
+        int minute;
+        if (LogStore_ParseTimePrefix(text + lineStart, length - lineStart, &minute) > 0) return minute;
+        if (lineStart <= floor) return -1;
+
+        lineStart--;
+        while (lineStart > floor && text[lineStart - 1] != '\n') lineStart--;
+    }
+}
+
+static BOOL AddHit(WorkItem *item, const GrepHit *hit) {
+    if (item->hitCount >= item->hitCapacity) {
+        int newCapacity = item->hitCapacity > 0 ? item->hitCapacity * 2 : 16;
+        GrepHit *newHits = (GrepHit *)realloc(item->hits, newCapacity * sizeof(GrepHit));
+        if (!newHits) return FALSE;
+        item->hits = newHits;
+        item->hitCapacity = newCapacity;
+    }
+    item->hits[item->hitCount++] = *hit;
+    return TRUE;
+}
+
+// Search one chunk. Newlines are only counted up to each hit, and entry
+// times only looked for back to the previous hit, so a chunk without
+// candidates costs little more than the literal scan.
+static void SearchChunk(const GrepJob *job, WorkItem *item, const char *text, size_t length) {
+    size_t pos = 0, counted = 0, timeFloor = 0;
+    DWORD line = 0;
+    int minute = -1;
+
+    while (pos < length) {
+        size_t candidate = Pattern_FindCandidate(job->pattern, text, length, pos);
+        if (candidate >= length) break;
+
+        size_t lineStart = candidate;
+        while (lineStart > pos && text[lineStart - 1] != '\n') lineStart--;
+        const char *newline = (const char *)memchr(text + candidate, '\n', length - candidate);
+        size_t lineEnd = newline ? (size_t)(newline - text) : length;
+        size_t contentEnd = lineEnd;
+        if (contentEnd > lineStart && text[contentEnd - 1] == '\r') contentEnd--;
+
+        size_t matchStart, matchEnd;
+        if (Pattern_MatchLine(job->pattern, text + lineStart, contentEnd - lineStart, &matchStart, &matchEnd)) {
+            line += CountNewlines(text + counted, lineStart - counted);
+            counted = lineStart;
+
+            int found = FindEntryMinute(text, timeFloor, lineStart, length);
+            if (found >= 0) minute = found;
+            timeFloor = lineStart;
+
+            GrepHit hit;
+            hit.lineStart = (DWORD)lineStart;
+            hit.lineLength = (DWORD)(contentEnd - lineStart);
+            hit.line = line;
+            hit.column = (DWORD)matchStart + 1;
+            hit.minute = minute;
+            if (!AddHit(item, &hit)) break;
+        }
+        pos = newline ? lineEnd + 1 : length;
+    }
+
+    item->lineCount = line + CountNewlines(text + counted, length - counted);
+
+    // The entry running at the end of the chunk carries into the next one
+    size_t lastLine = length;
+    if (lastLine > 0 && text[lastLine - 1] == '\n') lastLine--;
+    while (lastLine > timeFloor && text[lastLine - 1] != '\n') lastLine--;
+    item->lastMinute = length > 0 ? FindEntryMinute(text, timeFloor, lastLine, length) : -1;
+    if (item->lastMinute < 0) item->lastMinute = minute;
+}
+
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+    BOOL failed;
+} DayText;
+
+static BOOL AppendDayText(DayText *day, const char *text, size_t length) {
+    if (day->length + length + 1 > day->capacity) {
+        size_t newCapacity = day->capacity > 0 ? day->capacity * 2 : 64 * 1024;
+        while (newCapacity < day->length + length + 1) newCapacity *= 2;
+        char *newText = newCapacity < MAX_ITEM_BYTES ? (char *)realloc(day->text, newCapacity) : NULL;
+        if (!newText) {
+            day->failed = TRUE;
+            return FALSE;
+        }
+        day->text = newText;
+        day->capacity = newCapacity;
+    }
+    memcpy(day->text + day->length, text, length);
+    day->length += length;
+    day->text[day->length] = '\0';
+    return TRUE;
+}
+
+// One record as the lines an export would hold for it
+static BOOL RenderStoredRecord(const LogRecord *record, void *context) {
+    DayText *day = (DayText *)context;
+    char prefix[32];
+    int prefixLength = LogStore_FormatTimePrefix(record->timestamp, prefix, sizeof(prefix));
+    return AppendDayText(day, prefix, prefixLength) && AppendDayText(day, record->body, record->length) &&
+           AppendDayText(day, "\n", 1);
+}
+
+// Decompress or render the day a work item stands for. NULL if it is
+// unreadable or too large to search in one piece.
+static char* LoadDay(const GrepJob *job, const GrepFile *file, size_t *length) {
+    char *text = NULL;
+    *length = 0;
+    if (file->source == GREP_ARCHIVED_DAY) {
+        text = LogArchive_ReadDay(job->archives[file->archiveIndex], file->day, 0, 24 * 60 - 1, length);
+    } else {
+        LONGLONG from, to;
+        DayText day = {0};
+        BOOL scanned = LogStore_DayRange(file->day, &from, &to) &&
+                       LogStore_Scan(job->store, from, to, RenderStoredRecord, &day) && !day.failed;
+        if (scanned && !day.text) day.text = (char *)calloc(1, 1);
+        if (scanned) {
+            text = day.text;
+            *length = day.length;
+        } else {
+            free(day.text);
+        }
+    }
+    if (text && *length >= MAX_ITEM_BYTES) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+// Keep only the lines a loaded day's hits are on, so the day itself can
+// be freed before the hits are printed
+static BOOL KeepHitLines(WorkItem *item, const char *text) {
+    if (item->hitCount == 0) return TRUE;
+    size_t total = 0;
+    for (int h = 0; h < item->hitCount; h++) total += item->hits[h].lineLength;
+
+    item->lines = (char *)malloc(total > 0 ? total : 1);
+    if (!item->lines) return FALSE;
+    DWORD used = 0;
+    for (int h = 0; h < item->hitCount; h++) {
+        GrepHit *hit = &item->hits[h];
+        memcpy(item->lines + used, text + hit->lineStart, hit->lineLength);
+        hit->lineStart = used;
+        used += hit->lineLength;
+    }
+    return TRUE;
+}
+
+static void ProcessItem(GrepJob *job, WorkItem *item) {
+    const GrepFile *file = &job->files[item->fileIndex];
+    if (file->source == GREP_MAPPED) {
+        SearchChunk(job, item, file->data + item->offset, item->length);
+        return;
+    }
+
+    size_t length;
+    char *text = LoadDay(job, file, &length);
+    if (!text) {
+        fprintf(stderr, "Skipping unreadable day '%s'\n", file->path);
+        item->lastMinute = -1;
+        return;
+    }
+    item->length = (DWORD)length;
+    SearchChunk(job, item, text, length);
+    if (!KeepHitLines(item, text)) {
+        fprintf(stderr, "Out of memory keeping matches of '%s'\n", file->path);
+        item->hitCount = 0;
+    }
+    free(text);
+}
+
+static DWORD WINAPI WorkerThread(LPVOID param) {
+    GrepJob *job = (GrepJob *)param;
+
+    // Chunks are claimed in order, so the front of the output completes
+    // first and can be printed while the rest is searched
+    for (;;) {
+        LONG index = InterlockedIncrement(&job->nextItem) - 1;
+        if (index >= job->itemCount) break;
+
+        WorkItem *item = &job->items[index];
+        ProcessItem(job, item);
+        InterlockedExchange(&item->done, 1);
+        SetEvent(job->itemDone);
+    }
+    return 0;
+}
+
+// Map a file read-only; empty files are kept with a NULL view
+static BOOL MapGrepFile(GrepFile *file) {
+    file->hFile = CreateFile(file->path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file->hFile == INVALID_HANDLE_VALUE) return FALSE;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->hFile, &size)) {
+        CloseHandle(file->hFile);
+        return FALSE;
+    }
+    file->size = (ULONGLONG)size.QuadPart;
+    if (file->size == 0) return TRUE;
+
+    file->hMapping = CreateFileMapping(file->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!file->hMapping) {
+        CloseHandle(file->hFile);
+        return FALSE;
+    }
+    file->data = (const char *)MapViewOfFile(file->hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->data) {
+        CloseHandle(file->hMapping);
+        CloseHandle(file->hFile);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void UnmapGrepFile(GrepFile *file) {
+    if (file->data) UnmapViewOfFile(file->data);
+    if (file->hMapping) CloseHandle(file->hMapping);
+    if (file->hFile && file->hFile != INVALID_HANDLE_VALUE) CloseHandle(file->hFile);
+}
+
+static WorkItem* AddWorkItem(WorkItem **items, int *itemCount, int *itemCapacity, int fileIndex) {
+    if (*itemCount >= *itemCapacity) {
+        int newCapacity = *itemCapacity > 0 ? *itemCapacity * 2 : 64;
+        WorkItem *newItems = (WorkItem *)realloc(*items, newCapacity * sizeof(WorkItem));
+        if (!newItems) return NULL;
+        *items = newItems;
+        *itemCapacity = newCapacity;
+    }
+    WorkItem *item = &(*items)[(*itemCount)++];
+    memset(item, 0, sizeof(WorkItem));
+    item->fileIndex = fileIndex;
+    return item;
+}
+
+// Cut a file into chunks of roughly chunkSize bytes, each ending just
+// after a newline so no line straddles two chunks. Only a line longer
+// than MAX_ITEM_BYTES is cut, there.
+static BOOL SplitGrepFile(GrepFile *file, int fileIndex, ULONGLONG chunkSize,
+                          WorkItem **items, int *itemCount, int *itemCapacity) {
+    ULONGLONG offset = 0;
+
+    while (offset < file->size) {
+        ULONGLONG end = offset + chunkSize;
+        if (end >= file->size) {
+            end = file->size;
+        } else {
+            ULONGLONG limit = offset + MAX_ITEM_BYTES < file->size ? offset + MAX_ITEM_BYTES : file->size;
+            const char *nl = (const char *)memchr(file->data + end, '\n', (size_t)(limit - end));
+            end = nl ? (ULONGLONG)(nl - file->data) + 1 : limit;
+        }
+
+        WorkItem *item = AddWorkItem(items, itemCount, itemCapacity, fileIndex);
+        if (!item) return FALSE;
+        item->offset = offset;
+        item->length = (DWORD)(end - offset);
+
+        offset = end;
+    }
+    return TRUE;
+}
+
+// Day of the last "YYYY-MM-DD" in a path, as YYYYMMDD; 0 if none
+static DWORD DayFromPath(const char *path) {
+    DWORD day = 0;
+    for (const char *p = path; strlen(p) >= 10; p++) {
+        unsigned int year, month, dayOfMonth;
+        char tail;
+        if (p[4] == '-' && p[7] == '-' &&
+            sscanf(p, "%4u-%2u-%2u%c", &year, &month, &dayOfMonth, &tail) >= 3 &&
+            month >= 1 && month <= 12 && dayOfMonth >= 1 && dayOfMonth <= 31) {
+            day = year * 10000 + month * 100 + dayOfMonth;
+        }
+    }
+    return day;
+}
+
+// Directory prefix of a pattern including its separator, or "" if none
+static void PatternDirectory(const char *pattern, char *dir, size_t dirSize) {
+    dir[0] = '\0';
+    const char *slash = strrchr(pattern, '\\');
+    const char *fwd = strrchr(pattern, '/');
+    if (fwd > slash) slash = fwd;
+    if (slash && (size_t)(slash - pattern + 1) < dirSize) {
+        memcpy(dir, pattern, slash - pattern + 1);
+        dir[slash - pattern + 1] = '\0';
+    }
+}
+
+static GrepFile* AddGrepFile(GrepJob *job, GrepSource source) {
+    if (job->fileCount >= job->fileCapacity) {
+        int newCapacity = job->fileCapacity > 0 ? job->fileCapacity * 2 : 32;
+        GrepFile *newFiles = (GrepFile *)realloc(job->files, newCapacity * sizeof(GrepFile));
+        if (!newFiles) return NULL;
+        job->files = newFiles;
+        job->fileCapacity = newCapacity;
+    }
+    GrepFile *file = &job->files[job->fileCount++];
+    memset(file, 0, sizeof(GrepFile));
+    file->source = source;
+    return file;
+}
+
+static void NameDay(GrepFile *file, const char *path, DWORD day) {
+    snprintf(file->path, MAX_PATH, "%s:%04lu-%02lu-%02lu", path, (unsigned long)(day / 10000),
+             (unsigned long)(day / 100 % 100), (unsigned long)(day % 100));
+    file->day = day;
+}
+
+// Open an archive and add each day in its index; nothing is decompressed
+// until a worker claims the day
+static void AddArchivedDays(GrepJob *job, const char *path) {
+    LogArchive *archive = LogArchive_Open(path);
+    if (!archive) {
+        fprintf(stderr, "Skipping unreadable archive '%s'\n", path);
+        return;
+    }
+    if (job->archiveCount >= job->archiveCapacity) {
+        int newCapacity = job->archiveCapacity > 0 ? job->archiveCapacity * 2 : 16;
+        LogArchive **newArchives = (LogArchive **)realloc(job->archives, newCapacity * sizeof(LogArchive *));
+        if (!newArchives) {
+            LogArchive_Close(archive);
+            return;
+        }
+        job->archives = newArchives;
+        job->archiveCapacity = newCapacity;
+    }
+    int archiveIndex = job->archiveCount++;
+    job->archives[archiveIndex] = archive;
+
+    for (DWORD i = 0; i < archive->blockCount; i++) {
+        DWORD day = archive->blocks[i].day;
+        if (i > 0 && archive->blocks[i - 1].day == day) continue;
+
+        GrepFile *file = AddGrepFile(job, GREP_ARCHIVED_DAY);
+        if (!file) break;
+        NameDay(file, path, day);
+        file->archiveIndex = archiveIndex;
+    }
+}
+
+static int CompareDays(const void *a, const void *b) {
+    DWORD x = *(const DWORD *)a, y = *(const DWORD *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Add each day the store has a segment for, oldest first
+static void AddStoredDays(GrepJob *job, const char *directory) {
+    int count = job->store->segmentCount;
+    DWORD *days = (DWORD *)malloc((count > 0 ? count : 1) * sizeof(DWORD));
+    if (!days) return;
+    for (int i = 0; i < count; i++) days[i] = job->store->segments[i].day;
+    qsort(days, count, sizeof(DWORD), CompareDays);
+
+    for (int i = 0; i < count; i++) {
+        if (i > 0 && days[i] == days[i - 1]) continue;
+        GrepFile *file = AddGrepFile(job, GREP_STORED_DAY);
+        if (!file) break;
+        NameDay(file, directory, days[i]);
+    }
+    free(days);
+}
+
+// Collect matching files, then the archived days in the pattern's
+// directory (the directory prefix is kept for opening), then the days in
+// the store
+static void FindGrepFiles(GrepJob *job, const char *pattern, const char *directory) {
+    char dir[MAX_PATH];
+    PatternDirectory(pattern, dir, sizeof(dir));
+
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(pattern, &findData);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+            GrepFile *file = AddGrepFile(job, GREP_MAPPED);
+            if (!file) break;
+            snprintf(file->path, MAX_PATH, "%s%s", dir, findData.cFileName);
+            file->day = DayFromPath(findData.cFileName);
+        } while (FindNextFile(hFind, &findData));
+        FindClose(hFind);
+    }
+
+    char archivePattern[MAX_PATH];
+    snprintf(archivePattern, MAX_PATH, "%s%s", dir, LOGARCHIVE_PATTERN);
+    hFind = FindFirstFile(archivePattern, &findData);
+    if (hFind != INVALID_HANDLE_VALUE) {
+        do {
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+
+            char path[MAX_PATH];
+            snprintf(path, MAX_PATH, "%s%s", dir, findData.cFileName);
+            AddArchivedDays(job, path);
+        } while (FindNextFile(hFind, &findData));
+        FindClose(hFind);
+    }
+
+    // Opening creates a store, so only open one that is already there
+    DWORD attributes = GetFileAttributes(directory);
+    if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        job->store = LogStore_Open(directory);
+        if (job->store) {
+            AddStoredDays(job, directory);
+        } else {
+            fprintf(stderr, "Skipping unreadable log store '%s'\n", directory);
+        }
+    }
+}
+
+// Where printing stands in the current file
+typedef struct {
+    int fileIndex;
+    DWORD lineBase;
+    int minute;
+} PrintState;
+
+static void PrintItem(FILE *out, const GrepFile *files, const WorkItem *item, const char *text, PrintState *state) {
+    const GrepFile *file = &files[item->fileIndex];
+    if (item->fileIndex != state->fileIndex) {
+        state->fileIndex = item->fileIndex;
+        state->lineBase = 1;
+        state->minute = -1;
+    }
+
+    for (int h = 0; h < item->hitCount; h++) {
+        const GrepHit *hit = &item->hits[h];
+        int minute = hit->minute >= 0 ? hit->minute : state->minute;
+
+        fprintf(out, "%s:%lu:%lu: ", file->path, (unsigned long)(state->lineBase + hit->line),
+                (unsigned long)hit->column);
+        if (minute >= 0) {
+            int hour = minute / 60;
+            if (file->day) {
+                fprintf(out, "[%04lu-%02lu-%02lu ", (unsigned long)(file->day / 10000),
+                        (unsigned long)(file->day / 100 % 100), (unsigned long)(file->day % 100));
+            } else {
+                fputc('[', out);
+            }
+            fprintf(out, "%d:%02d%s] ", hour % 12 == 0 ? 12 : hour % 12, minute % 60, hour < 12 ? "am" : "pm");
+        }
+        fwrite(text + hit->lineStart, 1, hit->lineLength, out);
+        fputc('\n', out);
+    }
+
+    state->lineBase += item->lineCount;
+    if (item->lastMinute >= 0) state->minute = item->lastMinute;
+}
+
+static void PrintUsage(void) {
+    fprintf(stderr,
+            "Usage: LogGrep [-i] [-t threads] [-c chunkMB] [-d directory] [-o output] expression [pattern]\n"
+            "Default pattern is " DEFAULT_PATTERN ". Archives beside it and the log store in\n"
+            "'directory' (default " DEFAULT_DIRECTORY ") are searched too; -i ignores case.\n");
+}
+
+int main(int argc, char **argv) {
+    const char *expression = NULL;
+    const char *pattern = DEFAULT_PATTERN;
+    const char *directory = DEFAULT_DIRECTORY;
+    const char *outputPath = NULL;
+    int workerCount = 0;
+    int chunkMB = DEFAULT_CHUNK_MB;
+    DWORD flags = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            workerCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            chunkMB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0) {
+            flags |= PATTERN_IGNORE_CASE;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            PrintUsage();
+            return 2;
+        } else if (!expression) {
+            expression = argv[i];
+        } else {
+            pattern = argv[i];
+        }
+    }
+    if (!expression) {
+        PrintUsage();
+        return 2;
+    }
+
+    char error[128];
+    Pattern *compiled = Pattern_Compile(expression, flags, error, sizeof(error));
+    if (!compiled) {
+        fprintf(stderr, "Bad expression '%s': %s\n", expression, error);
+        return 2;
+    }
+
+    if (workerCount <= 0) {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        workerCount = (int)si.dwNumberOfProcessors;
+    }
+    if (workerCount > MAX_WORKERS) workerCount = MAX_WORKERS;
+    if (chunkMB <= 0) chunkMB = DEFAULT_CHUNK_MB;
+    if (chunkMB > MAX_CHUNK_MB) chunkMB = MAX_CHUNK_MB;
+
+    GrepJob job = {0};
+    job.pattern = compiled;
+    FindGrepFiles(&job, pattern, directory);
+    GrepFile *files = job.files;
+    int fileCount = job.fileCount;
+    if (fileCount == 0) {
+        fprintf(stderr, "No files match '%s' and no log store is in '%s'\n", pattern, directory);
+        Pattern_Destroy(compiled);
+        return 2;
+    }
+
+    // A mapped file is cut into chunks; a day is one item, loaded by its worker
+    WorkItem *items = NULL;
+    int itemCount = 0, itemCapacity = 0;
+    for (int f = 0; f < fileCount; f++) {
+        BOOL planned;
+        if (files[f].source != GREP_MAPPED) {
+            planned = AddWorkItem(&items, &itemCount, &itemCapacity, f) != NULL;
+        } else if (!MapGrepFile(&files[f])) {
+            fprintf(stderr, "Skipping unreadable file '%s'\n", files[f].path);
+            files[f].hFile = NULL;
+            continue;
+        } else {
+            planned = SplitGrepFile(&files[f], f, (ULONGLONG)chunkMB * 1024 * 1024, &items, &itemCount, &itemCapacity);
+        }
+        if (!planned) {
+            fprintf(stderr, "Out of memory while planning work\n");
+            return 2;
+        }
+    }
+    if (workerCount > itemCount) workerCount = itemCount > 0 ? itemCount : 1;
+
+    FILE *out = stdout;
+    if (outputPath) {
+        out = fopen(outputPath, "w");
+        if (!out) {
+            fprintf(stderr, "Could not create '%s'\n", outputPath);
+            out = stdout;
+        }
+    }
+    setvbuf(out, NULL, _IOFBF, OUTPUT_BUFFER);
+
+    job.items = items;
+    job.itemCount = itemCount;
+    job.itemDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+    HANDLE *threads = (HANDLE *)calloc(workerCount, sizeof(HANDLE));
+    if (!job.itemDone || !threads) {
+        fprintf(stderr, "Out of memory while starting workers\n");
+        return 2;
+    }
+
+    LARGE_INTEGER freq, start, stop;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    int started = 0;
+    for (int w = 0; w < workerCount; w++) {
+        threads[w] = CreateThread(NULL, 0, WorkerThread, &job, 0, NULL);
+        if (!threads[w]) break;
+        started++;
+    }
+
+    // Run inline if no thread could be started
+    if (started == 0) {
+        WorkerThread(&job);
+    }
+
+    // Print each chunk once it and everything before it are done
+    PrintState state = { -1, 1, -1 };
+    long long matchCount = 0;
+    ULONGLONG totalBytes = 0;
+    int printed = 0;
+    while (printed < itemCount) {
+        while (printed < itemCount && items[printed].done) {
+            WorkItem *item = &items[printed];
+            const char *text = item->lines ? item->lines : files[item->fileIndex].data + item->offset;
+            PrintItem(out, files, item, text, &state);
+            matchCount += item->hitCount;
+            totalBytes += item->length;
+            free(item->hits);
+            free(item->lines);
+            item->hits = NULL;
+            item->lines = NULL;
+            printed++;
+        }
+        if (printed < itemCount) WaitForSingleObject(job.itemDone, INFINITE);
+    }
+    fflush(out);
+
+    for (int w = 0; w < started; w++) {
+        WaitForSingleObject(threads[w], INFINITE);
+        CloseHandle(threads[w]);
+    }
+
+    QueryPerformanceCounter(&stop);
+    double seconds = (double)(stop.QuadPart - start.QuadPart) / (double)freq.QuadPart;
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "Searched %.1f MB in %d file(s) and day(s), %d chunk(s) with %d thread(s) in %.3f s "
+            "(%.1f MB/s): %lld matching line(s)\n",
+            totalBytes / (1024.0 * 1024.0), fileCount, itemCount, workerCount, seconds,
+            seconds > 0 ? totalBytes / (1024.0 * 1024.0) / seconds : 0.0, matchCount);
+
+    for (int f = 0; f < fileCount; f++) {
+        if (files[f].source == GREP_MAPPED) UnmapGrepFile(&files[f]);
+    }
+    for (int a = 0; a < job.archiveCount; a++) {
+        LogArchive_Close(job.archives[a]);
+    }
+    if (job.store) LogStore_Close(job.store);
+    CloseHandle(job.itemDone);
+    free(threads);
+    free(items);
+    free(files);
+    free(job.archives);
+    Pattern_Destroy(compiled);
+    return matchCount > 0 ? 0 : 1;
+}
@@ -0,0 +1,385 @@
+#include <windows.h>
+#include <shellapi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logstore.h"
+#include "ingest.h"
+
+// Command-line client for the ingestion pipe, and its load generator.
+//
+// Usage: LogIngest [-p pipe] entry...        send the arguments as entries
+//        LogIngest [-p pipe] -               send each line of stdin
+//        LogIngest -bench [-c connections] [-n entries] [-b batch]
+//                         [-w window] [-s bytes] [-d directory]
+//
+// Entries go to the running Logger unless -p names another pipe. The
+// benchmark starts its own server on a private pipe over a scratch store
+// (default IngestBench), so the real log is never touched. Each connection
+// keeps up to 'window' batches in flight and times every batch from send
+// to ack; the totals give entries per second and the latency percentiles.
+
+#define STDIN_BATCH_ENTRIES 256
+#define STDIN_WINDOW 8
+#define CONNECT_TIMEOUT_MS 2000
+#define MAX_CONNECTIONS 64
+#define MAX_LINE (64 * 1024)
+
+typedef struct {
+    const char *pipeName;
+    int index;
+    int entries;
+    int batchSize;
+    int window;
+    int entryBytes;
+    LONGLONG *sentAt;           // Per batch, then its latency in counter ticks
+    int batchCount;
+    int acked;
+    BOOL failed;
+} BenchClient;
+
+static void PrintUsage(void) {
+    fprintf(stderr,
+            "Usage: LogIngest [-p pipe] entry...\n"
+            "       LogIngest [-p pipe] -\n"
+            "       LogIngest -bench [-c connections] [-n entries] [-b batch]\n"
+            "                        [-w window] [-s bytes] [-d directory]\n"
+            "'-' sends each line of stdin. -bench runs its own server over a\n"
+            "scratch store and reports entries/s and ack latency.\n");
+}
+
+// Wait for the oldest outstanding ack; FALSE if it is missing or not OK
+static BOOL CollectAck(HANDLE pipe, DWORD expectedId) {
+    IngestAck ack;
+    if (!Ingest_ReadAck(pipe, &ack)) {
+        fprintf(stderr, "Connection closed before batch %lu was acknowledged\n", (unsigned long)expectedId);
+        return FALSE;
+    }
+    if (ack.batchId != expectedId || ack.status != INGEST_STATUS_OK) {
+        fprintf(stderr, "Batch %lu was rejected (status %lu)\n", (unsigned long)ack.batchId, (unsigned long)ack.status);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Entries are stored as UTF-8. Returns a malloc'd copy of 'text' (in
+// 'codePage') converted to it, or of 'wide' when it isn't NULL.
+static char* ToUtf8(const char *text, int length, UINT codePage, const WCHAR *wide, int *outLength) {
+    WCHAR *converted = NULL;
+    int wideLength = wide ? (int)wcslen(wide) : 0;
+    if (!wide) {
+        wideLength = length > 0 ? MultiByteToWideChar(codePage, 0, text, length, NULL, 0) : 0;
+        converted = (WCHAR *)malloc((wideLength + 1) * sizeof(WCHAR));
+        if (!converted) return NULL;
+        if (wideLength > 0) MultiByteToWideChar(codePage, 0, text, length, converted, wideLength);
+        wide = converted;
+    }
+
+    int resultLength = wideLength > 0 ? WideCharToMultiByte(CP_UTF8, 0, wide, wideLength, NULL, 0, NULL, NULL) : 0;
+    char *result = (char *)malloc(resultLength + 1);
+    if (result) {
+        if (resultLength > 0) WideCharToMultiByte(CP_UTF8, 0, wide, wideLength, result, resultLength, NULL, NULL);
+        result[resultLength] = '\0';
+        *outLength = resultLength;
+    }
+    free(converted);
+    return result;
+}
+
+// Send the command-line entries, taken from the UTF-16 command line so
+// text outside the ANSI code page arrives intact
+static int SendArguments(const char *pipeName, WCHAR **entries, int count) {
+    HANDLE pipe = Ingest_Connect(pipeName, CONNECT_TIMEOUT_MS);
+    if (pipe == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Could not connect to %s; is Logger running?\n", pipeName);
+        return 1;
+    }
+
+    LogRecord *records = (LogRecord *)calloc(count, sizeof(LogRecord));
+    BOOL ok = records != NULL;
+    for (int i = 0; ok && i < count; i++) {
+        int length = 0;
+        char *body = ToUtf8(NULL, 0, 0, entries[i], &length);
+        if (!body) ok = FALSE;
+        records[i].length = (DWORD)length;
+        records[i].body = body;
+    }
+    ok = ok && Ingest_SendBatch(pipe, 1, records, count) && CollectAck(pipe, 1);
+    for (int i = 0; records && i < count; i++) free((char *)records[i].body);
+    free(records);
+    CloseHandle(pipe);
+    return ok ? 0 : 1;
+}
+
+// Send stdin line by line, STDIN_BATCH_ENTRIES to a batch, with up to
+// STDIN_WINDOW batches waiting for their ack. Lines are converted to
+// UTF-8 from the console's input code page when typed, from the ANSI code
+// page when redirected.
+static int SendStdin(const char *pipeName) {
+    HANDLE pipe = Ingest_Connect(pipeName, CONNECT_TIMEOUT_MS);
+    if (pipe == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Could not connect to %s; is Logger running?\n", pipeName);
+        return 1;
+    }
+    UINT codePage = GetFileType(GetStdHandle(STD_INPUT_HANDLE)) == FILE_TYPE_CHAR ? GetConsoleCP() : CP_ACP;
+
+    char **lines = (char **)calloc(STDIN_BATCH_ENTRIES, sizeof(char *));
+    LogRecord *records = (LogRecord *)calloc(STDIN_BATCH_ENTRIES, sizeof(LogRecord));
+    char *line = (char *)malloc(MAX_LINE);
+    BOOL ok = lines && records && line;
+    DWORD sent = 0, acked = 0;
+    int count = 0;
+    long long total = 0;
+
+    while (ok) {
+        BOOL more = fgets(line, MAX_LINE, stdin) != NULL;
+        if (more) {
+            size_t length = strlen(line);
+            while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) length--;
+            if (length == 0) continue;
+            int utf8Length = 0;
+            lines[count] = ToUtf8(line, (int)length, codePage, NULL, &utf8Length);
+            if (!lines[count]) {
+                ok = FALSE;
+                break;
+            }
+            records[count].length = (DWORD)utf8Length;
+            records[count].body = lines[count];
+            count++;
+        }
+        if (count == STDIN_BATCH_ENTRIES || (!more && count > 0)) {
+            if (sent - acked == STDIN_WINDOW) ok = CollectAck(pipe, ++acked);
+            ok = ok && Ingest_SendBatch(pipe, ++sent, records, count);
+            total += count;
+            for (int i = 0; i < count; i++) free(lines[i]);
+            count = 0;
+        }
+        if (!more) break;
+    }
+    while (ok && acked < sent) ok = CollectAck(pipe, ++acked);
+
+    for (int i = 0; i < count; i++) free(lines[i]);
+    free(lines);
+    free(records);
+    free(line);
+    CloseHandle(pipe);
+    if (ok) fprintf(stderr, "Sent %lld entries in %lu batch(es)\n", total, (unsigned long)sent);
+    return ok ? 0 : 1;
+}
+
+static DWORD WINAPI BenchThread(LPVOID param) {
+    BenchClient *client = (BenchClient *)param;
+    client->failed = TRUE;
+    HANDLE pipe = Ingest_Connect(client->pipeName, CONNECT_TIMEOUT_MS);
+    if (pipe == INVALID_HANDLE_VALUE) return 0;
+
+    char *bodies = (char *)malloc((size_t)client->batchSize * client->entryBytes);
+    LogRecord *records = (LogRecord *)calloc(client->batchSize, sizeof(LogRecord));
+    if (!bodies || !records) {
+        free(bodies);
+        free(records);
+        CloseHandle(pipe);
+        return 0;
+    }
+
+    BOOL ok = TRUE;
+    int sent = 0, next = 0;
+    while (ok && client->acked < client->batchCount) {
+        if (sent < client->batchCount && sent - client->acked < client->window) {
+            int count = client->batchSize;
+            if (count > client->entries - next) count = client->entries - next;
+            for (int i = 0; i < count; i++) {
+                char *body = bodies + (size_t)i * client->entryBytes;
+                int length = snprintf(body, client->entryBytes, "bench %d.%d ", client->index, next + i);
+                if (length < 0 || length >= client->entryBytes) length = client->entryBytes - 1;
+                memset(body + length, 'x', client->entryBytes - length);
+                records[i].length = (DWORD)client->entryBytes;
+                records[i].body = body;
+            }
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            client->sentAt[sent] = now.QuadPart;
+            ok = Ingest_SendBatch(pipe, (DWORD)sent + 1, records, count);
+            sent++;
+            next += count;
+        } else {
+            ok = CollectAck(pipe, (DWORD)client->acked + 1);
+            if (!ok) break;
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            client->sentAt[client->acked] = now.QuadPart - client->sentAt[client->acked];
+            client->acked++;
+        }
+    }
+
+    client->failed = !ok;
+    free(bodies);
+    free(records);
+    CloseHandle(pipe);
+    return 0;
+}
+
+static int CompareTicks(const void *a, const void *b) {
+    LONGLONG x = *(const LONGLONG *)a, y = *(const LONGLONG *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int RunBenchmark(const char *directory, int connections, int entries, int batchSize, int window, int entryBytes) {
+    if (connections < 1) connections = 1;
+    if (connections > MAX_CONNECTIONS) connections = MAX_CONNECTIONS;
+    if (batchSize < 1) batchSize = 1;
+    if (batchSize > INGEST_MAX_BATCH_ENTRIES) batchSize = INGEST_MAX_BATCH_ENTRIES;
+    if (window < 1) window = 1;
+    if (entryBytes < 16) entryBytes = 16;
+    if (entryBytes > 64 * 1024) entryBytes = 64 * 1024;
+    if (entries < connections) entries = connections;
+
+    LogStore *store = LogStore_Open(directory);
+    if (!store) {
+        fprintf(stderr, "Could not open the store '%s'\n", directory);
+        return 1;
+    }
+    char pipeName[MAX_PATH];
+    snprintf(pipeName, sizeof(pipeName), "\\\\.\\pipe\\WorkLogIngestBench-%lu", (unsigned long)GetCurrentProcessId());
+    IngestServer *server = Ingest_Start(store, pipeName);
+    if (!server) {
+        fprintf(stderr, "Could not start the ingestion server\n");
+        LogStore_Close(store);
+        return 1;
+    }
+
+    BenchClient *clients = (BenchClient *)calloc(connections, sizeof(BenchClient));
+    HANDLE *threads = (HANDLE *)calloc(connections, sizeof(HANDLE));
+    int totalBatches = 0;
+    BOOL ok = clients && threads;
+    for (int c = 0; ok && c < connections; c++) {
+        BenchClient *client = &clients[c];
+        client->pipeName = pipeName;
+        client->index = c;
+        client->entries = entries / connections + (c < entries % connections ? 1 : 0);
+        client->batchSize = batchSize;
+        client->window = window;
+        client->entryBytes = entryBytes;
+        client->batchCount = (client->entries + batchSize - 1) / batchSize;
+        client->sentAt = (LONGLONG *)malloc(client->batchCount * sizeof(LONGLONG));
+        if (!client->sentAt) ok = FALSE;
+        totalBatches += client->batchCount;
+    }
+
+    LARGE_INTEGER freq, start, stop;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    int started = 0;
+    for (int c = 0; ok && c < connections; c++) {
+        threads[c] = CreateThread(NULL, 0, BenchThread, &clients[c], 0, NULL);
+        if (!threads[c]) {
+            ok = FALSE;
+            break;
+        }
+        started++;
+    }
+    for (int c = 0; c < started; c++) {
+        WaitForSingleObject(threads[c], INFINITE);
+        CloseHandle(threads[c]);
+    }
+
+    QueryPerformanceCounter(&stop);
+    double seconds = (double)(stop.QuadPart - start.QuadPart) / (double)freq.QuadPart;
+
+    // Every batch has been acked, so the committer's totals are final
+    DWORD batchesCommitted = server->batchesCommitted;
+    DWORD groupsCommitted = server->groupsCommitted;
+    Ingest_Stop(server);
+
+    LONGLONG *latencies = ok ? (LONGLONG *)malloc(totalBatches * sizeof(LONGLONG)) : NULL;
+    int latencyCount = 0;
+    long long ingested = 0;
+    for (int c = 0; c < started; c++) {
+        if (clients[c].failed) ok = FALSE;
+        for (int b = 0; latencies && b < clients[c].acked; b++) {
+            latencies[latencyCount++] = clients[c].sentAt[b];
+        }
+        ingested += clients[c].acked == clients[c].batchCount ? clients[c].entries : 0;
+    }
+
+    if (!ok) fprintf(stderr, "Some connections failed; the figures cover what was acknowledged\n");
+    double megabytes = (double)ingested * entryBytes / (1024.0 * 1024.0);
+    fprintf(stderr, "Ingested %lld entries (%d bytes) over %d connection(s), %d per batch, window %d, in %.3f s\n",
+            ingested, entryBytes, connections, batchSize, window, seconds);
+    fprintf(stderr, "Throughput: %.0f entries/s, %.1f MB/s\n",
+            seconds > 0 ? ingested / seconds : 0.0, seconds > 0 ? megabytes / seconds : 0.0);
+    if (latencyCount > 0) {
+        qsort(latencies, latencyCount, sizeof(LONGLONG), CompareTicks);
+        double ms = 1000.0 / (double)freq.QuadPart;
+        fprintf(stderr, "Ack latency: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+                latencies[latencyCount / 2] * ms, latencies[latencyCount * 9 / 10] * ms,
+                latencies[latencyCount * 99 / 100] * ms, latencies[latencyCount - 1] * ms);
+    }
+    fprintf(stderr, "Server: %lu batch(es) in %lu group commit(s), %.1f batches per flush\n",
+            (unsigned long)batchesCommitted, (unsigned long)groupsCommitted,
+            groupsCommitted > 0 ? (double)batchesCommitted / groupsCommitted : 0.0);
+
+    free(latencies);
+    for (int c = 0; clients && c < connections; c++) free(clients[c].sentAt);
+    free(clients);
+    free(threads);
+    LogStore_Close(store);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    const char *pipeName = INGEST_PIPE_NAME;
+    const char *directory = "IngestBench";
+    BOOL bench = FALSE, fromStdin = FALSE;
+    int connections = 4, entries = 200000, batchSize = 64, window = 8, entryBytes = 64;
+    int first = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            pipeName = argv[++i];
+        } else if (strcmp(argv[i], "-bench") == 0) {
+            bench = TRUE;
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            connections = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            entries = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            batchSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            window = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            entryBytes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (strcmp(argv[i], "-") == 0) {
+            fromStdin = TRUE;
+        } else if (argv[i][0] == '-') {
+            PrintUsage();
+            return 2;
+        } else {
+            first = i;
+            break;
+        }
+    }
+
+    if (bench) return RunBenchmark(directory, connections, entries, batchSize, window, entryBytes);
+    if (fromStdin) return SendStdin(pipeName);
+    if (first == argc) {
+        PrintUsage();
+        return 2;
+    }
+    int wideCount = 0;
+    WCHAR **wideArgv = CommandLineToArgvW(GetCommandLineW(), &wideCount);
+    int argumentCount = argc - first;
+    if (!wideArgv || wideCount < argumentCount) {
+        fprintf(stderr, "Could not read the command line\n");
+        if (wideArgv) LocalFree(wideArgv);
+        return 1;
+    }
+    int count = argumentCount > INGEST_MAX_BATCH_ENTRIES ? INGEST_MAX_BATCH_ENTRIES : argumentCount;
+    // The entries end both argument lists
+    int result = SendArguments(pipeName, wideArgv + wideCount - argumentCount, count);
+    LocalFree(wideArgv);
+    return result;
+}
@@ -0,0 +1,1399 @@
+#include "logstore.h"
+#include "logtotals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGMENT_VERSION 1
+#define SEGMENT_PATTERN "seg-*.wlog"
+#define PENDING_MARKER "replace.pending"
+#define COMMIT_MARKER "replace.commit"
+#define SHARED_FILE "store.map"
+#define SHARED_VERSION 1
+#define MAX_ROLLOVER_ATTEMPTS 16
+#define LOGSTORE_MAX_WRITE (256 * 1024)    // Batched appends write up to this much at once
+#define RECENT_TEXT_BYTES (1024 * 1024)     // Rendered lines the recent-record cache holds
+#define RECENT_ENTRIES 16384
+#define TIMESTAMP_MIN (-0x7FFFFFFFFFFFFFFFLL - 1)
+
+// Bytes of store.map used as locks, past the mapped state
+#define LOCK_WRITERS  0x10000   // Shared by appends and scans, exclusive for rewrites
+#define LOCK_PRESENCE 0x10001   // Shared by every process with the store open
+#define LOCK_APPEND   0x10002   // Exclusive from choosing a segment to writing into it
+
+#define MAKE_KEY(sequence, day) (((LONGLONG)(sequence) << 32) | (day))
+#define KEY_SEQUENCE(key) ((DWORD)((ULONGLONG)(key) >> 32))
+#define KEY_DAY(key) ((DWORD)(key))
+
+// FILETIME of 1970-01-01 and nanoseconds per FILETIME tick / per day
+#define UNIX_EPOCH_FILETIME 116444736000000000LL
+#define NS_PER_TICK 100
+#define NS_PER_DAY (86400LL * 1000000000LL)
+
+static DWORD s_crcTable[256];
+static volatile LONG s_crcReady = 0;
+
+static void InitCrcTable(void) {
+    if (s_crcReady) return;
+    for (DWORD i = 0; i < 256; i++) {
+        DWORD c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        s_crcTable[i] = c;
+    }
+    // Every thread computes the same table, so a racing init is harmless
+    InterlockedExchange(&s_crcReady, 1);
+}
+
+static DWORD Crc32Update(DWORD crc, const void *data, size_t length) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < length; i++) {
+        crc = s_crcTable[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+DWORD LogStore_Crc32(const void *data, size_t length) {
+    InitCrcTable();
+    return ~Crc32Update(0xFFFFFFFFu, data, length);
+}
+
+// Checksum over the header fields after 'checksum' and the body
+static DWORD RecordChecksum(const LogRecordHeader *header, const char *body) {
+    DWORD crc = 0xFFFFFFFFu;
+    crc = Crc32Update(crc, &header->timestamp, sizeof(LogRecordHeader) - offsetof(LogRecordHeader, timestamp));
+    crc = Crc32Update(crc, body, header->length);
+    return ~crc;
+}
+
+// Time conversions. Timestamps are UTC; days and rendering use local time.
+
+// FALSE for a timestamp Windows can't convert (before 1601); 'local' is
+// then 1970-01-01 so callers never work from an uninitialized date.
+static BOOL TimestampToLocal(LONGLONG timestamp, SYSTEMTIME *local) {
+    ULARGE_INTEGER ticks;
+    ticks.QuadPart = (ULONGLONG)(timestamp / NS_PER_TICK + UNIX_EPOCH_FILETIME);
+
+    FILETIME ft;
+    ft.dwLowDateTime = ticks.LowPart;
+    ft.dwHighDateTime = ticks.HighPart;
+
+    SYSTEMTIME utc;
+    if (FileTimeToSystemTime(&ft, &utc) && SystemTimeToTzSpecificLocalTime(NULL, &utc, local)) return TRUE;
+    memset(local, 0, sizeof(*local));
+    local->wYear = 1970;
+    local->wMonth = 1;
+    local->wDay = 1;
+    return FALSE;
+}
+
+static LONGLONG LocalToTimestamp(const SYSTEMTIME *local) {
+    SYSTEMTIME utc;
+    FILETIME ft;
+    TzSpecificLocalTimeToSystemTime(NULL, local, &utc);
+    SystemTimeToFileTime(&utc, &ft);
+    return LogStore_FromFileTime(&ft);
+}
+
+// YYYYMMDD, or 0 for a timestamp outside what the store accepts
+static DWORD LocalDay(LONGLONG timestamp) {
+    SYSTEMTIME local;
+    if (timestamp < 0 || timestamp >= LOGSTORE_MAX_TIMESTAMP || !TimestampToLocal(timestamp, &local)) return 0;
+    return local.wYear * 10000 + local.wMonth * 100 + local.wDay;
+}
+
+LONGLONG LogStore_FromFileTime(const FILETIME *fileTime) {
+    ULARGE_INTEGER ticks;
+    ticks.LowPart = fileTime->dwLowDateTime;
+    ticks.HighPart = fileTime->dwHighDateTime;
+    return ((LONGLONG)ticks.QuadPart - UNIX_EPOCH_FILETIME) * NS_PER_TICK;
+}
+
+LONGLONG LogStore_Now(void) {
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    return LogStore_FromFileTime(&ft);
+}
+
+LONGLONG LogStore_DayStart(LONGLONG timestamp) {
+    SYSTEMTIME local;
+    TimestampToLocal(timestamp, &local);
+    local.wHour = local.wMinute = local.wSecond = local.wMilliseconds = 0;
+    return LocalToTimestamp(&local);
+}
+
+LONGLONG LogStore_NextDayStart(LONGLONG timestamp) {
+    // Noon-to-noon steps stay on the right day across DST changes
+    return LogStore_DayStart(LogStore_DayStart(timestamp) + NS_PER_DAY + NS_PER_DAY / 2);
+}
+
+BOOL LogStore_DayRange(DWORD day, LONGLONG *from, LONGLONG *to) {
+    // Found from the day's noon, which every day has whatever DST does
+    SYSTEMTIME local = {0}, utc;
+    local.wYear = (WORD)(day / 10000);
+    local.wMonth = (WORD)(day / 100 % 100);
+    local.wDay = (WORD)(day % 100);
+    local.wHour = 12;
+
+    FILETIME ft;
+    if (!TzSpecificLocalTimeToSystemTime(NULL, &local, &utc) || !SystemTimeToFileTime(&utc, &ft)) return FALSE;
+    LONGLONG noon = LogStore_FromFileTime(&ft);
+    *from = LogStore_DayStart(noon);
+    *to = LogStore_NextDayStart(noon);
+    return TRUE;
+}
+
+int LogStore_LocalMinute(LONGLONG timestamp) {
+    SYSTEMTIME local;
+    TimestampToLocal(timestamp, &local);
+    return local.wHour * 60 + local.wMinute;
+}
+
+// "[h:mmam] " for a timestamp, as AddLogEntry used to write it
+int LogStore_FormatTimePrefix(LONGLONG timestamp, char *out, size_t outSize) {
+    SYSTEMTIME local;
+    TimestampToLocal(timestamp, &local);
+
+    int hour12 = local.wHour % 12;
+    if (hour12 == 0) hour12 = 12; // midnight or noon -> 12
+    const char *ampm = local.wHour >= 12 ? "pm" : "am";
+    return snprintf(out, outSize, "[%d:%02d%s] ", hour12, local.wMinute, ampm);
+}
+
+// Segment bookkeeping
+
+static void SegmentPath(const LogStore *store, DWORD sequence, DWORD day, char *path) {
+    snprintf(path, MAX_PATH, "%s\\seg-%06lu-%08lu.wlog", store->directory,
+             (unsigned long)sequence, (unsigned long)day);
+}
+
+static void MarkerPath(const LogStore *store, const char *name, char *path) {
+    snprintf(path, MAX_PATH, "%s\\%s", store->directory, name);
+}
+
+static BOOL AddSegment(LogStore *store, DWORD sequence, DWORD day) {
+    if (store->segmentCount >= store->segmentCapacity) {
+        int newCapacity = store->segmentCapacity > 0 ? store->segmentCapacity * 2 : 16;
+        LogSegment *newSegments = (LogSegment *)realloc(store->segments, newCapacity * sizeof(LogSegment));
+        if (!newSegments) return FALSE;
+        store->segments = newSegments;
+        store->segmentCapacity = newCapacity;
+    }
+    store->segments[store->segmentCount].sequence = sequence;
+    store->segments[store->segmentCount].day = day;
+    store->segmentCount++;
+    return TRUE;
+}
+
+static int CompareSegments(const void *a, const void *b) {
+    DWORD s1 = ((const LogSegment *)a)->sequence;
+    DWORD s2 = ((const LogSegment *)b)->sequence;
+    return s1 < s2 ? -1 : s1 > s2;
+}
+
+static BOOL ListSegments(LogStore *store) {
+    store->segmentCount = 0;
+
+    char pattern[MAX_PATH];
+    MarkerPath(store, SEGMENT_PATTERN, pattern);
+
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(pattern, &findData);
+    if (hFind == INVALID_HANDLE_VALUE) return TRUE;
+
+    BOOL ok = TRUE;
+    do {
+        unsigned long sequence, day;
+        if (sscanf(findData.cFileName, "seg-%lu-%lu.wlog", &sequence, &day) == 2) {
+            if (!AddSegment(store, (DWORD)sequence, (DWORD)day)) ok = FALSE;
+        }
+    } while (ok && FindNextFile(hFind, &findData));
+    FindClose(hFind);
+
+    qsort(store->segments, store->segmentCount, sizeof(LogSegment), CompareSegments);
+    return ok;
+}
+
+static BOOL HasSegment(const LogStore *store, DWORD sequence) {
+    for (int i = store->segmentCount - 1; i >= 0; i--) {
+        if (store->segments[i].sequence == sequence) return TRUE;
+    }
+    return FALSE;
+}
+
+// Delete segment files with sequence in [first, last) and drop them from
+// the list
+static void DeleteSegments(LogStore *store, DWORD first, DWORD last) {
+    int kept = 0;
+    for (int i = 0; i < store->segmentCount; i++) {
+        LogSegment *segment = &store->segments[i];
+        if (segment->sequence >= first && segment->sequence < last) {
+            char path[MAX_PATH];
+            SegmentPath(store, segment->sequence, segment->day, path);
+            DeleteFile(path);
+        } else {
+            store->segments[kept++] = *segment;
+        }
+    }
+    store->segmentCount = kept;
+}
+
+static BOOL ReadMarker(const char *path, DWORD *sequence) {
+    FILE *file = fopen(path, "r");
+    if (!file) return FALSE;
+    unsigned long value;
+    BOOL ok = fscanf(file, "%lu", &value) == 1;
+    fclose(file);
+    if (ok) *sequence = (DWORD)value;
+    return ok;
+}
+
+static BOOL WriteMarker(const char *path, DWORD sequence) {
+    FILE *file = fopen(path, "w");
+    if (!file) return FALSE;
+    BOOL ok = fprintf(file, "%lu\n", (unsigned long)sequence) > 0;
+    if (fclose(file) != 0) ok = FALSE;
+    return ok;
+}
+
+// Finish or undo a LogStore_ReplaceText that was interrupted. A commit
+// marker means the new segments are complete, so the old ones go; a
+// pending marker means they may not be, so they go instead.
+static void ResolveReplace(LogStore *store) {
+    char path[MAX_PATH];
+    DWORD firstNew;
+
+    MarkerPath(store, COMMIT_MARKER, path);
+    if (ReadMarker(path, &firstNew)) {
+        DeleteSegments(store, 0, firstNew);
+        DeleteFile(path);
+    }
+
+    MarkerPath(store, PENDING_MARKER, path);
+    if (ReadMarker(path, &firstNew)) {
+        DeleteSegments(store, firstNew, 0xFFFFFFFFu);
+        DeleteFile(path);
+    }
+}
+
+// Length of the valid prefix of a segment image: the header plus every
+// record up to the first one that is cut short or fails its checksum.
+// 'lastSequence' receives the sequence of the last valid record.
+static ULONGLONG ValidSegmentLength(const char *data, ULONGLONG size, DWORD *lastSequence) {
+    if (size < sizeof(LogSegmentHeader) || memcmp(data, "WLOG", 4) != 0) return 0;
+
+    ULONGLONG pos = sizeof(LogSegmentHeader);
+    while (size - pos >= sizeof(LogRecordHeader)) {
+        LogRecordHeader header;
+        memcpy(&header, data + pos, sizeof(header));
+        if (header.length > LOGSTORE_MAX_BODY) break;
+        if (size - pos - sizeof(header) < header.length) break;
+        if (RecordChecksum(&header, data + pos + sizeof(header)) != header.checksum) break;
+        pos += sizeof(header) + header.length;
+        *lastSequence = header.sequence;
+    }
+    return pos;
+}
+
+// Cut a torn tail left by a crash off the newest segment; a segment too
+// short to hold its header is removed. Only safe while no other process
+// has the store open, since their appends in flight would look torn.
+// The segment is mapped rather than read, so one that grew past the
+// usual size (an older writer could overshoot it) is recovered the same.
+static BOOL RecoverNewestSegment(LogStore *store, DWORD *lastSequence) {
+    while (store->segmentCount > 0) {
+        LogSegment *segment = &store->segments[store->segmentCount - 1];
+        char path[MAX_PATH];
+        SegmentPath(store, segment->sequence, segment->day, path);
+
+        HANDLE hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                  NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) return FALSE;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(hFile, &size)) {
+            CloseHandle(hFile);
+            return FALSE;
+        }
+
+        ULONGLONG valid = 0;
+        if (size.QuadPart > 0) {
+            HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+            const char *data = hMapping ? (const char *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+            if (data) valid = ValidSegmentLength(data, (ULONGLONG)size.QuadPart, lastSequence);
+            if (data) UnmapViewOfFile(data);
+            if (hMapping) CloseHandle(hMapping);
+            if (!data) {
+                CloseHandle(hFile);
+                return FALSE;
+            }
+        }
+
+        if (valid == 0) {
+            CloseHandle(hFile);
+            DeleteFile(path);
+            store->segmentCount--;
+            continue;
+        }
+
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)valid;
+        BOOL ok = (ULONGLONG)size.QuadPart == valid ||
+                  (SetFilePointerEx(hFile, end, NULL, FILE_BEGIN) && SetEndOfFile(hFile));
+        CloseHandle(hFile);
+        return ok;
+    }
+    return TRUE;
+}
+
+// Shared state and cross-process locking
+
+static BOOL OpenShared(LogStore *store) {
+    char path[MAX_PATH];
+    MarkerPath(store, SHARED_FILE, path);
+
+    store->sharedFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                   NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (store->sharedFile == INVALID_HANDLE_VALUE) return FALSE;
+
+    // Mapping with a size grows a new, empty file to hold the state
+    store->sharedMapping = CreateFileMapping(store->sharedFile, NULL, PAGE_READWRITE, 0,
+                                             sizeof(LogStoreShared), NULL);
+    if (store->sharedMapping) {
+        store->shared = (LogStoreShared *)MapViewOfFile(store->sharedMapping, FILE_MAP_WRITE, 0, 0,
+                                                        sizeof(LogStoreShared));
+    }
+    if (!store->shared) {
+        if (store->sharedMapping) CloseHandle(store->sharedMapping);
+        CloseHandle(store->sharedFile);
+        store->sharedMapping = NULL;
+        store->sharedFile = INVALID_HANDLE_VALUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Lock one byte of store.map; always succeeds for a private store
+static BOOL LockByte(LogStore *store, DWORD offset, DWORD flags) {
+    if (store->sharedFile == INVALID_HANDLE_VALUE) return TRUE;
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = offset;
+    return LockFileEx(store->sharedFile, flags, 0, 1, 0, &overlapped);
+}
+
+static void UnlockByte(LogStore *store, DWORD offset) {
+    if (store->sharedFile == INVALID_HANDLE_VALUE) return;
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = offset;
+    UnlockFileEx(store->sharedFile, 0, 1, 0, &overlapped);
+}
+
+// Appends and scans take the store shared; rewrites and recovery take it
+// exclusive, which waits out every other process's appends
+static void LockStore(LogStore *store, BOOL exclusive) {
+    EnterCriticalSection(&store->lock);
+    LockByte(store, LOCK_WRITERS, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0);
+}
+
+static void UnlockStore(LogStore *store) {
+    UnlockByte(store, LOCK_WRITERS);
+    LeaveCriticalSection(&store->lock);
+}
+
+// Point the append handle at the segment 'key' names (0 for none).
+// Without FILE_WRITE_DATA every write goes to the current end of file,
+// whoever else is writing.
+static BOOL OpenActiveSegment(LogStore *store, LONGLONG key) {
+    if (store->activeFile != INVALID_HANDLE_VALUE) {
+        // What this process wrote must be on disk before it loses track
+        // of the handle, so a later LogStore_Flush covers it
+        if (store->activeDirty) FlushFileBuffers(store->activeFile);
+        CloseHandle(store->activeFile);
+    }
+    store->activeFile = INVALID_HANDLE_VALUE;
+    store->activeDirty = FALSE;
+    store->activeKey = key;
+    store->activeSize = 0;
+    if (key == 0) return TRUE;
+
+    char path[MAX_PATH];
+    SegmentPath(store, KEY_SEQUENCE(key), KEY_DAY(key), path);
+    store->activeFile = CreateFile(path, GENERIC_READ | FILE_APPEND_DATA,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                   NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    return store->activeFile != INVALID_HANDLE_VALUE;
+}
+
+// Catch up with segments other processes have started or removed
+static BOOL SyncSegments(LogStore *store) {
+    LONGLONG active = store->shared->active;
+    LONG generation = store->shared->generation;
+    if (active == store->activeKey && generation == store->generation &&
+        store->activeFile != INVALID_HANDLE_VALUE) {
+        return TRUE;
+    }
+
+    if (generation != store->generation || (active != 0 && !HasSegment(store, KEY_SEQUENCE(active)))) {
+        if (!ListSegments(store)) return FALSE;
+        store->generation = generation;
+    }
+    return OpenActiveSegment(store, active);
+}
+
+// Create segment 'sequence' with its header written, ready to publish
+static BOOL CreateSegment(LogStore *store, DWORD sequence, DWORD day) {
+    char path[MAX_PATH];
+    SegmentPath(store, sequence, day, path);
+    HANDLE hFile = CreateFile(path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return FALSE;
+
+    LogSegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "WLOG", 4);
+    header.version = SEGMENT_VERSION;
+    header.day = day;
+
+    DWORD written;
+    BOOL ok = WriteFile(hFile, &header, sizeof(header), &written, NULL) && written == sizeof(header);
+    CloseHandle(hFile);
+    if (!ok) DeleteFile(path);
+    return ok;
+}
+
+// Start a segment for 'day' and swap it in as the active one. If another
+// writer swapped in its own first, ours is dropped and theirs adopted;
+// the caller re-checks whether that one suits it.
+static BOOL RollOver(LogStore *store, DWORD day) {
+    LONGLONG expected = store->activeKey;
+    DWORD sequence = (DWORD)InterlockedIncrement(&store->shared->nextSequence);
+    if (!CreateSegment(store, sequence, day)) return FALSE;
+
+    LONGLONG key = MAKE_KEY(sequence, day);
+    if (InterlockedCompareExchange64(&store->shared->active, key, expected) != expected) {
+        char path[MAX_PATH];
+        SegmentPath(store, sequence, day, path);
+        DeleteFile(path);
+        return SyncSegments(store);
+    }
+
+    return AddSegment(store, sequence, day) && OpenActiveSegment(store, key);
+}
+
+// Flush and close the append handle; a rewrite uses this to finish the
+// segments it writes
+static void SealActiveSegment(LogStore *store) {
+    if (store->activeFile == INVALID_HANDLE_VALUE) return;
+    FlushFileBuffers(store->activeFile);
+    CloseHandle(store->activeFile);
+    store->activeFile = INVALID_HANDLE_VALUE;
+    store->activeDirty = FALSE;
+    store->activeSize = 0;
+}
+
+// After segments were removed: publish the newest remaining one as active
+// and have every other process re-list
+static void PublishSegments(LogStore *store) {
+    LONGLONG key = 0;
+    if (store->segmentCount > 0) {
+        const LogSegment *newest = &store->segments[store->segmentCount - 1];
+        key = MAKE_KEY(newest->sequence, newest->day);
+    }
+    InterlockedExchange64(&store->shared->active, key);
+    store->generation = InterlockedIncrement(&store->shared->generation);
+    OpenActiveSegment(store, key);
+}
+
+LogStore* LogStore_Open(const char *directory) {
+    if (!directory || strlen(directory) >= MAX_PATH - 32) return NULL;
+
+    InitCrcTable();
+    CreateDirectory(directory, NULL);
+
+    LogStore *store = (LogStore *)calloc(1, sizeof(LogStore));
+    if (!store) return NULL;
+    strcpy(store->directory, directory);
+    store->activeFile = INVALID_HANDLE_VALUE;
+    store->sharedFile = INVALID_HANDLE_VALUE;
+    InitializeCriticalSection(&store->lock);
+
+    // Without store.map the store still works, just not across processes
+    if (!OpenShared(store)) store->shared = &store->localShared;
+    store->totals = LogTotals_Open(directory);
+
+    LockStore(store, TRUE);
+    BOOL ok = ListSegments(store);
+    if (ok) ResolveReplace(store);
+
+    // Alone with the store (nobody else holds the presence byte): repair
+    // the tail and rebuild the shared state from what is on disk
+    LogStoreShared *shared = store->shared;
+    BOOL alone = LockByte(store, LOCK_PRESENCE, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY);
+    if (alone) UnlockByte(store, LOCK_PRESENCE);
+    if (ok && (alone || memcmp(shared->magic, "WLSH", 4) != 0)) {
+        DWORD lastSequence = 0;
+        ok = RecoverNewestSegment(store, &lastSequence);
+        if (ok) {
+            if (memcmp(shared->magic, "WLSH", 4) != 0 || shared->version != SHARED_VERSION) {
+                memset(shared, 0, sizeof(LogStoreShared));
+                shared->appendCount = (LONG)lastSequence;
+            }
+            shared->nextSequence = store->segmentCount > 0 ? (LONG)store->segments[store->segmentCount - 1].sequence : 0;
+            shared->version = SHARED_VERSION;
+            memcpy(shared->magic, "WLSH", 4);
+            PublishSegments(store);
+
+            // Totals that missed records (or counted lost ones) wait for a
+            // rebuild. A newest segment with no records says nothing.
+            if (store->segmentCount == 0) {
+                LogTotals_Reset(store->totals, FALSE, (DWORD)shared->appendCount);
+            } else if (store->totals && lastSequence != 0 && store->totals->data->lastSequence != lastSequence) {
+                LogTotals_MarkStale(store->totals);
+            }
+        }
+    }
+    if (ok) {
+        LockByte(store, LOCK_PRESENCE, 0);
+        store->generation = shared->generation;
+        ok = SyncSegments(store);
+    }
+    UnlockStore(store);
+
+    if (!ok) {
+        LogStore_Close(store);
+        return NULL;
+    }
+    return store;
+}
+
+void LogStore_Close(LogStore *store) {
+    if (!store) return;
+    if (store->activeFile != INVALID_HANDLE_VALUE) CloseHandle(store->activeFile);
+    if (store->sharedFile != INVALID_HANDLE_VALUE) {
+        UnlockByte(store, LOCK_PRESENCE);
+        UnmapViewOfFile(store->shared);
+        CloseHandle(store->sharedMapping);
+        CloseHandle(store->sharedFile);
+    }
+    LogTotals_Close(store->totals);
+    DeleteCriticalSection(&store->lock);
+    free(store->recent.text);
+    free(store->recent.entries);
+    free(store->segments);
+    free(store);
+}
+
+// Recent records
+
+// Empty the cache and have it match the store as it is now. 'coldBefore'
+// is the newest timestamp a record it won't be given may have.
+static BOOL ResetRecent(LogStore *store, LONGLONG coldBefore) {
+    LogRecentCache *cache = &store->recent;
+    if (!cache->text) {
+        cache->text = (char *)malloc(RECENT_TEXT_BYTES);
+        cache->entries = (LogRecentEntry *)malloc(RECENT_ENTRIES * sizeof(LogRecentEntry));
+        if (!cache->text || !cache->entries) {
+            free(cache->text);
+            free(cache->entries);
+            cache->text = NULL;
+            cache->entries = NULL;
+            cache->valid = FALSE;
+            return FALSE;
+        }
+    }
+    cache->valid = TRUE;
+    cache->generation = store->shared->generation;
+    cache->lastSequence = (DWORD)store->shared->appendCount;
+    cache->coldBefore = coldBefore;
+    cache->textEnd = 0;
+    cache->first = 0;
+    cache->count = 0;
+    return TRUE;
+}
+
+static void EvictRecent(LogRecentCache *cache) {
+    const LogRecentEntry *oldest = &cache->entries[cache->first];
+    if (oldest->timestamp > cache->coldBefore) cache->coldBefore = oldest->timestamp;
+    cache->first = (cache->first + 1) % RECENT_ENTRIES;
+    cache->count--;
+}
+
+// Render one record into the cache, evicting the oldest lines for room.
+// A line never wraps: when it doesn't fit before the end of the text it
+// starts over at 0, and the lines still past that point are the oldest.
+static void AddRecent(LogRecentCache *cache, LONGLONG timestamp, const char *body, DWORD length) {
+    char prefix[32];
+    int prefixLength = LogStore_FormatTimePrefix(timestamp, prefix, sizeof(prefix));
+    size_t lineLength = prefixLength + (size_t)length + 2;
+    if (lineLength > RECENT_TEXT_BYTES) {
+        while (cache->count > 0) EvictRecent(cache);
+        if (timestamp > cache->coldBefore) cache->coldBefore = timestamp;
+        return;
+    }
+
+    if (cache->count == RECENT_ENTRIES) EvictRecent(cache);
+    if (cache->textEnd + lineLength > RECENT_TEXT_BYTES) {
+        while (cache->count > 0 && cache->entries[cache->first].offset >= cache->textEnd) EvictRecent(cache);
+        cache->textEnd = 0;
+    }
+    while (cache->count > 0 && cache->entries[cache->first].offset >= cache->textEnd &&
+           cache->entries[cache->first].offset < cache->textEnd + lineLength) {
+        EvictRecent(cache);
+    }
+
+    LogRecentEntry *entry = &cache->entries[(cache->first + cache->count) % RECENT_ENTRIES];
+    entry->timestamp = timestamp;
+    entry->offset = cache->textEnd;
+    entry->length = (DWORD)lineLength;
+    char *line = cache->text + cache->textEnd;
+    memcpy(line, prefix, prefixLength);
+    memcpy(line + prefixLength, body, length);
+    memcpy(line + prefixLength + length, "\r\n", 2);
+    cache->textEnd += (DWORD)lineLength;
+    cache->count++;
+}
+
+// Append hook: records this process wrote go into the cache while it still
+// matches the store, that is while nobody else has appended or rewritten
+static void RememberRecords(LogStore *store, const LogRecord *records, int count, DWORD firstSequence) {
+    LogRecentCache *cache = &store->recent;
+    if (!cache->valid) return;
+    if (firstSequence != cache->lastSequence + 1 || cache->generation != store->shared->generation) {
+        cache->valid = FALSE;
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        AddRecent(cache, records[i].timestamp, records[i].body, records[i].length);
+    }
+    cache->lastSequence = firstSequence + count - 1;
+}
+
+// Make the active segment one for 'day' with room for a record of
+// 'recordSize' bytes, rolling over on a new day or when it is full (a
+// segment always takes at least one record). Called with LOCK_APPEND
+// held, so no other process can write between the size check here and
+// the write it allows; a segment never grows past LOGSTORE_SEGMENT_BYTES.
+static BOOL PrepareSegment(LogStore *store, DWORD day, DWORD recordSize) {
+    if (!SyncSegments(store)) return FALSE;
+
+    for (int attempt = 0; ; attempt++) {
+        BOOL roll = store->activeFile == INVALID_HANDLE_VALUE || KEY_DAY(store->activeKey) != day;
+        if (!roll) {
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(store->activeFile, &size)) return FALSE;
+            store->activeSize = (ULONGLONG)size.QuadPart;
+            roll = store->activeSize > sizeof(LogSegmentHeader) &&
+                   store->activeSize + recordSize > LOGSTORE_SEGMENT_BYTES;
+        }
+        if (!roll) return TRUE;
+        if (attempt >= MAX_ROLLOVER_ATTEMPTS || !RollOver(store, day)) return FALSE;
+    }
+}
+
+// Append with the lock held. Runs of records for the same day that fit
+// the active segment go out in a single write, so records never
+// interleave with another writer's and a crash leaves at most one torn
+// write at the tail. Each run holds LOCK_APPEND from sizing the segment
+// to writing into it, which makes the room it found a reservation.
+static BOOL AppendRecordsLocked(LogStore *store, const LogRecord *records, int count) {
+    LONGLONG cachedTimestamp = 0;
+    DWORD cachedDay = 0;
+    char *buffer = NULL;
+    size_t bufferSize = 0;
+    BOOL ok = TRUE;
+
+    for (int first = 0; ok && first < count; ) {
+        if (cachedDay == 0 || records[first].timestamp != cachedTimestamp) {
+            cachedTimestamp = records[first].timestamp;
+            cachedDay = LocalDay(cachedTimestamp);
+        }
+        DWORD day = cachedDay;
+        if (day == 0) {
+            ok = FALSE;
+            break;
+        }
+        ULONGLONG runSize = sizeof(LogRecordHeader) + records[first].length;
+        LockByte(store, LOCK_APPEND, LOCKFILE_EXCLUSIVE_LOCK);
+        if (!PrepareSegment(store, day, (DWORD)runSize)) {
+            UnlockByte(store, LOCK_APPEND);
+            ok = FALSE;
+            break;
+        }
+
+        int last = first + 1;
+        while (last < count && runSize < LOGSTORE_MAX_WRITE) {
+            ULONGLONG nextSize = sizeof(LogRecordHeader) + records[last].length;
+            if (store->activeSize + runSize + nextSize > LOGSTORE_SEGMENT_BYTES) break;
+            if (records[last].timestamp != cachedTimestamp) {
+                cachedTimestamp = records[last].timestamp;
+                cachedDay = LocalDay(cachedTimestamp);
+            }
+            if (cachedDay != day) break;
+            runSize += nextSize;
+            last++;
+        }
+
+        if (runSize > bufferSize) {
+            char *newBuffer = (char *)realloc(buffer, (size_t)runSize);
+            if (!newBuffer) {
+                UnlockByte(store, LOCK_APPEND);
+                ok = FALSE;
+                break;
+            }
+            buffer = newBuffer;
+            bufferSize = (size_t)runSize;
+        }
+
+        // One bump of the shared counter numbers the whole run
+        DWORD sequence = (DWORD)InterlockedExchangeAdd(&store->shared->appendCount, last - first) + 1;
+        size_t pos = 0;
+        for (int i = first; i < last; i++) {
+            LogRecordHeader header;
+            memset(&header, 0, sizeof(header));
+            header.length = records[i].length;
+            header.timestamp = records[i].timestamp;
+            header.flags = records[i].flags;
+            header.sequence = sequence++;
+            header.checksum = RecordChecksum(&header, records[i].body);
+            memcpy(buffer + pos, &header, sizeof(header));
+            memcpy(buffer + pos + sizeof(header), records[i].body, records[i].length);
+            pos += sizeof(header) + records[i].length;
+        }
+
+        DWORD written = 0;
+        ok = WriteFile(store->activeFile, buffer, (DWORD)runSize, &written, NULL) && written == runSize;
+        if (written > 0) store->activeDirty = TRUE;
+        if (!ok) {
+            // Recovery only cuts the tail of a store nobody has open, so
+            // rather than truncate a partial write here, move everyone to
+            // a fresh segment past it
+            if (written > 0) RollOver(store, day);
+            UnlockByte(store, LOCK_APPEND);
+            break;
+        }
+        UnlockByte(store, LOCK_APPEND);
+        store->activeSize += runSize;
+        RememberRecords(store, records + first, last - first, sequence - (last - first));
+        LogTotals_AddRecords(store->totals, day, records + first, last - first, sequence - 1);
+        first = last;
+    }
+
+    free(buffer);
+    return ok;
+}
+
+static BOOL AppendLocked(LogStore *store, LONGLONG timestamp, DWORD flags, const char *body, DWORD length) {
+    LogRecord record;
+    record.timestamp = timestamp;
+    record.flags = flags;
+    record.sequence = 0;
+    record.length = length;
+    record.body = body;
+    return AppendRecordsLocked(store, &record, 1);
+}
+
+BOOL LogStore_Append(LogStore *store, LONGLONG timestamp, DWORD flags, const char *body, DWORD length) {
+    if (!store || (!body && length > 0) || length > LOGSTORE_MAX_BODY) return FALSE;
+
+    LockStore(store, FALSE);
+    BOOL ok = AppendLocked(store, timestamp, flags, body, length);
+    UnlockStore(store);
+    return ok;
+}
+
+BOOL LogStore_AppendBatch(LogStore *store, const LogRecord *records, int count) {
+    if (!store || (!records && count > 0)) return FALSE;
+    for (int i = 0; i < count; i++) {
+        if ((!records[i].body && records[i].length > 0) || records[i].length > LOGSTORE_MAX_BODY) return FALSE;
+    }
+
+    LockStore(store, FALSE);
+    BOOL ok = AppendRecordsLocked(store, records, count);
+    UnlockStore(store);
+    return ok;
+}
+
+BOOL LogStore_Flush(LogStore *store) {
+    if (!store) return FALSE;
+
+    LockStore(store, FALSE);
+    BOOL ok = TRUE;
+    if (store->activeDirty && store->activeFile != INVALID_HANDLE_VALUE) {
+        ok = FlushFileBuffers(store->activeFile);
+        if (ok) store->activeDirty = FALSE;
+    }
+    UnlockStore(store);
+    return ok;
+}
+
+BOOL LogStore_IsEmpty(LogStore *store) {
+    if (!store) return TRUE;
+
+    LockStore(store, FALSE);
+    SyncSegments(store);
+    BOOL empty = store->segmentCount == 0;
+    if (store->segmentCount == 1) {
+        LARGE_INTEGER size;
+        empty = store->activeFile == INVALID_HANDLE_VALUE ||
+                (GetFileSizeEx(store->activeFile, &size) && size.QuadPart <= (LONGLONG)sizeof(LogSegmentHeader));
+    }
+    UnlockStore(store);
+    return empty;
+}
+
+// Walk one segment's records through the callback; FALSE if it asked to
+// stop. Records still being appended fail their checksum and end the walk.
+static BOOL ScanSegment(LogStore *store, const LogSegment *segment,
+                        LONGLONG from, LONGLONG to, LogRecordCallback callback, void *context) {
+    char path[MAX_PATH];
+    SegmentPath(store, segment->sequence, segment->day, path);
+
+    HANDLE hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return TRUE;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart <= (LONGLONG)sizeof(LogSegmentHeader)) {
+        CloseHandle(hFile);
+        return TRUE;
+    }
+    // Appends may grow the file under us; only read what was there
+    ULONGLONG length = (ULONGLONG)size.QuadPart;
+
+    HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    const char *data = hMapping ? (const char *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+
+    BOOL keepGoing = TRUE;
+    if (data && memcmp(data, "WLOG", 4) == 0) {
+        ULONGLONG pos = sizeof(LogSegmentHeader);
+        while (keepGoing && length - pos >= sizeof(LogRecordHeader)) {
+            LogRecordHeader header;
+            memcpy(&header, data + pos, sizeof(header));
+            const char *body = data + pos + sizeof(header);
+            if (header.length > length - pos - sizeof(header)) break;
+            if (RecordChecksum(&header, body) != header.checksum) break;
+            pos += sizeof(header) + header.length;
+
+            if (header.timestamp < from || header.timestamp >= to) continue;
+
+            LogRecord record;
+            record.timestamp = header.timestamp;
+            record.flags = header.flags;
+            record.sequence = header.sequence;
+            record.length = header.length;
+            record.body = body;
+            keepGoing = callback(&record, context);
+        }
+    }
+
+    if (data) UnmapViewOfFile(data);
+    if (hMapping) CloseHandle(hMapping);
+    CloseHandle(hFile);
+    return keepGoing;
+}
+
+// Scan with the lock held
+static void ScanLocked(LogStore *store, LONGLONG from, LONGLONG to, LogRecordCallback callback, void *context) {
+    // A segment only holds records of its own local day. Widen the range by
+    // a day each way so a time zone change can't hide one.
+    DWORD firstDay = from > NS_PER_DAY ? LocalDay(from - NS_PER_DAY) : 0;
+    DWORD lastDay = to < LOGSTORE_MAX_TIMESTAMP - NS_PER_DAY ? LocalDay(to + NS_PER_DAY) : 0xFFFFFFFFu;
+
+    SyncSegments(store);
+    for (int i = 0; i < store->segmentCount; i++) {
+        const LogSegment *segment = &store->segments[i];
+        if (segment->day < firstDay || segment->day > lastDay) continue;
+        if (!ScanSegment(store, segment, from, to, callback, context)) break;
+    }
+}
+
+BOOL LogStore_Scan(LogStore *store, LONGLONG from, LONGLONG to, LogRecordCallback callback, void *context) {
+    if (!store || !callback) return FALSE;
+
+    LockStore(store, FALSE);
+    ScanLocked(store, from, to, callback, context);
+    UnlockStore(store);
+    return TRUE;
+}
+
+// Rendering
+
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+    BOOL failed;
+} TextBuffer;
+
+static BOOL AppendText(TextBuffer *buffer, const char *text, size_t length) {
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t newCapacity = buffer->capacity > 0 ? buffer->capacity * 2 : 4096;
+        while (newCapacity < buffer->length + length + 1) newCapacity *= 2;
+        char *newText = (char *)realloc(buffer->text, newCapacity);
+        if (!newText) {
+            buffer->failed = TRUE;
+            return FALSE;
+        }
+        buffer->text = newText;
+        buffer->capacity = newCapacity;
+    }
+    memcpy(buffer->text + buffer->length, text, length);
+    buffer->length += length;
+    buffer->text[buffer->length] = '\0';
+    return TRUE;
+}
+
+typedef struct {
+    TextBuffer *buffer;
+    LogRecentCache *cache;      // Refilled along the way, or NULL
+} RenderContext;
+
+static BOOL RenderRecord(const LogRecord *record, void *context) {
+    RenderContext *render = (RenderContext *)context;
+    char prefix[32];
+    int prefixLength = LogStore_FormatTimePrefix(record->timestamp, prefix, sizeof(prefix));
+    if (render->cache) AddRecent(render->cache, record->timestamp, record->body, record->length);
+    return AppendText(render->buffer, prefix, prefixLength) &&
+           AppendText(render->buffer, record->body, record->length) &&
+           AppendText(render->buffer, "\r\n", 2);
+}
+
+// Render from the recent-record cache, if it still matches the store and
+// holds every record in [from, to). Nobody has taken a sequence it lacks,
+// so no append can be in flight either.
+static BOOL RenderRecent(LogStore *store, LONGLONG from, LONGLONG to, TextBuffer *buffer, DWORD *lastSequence) {
+    const LogRecentCache *cache = &store->recent;
+    if (!cache->valid || from <= cache->coldBefore || cache->generation != store->shared->generation ||
+        cache->lastSequence != (DWORD)store->shared->appendCount) return FALSE;
+
+    for (int i = 0; i < cache->count; i++) {
+        const LogRecentEntry *entry = &cache->entries[(cache->first + i) % RECENT_ENTRIES];
+        if (entry->timestamp < from || entry->timestamp >= to) continue;
+        AppendText(buffer, cache->text + entry->offset, entry->length);
+    }
+    if (lastSequence) *lastSequence = cache->lastSequence;
+    return TRUE;
+}
+
+char* LogStore_RenderText(LogStore *store, LONGLONG from, LONGLONG to, size_t *length, DWORD *lastSequence) {
+    TextBuffer buffer = {0};
+    if (!AppendText(&buffer, "", 0)) return NULL;
+
+    EnterCriticalSection(&store->lock);
+    BOOL cached = RenderRecent(store, from, to, &buffer, lastSequence);
+    LeaveCriticalSection(&store->lock);
+
+    if (!cached) {
+        // Holding the store exclusively waits out appends in flight, so every
+        // sequence handed out so far is in the text. Such a render up to the
+        // end of time sees every record from 'from' on, so it refills the cache.
+        LockStore(store, lastSequence != NULL);
+        RenderContext render;
+        render.buffer = &buffer;
+        render.cache = NULL;
+        if (lastSequence && to == 0x7FFFFFFFFFFFFFFFLL &&
+            ResetRecent(store, from > TIMESTAMP_MIN ? from - 1 : TIMESTAMP_MIN)) {
+            render.cache = &store->recent;
+        }
+        ScanLocked(store, from, to, RenderRecord, &render);
+        if (render.cache && buffer.failed) store->recent.valid = FALSE;
+        if (lastSequence) *lastSequence = (DWORD)store->shared->appendCount;
+        UnlockStore(store);
+    }
+
+    if (buffer.failed) {
+        free(buffer.text);
+        return NULL;
+    }
+    if (length) *length = buffer.length;
+    return buffer.text;
+}
+
+// Parsing WorkLog.txt-style text
+
+typedef struct {
+    int minuteOfDay;        // -1 when the entry had no time prefix
+    const char *body;
+    size_t length;
+} TextEntry;
+
+typedef BOOL (*TextEntryCallback)(const TextEntry *entry, void *context);
+
+size_t LogStore_ParseTimePrefix(const char *line, size_t length, int *minuteOfDay) {
+    size_t i = 0;
+    int hour = 0, minute = 0;
+
+    if (i >= length || line[i++] != '[') return 0;
+    int digits = 0;
+    while (i < length && line[i] >= '0' && line[i] <= '9' && digits < 2) {
+        hour = hour * 10 + (line[i++] - '0');
+        digits++;
+    }
+    if (digits == 0 || hour < 1 || hour > 12 || i >= length || line[i++] != ':') return 0;
+    if (i + 2 > length || line[i] < '0' || line[i] > '5' || line[i + 1] < '0' || line[i + 1] > '9') return 0;
+    minute = (line[i] - '0') * 10 + (line[i + 1] - '0');
+    i += 2;
+
+    if (i + 3 > length || line[i + 1] != 'm' || line[i + 2] != ']') return 0;
+    BOOL pm;
+    if (line[i] == 'a') pm = FALSE;
+    else if (line[i] == 'p') pm = TRUE;
+    else return 0;
+    i += 3;
+    if (i < length && line[i] == ' ') i++;
+
+    *minuteOfDay = ((hour % 12) + (pm ? 12 : 0)) * 60 + minute;
+    return i;
+}
+
+// Split text into entries. A line with a time prefix starts an entry; the
+// lines after it, up to the next prefix, continue its body.
+static BOOL ForEachTextEntry(const char *text, size_t length, TextEntryCallback callback, void *context) {
+    TextEntry entry;
+    BOOL haveEntry = FALSE;
+    size_t pos = 0;
+
+    while (pos < length) {
+        size_t lineEnd = pos;
+        while (lineEnd < length && text[lineEnd] != '\n') lineEnd++;
+        size_t next = lineEnd < length ? lineEnd + 1 : lineEnd;
+        size_t contentEnd = lineEnd;
+        while (contentEnd > pos && text[contentEnd - 1] == '\r') contentEnd--;
+
+        int minuteOfDay;
+        size_t prefix = LogStore_ParseTimePrefix(text + pos, contentEnd - pos, &minuteOfDay);
+        if (prefix > 0 || (!haveEntry && contentEnd > pos)) {
+            if (haveEntry && !callback(&entry, context)) return FALSE;
+            entry.minuteOfDay = prefix > 0 ? minuteOfDay : -1;
+            entry.body = text + pos + prefix;
+            entry.length = contentEnd - pos - prefix;
+            haveEntry = TRUE;
+        } else if (haveEntry && contentEnd > pos) {
+            // Continuation; blank lines in between stay part of the body
+            entry.length = contentEnd - (size_t)(entry.body - text);
+        }
+        pos = next;
+    }
+
+    return !haveEntry || callback(&entry, context);
+}
+
+// Timestamp for 'minuteOfDay' on the local day of 'day'
+static LONGLONG TimestampOnDay(LONGLONG day, int minuteOfDay) {
+    SYSTEMTIME local;
+    TimestampToLocal(day, &local);
+    local.wHour = (WORD)(minuteOfDay / 60);
+    local.wMinute = (WORD)(minuteOfDay % 60);
+    local.wSecond = local.wMilliseconds = 0;
+    return LocalToTimestamp(&local);
+}
+
+typedef struct {
+    LogStore *store;
+    LONGLONG day;
+    LONGLONG previous;
+    DWORD flags;
+    BOOL failed;
+} ImportContext;
+
+static BOOL ImportEntry(const TextEntry *entry, void *context) {
+    ImportContext *import = (ImportContext *)context;
+    LONGLONG timestamp = entry->minuteOfDay >= 0 ? TimestampOnDay(import->day, entry->minuteOfDay)
+                                                 : import->previous;
+    DWORD length = (DWORD)(entry->length < LOGSTORE_MAX_BODY ? entry->length : LOGSTORE_MAX_BODY);
+    if (!AppendLocked(import->store, timestamp, import->flags, entry->body, length)) {
+        import->failed = TRUE;
+        return FALSE;
+    }
+    import->previous = timestamp;
+    return TRUE;
+}
+
+BOOL LogStore_ImportText(LogStore *store, const char *text, size_t length, LONGLONG day, DWORD flags) {
+    if (!store || !text) return FALSE;
+
+    ImportContext import;
+    import.store = store;
+    import.day = day;
+    import.previous = LogStore_DayStart(day);
+    import.flags = flags;
+    import.failed = FALSE;
+
+    LockStore(store, FALSE);
+    ForEachTextEntry(text, length, ImportEntry, &import);
+    UnlockStore(store);
+    return !import.failed;
+}
+
+// Rewriting from edited text
+
+typedef struct {
+    LONGLONG timestamp;
+    DWORD flags;
+    int minuteOfDay;
+    BOOL unseen;            // Appended after the text being saved was rendered
+    DWORD length;
+    char *body;
+} SavedRecord;
+
+typedef struct {
+    SavedRecord *records;
+    int count;
+    int capacity;
+    DWORD shownSequence;
+    BOOL failed;
+} SavedRecords;
+
+// Whether 'sequence' was appended after 'shown' (0: before anything).
+// Records from before sequences existed carry 0 and count as old.
+static BOOL IsNewerSequence(DWORD sequence, DWORD shown) {
+    return sequence != 0 && (shown == 0 || (LONG)(sequence - shown) > 0);
+}
+
+static BOOL SaveRecord(const LogRecord *record, void *context) {
+    SavedRecords *saved = (SavedRecords *)context;
+    if (saved->count >= saved->capacity) {
+        int newCapacity = saved->capacity > 0 ? saved->capacity * 2 : 256;
+        SavedRecord *newRecords = (SavedRecord *)realloc(saved->records, newCapacity * sizeof(SavedRecord));
+        if (!newRecords) {
+            saved->failed = TRUE;
+            return FALSE;
+        }
+        saved->records = newRecords;
+        saved->capacity = newCapacity;
+    }
+
+    SavedRecord *copy = &saved->records[saved->count];
+    copy->body = (char *)malloc(record->length + 1);
+    if (!copy->body) {
+        saved->failed = TRUE;
+        return FALSE;
+    }
+    memcpy(copy->body, record->body, record->length);
+    copy->timestamp = record->timestamp;
+    copy->flags = record->flags;
+    copy->length = record->length;
+    copy->unseen = IsNewerSequence(record->sequence, saved->shownSequence);
+
+    SYSTEMTIME local;
+    TimestampToLocal(record->timestamp, &local);
+    copy->minuteOfDay = local.wHour * 60 + local.wMinute;
+    saved->count++;
+    return TRUE;
+}
+
+typedef struct {
+    LogStore *store;
+    SavedRecords *saved;
+    int cursor;             // First saved record not yet matched
+    LONGLONG previous;
+    BOOL failed;
+} ReplaceContext;
+
+static BOOL ReplaceEntry(const TextEntry *entry, void *context) {
+    ReplaceContext *replace = (ReplaceContext *)context;
+    SavedRecords *saved = replace->saved;
+
+    // Unchanged entries keep their record; look ahead so deleted lines
+    // don't throw off the rest
+    LONGLONG timestamp = 0;
+    DWORD flags = LOGSTORE_FLAG_EDITED;
+    BOOL matched = FALSE;
+    for (int i = replace->cursor; i < saved->count; i++) {
+        SavedRecord *record = &saved->records[i];
+        if (!record->unseen && record->minuteOfDay == entry->minuteOfDay && record->length == entry->length &&
+            memcmp(record->body, entry->body, entry->length) == 0) {
+            timestamp = record->timestamp;
+            flags = record->flags;
+            replace->cursor = i + 1;
+            matched = TRUE;
+            break;
+        }
+    }
+
+    // New or changed: the time as typed, on the day of the entry before it
+    if (!matched) {
+        timestamp = entry->minuteOfDay >= 0 ? TimestampOnDay(replace->previous, entry->minuteOfDay)
+                                            : replace->previous;
+    }
+
+    DWORD length = (DWORD)(entry->length < LOGSTORE_MAX_BODY ? entry->length : LOGSTORE_MAX_BODY);
+    if (!AppendLocked(replace->store, timestamp, flags, entry->body, length)) {
+        replace->failed = TRUE;
+        return FALSE;
+    }
+    replace->previous = timestamp;
+    return TRUE;
+}
+
+BOOL LogStore_ReplaceText(LogStore *store, const char *text, size_t length, DWORD shownSequence) {
+    if (!store || !text) return FALSE;
+
+    // Holding the store exclusively keeps every other process out until
+    // the new segments are in place
+    LockStore(store, TRUE);
+    SyncSegments(store);
+
+    SavedRecords saved = {0};
+    saved.shownSequence = shownSequence;
+    for (int i = 0; i < store->segmentCount && !saved.failed; i++) {
+        ScanSegment(store, &store->segments[i], 0, 0x7FFFFFFFFFFFFFFFLL, SaveRecord, &saved);
+    }
+
+    BOOL ok = !saved.failed;
+    char pendingPath[MAX_PATH], commitPath[MAX_PATH];
+    MarkerPath(store, PENDING_MARKER, pendingPath);
+    MarkerPath(store, COMMIT_MARKER, commitPath);
+
+    // With no segment active the first new record starts one. The new
+    // records will be all the store holds, so the cache and totals start
+    // over.
+    DWORD firstNew = (DWORD)store->shared->nextSequence + 1;
+    ResetRecent(store, TIMESTAMP_MIN);
+    LogTotals_Reset(store->totals, FALSE, (DWORD)store->shared->appendCount);
+    SealActiveSegment(store);
+    InterlockedExchange64(&store->shared->active, 0);
+    OpenActiveSegment(store, 0);
+
+    // The new records go into fresh segments after the old ones; the
+    // markers let LogStore_Open finish or undo this after a crash
+    if (ok) ok = WriteMarker(pendingPath, firstNew);
+    if (ok) {
+        ReplaceContext replace;
+        replace.store = store;
+        replace.saved = &saved;
+        replace.cursor = 0;
+        replace.previous = saved.count > 0 ? saved.records[0].timestamp : LogStore_Now();
+        replace.failed = FALSE;
+        ForEachTextEntry(text, length, ReplaceEntry, &replace);
+        ok = !replace.failed;
+    }
+
+    // Entries other writers added since the text was rendered weren't
+    // there to be edited; carry them over as they are
+    for (int i = 0; ok && i < saved.count; i++) {
+        SavedRecord *record = &saved.records[i];
+        if (record->unseen) ok = AppendLocked(store, record->timestamp, record->flags, record->body, record->length);
+    }
+    SealActiveSegment(store);
+
+    if (ok && MoveFileEx(pendingPath, commitPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteSegments(store, 0, firstNew);
+        DeleteFile(commitPath);
+    } else {
+        ok = FALSE;
+        DeleteSegments(store, firstNew, 0xFFFFFFFFu);
+        DeleteFile(pendingPath);
+    }
+    PublishSegments(store);
+    if (ok) {
+        store->recent.generation = store->generation;
+    } else {
+        store->recent.valid = FALSE;
+        LogTotals_MarkStale(store->totals);
+    }
+
+    UnlockStore(store);
+
+    for (int i = 0; i < saved.count; i++) {
+        free(saved.records[i].body);
+    }
+    free(saved.records);
+    return ok;
+}
+
+// Totals rebuild
+
+typedef struct {
+    LogStore *store;
+    volatile LONG nextSegment;  // Last segment claimed
+} RebuildContext;
+
+typedef struct {
+    RebuildContext *rebuild;
+    LogTotals *totals;
+} RebuildWorker;
+
+typedef struct {
+    LogTotals *totals;
+    DWORD day;
+} CountContext;
+
+static BOOL CountRecord(const LogRecord *record, void *context) {
+    CountContext *count = (CountContext *)context;
+    LogTotals_Count(count->totals, count->day, record);
+    return TRUE;
+}
+
+// Count whole segments, claiming the next one until none are left
+static DWORD WINAPI RebuildThread(LPVOID param) {
+    RebuildWorker *worker = (RebuildWorker *)param;
+    LogStore *store = worker->rebuild->store;
+    for (;;) {
+        LONG index = InterlockedIncrement(&worker->rebuild->nextSegment);
+        if (index >= store->segmentCount) break;
+        CountContext count;
+        count.totals = worker->totals;
+        count.day = store->segments[index].day;
+        ScanSegment(store, &store->segments[index], TIMESTAMP_MIN, 0x7FFFFFFFFFFFFFFFLL, CountRecord, &count);
+    }
+    return 0;
+}
+
+BOOL LogStore_RebuildTotals(LogStore *store, int threadCount) {
+    if (!store || !store->totals) return FALSE;
+    if (threadCount <= 0) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        threadCount = (int)info.dwNumberOfProcessors;
+    }
+    if (threadCount > 64) threadCount = 64;
+
+    // Exclusive, so no append lands between the count and the publish
+    LockStore(store, TRUE);
+    SyncSegments(store);
+    if (threadCount > store->segmentCount) threadCount = store->segmentCount > 0 ? store->segmentCount : 1;
+
+    RebuildContext rebuild;
+    rebuild.store = store;
+    rebuild.nextSegment = -1;
+    RebuildWorker workers[64];
+    HANDLE threads[64];
+    int started = 0;
+    BOOL ok = TRUE;
+    for (int i = 0; i < threadCount; i++) {
+        workers[i].rebuild = &rebuild;
+        workers[i].totals = LogTotals_Create();
+        if (!workers[i].totals) {
+            ok = FALSE;
+            threadCount = i;
+            break;
+        }
+    }
+    // The calling thread counts too, so a failed CreateThread only costs speed
+    for (int i = 1; ok && i < threadCount; i++) {
+        threads[started] = CreateThread(NULL, 0, RebuildThread, &workers[i], 0, NULL);
+        if (threads[started]) started++;
+    }
+    if (ok) RebuildThread(&workers[0]);
+    if (started > 0) WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+    for (int i = 0; i < started; i++) {
+        CloseHandle(threads[i]);
+    }
+
+    if (ok) {
+        for (int i = 1; i < threadCount; i++) {
+            LogTotals_Merge(workers[0].totals, workers[i].totals);
+        }
+        LogTotals_Publish(store->totals, workers[0].totals);
+    }
+    UnlockStore(store);
+
+    for (int i = 0; i < threadCount; i++) {
+        LogTotals_Close(workers[i].totals);
+    }
+    return ok;
+}
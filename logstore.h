@@ -0,0 +1,190 @@
+#ifndef LOGSTORE_H
+#define LOGSTORE_H
+
+#include <windows.h>
+
+// Append-only storage for work log entries.
+//
+// Entries live in segment files under one directory, named
+// seg-<sequence>-<YYYYMMDD>.wlog after the order they were opened in and
+// the local day their records belong to. A segment is a small header and
+// then records back to back, each a fixed header followed by its UTF-8
+// body. The checksum covers everything after it, so a torn or partly
+// written record is detected rather than parsed.
+//
+// A segment is sealed once it reaches LOGSTORE_SEGMENT_BYTES or a record
+// arrives for a different day, and is never written again. Only the newest
+// segment can end in a torn record, so opening the store validates just
+// that one and truncates it after its last good record.
+//
+// Several processes may have the store open at once. Each record goes out
+// as one write through an append-only handle, so concurrent appends land
+// whole and back to back. Which segment is active, the segment numbers and
+// a store-wide record sequence live in a small mapped file, store.map, and
+// change only through interlocked operations. Byte-range locks on that
+// file let a rewrite or recovery shut appends out, tell an opening
+// process whether any other one is still using the store, and make
+// checking a segment's room and writing into it one step for appenders.
+
+#define LOGSTORE_SEGMENT_BYTES (4 * 1024 * 1024)
+#define LOGSTORE_MAX_BODY (1024 * 1024)
+
+// Records must be timestamped from 1970-01-01 up to (not including)
+// 2200-01-01 UTC; appends outside that range fail
+#define LOGSTORE_MAX_TIMESTAMP (7258118400LL * 1000000000LL)
+
+#define LOGSTORE_FLAG_IMPORTED 0x0001   // Converted from WorkLog.txt text (minute resolution)
+#define LOGSTORE_FLAG_EDITED   0x0002   // Rewritten from the View editor
+#define LOGSTORE_FLAG_INGESTED 0x0004   // Received through the ingestion pipe
+
+typedef struct {
+    char magic[4];          // "WLOG"
+    DWORD version;
+    DWORD day;              // YYYYMMDD, local time
+    DWORD reserved;
+} LogSegmentHeader;
+
+typedef struct {
+    DWORD length;           // Body bytes that follow the header
+    DWORD checksum;         // CRC-32 of the fields below and the body
+    LONGLONG timestamp;     // Nanoseconds since 1970-01-01 UTC
+    DWORD flags;
+    DWORD sequence;         // Store-wide append number (0 in older records)
+} LogRecordHeader;
+
+typedef struct {
+    LONGLONG timestamp;
+    DWORD flags;
+    DWORD sequence;
+    DWORD length;
+    const char *body;       // Not NUL-terminated; valid during the callback
+} LogRecord;
+
+typedef struct {
+    DWORD sequence;
+    DWORD day;
+} LogSegment;
+
+// The mapped store.map. Segment keys are sequence << 32 | day.
+typedef struct {
+    char magic[4];                  // "WLSH"
+    DWORD version;
+    volatile LONGLONG active;       // Key of the segment to append to, or 0
+    volatile LONG nextSequence;     // Last segment sequence handed out
+    volatile LONG generation;       // Bumped whenever segments are removed
+    volatile LONG appendCount;      // Last record sequence handed out
+    DWORD reserved;
+} LogStoreShared;
+
+// Rendered lines of the newest records, so rendering recent entries needs
+// no disk I/O. Only records appended by this process are added; whenever
+// another process appends or rewrites the store the cache stops matching
+// and renders read the segments again.
+typedef struct {
+    LONGLONG timestamp;
+    DWORD offset;           // Of its line in the text ring
+    DWORD length;
+} LogRecentEntry;
+
+typedef struct {
+    BOOL valid;
+    LONG generation;        // shared->generation it was built against
+    DWORD lastSequence;     // Holds every record up to this while it equals shared->appendCount
+    LONGLONG coldBefore;    // Newest timestamp of any record not held
+    char *text;             // Rendered lines, written round and round
+    DWORD textEnd;
+    LogRecentEntry *entries;
+    int first;              // Oldest entry
+    int count;
+} LogRecentCache;
+
+typedef struct LogTotals LogTotals;     // logtotals.h
+
+typedef struct {
+    char directory[MAX_PATH];
+    LogSegment *segments;   // Oldest first; the last one is active
+    int segmentCount;
+    int segmentCapacity;
+    HANDLE activeFile;      // Append-only handle, or INVALID_HANDLE_VALUE
+    LONGLONG activeKey;     // Segment activeFile was opened for
+    ULONGLONG activeSize;   // Its size when last checked
+    BOOL activeDirty;       // Written through activeFile since its last flush
+    LONG generation;        // shared->generation the segment list reflects
+    HANDLE sharedFile;      // store.map, or INVALID_HANDLE_VALUE if unavailable
+    HANDLE sharedMapping;
+    LogStoreShared *shared; // Mapped view, or localShared for a private store
+    LogStoreShared localShared;
+    LogRecentCache recent;
+    LogTotals *totals;      // Per-day and keyword totals, or NULL if unavailable
+    CRITICAL_SECTION lock;
+} LogStore;
+
+// Return FALSE to stop the scan. Must not call back into the store.
+typedef BOOL (*LogRecordCallback)(const LogRecord *record, void *context);
+
+// Open (creating the directory if needed) and recover the store
+LogStore* LogStore_Open(const char *directory);
+void LogStore_Close(LogStore *store);
+
+// Safe against other threads and other processes appending to the store
+BOOL LogStore_Append(LogStore *store, LONGLONG timestamp, DWORD flags, const char *body, DWORD length);
+
+// Append 'count' records (their sequence is ignored) in as few writes as
+// possible. Each record lands whole, but after a failure only a prefix of
+// the batch may have been stored.
+BOOL LogStore_AppendBatch(LogStore *store, const LogRecord *records, int count);
+
+// Make what this process appended durable (FlushFileBuffers). Appends
+// are otherwise left to the file cache.
+BOOL LogStore_Flush(LogStore *store);
+BOOL LogStore_IsEmpty(LogStore *store);
+
+// Records with from <= timestamp < to, in the order they were appended.
+// Segments for days outside the range are skipped without being read.
+BOOL LogStore_Scan(LogStore *store, LONGLONG from, LONGLONG to, LogRecordCallback callback, void *context);
+
+// Time helpers (local time is used for days and rendering)
+LONGLONG LogStore_Now(void);
+LONGLONG LogStore_FromFileTime(const FILETIME *fileTime);
+LONGLONG LogStore_DayStart(LONGLONG timestamp);
+LONGLONG LogStore_NextDayStart(LONGLONG timestamp);
+// The [from, to) range of a YYYYMMDD local day; FALSE for a day that isn't one
+BOOL LogStore_DayRange(DWORD day, LONGLONG *from, LONGLONG *to);
+// Minute of the local day a timestamp falls in (0-1439)
+int LogStore_LocalMinute(LONGLONG timestamp);
+// "[h:mmam] " as the text format writes it; returns its length
+int LogStore_FormatTimePrefix(LONGLONG timestamp, char *out, size_t outSize);
+
+// Render records in the WorkLog.txt text format, "[h:mmam] body\r\n".
+// Returns a malloc'd NUL-terminated buffer, or NULL on failure. Ranges the
+// recent-record cache covers are rendered from memory; a render of the
+// whole store with 'lastSequence' refills the cache.
+// 'lastSequence' (optional) receives the last record sequence handed out;
+// every record up to it is in the text if the range covers the store.
+char* LogStore_RenderText(LogStore *store, LONGLONG from, LONGLONG to, size_t *length, DWORD *lastSequence);
+
+// Parse a "[h:mmam] " / "[h:mmpm] " line prefix (the space is optional).
+// Returns its length and sets the minute of the day, or returns 0.
+size_t LogStore_ParseTimePrefix(const char *line, size_t length, int *minuteOfDay);
+
+// CRC-32 (the record checksum) of a buffer
+DWORD LogStore_Crc32(const void *data, size_t length);
+
+// Append entries parsed from WorkLog.txt-style text. Lines without a time
+// prefix continue the previous entry; times are taken on the local day of
+// 'day' (any timestamp within it).
+BOOL LogStore_ImportText(LogStore *store, const char *text, size_t length, LONGLONG day, DWORD flags);
+
+// Replace every record with entries parsed from edited rendered text.
+// Entries that still match a record keep its exact timestamp and flags.
+// The new segments are written in full before the old ones are removed.
+// Records newer than 'shownSequence' (from LogStore_RenderText) weren't in
+// the text, so they are kept as they are after the edited entries.
+BOOL LogStore_ReplaceText(LogStore *store, const char *text, size_t length, DWORD shownSequence);
+
+// Recount store->totals from every segment, on 'threadCount' threads
+// (0 for one per processor), and mark them current. Appends wait until
+// it is done.
+BOOL LogStore_RebuildTotals(LogStore *store, int threadCount);
+
+#endif // LOGSTORE_H
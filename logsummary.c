@@ -0,0 +1,188 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logstore.h"
+#include "logtotals.h"
+
+// Work log summaries from the store's running totals.
+//
+// Usage: LogSummary [-d directory] [-w] [-k count] [-rebuild] [-t threads]
+//
+// Prints entries per day with the first and last entry time, per-week
+// totals with -w, and the most frequent keywords (-k, default 20). The
+// totals are kept up to date by every append, so this reads O(days)
+// instead of every record. Stale totals (after a crash, or a store from
+// before they existed) are rebuilt from the segments first; -rebuild
+// forces that, on 'threads' threads (default one per processor).
+
+#define DEFAULT_DIRECTORY "WorkLog"
+#define DEFAULT_KEYWORDS 20
+
+static void PrintUsage(void) {
+    fprintf(stderr,
+            "Usage: LogSummary [-d directory] [-w] [-k count] [-rebuild] [-t threads]\n"
+            "Entries per day (and week with -w) and the top keywords of the work log.\n");
+}
+
+static double ElapsedMs(LARGE_INTEGER start, LARGE_INTEGER frequency) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double)(now.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+}
+
+// "h:mmam" in local time: the log's "[h:mmam] " prefix without its brackets
+static void FormatTime(LONGLONG timestamp, char *out, size_t outSize) {
+    char prefix[32];
+    int length = LogStore_FormatTimePrefix(timestamp, prefix, sizeof(prefix));
+    snprintf(out, outSize, "%.*s", length - 3, prefix + 1);
+}
+
+// Days since 1970-01-01 of a YYYYMMDD day
+static LONG DayNumber(DWORD day) {
+    int y = (int)(day / 10000), m = (int)(day / 100 % 100), d = (int)(day % 100);
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yearOfEra = y - era * 400;
+    int dayOfYear = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+static DWORD DayFromNumber(LONG number) {
+    number += 719468;
+    LONG era = (number >= 0 ? number : number - 146096) / 146097;
+    LONG dayOfEra = number - era * 146097;
+    LONG yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    LONG dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    LONG mp = (5 * dayOfYear + 2) / 153;
+    LONG d = dayOfYear - (153 * mp + 2) / 5 + 1;
+    LONG m = mp < 10 ? mp + 3 : mp - 9;
+    LONG y = yearOfEra + era * 400 + (m <= 2);
+    return (DWORD)(y * 10000 + m * 100 + d);
+}
+
+// The Monday starting the week 'day' falls in (1970-01-01 was a Thursday)
+static DWORD WeekStart(DWORD day) {
+    LONG number = DayNumber(day);
+    LONG weekday = ((number + 3) % 7 + 7) % 7;
+    return DayFromNumber(number - weekday);
+}
+
+static void PrintDays(const LogDayTotals *days, int dayCount) {
+    printf("%-10s %8s  %-8s %-8s\n", "Day", "Entries", "First", "Last");
+    for (int i = 0; i < dayCount; i++) {
+        char first[16], last[16];
+        FormatTime(days[i].first, first, sizeof(first));
+        FormatTime(days[i].last, last, sizeof(last));
+        printf("%04lu-%02lu-%02lu %8lu  %-8s %-8s\n",
+               (unsigned long)(days[i].day / 10000), (unsigned long)(days[i].day / 100 % 100),
+               (unsigned long)(days[i].day % 100), (unsigned long)days[i].count, first, last);
+    }
+}
+
+// Days are in order, so each week is a run of them
+static void PrintWeeks(const LogDayTotals *days, int dayCount) {
+    printf("\n%-10s %8s %5s\n", "Week of", "Entries", "Days");
+    for (int i = 0; i < dayCount; ) {
+        DWORD week = WeekStart(days[i].day);
+        ULONGLONG count = 0;
+        int active = 0;
+        for (; i < dayCount && WeekStart(days[i].day) == week; i++) {
+            count += days[i].count;
+            active++;
+        }
+        printf("%04lu-%02lu-%02lu %8llu %5d\n", (unsigned long)(week / 10000), (unsigned long)(week / 100 % 100),
+               (unsigned long)(week % 100), (unsigned long long)count, active);
+    }
+}
+
+// Words cut short in the totals end in "..."
+static void PrintKeywords(const LogKeywordTotals *keywords, int keywordCount, int top) {
+    printf("\n%-26s %8s\n", "Keyword", "Count");
+    for (int i = 0; i < keywordCount && i < top; i++) {
+        char word[LOGTOTALS_KEYWORD_BYTES + 3];
+        snprintf(word, sizeof(word), "%s%s", keywords[i].word, keywords[i].truncated ? "..." : "");
+        printf("%-26s %8lu\n", word, (unsigned long)keywords[i].count);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *directory = DEFAULT_DIRECTORY;
+    BOOL weekly = FALSE, rebuild = FALSE;
+    int top = DEFAULT_KEYWORDS, threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (strcmp(argv[i], "-w") == 0) {
+            weekly = TRUE;
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            top = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-rebuild") == 0) {
+            rebuild = TRUE;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    LARGE_INTEGER frequency, start;
+    QueryPerformanceFrequency(&frequency);
+
+    // Opening creates a store, so only open one that is already there
+    DWORD attributes = GetFileAttributes(directory);
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        fprintf(stderr, "No log store in %s\n", directory);
+        return 1;
+    }
+    LogStore *store = LogStore_Open(directory);
+    if (!store || !store->totals) {
+        fprintf(stderr, "Cannot open the log store in %s\n", directory);
+        LogStore_Close(store);
+        return 1;
+    }
+
+    if (rebuild || LogTotals_IsStale(store->totals)) {
+        QueryPerformanceCounter(&start);
+        if (!LogStore_RebuildTotals(store, threads)) {
+            fprintf(stderr, "Rebuilding the totals failed\n");
+            LogStore_Close(store);
+            return 1;
+        }
+        fprintf(stderr, "Rebuilt totals from %d segments in %.1f ms\n", store->segmentCount, ElapsedMs(start, frequency));
+    }
+
+    QueryPerformanceCounter(&start);
+    LogDayTotals *days;
+    LogKeywordTotals *keywords;
+    int dayCount = LogTotals_GetDays(store->totals, &days);
+    int keywordCount = LogTotals_GetKeywords(store->totals, &keywords);
+    double readMs = ElapsedMs(start, frequency);
+    if (dayCount < 0 || keywordCount < 0) {
+        fprintf(stderr, "Out of memory\n");
+        free(days);
+        free(keywords);
+        LogStore_Close(store);
+        return 1;
+    }
+
+    PrintDays(days, dayCount);
+    if (weekly) PrintWeeks(days, dayCount);
+    if (top > 0) PrintKeywords(keywords, keywordCount, top);
+
+    const LogTotalsData *data = store->totals->data;
+    printf("\n%llu entries on %d days\n", (unsigned long long)data->records, dayCount);
+    if (data->untrackedRecords > 0 || data->untrackedWords > 0) {
+        printf("(%lu entries and %llu words beyond the table sizes were not broken down)\n",
+               (unsigned long)data->untrackedRecords, (unsigned long long)data->untrackedWords);
+    }
+    fprintf(stderr, "Read totals in %.2f ms\n", readMs);
+
+    free(days);
+    free(keywords);
+    LogStore_Close(store);
+    return 0;
+}
@@ -0,0 +1,397 @@
+#include "logtotals.h"
+#include "utf8.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TOTALS_FILE "totals.map"
+#define TOTALS_VERSION 2
+#define LOCK_TOTALS 0x40000000  // Past the largest the tables can grow to
+#define MAX_KEYWORD_PROBES 64   // Before the table is grown or the word left out
+
+static BOOL IsPrivate(const LogTotals *totals) {
+    return totals->hFile == INVALID_HANDLE_VALUE;
+}
+
+// Map the file to cover 'capacity' keyword slots, extending it if it is
+// shorter. On failure the old view stays in place.
+static BOOL MapCapacity(LogTotals *totals, DWORD capacity) {
+    size_t size = LOGTOTALS_DATA_SIZE(capacity);
+    HANDLE hMapping = CreateFileMapping(totals->hFile, NULL, PAGE_READWRITE, 0, (DWORD)size, NULL);
+    LogTotalsData *data = hMapping ? (LogTotalsData *)MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : NULL;
+    if (!data) {
+        if (hMapping) CloseHandle(hMapping);
+        return FALSE;
+    }
+    if (totals->data) UnmapViewOfFile(totals->data);
+    if (totals->hMapping) CloseHandle(totals->hMapping);
+    totals->hMapping = hMapping;
+    totals->data = data;
+    totals->mappedCapacity = capacity;
+    return TRUE;
+}
+
+static void LockTotalsFile(LogTotals *totals, BOOL exclusive) {
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = LOCK_TOTALS;
+    LockFileEx(totals->hFile, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, 1, 0, &overlapped);
+}
+
+static void UnlockTotalsFile(LogTotals *totals) {
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = LOCK_TOTALS;
+    UnlockFileEx(totals->hFile, 0, 1, 0, &overlapped);
+}
+
+// Lock the totals, first catching up with a keyword table another
+// process has grown. FALSE (and nothing held) if the bigger view can't be
+// mapped.
+static BOOL LockTotals(LogTotals *totals, BOOL exclusive) {
+    EnterCriticalSection(&totals->lock);
+    if (IsPrivate(totals)) return TRUE;
+    LockTotalsFile(totals, exclusive);
+    DWORD capacity = totals->data->keywordCapacity;
+    if (capacity != totals->mappedCapacity && !MapCapacity(totals, capacity)) {
+        UnlockTotalsFile(totals);
+        LeaveCriticalSection(&totals->lock);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void UnlockTotals(LogTotals *totals) {
+    if (!IsPrivate(totals)) UnlockTotalsFile(totals);
+    LeaveCriticalSection(&totals->lock);
+}
+
+static BOOL IsValidCapacity(DWORD capacity) {
+    return capacity >= LOGTOTALS_MIN_KEYWORDS && capacity <= LOGTOTALS_MAX_KEYWORDS &&
+           (capacity & (capacity - 1)) == 0;
+}
+
+// Empty the tables, keeping the keyword table at its current size
+static void ClearData(LogTotalsData *data, DWORD capacity, BOOL stale, DWORD lastSequence) {
+    memset(data, 0, LOGTOTALS_DATA_SIZE(capacity));
+    memcpy(data->magic, "WLTT", 4);
+    data->version = TOTALS_VERSION;
+    data->stale = stale;
+    data->lastSequence = lastSequence;
+    data->keywordCapacity = capacity;
+}
+
+LogTotals* LogTotals_Open(const char *directory) {
+    char path[MAX_PATH];
+    if (snprintf(path, sizeof(path), "%s\\%s", directory, TOTALS_FILE) >= (int)sizeof(path)) return NULL;
+
+    LogTotals *totals = (LogTotals *)calloc(1, sizeof(LogTotals));
+    if (!totals) return NULL;
+    InitializeCriticalSection(&totals->lock);
+    totals->hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (totals->hFile == INVALID_HANDLE_VALUE) {
+        DeleteCriticalSection(&totals->lock);
+        free(totals);
+        return NULL;
+    }
+
+    // Map the header to learn the keyword table's size, then all of it. A
+    // new file, or one from another version, starts out stale.
+    LockTotalsFile(totals, TRUE);
+    BOOL ok = MapCapacity(totals, 0);
+    if (ok) {
+        LogTotalsData *data = totals->data;
+        BOOL valid = memcmp(data->magic, "WLTT", 4) == 0 && data->version == TOTALS_VERSION &&
+                     IsValidCapacity(data->keywordCapacity);
+        ok = MapCapacity(totals, valid ? data->keywordCapacity : LOGTOTALS_MIN_KEYWORDS);
+        if (ok && !valid) ClearData(totals->data, LOGTOTALS_MIN_KEYWORDS, TRUE, 0);
+    }
+    UnlockTotalsFile(totals);
+    if (!ok) {
+        LogTotals_Close(totals);
+        return NULL;
+    }
+    return totals;
+}
+
+LogTotals* LogTotals_Create(void) {
+    LogTotals *totals = (LogTotals *)calloc(1, sizeof(LogTotals));
+    if (!totals) return NULL;
+    totals->hFile = INVALID_HANDLE_VALUE;
+    totals->data = (LogTotalsData *)malloc(LOGTOTALS_DATA_SIZE(LOGTOTALS_MIN_KEYWORDS));
+    if (!totals->data) {
+        free(totals);
+        return NULL;
+    }
+    totals->mappedCapacity = LOGTOTALS_MIN_KEYWORDS;
+    ClearData(totals->data, LOGTOTALS_MIN_KEYWORDS, FALSE, 0);
+    InitializeCriticalSection(&totals->lock);
+    return totals;
+}
+
+void LogTotals_Close(LogTotals *totals) {
+    if (!totals) return;
+    if (IsPrivate(totals)) {
+        free(totals->data);
+    } else {
+        if (totals->data) UnmapViewOfFile(totals->data);
+        if (totals->hMapping) CloseHandle(totals->hMapping);
+        CloseHandle(totals->hFile);
+    }
+    DeleteCriticalSection(&totals->lock);
+    free(totals);
+}
+
+static DWORD HashWord(const char *word, BOOL truncated) {
+    DWORD hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)word; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    // As if followed by a byte no UTF-8 text has
+    return truncated ? (hash ^ 0xFFu) * 16777619u : hash;
+}
+
+static LogDayTotals* FindDay(LogTotalsData *data, DWORD day) {
+    DWORD slot = (day * 2654435761u) % LOGTOTALS_MAX_DAYS;
+    for (int probe = 0; probe < LOGTOTALS_MAX_DAYS; probe++) {
+        LogDayTotals *totals = &data->days[slot];
+        if (totals->day == day) return totals;
+        if (totals->day == 0) {
+            totals->day = day;
+            data->dayCount++;
+            return totals;
+        }
+        slot = (slot + 1) % LOGTOTALS_MAX_DAYS;
+    }
+    return NULL;
+}
+
+// The slot holding 'word', or the free one it would go in; NULL when
+// MAX_KEYWORD_PROBES slots in a row are taken by other words
+static LogKeywordTotals* ProbeKeyword(LogTotalsData *data, const char *word, BOOL truncated) {
+    DWORD mask = data->keywordCapacity - 1;
+    DWORD slot = HashWord(word, truncated) & mask;
+    for (int probe = 0; probe < MAX_KEYWORD_PROBES; probe++) {
+        LogKeywordTotals *totals = &data->keywords[slot];
+        if (totals->word[0] == '\0') return totals;
+        if (totals->truncated == truncated && strcmp(totals->word, word) == 0) return totals;
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+// Double the keyword table and rehash it in place. Marked stale while the
+// table is half rebuilt, so a crash in between is recounted.
+static BOOL GrowKeywords(LogTotals *totals) {
+    DWORD capacity = totals->data->keywordCapacity;
+    if (capacity >= LOGTOTALS_MAX_KEYWORDS) return FALSE;
+    LogKeywordTotals *old = (LogKeywordTotals *)malloc(capacity * sizeof(LogKeywordTotals));
+    if (!old) return FALSE;
+    memcpy(old, totals->data->keywords, capacity * sizeof(LogKeywordTotals));
+
+    BOOL ok;
+    if (IsPrivate(totals)) {
+        LogTotalsData *data = (LogTotalsData *)realloc(totals->data, LOGTOTALS_DATA_SIZE(capacity * 2));
+        ok = data != NULL;
+        if (ok) {
+            totals->data = data;
+            totals->mappedCapacity = capacity * 2;
+        }
+    } else {
+        ok = MapCapacity(totals, capacity * 2);
+    }
+    if (!ok) {
+        free(old);
+        return FALSE;
+    }
+
+    LogTotalsData *data = totals->data;
+    BOOL stale = data->stale;
+    data->stale = TRUE;
+    memset(data->keywords, 0, (size_t)capacity * 2 * sizeof(LogKeywordTotals));
+    data->keywordCapacity = capacity * 2;
+    for (DWORD i = 0; i < capacity; i++) {
+        if (old[i].word[0] == '\0') continue;
+        LogKeywordTotals *slot = ProbeKeyword(data, old[i].word, old[i].truncated);
+        if (slot) *slot = old[i];
+        else data->untrackedWords += old[i].count;  // Not expected at half the load
+    }
+    data->stale = stale;
+    free(old);
+    return TRUE;
+}
+
+static LogKeywordTotals* FindKeyword(LogTotals *totals, const char *word, BOOL truncated) {
+    for (;;) {
+        LogTotalsData *data = totals->data;
+        LogKeywordTotals *slot = ProbeKeyword(data, word, truncated);
+        BOOL full = (data->keywordCount + 1) * 4 > data->keywordCapacity * 3;
+        if (slot && slot->word[0] != '\0') return slot;
+        if ((!slot || full) && GrowKeywords(totals)) continue;
+        if (!slot) return NULL;
+
+        strcpy(slot->word, word);
+        slot->truncated = truncated;
+        data->keywordCount++;
+        return slot;
+    }
+}
+
+static void AddDay(LogTotalsData *data, DWORD day, DWORD count, LONGLONG first, LONGLONG last) {
+    LogDayTotals *totals = FindDay(data, day);
+    if (!totals) {
+        data->untrackedRecords += count;
+        return;
+    }
+    if (totals->count == 0 || first < totals->first) totals->first = first;
+    if (totals->count == 0 || last > totals->last) totals->last = last;
+    totals->count += count;
+}
+
+static void AddKeyword(LogTotals *totals, const char *word, BOOL truncated, DWORD count) {
+    LogKeywordTotals *keyword = FindKeyword(totals, word, truncated);
+    if (keyword) keyword->count += count;
+    else totals->data->untrackedWords += count;
+}
+
+// Sequences wrap; the newer of two is the one less than 2^31 ahead
+static BOOL IsNewer(DWORD sequence, DWORD than) {
+    return (LONG)(sequence - than) > 0;
+}
+
+void LogTotals_Count(LogTotals *totals, DWORD day, const LogRecord *record) {
+    LogTotalsData *data = totals->data;
+    data->records++;
+    if (IsNewer(record->sequence, data->lastSequence)) data->lastSequence = record->sequence;
+    AddDay(data, day, 1, record->timestamp, record->timestamp);
+
+    size_t pos = 0, start, length;
+    while (Utf8_NextWord(record->body, record->length, &pos, &start, &length)) {
+        if (length < LOGTOTALS_MIN_KEYWORD) continue;
+        char word[LOGTOTALS_KEYWORD_BYTES];
+        size_t kept = Utf8_TruncateLength(record->body + start, length, LOGTOTALS_KEYWORD_BYTES - 1);
+        Utf8_Fold(record->body + start, kept, word);
+        AddKeyword(totals, word, kept < length, 1);
+    }
+}
+
+void LogTotals_Merge(LogTotals *into, const LogTotals *from) {
+    LogTotalsData *data = into->data;
+    data->records += from->data->records;
+    if (IsNewer(from->data->lastSequence, data->lastSequence)) data->lastSequence = from->data->lastSequence;
+    data->untrackedWords += from->data->untrackedWords;
+    data->untrackedRecords += from->data->untrackedRecords;
+    for (int i = 0; i < LOGTOTALS_MAX_DAYS; i++) {
+        const LogDayTotals *day = &from->data->days[i];
+        if (day->day != 0) AddDay(data, day->day, day->count, day->first, day->last);
+    }
+    for (DWORD i = 0; i < from->data->keywordCapacity; i++) {
+        const LogKeywordTotals *keyword = &from->data->keywords[i];
+        if (keyword->word[0] != '\0') AddKeyword(into, keyword->word, keyword->truncated, keyword->count);
+    }
+}
+
+void LogTotals_AddRecords(LogTotals *totals, DWORD day, const LogRecord *records, int count, DWORD lastSequence) {
+    if (!totals || count <= 0) return;
+
+    // Records that can't be counted leave the totals short until a rebuild
+    if (!LockTotals(totals, TRUE)) {
+        LogTotals_MarkStale(totals);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        LogTotals_Count(totals, day, &records[i]);
+    }
+    // Writers can finish out of order; keep the newest
+    if (IsNewer(lastSequence, totals->data->lastSequence)) totals->data->lastSequence = lastSequence;
+    UnlockTotals(totals);
+}
+
+void LogTotals_Reset(LogTotals *totals, BOOL stale, DWORD lastSequence) {
+    if (!totals || !LockTotals(totals, TRUE)) return;
+    ClearData(totals->data, totals->data->keywordCapacity, stale, lastSequence);
+    UnlockTotals(totals);
+}
+
+// Under the file lock, so a Publish or Reset in another process can't
+// overwrite the mark. The flag is in the header, mapped whatever the
+// table's size, so it is set even if a grown table can't be mapped.
+void LogTotals_MarkStale(LogTotals *totals) {
+    if (!totals) return;
+    if (!LockTotals(totals, TRUE)) {
+        EnterCriticalSection(&totals->lock);
+        LockTotalsFile(totals, TRUE);
+    }
+    totals->data->stale = TRUE;
+    UnlockTotals(totals);
+}
+
+// Totals that can't be locked are taken as stale
+BOOL LogTotals_IsStale(LogTotals *totals) {
+    if (!totals || !LockTotals(totals, FALSE)) return TRUE;
+    BOOL stale = totals->data->stale;
+    UnlockTotals(totals);
+    return stale;
+}
+
+void LogTotals_Publish(LogTotals *totals, const LogTotals *from) {
+    if (!totals || !LockTotals(totals, TRUE)) return;
+
+    // The table only ever gets bigger in the file; a smaller one is
+    // published by its size in the header
+    DWORD capacity = from->data->keywordCapacity;
+    if (capacity <= totals->mappedCapacity || MapCapacity(totals, capacity)) {
+        memcpy(totals->data, from->data, LOGTOTALS_DATA_SIZE(capacity));
+        memcpy(totals->data->magic, "WLTT", 4);
+        totals->data->version = TOTALS_VERSION;
+        totals->data->stale = FALSE;
+    }
+    UnlockTotals(totals);
+}
+
+static int CompareDays(const void *a, const void *b) {
+    DWORD x = ((const LogDayTotals *)a)->day, y = ((const LogDayTotals *)b)->day;
+    return x < y ? -1 : x > y;
+}
+
+static int CompareKeywords(const void *a, const void *b) {
+    const LogKeywordTotals *x = (const LogKeywordTotals *)a, *y = (const LogKeywordTotals *)b;
+    if (x->count != y->count) return x->count > y->count ? -1 : 1;
+    return strcmp(x->word, y->word);
+}
+
+int LogTotals_GetDays(LogTotals *totals, LogDayTotals **days) {
+    *days = NULL;
+    if (!totals) return -1;
+
+    if (!LockTotals(totals, FALSE)) return -1;
+    int count = 0, capacity = (int)totals->data->dayCount;
+    LogDayTotals *result = (LogDayTotals *)malloc((capacity + 1) * sizeof(LogDayTotals));
+    for (int i = 0; result && i < LOGTOTALS_MAX_DAYS && count < capacity; i++) {
+        if (totals->data->days[i].day != 0) result[count++] = totals->data->days[i];
+    }
+    UnlockTotals(totals);
+
+    if (!result) return -1;
+    qsort(result, count, sizeof(LogDayTotals), CompareDays);
+    *days = result;
+    return count;
+}
+
+int LogTotals_GetKeywords(LogTotals *totals, LogKeywordTotals **keywords) {
+    *keywords = NULL;
+    if (!totals) return -1;
+
+    if (!LockTotals(totals, FALSE)) return -1;
+    int count = 0, capacity = (int)totals->data->keywordCount;
+    LogKeywordTotals *result = (LogKeywordTotals *)malloc((capacity + 1) * sizeof(LogKeywordTotals));
+    for (DWORD i = 0; result && i < totals->data->keywordCapacity && count < capacity; i++) {
+        if (totals->data->keywords[i].word[0] != '\0') result[count++] = totals->data->keywords[i];
+    }
+    UnlockTotals(totals);
+
+    if (!result) return -1;
+    qsort(result, count, sizeof(LogKeywordTotals), CompareKeywords);
+    *keywords = result;
+    return count;
+}
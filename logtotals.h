@@ -0,0 +1,110 @@
+#ifndef LOGTOTALS_H
+#define LOGTOTALS_H
+
+#include <windows.h>
+#include "logstore.h"
+
+// Running totals over the log store, so summaries cost O(days) instead of
+// a pass over every record.
+//
+// totals.map beside the segments holds, per local day, the number of
+// entries and the first and last entry time, and a tally of the words in
+// all entries (folded, at least LOGTOTALS_MIN_KEYWORD bytes). Every append
+// adds its records under a byte-range lock on the file, so every process
+// writing to the store keeps it current; a View rewrite starts it over
+// with the records it writes.
+//
+// The keyword table starts at LOGTOTALS_MIN_KEYWORDS slots and doubles,
+// file and all, whenever it is three quarters full, up to
+// LOGTOTALS_MAX_KEYWORDS. Other processes see the new size in the header
+// and map the file again the next time they lock it. Lookups give up
+// after a bounded number of probes, so only once the table can't grow
+// are words left out (counted in untrackedWords).
+//
+// The totals also remember the last record sequence they counted. When
+// the store is opened with nobody else using it and that doesn't match
+// the newest record on disk (a crash between a write and its update, or
+// a store older than the totals), they are marked stale until
+// LogStore_RebuildTotals recounts them from the segments. A new totals
+// file starts out stale too.
+
+#define LOGTOTALS_MAX_DAYS 8192
+#define LOGTOTALS_MIN_KEYWORDS 4096
+#define LOGTOTALS_MAX_KEYWORDS (1024 * 1024)
+#define LOGTOTALS_KEYWORD_BYTES 24
+#define LOGTOTALS_MIN_KEYWORD 4
+
+typedef struct {
+    DWORD day;              // YYYYMMDD, 0 for a free slot
+    DWORD count;
+    LONGLONG first;         // Earliest and latest entry timestamps
+    LONGLONG last;
+} LogDayTotals;
+
+// Words longer than the key are tallied under their first
+// LOGTOTALS_KEYWORD_BYTES - 1 bytes (whole code points), kept apart from
+// a word that is exactly that prefix
+typedef struct {
+    char word[LOGTOTALS_KEYWORD_BYTES];     // NUL-terminated, "" for a free slot
+    DWORD count;
+    BOOL truncated;                         // 'word' is the start of longer words
+} LogKeywordTotals;
+
+// The mapped totals.map; days and keywords are open-addressed tables
+typedef struct {
+    char magic[4];          // "WLTT"
+    DWORD version;
+    BOOL stale;             // Not to be trusted until rebuilt
+    DWORD lastSequence;     // Newest record sequence counted
+    ULONGLONG records;
+    ULONGLONG untrackedWords;   // Counted while the keyword table was full
+    DWORD dayCount;
+    DWORD keywordCount;
+    DWORD untrackedRecords;     // Counted while the day table was full
+    DWORD keywordCapacity;      // Slots in keywords, a power of two
+    LogDayTotals days[LOGTOTALS_MAX_DAYS];
+    LogKeywordTotals keywords[];
+} LogTotalsData;
+
+#define LOGTOTALS_DATA_SIZE(keywordCapacity) \
+    (sizeof(LogTotalsData) + (size_t)(keywordCapacity) * sizeof(LogKeywordTotals))
+
+// Mapped from totals.map, or private memory (hFile is
+// INVALID_HANDLE_VALUE) that grows with realloc
+struct LogTotals {
+    HANDLE hFile;
+    HANDLE hMapping;
+    LogTotalsData *data;
+    DWORD mappedCapacity;   // Keyword slots 'data' covers
+    CRITICAL_SECTION lock;  // Held with the file lock; remapping moves 'data'
+};
+
+// Open (creating if needed) totals.map in 'directory'; NULL on failure
+LogTotals* LogTotals_Open(const char *directory);
+void LogTotals_Close(LogTotals *totals);
+
+// Empty totals in private memory, as a rebuild counts into per thread
+LogTotals* LogTotals_Create(void);
+
+// Count records of one local day, the newest with 'lastSequence'
+void LogTotals_AddRecords(LogTotals *totals, DWORD day, const LogRecord *records, int count, DWORD lastSequence);
+
+// Empty the totals, marked stale or not, as of record 'lastSequence'
+void LogTotals_Reset(LogTotals *totals, BOOL stale, DWORD lastSequence);
+void LogTotals_MarkStale(LogTotals *totals);
+BOOL LogTotals_IsStale(LogTotals *totals);
+
+// Building totals from LogTotals_Create, not safe for use by several
+// threads. Count keeps the newest record sequence it saw as lastSequence.
+void LogTotals_Count(LogTotals *totals, DWORD day, const LogRecord *record);
+void LogTotals_Merge(LogTotals *into, const LogTotals *from);
+
+// Replace the totals with those in 'from' and mark them current
+void LogTotals_Publish(LogTotals *totals, const LogTotals *from);
+
+// Copies of the tables as malloc'd arrays, days in order and keywords by
+// falling count. Return the number of entries, or -1 on failure.
+int LogTotals_GetDays(LogTotals *totals, LogDayTotals **days);
+int LogTotals_GetKeywords(LogTotals *totals, LogKeywordTotals **keywords);
+
+#endif // LOGTOTALS_H
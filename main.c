@@ -1,7 +1,14 @@
 #include <windows.h>
 #include <stdio.h>
 #include <time.h>
+#include <ctype.h>
 #include "spellchecker.h"
+#include "utf8.h"
+#include "logstore.h"
+#include "logtotals.h"
+#include "logarchive.h"
+#include "ingest.h"
+#include "iojob.h"
 
 // Helper macros for mouse position extraction
 #define GET_X_LPARAM(lp) ((int)(short)LOWORD(lp))
@@ -9,6 +16,9 @@
 
 // Spell checker globals
 static SpellChecker *g_spellChecker = NULL;
+static SpellCheckMemoryTracker g_spellCheckerMemory;   // Everything the checker allocates
+static LogStore *g_logStore = NULL;
+static IngestServer *g_ingestServer = NULL;
 static HWND g_hwndInput = NULL;
 static UINT_PTR g_spellCheckTimer = 0;
 static DWORD g_lastSpellCheckTime = 0;
@@ -16,12 +26,53 @@ static BOOL g_spellCheckEnabled = TRUE;
 static int g_contextMenuWordIndex = -1;
 static HWND g_hwndTooltip = NULL;
 
+// Spans as last shown, so a check repaints only the underlines it changed.
+// The checker works on UTF-8 byte offsets; these are in the edit
+// control's characters (UTF-16 units), converted through g_checkedSpans.
+static MisspelledWordList g_shownMisspelled = {0};
+static MisspelledWordList g_checkedSpans = {0};
+static MisspelledDiff g_misspelledDiff = {0};
+static BOOL g_shownMisspelledLost = FALSE;      // Copy failed; repaint everything next time
+
+// The dictionaries load on a job of their own while the window comes up;
+// until then g_spellChecker is NULL and a check asked for is held back
+static IoJob *g_spellCheckerJob = NULL;
+static BOOL g_spellCheckPending = FALSE;
+static const char *g_spellCheckNotice = NULL;   // Shown in the title
+static LARGE_INTEGER g_startTime;               // For the startup timings
+
+// As-you-type completion: hint line under the input, Tab accepts the first
+static HWND g_hwndCompletion = NULL;
+static char g_completion[256] = {0};            // UTF-8
+static int g_completionPrefixLen = 0;           // Bytes of g_completion already typed
+
+// Export, view and save run as background jobs, one at a time
+static IoJob *g_ioJob = NULL;
+static char g_jobStatus[64] = {0};      // Shown in the title while a job runs
+
+typedef struct {
+    char filename[64];
+    LONGLONG now;
+    BOOL empty;                 // No entries today, nothing written
+} ExportJob;
+
+typedef struct {
+    DWORD sequence;             // Newest entry in the rendered text
+} ViewJob;
+
+typedef struct {
+    char *text;                 // Edited view text, UTF-8
+    int length;
+    DWORD shownSequence;
+} SaveJob;
+
 // Global variables for view/edit mode
 static BOOL isViewMode = FALSE;
+static DWORD g_viewSequence = 0;    // Newest entry shown in view mode
 static HWND hwndSaveBtn = NULL;
 static HWND hwndCancelBtn = NULL;
 static char originalContent[4096] = {0};
-static char mainInputBackup[4096] = {0};
+static WCHAR *mainInputBackup = NULL;  // What was typed before View, restored after
 
 #define ID_INPUT 1
 #define ID_ADD 2
@@ -29,40 +80,351 @@ static char mainInputBackup[4096] = {0};
 #define ID_EXPORT 4
 #define ID_SAVE 5
 #define ID_CANCEL 6
+#define ID_COMPLETION 7
 #define ID_SPELLCHECK_TIMER 100
 #define ID_CONTEXT_MENU_SUGGESTION_BASE 1000
+#define ID_CONTEXT_MENU_REPLACE_ALL_BASE 1050
 #define ID_CONTEXT_MENU_ADD_DICT 1100
 #define ID_CONTEXT_MENU_IGNORE 1101
 #define SPELLCHECK_DEBOUNCE_MS 150
+#define COMPLETION_MIN_PREFIX 2
+#define COMPLETION_COUNT 5
+#define WM_DICTIONARY_RELOADED (WM_APP + 1)
+#define WM_IOJOB (WM_APP + 2)
+#define LOG_STORE_DIRECTORY "WorkLog"
+#define LEGACY_LOG_FILE "WorkLog.txt"
 
 // Function declarations
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 LRESULT CALLBACK EditProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 void AddLogEntry(HWND hwndInput);
-void ExportLog();
-void InitializeSpellChecker(void);
+void ExportLog(HWND hwnd);
+void InitializeSpellChecker(HWND hwnd);
+BOOL LoadSpellCheckerJobProc(IoJob *job);
+void OnSpellCheckerLoaded(IoJob *job);
+void ReportStartupTime(const char *milestone);
+void ReportVerdictCache(void);
+void ReportSpellCheckerMemory(void);
 void CleanupSpellChecker(void);
+void InitializeLogStore(void);
+void ImportLegacyLog(void);
+void SeedWordUses(void);
+void CleanupLogStore(void);
+char* ConvertCodePage(const char *text, int length, UINT fromCodePage, UINT toCodePage, int *outLength);
+char* WideToUtf8(const WCHAR *wide, int wideLength, int *outLength);
+WCHAR* Utf8ToWide(const char *text, int length);
+char* GetEditTextUtf8(HWND hwnd, int *outLength);
+DWORD Utf8OffsetToChar(const char *text, size_t length, size_t from, DWORD fromChar, size_t offset);
+BOOL SpansToCharPositions(const MisspelledWordList *spans, const char *text, size_t length, MisspelledWordList *out);
 void TriggerSpellCheck(void);
 void CALLBACK SpellCheckTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
 void DrawMisspelledUnderlines(HWND hwnd);
+void ShowMisspelledChanges(const char *text, int length);
+void GetEditTextMetrics(HWND hwnd, TEXTMETRIC *tm);
+void InvalidateCharRange(HWND hwnd, DWORD start, DWORD end, const TEXTMETRIC *tm);
 BOOL HandleSpellCheckContextMenu(HWND hwnd, int xPos, int yPos);
-void ReplaceWord(const char *oldWord, const char *newWord);
+void ReplaceWord(int wordIndex, const char *newWord, BOOL replaceAll);
+void UpdateWindowTitle(void);
+BOOL StartJob(HWND hwnd, const char *status, IoJobProc proc, IoJobCallback onComplete,
+              IoJobCallback onProgress, void *context);
+void EndJob(void);
+BOOL ExportJobProc(IoJob *job);
+void OnExportProgress(IoJob *job);
+void OnExportComplete(IoJob *job);
+BOOL LoadViewJobProc(IoJob *job);
+void OnViewLoaded(IoJob *job);
+BOOL SaveViewJobProc(IoJob *job);
+void OnViewSaved(IoJob *job);
+void EnterViewMode(HWND hwnd, const char *text);
+void ExitViewMode(HWND hwnd);
+void RestoreMainInput(void);
+void OnDictionaryReloaded(void *context);
+void UpdateCompletions(HWND hwndEdit);
+void ClearCompletions(void);
 
 // Keep original edit control procedure so we can forward messages we don't handle
 static WNDPROC g_oldEditProc = NULL;
 
-// Initialize spell checker at startup
-void InitializeSpellChecker(void) {
-    g_spellChecker = SpellChecker_Create();
-    if (g_spellChecker) {
-        if (!SpellChecker_LoadDictionary(g_spellChecker, "dictionary.txt")) {
-            MessageBox(NULL, "Warning: Could not load spell-check dictionary. Spell checking disabled.", 
-                      "Dictionary Load Error", MB_OK | MB_ICONWARNING);
-            g_spellCheckEnabled = FALSE;
-        } else {
-            SpellChecker_LoadUserDictionary(g_spellChecker, "user_dictionary.txt");
-            g_spellCheckEnabled = TRUE;
+// Convert text between code pages (through UTF-16). Returns a malloc'd
+// NUL-terminated buffer, or NULL on failure.
+char* ConvertCodePage(const char *text, int length, UINT fromCodePage, UINT toCodePage, int *outLength) {
+    int wideLength = length > 0 ? MultiByteToWideChar(fromCodePage, 0, text, length, NULL, 0) : 0;
+    WCHAR *wide = (WCHAR *)malloc((wideLength + 1) * sizeof(WCHAR));
+    if (!wide) return NULL;
+    if (wideLength > 0) MultiByteToWideChar(fromCodePage, 0, text, length, wide, wideLength);
+    
+    int resultLength = wideLength > 0 ? WideCharToMultiByte(toCodePage, 0, wide, wideLength, NULL, 0, NULL, NULL) : 0;
+    char *result = (char *)malloc(resultLength + 1);
+    if (result) {
+        if (resultLength > 0) WideCharToMultiByte(toCodePage, 0, wide, wideLength, result, resultLength, NULL, NULL);
+        result[resultLength] = '\0';
+        if (outLength) *outLength = resultLength;
+    }
+    free(wide);
+    return result;
+}
+
+// UTF-16 to UTF-8. Returns a malloc'd NUL-terminated buffer, or NULL.
+char* WideToUtf8(const WCHAR *wide, int wideLength, int *outLength) {
+    int length = wideLength > 0 ? WideCharToMultiByte(CP_UTF8, 0, wide, wideLength, NULL, 0, NULL, NULL) : 0;
+    char *result = (char *)malloc(length + 1);
+    if (!result) return NULL;
+    if (length > 0) WideCharToMultiByte(CP_UTF8, 0, wide, wideLength, result, length, NULL, NULL);
+    result[length] = '\0';
+    if (outLength) *outLength = length;
+    return result;
+}
+
+// UTF-8 to UTF-16, for text going into the controls. Returns a malloc'd
+// NUL-terminated buffer, or NULL.
+WCHAR* Utf8ToWide(const char *text, int length) {
+    int wideLength = length > 0 ? MultiByteToWideChar(CP_UTF8, 0, text, length, NULL, 0) : 0;
+    WCHAR *wide = (WCHAR *)malloc((wideLength + 1) * sizeof(WCHAR));
+    if (!wide) return NULL;
+    if (wideLength > 0) MultiByteToWideChar(CP_UTF8, 0, text, length, wide, wideLength);
+    wide[wideLength] = 0;
+    return wide;
+}
+
+// An edit control's text as UTF-8, which is what the spell checker and
+// its dictionaries work in. Read as UTF-16 so nothing is lost to the
+// ANSI code page. Returns a malloc'd buffer, or NULL.
+char* GetEditTextUtf8(HWND hwnd, int *outLength) {
+    int wideLength = GetWindowTextLengthW(hwnd);
+    WCHAR *wide = (WCHAR *)malloc((wideLength + 1) * sizeof(WCHAR));
+    if (!wide) return NULL;
+    wideLength = wideLength > 0 ? GetWindowTextW(hwnd, wide, wideLength + 1) : 0;
+    char *text = WideToUtf8(wide, wideLength, outLength);
+    free(wide);
+    return text;
+}
+
+// Character position in the edit control (UTF-16 units) of byte 'offset'
+// of the UTF-8 'text'. Counting resumes from byte 'from', known to be
+// character 'fromChar', so sorted offsets convert in one pass.
+DWORD Utf8OffsetToChar(const char *text, size_t length, size_t from, DWORD fromChar, size_t offset) {
+    if (offset < from) {
+        from = 0;
+        fromChar = 0;
+    }
+    while (from < offset && from < length) {
+        unsigned int codePoint;
+        from += Utf8_Decode((const unsigned char *)text + from, length - from, &codePoint);
+        fromChar += codePoint >= 0x10000 ? 2 : 1;
+    }
+    return fromChar;
+}
+
+// Copy the checker's spans, which are byte offsets into 'text', into
+// 'out' with character positions. FALSE if 'out' couldn't grow.
+BOOL SpansToCharPositions(const MisspelledWordList *spans, const char *text, size_t length, MisspelledWordList *out) {
+    if (spans->count > out->capacity) {
+        MisspelledWord *words = (MisspelledWord *)realloc(out->words, spans->count * sizeof(MisspelledWord));
+        if (!words) {
+            out->count = 0;
+            return FALSE;
         }
+        out->words = words;
+        out->capacity = spans->count;
+    }
+    
+    size_t byte = 0;
+    DWORD position = 0;
+    for (int i = 0; i < spans->count; i++) {
+        const MisspelledWord *span = &spans->words[i];
+        out->words[i] = *span;
+        position = Utf8OffsetToChar(text, length, byte, position, span->startPos);
+        out->words[i].startPos = position;
+        position = Utf8OffsetToChar(text, length, span->startPos, position, span->endPos);
+        out->words[i].endPos = position;
+        byte = span->endPos;
+    }
+    out->count = spans->count;
+    return TRUE;
+}
+
+// Open the log store at startup and start taking entries from other
+// programs on the ingestion pipe. Only the first running instance gets
+// the pipe; later ones just share the store.
+void InitializeLogStore(void) {
+    g_logStore = LogStore_Open(LOG_STORE_DIRECTORY);
+    if (!g_logStore) {
+        MessageBox(NULL, "Warning: Could not open the log store. Entries cannot be saved.",
+                  "Log Store Error", MB_OK | MB_ICONWARNING);
+        return;
+    }
+    if (LogStore_IsEmpty(g_logStore)) ImportLegacyLog();
+    g_ingestServer = Ingest_Start(g_logStore, INGEST_PIPE_NAME);
+}
+
+// The first time, entries from the old WorkLog.txt are brought over; it
+// has no dates, so they are placed on the day the file was last written.
+void ImportLegacyLog(void) {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesEx(LEGACY_LOG_FILE, GetFileExInfoStandard, &info)) return;
+    if (info.nFileSizeHigh != 0 || info.nFileSizeLow == 0) return;
+    
+    FILE *file = fopen(LEGACY_LOG_FILE, "rb");
+    if (!file) return;
+    char *raw = (char *)malloc(info.nFileSizeLow);
+    size_t bytesRead = raw ? fread(raw, 1, info.nFileSizeLow, file) : 0;
+    fclose(file);
+    
+    int length;
+    char *text = raw ? ConvertCodePage(raw, (int)bytesRead, CP_ACP, CP_UTF8, &length) : NULL;
+    if (text) {
+        LONGLONG lastWrite = LogStore_FromFileTime(&info.ftLastWriteTime);
+        LogStore_ImportText(g_logStore, text, length, lastWrite, LOGSTORE_FLAG_IMPORTED);
+    }
+    free(text);
+    free(raw);
+}
+
+// Rank completions and suggestions by the words of earlier entries too,
+// from the store's keyword totals (entries added from now on are counted
+// as they are added). Stale totals are skipped rather than rebuilt here.
+void SeedWordUses(void) {
+    if (!g_spellChecker || !g_logStore || LogTotals_IsStale(g_logStore->totals)) return;
+    
+    LogKeywordTotals *keywords;
+    int keywordCount = LogTotals_GetKeywords(g_logStore->totals, &keywords);
+    for (int i = 0; i < keywordCount; i++) {
+        // A cut-short keyword stands for several longer words, none of them it
+        if (keywords[i].truncated) continue;
+        SpellChecker_RecordWordCount(g_spellChecker, keywords[i].word, (int)keywords[i].count);
+    }
+    free(keywords);
+}
+
+void CleanupLogStore(void) {
+    Ingest_Stop(g_ingestServer);
+    g_ingestServer = NULL;
+    LogStore_Close(g_logStore);
+    g_logStore = NULL;
+}
+
+// Start loading the spell checker while the window is created; it is
+// handed over in OnSpellCheckerLoaded
+void InitializeSpellChecker(HWND hwnd) {
+    g_spellCheckerJob = IoJob_Start(hwnd, WM_IOJOB, LoadSpellCheckerJobProc, OnSpellCheckerLoaded, NULL, NULL);
+    if (g_spellCheckerJob) {
+        g_spellCheckNotice = "Loading dictionary...";
+    } else {
+        g_spellCheckEnabled = FALSE;
+        g_spellCheckNotice = "Spell checking off";
+    }
+}
+
+// Runs on the job thread. Nothing else sees the checker until it is
+// handed over, so the setup-time loads need no coordination.
+BOOL LoadSpellCheckerJobProc(IoJob *job) {
+    SpellChecker *checker = SpellChecker_CreateWithAllocator(&g_spellCheckerMemory.allocator);
+    if (!checker) return FALSE;
+    
+    // Embedded builds carry dictionary.txt inside the executable, so
+    // there is nothing to look up or parse at startup
+    BOOL haveDictionary = SpellChecker_HasEmbeddedDictionary() ||
+                          SpellChecker_LoadDictionary(checker, "dictionary.txt");
+    if (!haveDictionary) {
+        SpellChecker_Destroy(checker);
+        return FALSE;
+    }
+    SpellChecker_LoadUserDictionary(checker, "user_dictionary.txt");
+    SpellChecker_LoadGlossary(checker, "glossary.txt");
+    SpellChecker_LoadFrequencies(checker, "word_frequency.txt");
+    job->result = checker;
+    return TRUE;
+}
+
+void OnSpellCheckerLoaded(IoJob *job) {
+    g_spellCheckerJob = NULL;
+    g_spellChecker = (SpellChecker *)job->result;
+    job->result = NULL;         // Ours now, not freed with the job
+    
+    if (!job->succeeded || !g_spellChecker) {
+        // Shown in the title rather than a message box in the way of typing
+        g_spellCheckEnabled = FALSE;
+        g_spellCheckNotice = "Spell checking off: no dictionary";
+    } else {
+        g_spellCheckNotice = NULL;
+        
+        // Pick up edits to dictionary.txt / user_dictionary.txt without a restart
+        SpellChecker_StartWatching(g_spellChecker, OnDictionaryReloaded, NULL);
+        SeedWordUses();
+        
+        // One check of the current text covers every one asked for meanwhile
+        if (g_spellCheckPending) TriggerSpellCheck();
+    }
+    g_spellCheckPending = FALSE;
+    UpdateWindowTitle();
+    ReportStartupTime("spell checker ready");
+}
+
+// Time since WinMain started, to the debugger output
+void ReportStartupTime(const char *milestone) {
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    
+    char message[128];
+    snprintf(message, sizeof(message), "Logger: %s after %.1f ms\n", milestone,
+             (now.QuadPart - g_startTime.QuadPart) * 1000.0 / freq.QuadPart);
+    OutputDebugString(message);
+}
+
+// How often the session's checks found a word's verdict already cached,
+// to the debugger output
+void ReportVerdictCache(void) {
+    VerdictCacheStats stats;
+    SpellChecker_GetVerdictStats(g_spellChecker, &stats);
+    ULONGLONG lookups = stats.hits + stats.misses;
+    if (lookups == 0) return;
+    
+    char message[160];
+    snprintf(message, sizeof(message), "Logger: word verdicts %llu of %llu cached (%.1f%%), %d held\n",
+             (unsigned long long)stats.hits, (unsigned long long)lookups, stats.hits * 100.0 / lookups,
+             stats.entries);
+    OutputDebugString(message);
+}
+
+// What the checker holds, per part and in total, whether any check pass
+// allocated, and the size of its DAWG and indexes, to the debugger output
+void ReportSpellCheckerMemory(void) {
+    SpellCheckMemoryStats stats;
+    SpellChecker_GetMemoryStats(&g_spellCheckerMemory, &stats);
+    
+    char message[160];
+    for (int i = 0; i < SPELLCHECK_MEMORY_USE_COUNT; i++) {
+        const SpellCheckMemoryCounters *use = &stats.uses[i];
+        if (use->allocations == 0) continue;
+        snprintf(message, sizeof(message), "Logger: checker %s memory %.1f KB live, %.1f KB peak, %llu allocations\n",
+                 SpellChecker_GetMemoryUseName((SpellCheckMemoryUse)i), use->liveBytes / 1024.0,
+                 use->peakBytes / 1024.0, (unsigned long long)use->allocations);
+        OutputDebugString(message);
+    }
+    snprintf(message, sizeof(message),
+             "Logger: checker memory %.1f KB live, %.1f KB peak; %llu allocations in %llu check passes\n",
+             stats.total.liveBytes / 1024.0, stats.total.peakBytes / 1024.0,
+             (unsigned long long)stats.checkPassAllocations, (unsigned long long)stats.checkPasses);
+    OutputDebugString(message);
+    
+    // The DAWG and suggestion indexes are built outside the tracker
+    SpellCheckIndexMemory indexes;
+    SpellChecker_GetIndexMemory(g_spellChecker, &indexes);
+    snprintf(message, sizeof(message),
+             "Logger: checker indexes %.1f KB (dawg %.1f KB, main %.1f KB, embedded %.1f KB, used %.1f KB)\n",
+             (indexes.dawg + indexes.mainIndex + indexes.embeddedIndex + indexes.usedIndex) / 1024.0,
+             indexes.dawg / 1024.0, indexes.mainIndex / 1024.0, indexes.embeddedIndex / 1024.0,
+             indexes.usedIndex / 1024.0);
+    OutputDebugString(message);
+}
+
+// Called on the dictionary watcher thread after a reload; hand off to the
+// UI thread so the recheck timer is owned by the message loop
+void OnDictionaryReloaded(void *context) {
+    HWND hwndMain = g_hwndInput ? GetParent(g_hwndInput) : NULL;
+    if (hwndMain) {
+        PostMessage(hwndMain, WM_DICTIONARY_RELOADED, 0, 0);
     }
 }
 
@@ -73,15 +435,28 @@ void CleanupSpellChecker(void) {
         g_spellCheckTimer = 0;
     }
     if (g_spellChecker) {
+        // Stop the watcher first so our own save doesn't trigger a reload
+        SpellChecker_StopWatching(g_spellChecker);
         SpellChecker_SaveUserDictionary(g_spellChecker, "user_dictionary.txt");
+        ReportVerdictCache();
+        ReportSpellCheckerMemory();
         SpellChecker_Destroy(g_spellChecker);
         g_spellChecker = NULL;
     }
+    SpellChecker_FreeMisspelledList(&g_shownMisspelled);
+    SpellChecker_FreeMisspelledList(&g_checkedSpans);
+    Spans_FreeDiff(&g_misspelledDiff);
+    SpellChecker_DeleteMemoryTracker(&g_spellCheckerMemory);
 }
 
 // Trigger spell check with debouncing
 void TriggerSpellCheck(void) {
-    if (!g_spellCheckEnabled || !g_spellChecker) return;
+    if (!g_spellCheckEnabled) return;
+    if (!g_spellChecker) {
+        // Still loading; checked once it is ready
+        if (g_spellCheckerJob) g_spellCheckPending = TRUE;
+        return;
+    }
     
     // Kill existing timer if any
     if (g_spellCheckTimer) {
@@ -96,24 +471,23 @@ void TriggerSpellCheck(void) {
 void CALLBACK SpellCheckTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime) {
     if (!g_spellCheckEnabled || !g_spellChecker || !g_hwndInput) return;
     
-    // Get text from edit control
-    int textLen = GetWindowTextLength(g_hwndInput);
+    // Get text from edit control, as UTF-8 for the checker
+    int textLen;
+    char *text = GetEditTextUtf8(g_hwndInput, &textLen);
+    if (!text) goto cleanup;
     if (textLen == 0) {
-        if (g_spellChecker->misspelled.count > 0) {
-            g_spellChecker->misspelled.count = 0;
-            InvalidateRect(g_hwndInput, NULL, FALSE);
-        }
+        g_spellChecker->misspelled.count = 0;
+        ShowMisspelledChanges(text, 0);
+        free(text);
         goto cleanup;
     }
     
-    char *text = (char *)malloc(textLen + 1);
-    if (!text) goto cleanup;
-    
-    GetWindowText(g_hwndInput, text, textLen + 1);
-    
     // Perform spell check
     SpellChecker_Check(g_spellChecker, text);
     
+    // Precompute suggestions so a right-click menu opens instantly
+    SpellChecker_WarmSuggestions(g_spellChecker, &g_spellChecker->misspelled);
+    
     // Create or update tooltip with misspelled words
     if (g_spellChecker->misspelled.count > 0) {
         char tooltipText[512] = "Misspelled words:\n";
@@ -122,26 +496,10 @@ void CALLBACK SpellCheckTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD
             strcat(tooltipText, g_spellChecker->misspelled.words[i].word);
             strcat(tooltipText, "\n");
         }
-        
-        // Set title bar to indicate spell errors
-        HWND hwndMain = GetParent(g_hwndInput);
-        if (hwndMain) {
-            char titleText[256];
-            snprintf(titleText, sizeof(titleText), "Logger- Your Work Log Aggregator! - %d spelling error(s)", 
-                    g_spellChecker->misspelled.count);
-            SetWindowText(hwndMain, titleText);
-        }
-    } else {
-        // Restore normal title
-        HWND hwndMain = GetParent(g_hwndInput);
-        if (hwndMain) {
-            SetWindowText(hwndMain, "Logger- Your Work Log Aggregator!");
-        }
     }
     
-    // Trigger repaint
-    InvalidateRect(g_hwndInput, NULL, FALSE);
-    UpdateWindow(g_hwndInput);
+    // Repaint only the underlines that changed
+    ShowMisspelledChanges(text, textLen);
     
     free(text);
 
@@ -153,37 +511,297 @@ cleanup:
     }
 }
 
-// Replace a word in the text
-void ReplaceWord(const char *oldWord, const char *newWord) {
-    if (!g_hwndInput || !oldWord || !newWord) return;
+// Hide the completion hint
+void ClearCompletions(void) {
+    if (g_completion[0] == '\0') return;
+    g_completion[0] = '\0';
+    g_completionPrefixLen = 0;
+    if (g_hwndCompletion) SetWindowText(g_hwndCompletion, "");
+}
+
+// Offer completions for the word ending at the caret. Runs on every
+// character typed; the spell checker caches results per prefix.
+void UpdateCompletions(HWND hwndEdit) {
+    if (!g_spellCheckEnabled || !g_spellChecker || !g_hwndCompletion) return;
+    
+    DWORD selStart = 0, selEnd = 0;
+    SendMessage(hwndEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+    if (selStart != selEnd) {
+        ClearCompletions();
+        return;
+    }
+    
+    // Only the caret's line is needed to find the word being typed. It is
+    // read as UTF-16 so letters outside the ANSI code page count.
+    int line = (int)SendMessage(hwndEdit, EM_LINEFROMCHAR, selStart, 0);
+    int lineStart = (int)SendMessage(hwndEdit, EM_LINEINDEX, line, 0);
+    WCHAR lineText[1024];
+    lineText[0] = (WCHAR)(sizeof(lineText) / sizeof(WCHAR) - 1);
+    int lineLen = (int)SendMessageW(hwndEdit, EM_GETLINE, line, (LPARAM)lineText);
+    lineText[lineLen] = 0;
     
-    int textLen = GetWindowTextLength(g_hwndInput);
-    if (textLen == 0) return;
+    int caret = (int)selStart - lineStart;
+    if (caret < 0 || caret > lineLen || Utf8_IsLetter(lineText[caret])) {
+        // Caret is inside a word rather than at its end
+        ClearCompletions();
+        return;
+    }
+    
+    int start = caret;
+    while (start > 0 && Utf8_IsLetter(lineText[start - 1])) start--;
+    if (caret - start < COMPLETION_MIN_PREFIX) {
+        ClearCompletions();
+        return;
+    }
+    
+    int prefixLen;
+    char *prefix = WideToUtf8(lineText + start, caret - start, &prefixLen);
+    if (!prefix || prefixLen >= (int)sizeof(g_completion)) {
+        free(prefix);
+        ClearCompletions();
+        return;
+    }
+    
+    int count = 0;
+    char **completions = SpellChecker_Complete(g_spellChecker, prefix, COMPLETION_COUNT, &count);
+    free(prefix);
+    if (!completions || count == 0) {
+        SpellChecker_FreeSuggestions(completions, count);
+        ClearCompletions();
+        return;
+    }
+    
+    // "Tab: first   second  third ..."
+    char hint[512];
+    snprintf(hint, sizeof(hint), "Tab: %s  ", completions[0]);
+    for (int i = 1; i < count; i++) {
+        strncat(hint, " ", sizeof(hint) - strlen(hint) - 1);
+        strncat(hint, completions[i], sizeof(hint) - strlen(hint) - 1);
+    }
+    
+    strncpy(g_completion, completions[0], sizeof(g_completion) - 1);
+    g_completion[sizeof(g_completion) - 1] = '\0';
+    g_completionPrefixLen = prefixLen;
+    WCHAR *wideHint = Utf8ToWide(hint, (int)strlen(hint));
+    if (wideHint) SetWindowTextW(g_hwndCompletion, wideHint);
+    free(wideHint);
     
-    char *text = (char *)malloc(textLen + 1);
+    SpellChecker_FreeSuggestions(completions, count);
+}
+
+// Show the running job and the number of misspellings in the title bar
+void UpdateWindowTitle(void) {
+    HWND hwndMain = g_hwndInput ? GetParent(g_hwndInput) : NULL;
+    if (!hwndMain) return;
+    
+    char titleText[256] = "Logger- Your Work Log Aggregator!";
+    size_t used = strlen(titleText);
+    if (g_jobStatus[0]) {
+        used += snprintf(titleText + used, sizeof(titleText) - used, " - %s", g_jobStatus);
+    }
+    if (g_spellCheckNotice && used < sizeof(titleText)) {
+        used += snprintf(titleText + used, sizeof(titleText) - used, " - %s", g_spellCheckNotice);
+    }
+    if (g_spellChecker && g_spellChecker->misspelled.count > 0 && used < sizeof(titleText)) {
+        snprintf(titleText + used, sizeof(titleText) - used, " - %d spelling error(s)",
+                g_spellChecker->misspelled.count);
+    }
+    SetWindowText(hwndMain, titleText);
+}
+
+// Bring the underlines and the title's error count up to date with the
+// last check of 'text' (the UTF-8 its spans point into; NULL to read the
+// control). Only the spans that appeared, went or moved are repainted,
+// and nothing at all when the check found what was already shown.
+void ShowMisspelledChanges(const char *text, int length) {
+    if (!g_spellChecker || !g_hwndInput) return;
+    
+    char *read = NULL;
+    if (!text) text = read = GetEditTextUtf8(g_hwndInput, &length);
+    BOOL converted = text && SpansToCharPositions(&g_spellChecker->misspelled, text, length, &g_checkedSpans);
+    free(read);
+    const MisspelledWordList *current = &g_checkedSpans;
+    if (!converted) g_checkedSpans.count = 0;
+    
+    BOOL diffed = converted && !g_shownMisspelledLost &&
+                  Spans_Diff(&g_shownMisspelled, current, &g_misspelledDiff);
+    if (diffed && g_misspelledDiff.count == 0) return;
+    BOOL countChanged = !diffed || g_shownMisspelled.count != current->count;
+    
+    if (diffed) {
+        // A moved span is repainted where it was and where it is now
+        TEXTMETRIC tm;
+        GetEditTextMetrics(g_hwndInput, &tm);
+        for (int i = 0; i < g_misspelledDiff.count; i++) {
+            const MisspelledChange *change = &g_misspelledDiff.changes[i];
+            if (change->change != SPELLCHECK_SPAN_ADDED) {
+                InvalidateCharRange(g_hwndInput, change->oldStart, change->oldEnd, &tm);
+            }
+            if (change->change != SPELLCHECK_SPAN_REMOVED) {
+                InvalidateCharRange(g_hwndInput, change->newStart, change->newEnd, &tm);
+            }
+        }
+    } else {
+        InvalidateRect(g_hwndInput, NULL, TRUE);
+    }
+    
+    // What is shown now is kept for the next diff; the old buffer takes
+    // the next conversion
+    MisspelledWordList shown = g_shownMisspelled;
+    g_shownMisspelled = g_checkedSpans;
+    g_checkedSpans = shown;
+    g_shownMisspelledLost = !converted;
+    
+    if (countChanged) UpdateWindowTitle();
+}
+
+// Metrics of the edit control's font
+void GetEditTextMetrics(HWND hwnd, TEXTMETRIC *tm) {
+    HDC hdc = GetDC(hwnd);
+    HFONT font = (HFONT)SendMessage(hwnd, WM_GETFONT, 0, 0);
+    HFONT oldFont = font ? (HFONT)SelectObject(hdc, font) : NULL;
+    GetTextMetrics(hdc, tm);
+    if (oldFont) SelectObject(hdc, oldFont);
+    ReleaseDC(hwnd, hdc);
+}
+
+// Invalidate where characters [start, end) are drawn: that stretch of
+// their line, or the whole lines when they wrap. Characters past the end
+// of the text are gone, and the control repainted where they were.
+void InvalidateCharRange(HWND hwnd, DWORD start, DWORD end, const TEXTMETRIC *tm) {
+    DWORD length = (DWORD)GetWindowTextLength(hwnd);
+    if (end > length) end = length;
+    if (start >= end) return;
+    
+    LRESULT first = SendMessage(hwnd, EM_POSFROMCHAR, start, 0);
+    LRESULT last = SendMessage(hwnd, EM_POSFROMCHAR, end - 1, 0);
+    if (first == -1 || last == -1) return;
+    
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    int firstY = (short)HIWORD(first);
+    int lastY = (short)HIWORD(last);
+    if (firstY == lastY) {
+        rc.left = (short)LOWORD(first);
+        rc.right = (short)LOWORD(last) + tm->tmMaxCharWidth;
+    }
+    rc.top = firstY;
+    rc.bottom = lastY + tm->tmHeight;
+    InvalidateRect(hwnd, &rc, TRUE);
+}
+
+// Red wavy line beneath each visible misspelled span, drawn over what the
+// edit control painted. A span whose text changed since the check is left
+// out until the next check catches up, so typing never leaves an underline
+// under the wrong characters.
+void DrawMisspelledUnderlines(HWND hwnd) {
+    if (!g_spellCheckEnabled || !g_spellChecker || g_shownMisspelled.count == 0) return;
+    const MisspelledWordList *list = &g_shownMisspelled;
+    
+    // The control's text in its own characters, which the shown spans index
+    DWORD length = (DWORD)GetWindowTextLengthW(hwnd);
+    WCHAR *text = (WCHAR *)malloc((length + 1) * sizeof(WCHAR));
     if (!text) return;
+    length = (DWORD)GetWindowTextW(hwnd, text, length + 1);
+    
+    HDC hdc = GetDC(hwnd);
+    HFONT font = (HFONT)SendMessage(hwnd, WM_GETFONT, 0, 0);
+    HFONT oldFont = font ? (HFONT)SelectObject(hdc, font) : NULL;
+    HPEN pen = CreatePen(PS_SOLID, 1, RGB(255, 0, 0));
+    HPEN oldPen = (HPEN)SelectObject(hdc, pen);
+    TEXTMETRIC tm;
+    GetTextMetrics(hdc, &tm);
+    RECT client;
+    GetClientRect(hwnd, &client);
     
-    GetWindowText(g_hwndInput, text, textLen + 1);
+    // Characters on the visible lines
+    int firstLine = (int)SendMessage(hwnd, EM_GETFIRSTVISIBLELINE, 0, 0);
+    int lineCount = tm.tmHeight > 0 ? client.bottom / tm.tmHeight + 1 : 1;
+    LRESULT visibleStart = SendMessage(hwnd, EM_LINEINDEX, firstLine, 0);
+    LRESULT visibleEnd = SendMessage(hwnd, EM_LINEINDEX, firstLine + lineCount, 0);
+    if (visibleEnd < 0) visibleEnd = length;
     
-    // Simple find and replace (replaces first occurrence)
-    char *pos = strstr(text, oldWord);
-    if (pos) {
-        int oldLen = strlen(oldWord);
-        int newLen = strlen(newWord);
+    // Wave between just below the baseline and two pixels under it
+    int offset = tm.tmAscent + 1 < tm.tmHeight - 3 ? tm.tmAscent + 1 : tm.tmHeight - 3;
+    
+    for (int i = 0; i < list->count; i++) {
+        const MisspelledWord *span = &list->words[i];
+        if ((LRESULT)span->endPos <= visibleStart) continue;
+        if ((LRESULT)span->startPos >= visibleEnd) break;
+        if (span->endPos > length || span->startPos >= span->endPos) continue;
         
-        // Create new text with replacement
-        char *newText = (char *)malloc(textLen + newLen - oldLen + 1);
-        if (newText) {
-            int offset = pos - text;
-            strncpy(newText, text, offset);
-            strcpy(newText + offset, newWord);
-            strcpy(newText + offset + newLen, text + offset + oldLen);
-            
-            SetWindowText(g_hwndInput, newText);
+        // The span's characters must still spell the checked word (which
+        // may be cut short at 255 bytes)
+        char spelled[1024];
+        size_t wordLength = strlen(span->word);
+        int spanLength = (int)(span->endPos - span->startPos);
+        if (spanLength > (int)sizeof(span->word)) spanLength = (int)sizeof(span->word);
+        int spelledLength = WideCharToMultiByte(CP_UTF8, 0, text + span->startPos, spanLength,
+                                                spelled, sizeof(spelled), NULL, NULL);
+        if ((size_t)spelledLength < wordLength || memcmp(spelled, span->word, wordLength) != 0) {
+            continue;
+        }
+        
+        LRESULT first = SendMessage(hwnd, EM_POSFROMCHAR, span->startPos, 0);
+        LRESULT last = SendMessage(hwnd, EM_POSFROMCHAR, span->endPos - 1, 0);
+        if (first == -1 || last == -1) continue;
+        
+        int left = (short)LOWORD(first);
+        int top = (short)HIWORD(first);
+        int right = client.right;
+        if ((short)HIWORD(last) == top) {
+            SIZE lastChar;
+            GetTextExtentPoint32W(hdc, text + span->endPos - 1, 1, &lastChar);
+            right = (short)LOWORD(last) + lastChar.cx;
+        }
+        
+        int y = top + offset;
+        MoveToEx(hdc, left, y, NULL);
+        for (int x = left + 2, down = 1; x <= right; x += 2, down = !down) {
+            LineTo(hdc, x, down ? y + 2 : y);
+        }
+    }
+    
+    SelectObject(hdc, oldPen);
+    DeleteObject(pen);
+    if (oldFont) SelectObject(hdc, oldFont);
+    ReleaseDC(hwnd, hdc);
+    free(text);
+}
+
+// Replace misspelled word 'wordIndex', or with 'replaceAll' every
+// occurrence of it, with 'newWord'. The spans from the first to the last
+// one replaced go out as a single selection replace, so the control keeps
+// its layout and scroll position and one undo reverts it all; only the
+// replaced range is checked again.
+void ReplaceWord(int wordIndex, const char *newWord, BOOL replaceAll) {
+    if (!g_hwndInput || !g_spellChecker || !newWord) return;
+    
+    // The plan is in bytes of the UTF-8 text; the selection in characters
+    int textLen;
+    char *text = GetEditTextUtf8(g_hwndInput, &textLen);
+    if (!text) return;
+    
+    SpellCheckEdit edit;
+    if (textLen > 0 && Spans_PlanReplacement(&g_spellChecker->misspelled, wordIndex, replaceAll, newWord,
+                                                    text, textLen, &edit)) {
+        DWORD start = Utf8OffsetToChar(text, textLen, 0, 0, edit.start);
+        DWORD end = Utf8OffsetToChar(text, textLen, edit.start, start, edit.end);
+        WCHAR *replacement = Utf8ToWide(edit.text, (int)edit.length);
+        if (replacement) {
+            SendMessage(g_hwndInput, EM_SETSEL, start, end);
+            SendMessageW(g_hwndInput, EM_REPLACESEL, TRUE, (LPARAM)replacement);
+            free(replacement);
+        }
+        if (replacement && SpellChecker_ApplyEdit(g_spellChecker, &edit)) {
+            ShowMisspelledChanges(NULL, 0);
+        } else {
             TriggerSpellCheck();
-            
-            free(newText);
         }
+        Spans_FreeEdit(&edit);
+    } else {
+        // The text changed since it was checked; check it again instead
+        TriggerSpellCheck();
     }
     
     free(text);
@@ -193,26 +811,22 @@ void ReplaceWord(const char *oldWord, const char *newWord) {
 BOOL HandleSpellCheckContextMenu(HWND hwnd, int xPos, int yPos) {
     if (!g_spellChecker || g_spellChecker->misspelled.count == 0) return FALSE;
     
-    // Get text to find word at position
-    int textLen = GetWindowTextLength(hwnd);
-    if (textLen == 0) return FALSE;
-    
-    char *text = (char *)malloc(textLen + 1);
-    if (!text) return FALSE;
+    // The shown spans are the checker's, in the same order, in characters;
+    // until the two agree again there is nothing to offer
+    if (g_shownMisspelledLost || g_shownMisspelled.count != g_spellChecker->misspelled.count) return FALSE;
     
-    GetWindowText(hwnd, text, textLen + 1);
-    
-    // Get cursor position (approximate from click point)
+    // Character under the click
     POINT pt = {xPos, yPos};
     ScreenToClient(hwnd, &pt);
+    LRESULT hit = SendMessage(hwnd, EM_CHARFROMPOS, 0, MAKELPARAM(pt.x, pt.y));
+    DWORD pos = LOWORD(hit);
     
-    // Find a misspelled word near the cursor
+    // Find the misspelled word under it
     char misspelledWord[256] = {0};
     int wordIndex = -1;
     
-    for (int i = 0; i < g_spellChecker->misspelled.count; i++) {
-        if (pt.x >= g_spellChecker->misspelled.words[i].startPos * 6 && 
-            pt.x <= g_spellChecker->misspelled.words[i].endPos * 6) {
+    for (int i = 0; i < g_shownMisspelled.count; i++) {
+        if (pos >= g_shownMisspelled.words[i].startPos && pos < g_shownMisspelled.words[i].endPos) {
             strcpy(misspelledWord, g_spellChecker->misspelled.words[i].word);
             wordIndex = i;
             break;
@@ -220,28 +834,47 @@ BOOL HandleSpellCheckContextMenu(HWND hwnd, int xPos, int yPos) {
     }
     
     if (wordIndex < 0) {
-        free(text);
         return FALSE;
     }
     
     // Create context menu
     HMENU hMenu = CreatePopupMenu();
     if (!hMenu) {
-        free(text);
         return FALSE;
     }
     
-    // Get suggestions
+    // Get suggestions (usually already cached by the background warm-up);
+    // the list is kept until the selection is handled
     int suggestCount = 0;
     char **suggestions = SpellChecker_GetSuggestions(g_spellChecker, misspelledWord, &suggestCount);
     
+    // A word flagged more than once can be replaced everywhere at once
+    int occurrences = 0;
+    for (int i = 0; i < g_spellChecker->misspelled.count; i++) {
+        if (strcmp(g_spellChecker->misspelled.words[i].word, misspelledWord) == 0) occurrences++;
+    }
+    
     // Add suggestion options
     if (suggestions && suggestCount > 0) {
+        // Suggestions are UTF-8
+        WCHAR *labels[5] = {0};
         for (int i = 0; i < suggestCount && i < 5; i++) {
-            AppendMenu(hMenu, MF_STRING, ID_CONTEXT_MENU_SUGGESTION_BASE + i, suggestions[i]);
+            labels[i] = Utf8ToWide(suggestions[i], (int)strlen(suggestions[i]));
+            if (labels[i]) AppendMenuW(hMenu, MF_STRING, ID_CONTEXT_MENU_SUGGESTION_BASE + i, labels[i]);
+        }
+        HMENU hReplaceAll = occurrences > 1 ? CreatePopupMenu() : NULL;
+        if (hReplaceAll) {
+            for (int i = 0; i < suggestCount && i < 5; i++) {
+                if (labels[i]) AppendMenuW(hReplaceAll, MF_STRING, ID_CONTEXT_MENU_REPLACE_ALL_BASE + i, labels[i]);
+            }
+            char label[64];
+            snprintf(label, sizeof(label), "Replace All (%d)", occurrences);
+            AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hReplaceAll, label);
+        }
+        for (int i = 0; i < 5; i++) {
+            free(labels[i]);
         }
         AppendMenu(hMenu, MF_SEPARATOR, 0, NULL);
-        SpellChecker_FreeSuggestions(suggestions, suggestCount);
     } else {
         AppendMenu(hMenu, MF_STRING | MF_GRAYED, 0, "No suggestions");
         AppendMenu(hMenu, MF_SEPARATOR, 0, NULL);
@@ -257,10 +890,12 @@ BOOL HandleSpellCheckContextMenu(HWND hwnd, int xPos, int yPos) {
     // Handle menu selection
     if (selection >= ID_CONTEXT_MENU_SUGGESTION_BASE && selection < ID_CONTEXT_MENU_SUGGESTION_BASE + 10) {
         // User selected a suggestion
-        char **sugg = SpellChecker_GetSuggestions(g_spellChecker, misspelledWord, &suggestCount);
-        if (sugg && selection - ID_CONTEXT_MENU_SUGGESTION_BASE < suggestCount) {
-            ReplaceWord(misspelledWord, sugg[selection - ID_CONTEXT_MENU_SUGGESTION_BASE]);
-            SpellChecker_FreeSuggestions(sugg, suggestCount);
+        if (suggestions && selection - ID_CONTEXT_MENU_SUGGESTION_BASE < suggestCount) {
+            ReplaceWord(wordIndex, suggestions[selection - ID_CONTEXT_MENU_SUGGESTION_BASE], FALSE);
+        }
+    } else if (selection >= ID_CONTEXT_MENU_REPLACE_ALL_BASE && selection < ID_CONTEXT_MENU_REPLACE_ALL_BASE + 10) {
+        if (suggestions && selection - ID_CONTEXT_MENU_REPLACE_ALL_BASE < suggestCount) {
+            ReplaceWord(wordIndex, suggestions[selection - ID_CONTEXT_MENU_REPLACE_ALL_BASE], TRUE);
         }
     } else if (selection == ID_CONTEXT_MENU_ADD_DICT) {
         SpellChecker_AddToUserDictionary(g_spellChecker, misspelledWord);
@@ -271,17 +906,20 @@ BOOL HandleSpellCheckContextMenu(HWND hwnd, int xPos, int yPos) {
         TriggerSpellCheck();
     }
     
+    SpellChecker_FreeSuggestions(suggestions, suggestCount);
     DestroyMenu(hMenu);
-    free(text);
     return TRUE;
 }
 
 // Entry point
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     const char CLASS_NAME[] = "WorkLogAggregatorClass";
+    QueryPerformanceCounter(&g_startTime);
 
-    // Initialize spell checker
-    InitializeSpellChecker();
+    // Log storage; the spell checker starts loading with the window.
+    // Allocations its check passes make are reported as they happen.
+    InitializeLogStore();
+    SpellChecker_InitMemoryTracker(&g_spellCheckerMemory, TRUE);
 
     WNDCLASS wc = {0};
     wc.lpfnWndProc = WindowProc;
@@ -308,11 +946,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
     if (hwnd == NULL) {
         CleanupSpellChecker();
+        CleanupLogStore();
         return 0;
     }
 
     ShowWindow(hwnd, nCmdShow);
     UpdateWindow(hwnd);
+    ReportStartupTime("window shown");
 
     MSG msg = {0};
     while (GetMessage(&msg, NULL, 0, 0)) {
@@ -321,6 +961,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     }
 
     CleanupSpellChecker();
+    CleanupLogStore();
     return 0;
 }
 
@@ -330,10 +971,14 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
     switch (uMsg) {
     case WM_CREATE:
-        hwndInput = CreateWindowEx(
+        InitializeSpellChecker(hwnd);
+        
+        // A Unicode control, so text outside the ANSI code page can be
+        // typed and spell checked
+        hwndInput = CreateWindowExW(
             WS_EX_CLIENTEDGE,
-            "EDIT",
-            "",
+            L"EDIT",
+            L"",
             WS_CHILD | WS_VISIBLE | ES_MULTILINE | ES_AUTOVSCROLL | WS_VSCROLL,
             20, 20, 440, 250,
             hwnd,
@@ -345,9 +990,20 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
         // Subclass the edit control so we can handle Ctrl+A (select all)
         if (hwndInput) {
             g_hwndInput = hwndInput;  // Store for spell checker
-            g_oldEditProc = (WNDPROC)SetWindowLongPtr(hwndInput, GWLP_WNDPROC, (LONG_PTR)EditProc);
+            g_oldEditProc = (WNDPROC)SetWindowLongPtrW(hwndInput, GWLP_WNDPROC, (LONG_PTR)EditProc);
         }
 
+        g_hwndCompletion = CreateWindow(
+            "STATIC",
+            "",
+            WS_VISIBLE | WS_CHILD | SS_LEFTNOWORDWRAP | SS_NOPREFIX,
+            20, 272, 440, 16,
+            hwnd,
+            (HMENU)ID_COMPLETION,
+            GetModuleHandle(NULL),
+            NULL
+        );
+
         hwndAddBtn = CreateWindow(
             "BUTTON",
             "Add Entry",
@@ -380,6 +1036,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             GetModuleHandle(NULL),
             NULL
         );
+        UpdateWindowTitle();
         break;
 
     case WM_COMMAND:
@@ -390,125 +1047,49 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
             }
             break;
         case ID_VIEW:
-            if (!isViewMode) {
-                // Backup whatever the user has typed in the main input so we can restore it
-                if (hwndInput) {
-                    GetWindowText(hwndInput, mainInputBackup, sizeof(mainInputBackup));
-                }
-                // Load content from file
-                FILE *file = fopen("WorkLog.txt", "r");
-                if (!file) {
-                    MessageBox(NULL, "No entries to view!", "Error", MB_OK | MB_ICONERROR);
-                    break;
+            if (!isViewMode && !g_ioJob) {
+                // Rendering the whole store can take a while; the window
+                // switches to view mode once it is ready
+                ViewJob *view = (ViewJob *)calloc(1, sizeof(ViewJob));
+                if (!view || !StartJob(hwnd, "Loading entries...", LoadViewJobProc, OnViewLoaded, NULL, view)) {
+                    free(view);
+                    MessageBox(NULL, "Could not load the entries!", "Error", MB_OK | MB_ICONERROR);
                 }
-
-                // Read file content and normalize line endings to CRLF for the edit control
-                char raw[4096] = {0};
-                size_t bytesRead = fread(raw, 1, sizeof(raw) - 1, file);
-                fclose(file);
-
-                if (bytesRead == 0) {
-                    MessageBox(NULL, "No entries to view!", "Error", MB_OK | MB_ICONERROR);
-                    break;
-                }
-
-                // Convert lone LF to CRLF so the Windows edit control shows new lines correctly.
-                // Use a larger buffer for converted content.
-                char converted[8192] = {0};
-                size_t ri = 0, wi = 0;
-                for (ri = 0; ri < bytesRead && wi + 2 < sizeof(converted); ++ri) {
-                    unsigned char c = raw[ri];
-                    if (c == '\r') {
-                        // keep CR as-is
-                        converted[wi++] = '\r';
-                        // If next is LF, it'll be handled in next iteration and appended
-                    } else if (c == '\n') {
-                        // If previous char wasn't CR, insert CR before LF
-                        if (ri == 0 || raw[ri - 1] != '\r') {
-                            converted[wi++] = '\r';
-                        }
-                        converted[wi++] = '\n';
-                    } else {
-                        converted[wi++] = c;
-                    }
-                }
-
-                // Ensure null-terminated
-                converted[wi] = '\0';
-
-                // Store original content (raw) for possible later comparison
-                strncpy(originalContent, converted, sizeof(originalContent) - 1);
-
-                // Show content in input box (this temporarily replaces what was in the main input)
-                SetWindowText(hwndInput, converted);
-
-                // Hide regular buttons and show Save/Cancel buttons
-                ShowWindow(hwndAddBtn, SW_HIDE);
-                ShowWindow(GetDlgItem(hwnd, ID_VIEW), SW_HIDE);
-                ShowWindow(hwndExportBtn, SW_HIDE);
-
-                // Create Save and Cancel buttons
-                hwndSaveBtn = CreateWindow(
-                    "BUTTON", "Save Changes",
-                    WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_DEFPUSHBUTTON,
-                    20, 290, 100, 30,
-                    hwnd, (HMENU)ID_SAVE,
-                    GetModuleHandle(NULL), NULL
-                );
-
-                hwndCancelBtn = CreateWindow(
-                    "BUTTON", "Cancel",
-                    WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_PUSHBUTTON,
-                    140, 290, 100, 30,
-                    hwnd, (HMENU)ID_CANCEL,
-                    GetModuleHandle(NULL), NULL
-                );
-
-                isViewMode = TRUE;
             }
             break;
         case ID_SAVE:
-            if (isViewMode) {
-                // Get current content
-                char newContent[4096];
-                GetWindowText(hwndInput, newContent, sizeof(newContent));
-
-                // Save to file
-                FILE *file = fopen("WorkLog.txt", "w");
-                if (file) {
-                    fputs(newContent, file);
-                    fclose(file);
-                    MessageBox(NULL, "Changes saved successfully!", "Success", MB_OK | MB_ICONINFORMATION);
+            if (isViewMode && !g_ioJob) {
+                // Rewrite the store from the edited text in the background; unchanged entries
+                // keep their timestamps, and entries other instances added since View are kept.
+                // Read as UTF-8 so characters outside the ANSI code page survive.
+                SaveJob *save = (SaveJob *)calloc(1, sizeof(SaveJob));
+                if (save) {
+                    save->text = GetEditTextUtf8(hwndInput, &save->length);
+                    save->shownSequence = g_viewSequence;
+                }
+                if (save && save->text && StartJob(hwnd, "Saving...", SaveViewJobProc, OnViewSaved, NULL, save)) {
+                    // The text being saved stays as it is until the job ends
+                    SendMessage(hwndInput, EM_SETREADONLY, TRUE, 0);
+                    break;
                 }
+                if (save) free(save->text);
+                free(save);
 
-                // Restore the user's previous main input (preserve what they were typing)
-                SetWindowText(hwndInput, mainInputBackup);
-                
-                // Exit view mode
-                goto exit_view_mode;
+                MessageBox(NULL, "Could not save changes!", "Error", MB_OK | MB_ICONERROR);
+                RestoreMainInput();
+                ExitViewMode(hwnd);
             }
             break;
         case ID_CANCEL:
-            if (isViewMode) {
+            if (isViewMode && !g_ioJob) {
                 // Restore the user's previous main input (preserve what they were typing)
-                SetWindowText(hwndInput, mainInputBackup);
-exit_view_mode:
-                // Clean up view mode
-                DestroyWindow(hwndSaveBtn);
-                DestroyWindow(hwndCancelBtn);
-                hwndSaveBtn = hwndCancelBtn = NULL;
-
-                // Show regular buttons
-                ShowWindow(hwndAddBtn, SW_SHOW);
-                ShowWindow(GetDlgItem(hwnd, ID_VIEW), SW_SHOW);
-                ShowWindow(hwndExportBtn, SW_SHOW);
-
-                isViewMode = FALSE;
+                RestoreMainInput();
+                ExitViewMode(hwnd);
             }
             break;
         case ID_EXPORT:
-            if (!isViewMode) {
-                ExportLog();
+            if (!isViewMode && !g_ioJob) {
+                ExportLog(hwnd);
             }
             break;
         }
@@ -547,6 +1128,14 @@ exit_view_mode:
                 inputHeight - margin,                      // height
                 TRUE);
             
+            // Completion hint in the gap between the input and the buttons
+            MoveWindow(g_hwndCompletion,
+                margin,                                    // x position
+                inputHeight + 2,                           // y position
+                rcClient.right - (margin * 2),            // width
+                16,                                        // height
+                TRUE);
+            
             // Position the buttons at the bottom
             MoveWindow(hwndAddBtn,
                 margin,                                    // x position
@@ -573,7 +1162,35 @@ exit_view_mode:
         }
         break;
 
+    case WM_DICTIONARY_RELOADED:
+        // Dictionary files changed on disk; recheck against the new snapshot
+        TriggerSpellCheck();
+        break;
+
+    case WM_IOJOB:
+        IoJob_Dispatch(wParam, lParam);
+        break;
+
     case WM_DESTROY:
+        // A running job still uses the store; let it stop before the store closes
+        if (g_ioJob) {
+            IoJob_Cancel(g_ioJob);
+            IoJob_Wait(g_ioJob);
+
+            // Its completion never runs now, so nor does the callback that frees the context
+            if (g_ioJob->onComplete == OnViewSaved) free(((SaveJob *)g_ioJob->context)->text);
+            free(g_ioJob->context);
+            IoJob_Free(g_ioJob);
+            g_ioJob = NULL;
+        }
+        // Likewise a dictionary load, whose checker was never handed over
+        if (g_spellCheckerJob) {
+            IoJob_Wait(g_spellCheckerJob);
+            SpellChecker_Destroy((SpellChecker *)g_spellCheckerJob->result);
+            g_spellCheckerJob->result = NULL;
+            IoJob_Free(g_spellCheckerJob);
+            g_spellCheckerJob = NULL;
+        }
         PostQuitMessage(0);
         break;
 
@@ -585,87 +1202,273 @@ exit_view_mode:
 
 // Add an entry to today's log
 void AddLogEntry(HWND hwndInput) {
-    char text[1024];
-    GetWindowText(hwndInput, text, sizeof(text));
-
-    if (strlen(text) == 0) {
+    int length;
+    char *utf8 = GetEditTextUtf8(hwndInput, &length);
+    if (utf8 && length == 0) {
+        free(utf8);
         MessageBox(NULL, "Please enter a note before adding.", "No Entry", MB_OK | MB_ICONWARNING);
         return;
     }
 
-    // Open file for update so we can check last character
-    FILE *file = fopen("WorkLog.txt", "a+");
-    if (!file) {
-        MessageBox(NULL, "Could not open log file!", "Error", MB_OK | MB_ICONERROR);
+    // Stored as UTF-8 with a full timestamp; the "[h:mmam]" text is
+    // rendered from it when viewing or exporting
+    BOOL added = utf8 && g_logStore && LogStore_Append(g_logStore, LogStore_Now(), 0, utf8, length);
+    if (!added) {
+        free(utf8);
+        MessageBox(NULL, "Could not save the entry!", "Error", MB_OK | MB_ICONERROR);
         return;
     }
 
-    // Move to end and check if file is non-empty and doesn't end with a newline
-    int needSep = 0;
-    if (fseek(file, 0, SEEK_END) == 0) {
-        long pos = ftell(file);
-        if (pos > 0) {
-            // Go back one char to read last byte
-            if (fseek(file, -1, SEEK_END) == 0) {
-                int last = fgetc(file);
-                if (last != '\n' && last != '\r') {
-                    needSep = 1;
-                }
-            }
-        }
+    // Words the user actually writes rank first in completions
+    if (g_spellChecker) {
+        SpellChecker_RecordWordUse(g_spellChecker, utf8);
     }
+    free(utf8);
 
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
+    SetWindowText(hwndInput, ""); // clear input box
+    ClearCompletions();
+    MessageBox(NULL, "Entry added to the work log!", "Success", MB_OK | MB_ICONINFORMATION);
+}
 
-    if (needSep) {
-        // write CRLF separator
-        fputc('\r', file);
-        fputc('\n', file);
-    }
+// Run 'proc' in the background, with 'status' in the title until it
+// ends. Only one job runs at a time.
+BOOL StartJob(HWND hwnd, const char *status, IoJobProc proc, IoJobCallback onComplete,
+              IoJobCallback onProgress, void *context) {
+    if (g_ioJob) return FALSE;
+    g_ioJob = IoJob_Start(hwnd, WM_IOJOB, proc, onComplete, onProgress, context);
+    if (!g_ioJob) return FALSE;
+    
+    strncpy(g_jobStatus, status, sizeof(g_jobStatus) - 1);
+    g_jobStatus[sizeof(g_jobStatus) - 1] = '\0';
+    UpdateWindowTitle();
+    return TRUE;
+}
 
-    // Convert to 12-hour format with am/pm
-    int hour12 = t->tm_hour % 12;
-    if (hour12 == 0) hour12 = 12; // midnight or noon -> 12
-    const char *ampm = (t->tm_hour >= 12) ? "pm" : "am";
-    // Write entry with CRLF line ending and am/pm
-    fprintf(file, "[%d:%02d%s] %s\r\n", hour12, t->tm_min, ampm, text);
-    fclose(file);
+// First thing every completion callback does
+void EndJob(void) {
+    g_ioJob = NULL;
+    g_jobStatus[0] = '\0';
+    UpdateWindowTitle();
+}
 
-    SetWindowText(hwndInput, ""); // clear input box
-    MessageBox(NULL, "Entry added to WorkLog.txt!", "Success", MB_OK | MB_ICONINFORMATION);
+// Export today's entries to a daily file in the text format
+void ExportLog(HWND hwnd) {
+    ExportJob *exportJob = (ExportJob *)calloc(1, sizeof(ExportJob));
+    if (!exportJob) return;
+    
+    time_t clock = time(NULL);
+    struct tm *t = localtime(&clock);
+    sprintf(exportJob->filename, "WorkLog_%04d-%02d-%02d.txt",
+            t->tm_year + 1900, t->tm_mon + 1, t->tm_mday);
+    exportJob->now = LogStore_Now();
+    
+    if (!StartJob(hwnd, "Exporting...", ExportJobProc, OnExportComplete, OnExportProgress, exportJob)) {
+        free(exportJob);
+        MessageBox(NULL, "Could not create export file!", "Error", MB_OK | MB_ICONERROR);
+    }
 }
 
-// Export the log (just copies to a daily file)
-void ExportLog() {
-    char buffer[1024];
-    FILE *src = fopen("WorkLog.txt", "r");
-    if (!src) {
-        MessageBox(NULL, "No log file found!", "Error", MB_OK | MB_ICONERROR);
-        return;
+BOOL ExportJobProc(IoJob *job) {
+    ExportJob *exportJob = (ExportJob *)job->context;
+    size_t length = 0;
+    char *text = g_logStore ? LogStore_RenderText(g_logStore, LogStore_DayStart(exportJob->now),
+                                                  LogStore_NextDayStart(exportJob->now), &length, NULL) : NULL;
+    if (!text || length == 0) {
+        free(text);
+        exportJob->empty = TRUE;
+        return TRUE;
+    }
+    
+    BOOL ok = !IoJob_IsCancelled(job) && IoJob_WriteFile(job, exportJob->filename, text, length);
+    free(text);
+    
+    // Older exports move into the monthly compressed archives
+    if (ok && !IoJob_IsCancelled(job)) {
+        LogArchive_PackExports(".", LOGARCHIVE_DEFAULT_AGE_DAYS, NULL);
     }
+    return ok;
+}
 
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    char filename[64];
-    sprintf(filename, "WorkLog_%04d-%02d-%02d.txt",
-            t->tm_year + 1900, t->tm_mon + 1, t->tm_mday);
+void OnExportProgress(IoJob *job) {
+    if (job->total <= 0) return;
+    snprintf(g_jobStatus, sizeof(g_jobStatus), "Exporting %d%%", (int)(job->done * 100 / job->total));
+    UpdateWindowTitle();
+}
 
-    FILE *dest = fopen(filename, "w");
-    if (!dest) {
+void OnExportComplete(IoJob *job) {
+    ExportJob *exportJob = (ExportJob *)job->context;
+    EndJob();
+    
+    if (exportJob->empty) {
+        MessageBox(NULL, "No entries for today!", "Error", MB_OK | MB_ICONERROR);
+    } else if (job->succeeded) {
+        MessageBox(NULL, "Daily log exported!", "Export Complete", MB_OK | MB_ICONINFORMATION);
+    } else if (!job->cancelled) {
         MessageBox(NULL, "Could not create export file!", "Error", MB_OK | MB_ICONERROR);
-        fclose(src);
+    }
+    free(exportJob);
+}
+
+// Render the stored entries for the View editor; the UTF-8 text is the job's result
+BOOL LoadViewJobProc(IoJob *job) {
+    ViewJob *view = (ViewJob *)job->context;
+    size_t rendered = 0;
+    char *raw = g_logStore ? LogStore_RenderText(g_logStore, 0, 0x7FFFFFFFFFFFFFFFLL, &rendered,
+                                                 &view->sequence) : NULL;
+    size_t bytesRead = rendered;
+    if (!raw || bytesRead == 0 || IoJob_IsCancelled(job)) {
+        free(raw);
+        return FALSE;
+    }
+
+    // Convert lone LF to CRLF so the Windows edit control shows new lines correctly.
+    // Imported entries may still carry bare LFs.
+    size_t convertedSize = 2 * bytesRead + 1;
+    char *converted = (char *)malloc(convertedSize);
+    if (!converted) {
+        free(raw);
+        return FALSE;
+    }
+    size_t ri = 0, wi = 0;
+    for (ri = 0; ri < bytesRead && wi + 2 < convertedSize; ++ri) {
+        unsigned char c = raw[ri];
+        if (c == '\r') {
+            // keep CR as-is
+            converted[wi++] = '\r';
+            // If next is LF, it'll be handled in next iteration and appended
+        } else if (c == '\n') {
+            // If previous char wasn't CR, insert CR before LF
+            if (ri == 0 || raw[ri - 1] != '\r') {
+                converted[wi++] = '\r';
+            }
+            converted[wi++] = '\n';
+        } else {
+            converted[wi++] = c;
+        }
+    }
+
+    // Ensure null-terminated
+    converted[wi] = '\0';
+    free(raw);
+
+    job->result = converted;
+    job->resultLength = wi;
+    return TRUE;
+}
+
+void OnViewLoaded(IoJob *job) {
+    ViewJob *view = (ViewJob *)job->context;
+    EndJob();
+    
+    if (job->succeeded && !job->cancelled && !isViewMode) {
+        g_viewSequence = view->sequence;
+        EnterViewMode(job->hwnd, (const char *)job->result);
+    } else if (!job->cancelled) {
+        MessageBox(NULL, "No entries to view!", "Error", MB_OK | MB_ICONERROR);
+    }
+    free(view);
+}
+
+// Cancelling only helps before the rewrite starts; once it has, it runs
+// to the end so the store is never left half replaced
+BOOL SaveViewJobProc(IoJob *job) {
+    SaveJob *save = (SaveJob *)job->context;
+    if (IoJob_IsCancelled(job)) return FALSE;
+    return g_logStore && LogStore_ReplaceText(g_logStore, save->text, save->length, save->shownSequence);
+}
+
+void OnViewSaved(IoJob *job) {
+    SaveJob *save = (SaveJob *)job->context;
+    EndJob();
+    SendMessage(g_hwndInput, EM_SETREADONLY, FALSE, 0);
+    free(save->text);
+    free(save);
+    
+    // Cancelled before it started: still in the editor, nothing changed
+    if (job->cancelled && !job->succeeded) return;
+    
+    if (job->succeeded) {
+        MessageBox(NULL, "Changes saved successfully!", "Success", MB_OK | MB_ICONINFORMATION);
+    } else {
+        MessageBox(NULL, "Could not save changes!", "Error", MB_OK | MB_ICONERROR);
+    }
+    
+    // Restore the user's previous main input (preserve what they were typing)
+    RestoreMainInput();
+    ExitViewMode(job->hwnd);
+}
+
+// Show 'text' in the input box for editing, with Save/Cancel in place of
+// the regular buttons
+void EnterViewMode(HWND hwnd, const char *text) {
+    // Shown as UTF-16, since the input is a Unicode control
+    WCHAR *wideText = Utf8ToWide(text, (int)strlen(text));
+    if (!wideText) {
+        MessageBox(NULL, "Could not load the entries!", "Error", MB_OK | MB_ICONERROR);
         return;
     }
 
-    while (fgets(buffer, sizeof(buffer), src)) {
-        fputs(buffer, dest);
+    // Backup whatever the user has typed in the main input so we can restore it,
+    // in the control's own UTF-16 so nothing is lost
+    free(mainInputBackup);
+    int backupLength = GetWindowTextLengthW(g_hwndInput);
+    mainInputBackup = (WCHAR *)malloc((backupLength + 1) * sizeof(WCHAR));
+    if (mainInputBackup) {
+        mainInputBackup[0] = 0;
+        if (backupLength > 0) GetWindowTextW(g_hwndInput, mainInputBackup, backupLength + 1);
     }
 
-    fclose(src);
-    fclose(dest);
+    // Store original content (raw) for possible later comparison
+    strncpy(originalContent, text, sizeof(originalContent) - 1);
+
+    // Show content in input box (this temporarily replaces what was in the main input)
+    SetWindowTextW(g_hwndInput, wideText);
+    free(wideText);
+
+    // Hide regular buttons and show Save/Cancel buttons
+    ShowWindow(GetDlgItem(hwnd, ID_ADD), SW_HIDE);
+    ShowWindow(GetDlgItem(hwnd, ID_VIEW), SW_HIDE);
+    ShowWindow(GetDlgItem(hwnd, ID_EXPORT), SW_HIDE);
+
+    // Create Save and Cancel buttons
+    hwndSaveBtn = CreateWindow(
+        "BUTTON", "Save Changes",
+        WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_DEFPUSHBUTTON,
+        20, 290, 100, 30,
+        hwnd, (HMENU)ID_SAVE,
+        GetModuleHandle(NULL), NULL
+    );
+
+    hwndCancelBtn = CreateWindow(
+        "BUTTON", "Cancel",
+        WS_TABSTOP | WS_VISIBLE | WS_CHILD | BS_PUSHBUTTON,
+        140, 290, 100, 30,
+        hwnd, (HMENU)ID_CANCEL,
+        GetModuleHandle(NULL), NULL
+    );
 
-    MessageBox(NULL, "Daily log exported!", "Export Complete", MB_OK | MB_ICONINFORMATION);
+    isViewMode = TRUE;
+}
+
+// Put back what was typed before View, and let the backup go
+void RestoreMainInput(void) {
+    SetWindowTextW(g_hwndInput, mainInputBackup ? mainInputBackup : L"");
+    free(mainInputBackup);
+    mainInputBackup = NULL;
+}
+
+void ExitViewMode(HWND hwnd) {
+    // Clean up view mode
+    DestroyWindow(hwndSaveBtn);
+    DestroyWindow(hwndCancelBtn);
+    hwndSaveBtn = hwndCancelBtn = NULL;
+
+    // Show regular buttons
+    ShowWindow(GetDlgItem(hwnd, ID_ADD), SW_SHOW);
+    ShowWindow(GetDlgItem(hwnd, ID_VIEW), SW_SHOW);
+    ShowWindow(GetDlgItem(hwnd, ID_EXPORT), SW_SHOW);
+
+    isViewMode = FALSE;
 }
 
 // Subclassed edit control procedure to support Ctrl+A for 'select all' and spell checking
@@ -678,10 +1481,54 @@ LRESULT CALLBACK EditProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
             SendMessage(hwnd, EM_SETSEL, 0, -1);
             return 0; // handled
         }
+        // Caret movement leaves the completed word behind
+        switch (wParam) {
+        case VK_LEFT: case VK_RIGHT: case VK_UP: case VK_DOWN:
+        case VK_HOME: case VK_END: case VK_PRIOR: case VK_NEXT: case VK_DELETE:
+            ClearCompletions();
+            break;
+        }
         // Trigger spell check on any key press
         TriggerSpellCheck();
         break;
     
+    case WM_CHAR:
+        // Tab accepts the first completion; Escape dismisses the hint
+        if (wParam == '\t' && g_completion[0]) {
+            const char *rest = g_completion + g_completionPrefixLen;
+            WCHAR *wideRest = Utf8ToWide(rest, (int)strlen(rest));
+            if (wideRest) SendMessageW(hwnd, EM_REPLACESEL, TRUE, (LPARAM)wideRest);
+            free(wideRest);
+            ClearCompletions();
+            TriggerSpellCheck();
+            return 0;
+        }
+        if (wParam == VK_ESCAPE) {
+            // Escape also cancels a running export, load or save
+            ClearCompletions();
+            IoJob_Cancel(g_ioJob);
+            return 0;
+        }
+        {
+            // Let the edit control insert the character, then complete
+            LRESULT result = CallWindowProcW(g_oldEditProc, hwnd, uMsg, wParam, lParam);
+            UpdateCompletions(hwnd);
+            return result;
+        }
+    
+    case WM_LBUTTONDOWN:
+    case WM_KILLFOCUS:
+        ClearCompletions();
+        break;
+    
+    case WM_PAINT:
+        {
+            // The control draws its text, then the underlines go on top
+            LRESULT result = CallWindowProcW(g_oldEditProc, hwnd, uMsg, wParam, lParam);
+            DrawMisspelledUnderlines(hwnd);
+            return result;
+        }
+    
     case WM_RBUTTONUP:
         // Handle right-click for spell check suggestions
         {
@@ -695,7 +1542,7 @@ LRESULT CALLBACK EditProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
             if (!HandleSpellCheckContextMenu(hwnd, pt.x, pt.y)) {
                 // No misspelled word found, show default context menu
                 if (g_oldEditProc) {
-                    return CallWindowProc(g_oldEditProc, hwnd, uMsg, wParam, lParam);
+                    return CallWindowProcW(g_oldEditProc, hwnd, uMsg, wParam, lParam);
                 }
             }
             return 0;
@@ -704,7 +1551,7 @@ LRESULT CALLBACK EditProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
 
     // Forward other messages to the original window procedure
     if (g_oldEditProc) {
-        return CallWindowProc(g_oldEditProc, hwnd, uMsg, wParam, lParam);
+        return CallWindowProcW(g_oldEditProc, hwnd, uMsg, wParam, lParam);
     }
-    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+    return DefWindowProcW(hwnd, uMsg, wParam, lParam);
 }
\ No newline at end of file
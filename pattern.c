@@ -0,0 +1,801 @@
+#include "pattern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PATTERN_SSE2
+#endif
+
+enum {
+    OP_CHAR,
+    OP_ANY,
+    OP_CLASS,
+    OP_SPLIT,                   // Try x, then y
+    OP_JMP,
+    OP_BOL,
+    OP_EOL,
+    OP_WORD_BOUNDARY,
+    OP_NOT_WORD_BOUNDARY,
+    OP_MATCH
+};
+
+enum {
+    NODE_EMPTY,
+    NODE_CHAR,
+    NODE_ANY,
+    NODE_CLASS,
+    NODE_BOL,
+    NODE_EOL,
+    NODE_WORD_BOUNDARY,
+    NODE_NOT_WORD_BOUNDARY,
+    NODE_CAT,
+    NODE_ALT,
+    NODE_REPEAT
+};
+
+#define MAX_NODES 1024
+#define MAX_DEPTH 64
+#define MAX_REPEAT 255
+#define REPEAT_FOREVER -1
+
+typedef struct {
+    int type;
+    unsigned char c;
+    int cls;
+    int left;                   // Also the repeated node
+    int right;
+    int min;
+    int max;
+} Node;
+
+typedef struct {
+    const char *p;
+    Node nodes[MAX_NODES];
+    int nodeCount;
+    unsigned char (*classes)[32];
+    int classCount;
+    int classCapacity;
+    int depth;
+    DWORD flags;
+    const char *error;
+    PatternInstruction *program;
+    int length;
+} Parser;
+
+static void SetBit(unsigned char *set, unsigned char c) {
+    set[c >> 3] |= (unsigned char)(1 << (c & 7));
+}
+
+static BOOL HasBit(const unsigned char *set, unsigned char c) {
+    return (set[c >> 3] >> (c & 7)) & 1;
+}
+
+// Bytes that make up words for \w and \b; bytes past ASCII count as
+// letters, since they are parts of accented words in either encoding
+static BOOL IsWordByte(int c) {
+    return c >= 0 && (isalnum(c) || c == '_' || c >= 0x80);
+}
+
+static int NewNode(Parser *ps, int type) {
+    if (ps->nodeCount >= MAX_NODES) {
+        ps->error = "pattern too complex";
+        return -1;
+    }
+    Node *node = &ps->nodes[ps->nodeCount];
+    memset(node, 0, sizeof(Node));
+    node->type = type;
+    return ps->nodeCount++;
+}
+
+static int NewClass(Parser *ps, const unsigned char *set) {
+    if (ps->classCount >= ps->classCapacity) {
+        int newCapacity = ps->classCapacity > 0 ? ps->classCapacity * 2 : 8;
+        unsigned char (*newClasses)[32] = realloc(ps->classes, newCapacity * sizeof(*newClasses));
+        if (!newClasses) {
+            ps->error = "out of memory";
+            return -1;
+        }
+        ps->classes = newClasses;
+        ps->classCapacity = newCapacity;
+    }
+    memcpy(ps->classes[ps->classCount], set, 32);
+    return ps->classCount++;
+}
+
+// Add the bytes of \d \w \s (or their complements) to a set; FALSE if
+// 'letter' isn't one of them
+static BOOL AddEscapeClass(unsigned char *set, char letter) {
+    unsigned char members[32];
+    memset(members, 0, sizeof(members));
+    char kind = (char)tolower((unsigned char)letter);
+    for (int c = 0; c < 256; c++) {
+        BOOL in = kind == 'd' ? isdigit(c) != 0 :
+                  kind == 'w' ? IsWordByte(c) :
+                  kind == 's' ? (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v') : FALSE;
+        if (in) SetBit(members, (unsigned char)c);
+    }
+    if (kind != 'd' && kind != 'w' && kind != 's') return FALSE;
+
+    BOOL negate = isupper((unsigned char)letter) != 0;
+    for (int i = 0; i < 32; i++) {
+        set[i] |= negate ? (unsigned char)~members[i] : members[i];
+    }
+    return TRUE;
+}
+
+// The byte an escape stands for outside the class letters
+static unsigned char EscapedByte(char c) {
+    switch (c) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    default: return (unsigned char)c;
+    }
+}
+
+static int ParseAlternation(Parser *ps);
+
+// "[...]" after the opening bracket
+static int ParseClass(Parser *ps) {
+    unsigned char set[32];
+    memset(set, 0, sizeof(set));
+    BOOL negate = FALSE;
+    if (*ps->p == '^') {
+        negate = TRUE;
+        ps->p++;
+    }
+
+    BOOL first = TRUE;
+    while (*ps->p && (*ps->p != ']' || first)) {
+        first = FALSE;
+        unsigned char low;
+        if (*ps->p == '\\') {
+            ps->p++;
+            if (!*ps->p) break;
+            if (AddEscapeClass(set, *ps->p)) {
+                ps->p++;
+                continue;
+            }
+            low = EscapedByte(*ps->p++);
+        } else {
+            low = (unsigned char)*ps->p++;
+        }
+
+        unsigned char high = low;
+        if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+            ps->p++;
+            if (*ps->p == '\\') {
+                ps->p++;
+                if (!*ps->p || strchr("dDwWsS", *ps->p)) {
+                    ps->error = "bad class range";
+                    return -1;
+                }
+                high = EscapedByte(*ps->p++);
+            } else {
+                high = (unsigned char)*ps->p++;
+            }
+            if (high < low) {
+                ps->error = "bad class range";
+                return -1;
+            }
+        }
+        for (int c = low; c <= high; c++) SetBit(set, (unsigned char)c);
+    }
+    if (*ps->p != ']') {
+        ps->error = "missing ]";
+        return -1;
+    }
+    ps->p++;
+
+    // Fold before negating, so "[^a]" excludes 'A' as well
+    if (ps->flags & PATTERN_IGNORE_CASE) {
+        for (int c = 'a'; c <= 'z'; c++) {
+            if (HasBit(set, (unsigned char)c) || HasBit(set, (unsigned char)toupper(c))) {
+                SetBit(set, (unsigned char)c);
+                SetBit(set, (unsigned char)toupper(c));
+            }
+        }
+    }
+    if (negate) {
+        for (int i = 0; i < 32; i++) set[i] = (unsigned char)~set[i];
+    }
+    int node = NewNode(ps, NODE_CLASS);
+    if (node < 0) return -1;
+    ps->nodes[node].cls = NewClass(ps, set);
+    return ps->nodes[node].cls < 0 ? -1 : node;
+}
+
+static int ParseAtom(Parser *ps) {
+    char c = *ps->p;
+    int node;
+
+    switch (c) {
+    case '(':
+        if (++ps->depth > MAX_DEPTH) {
+            ps->error = "groups nested too deeply";
+            return -1;
+        }
+        ps->p++;
+        if (ps->p[0] == '?' && ps->p[1] == ':') ps->p += 2;
+        node = ParseAlternation(ps);
+        if (node < 0) return -1;
+        if (*ps->p != ')') {
+            ps->error = "missing )";
+            return -1;
+        }
+        ps->p++;
+        ps->depth--;
+        return node;
+    case '[':
+        ps->p++;
+        return ParseClass(ps);
+    case '.':
+        ps->p++;
+        return NewNode(ps, NODE_ANY);
+    case '^':
+        ps->p++;
+        return NewNode(ps, NODE_BOL);
+    case '$':
+        ps->p++;
+        return NewNode(ps, NODE_EOL);
+    case '*':
+    case '+':
+    case '?':
+        ps->error = "nothing to repeat";
+        return -1;
+    case '\\':
+        ps->p++;
+        c = *ps->p++;
+        if (!c) {
+            ps->error = "trailing backslash";
+            return -1;
+        }
+        if (c == 'b') return NewNode(ps, NODE_WORD_BOUNDARY);
+        if (c == 'B') return NewNode(ps, NODE_NOT_WORD_BOUNDARY);
+
+        unsigned char set[32];
+        memset(set, 0, sizeof(set));
+        if (AddEscapeClass(set, c)) {
+            node = NewNode(ps, NODE_CLASS);
+            if (node < 0) return -1;
+            ps->nodes[node].cls = NewClass(ps, set);
+            return ps->nodes[node].cls < 0 ? -1 : node;
+        }
+        node = NewNode(ps, NODE_CHAR);
+        if (node >= 0) ps->nodes[node].c = EscapedByte(c);
+        return node;
+    default:
+        ps->p++;
+        node = NewNode(ps, NODE_CHAR);
+        if (node >= 0) ps->nodes[node].c = (unsigned char)c;
+        return node;
+    }
+}
+
+// "{n}", "{n,}" or "{n,m}"; FALSE (and nothing consumed) if 'p' doesn't
+// start one, so a stray brace stays a literal
+static BOOL ParseBraces(Parser *ps, int *min, int *max) {
+    const char *p = ps->p + 1;
+    if (!isdigit((unsigned char)*p)) return FALSE;
+
+    *min = (int)strtol(p, (char **)&p, 10);
+    *max = *min;
+    if (*p == ',') {
+        p++;
+        *max = isdigit((unsigned char)*p) ? (int)strtol(p, (char **)&p, 10) : REPEAT_FOREVER;
+    }
+    if (*p != '}') return FALSE;
+    ps->p = p + 1;
+    return TRUE;
+}
+
+static int ParseRepeat(Parser *ps) {
+    int atom = ParseAtom(ps);
+    while (atom >= 0) {
+        int min, max;
+        char c = *ps->p;
+        if (c == '*') {
+            min = 0;
+            max = REPEAT_FOREVER;
+            ps->p++;
+        } else if (c == '+') {
+            min = 1;
+            max = REPEAT_FOREVER;
+            ps->p++;
+        } else if (c == '?') {
+            min = 0;
+            max = 1;
+            ps->p++;
+        } else if (c == '{' && ParseBraces(ps, &min, &max)) {
+            if (min > MAX_REPEAT || max > MAX_REPEAT || (max != REPEAT_FOREVER && max < min)) {
+                ps->error = "bad repeat count";
+                return -1;
+            }
+        } else {
+            break;
+        }
+
+        int node = NewNode(ps, NODE_REPEAT);
+        if (node < 0) return -1;
+        ps->nodes[node].left = atom;
+        ps->nodes[node].min = min;
+        ps->nodes[node].max = max;
+        atom = node;
+    }
+    return atom;
+}
+
+static int ParseSequence(Parser *ps) {
+    int sequence = -1;
+    while (*ps->p && *ps->p != '|' && *ps->p != ')') {
+        int atom = ParseRepeat(ps);
+        if (atom < 0) return -1;
+        if (sequence < 0) {
+            sequence = atom;
+            continue;
+        }
+        int node = NewNode(ps, NODE_CAT);
+        if (node < 0) return -1;
+        ps->nodes[node].left = sequence;
+        ps->nodes[node].right = atom;
+        sequence = node;
+    }
+    return sequence >= 0 ? sequence : NewNode(ps, NODE_EMPTY);
+}
+
+static int ParseAlternation(Parser *ps) {
+    int left = ParseSequence(ps);
+    while (left >= 0 && *ps->p == '|') {
+        ps->p++;
+        int right = ParseSequence(ps);
+        if (right < 0) return -1;
+        int node = NewNode(ps, NODE_ALT);
+        if (node < 0) return -1;
+        ps->nodes[node].left = left;
+        ps->nodes[node].right = right;
+        left = node;
+    }
+    return left;
+}
+
+static int Emit(Parser *ps, unsigned char op, unsigned char c, int x, int y) {
+    if (ps->length >= PATTERN_MAX_INSTRUCTIONS) {
+        ps->error = "pattern too large";
+        return -1;
+    }
+    PatternInstruction *in = &ps->program[ps->length];
+    in->op = op;
+    in->c = c;
+    in->x = x;
+    in->y = y;
+    return ps->length++;
+}
+
+// Emit the program for a node. Repeats are written out: the required
+// copies, then a loop or a chain of optional copies.
+static BOOL EmitNode(Parser *ps, int index, DWORD flags) {
+    const Node *node = &ps->nodes[index];
+    int split, jump;
+
+    switch (node->type) {
+    case NODE_EMPTY:
+        return TRUE;
+    case NODE_CHAR:
+        if ((flags & PATTERN_IGNORE_CASE) && isalpha(node->c)) {
+            unsigned char set[32];
+            memset(set, 0, sizeof(set));
+            SetBit(set, (unsigned char)tolower(node->c));
+            SetBit(set, (unsigned char)toupper(node->c));
+            int cls = NewClass(ps, set);
+            return cls >= 0 && Emit(ps, OP_CLASS, 0, cls, 0) >= 0;
+        }
+        return Emit(ps, OP_CHAR, node->c, 0, 0) >= 0;
+    case NODE_ANY:
+        return Emit(ps, OP_ANY, 0, 0, 0) >= 0;
+    case NODE_CLASS:
+        return Emit(ps, OP_CLASS, 0, node->cls, 0) >= 0;
+    case NODE_BOL:
+        return Emit(ps, OP_BOL, 0, 0, 0) >= 0;
+    case NODE_EOL:
+        return Emit(ps, OP_EOL, 0, 0, 0) >= 0;
+    case NODE_WORD_BOUNDARY:
+        return Emit(ps, OP_WORD_BOUNDARY, 0, 0, 0) >= 0;
+    case NODE_NOT_WORD_BOUNDARY:
+        return Emit(ps, OP_NOT_WORD_BOUNDARY, 0, 0, 0) >= 0;
+    case NODE_CAT:
+        return EmitNode(ps, node->left, flags) && EmitNode(ps, node->right, flags);
+    case NODE_ALT:
+        split = Emit(ps, OP_SPLIT, 0, 0, 0);
+        if (split < 0) return FALSE;
+        ps->program[split].x = ps->length;
+        if (!EmitNode(ps, node->left, flags)) return FALSE;
+        jump = Emit(ps, OP_JMP, 0, 0, 0);
+        if (jump < 0) return FALSE;
+        ps->program[split].y = ps->length;
+        if (!EmitNode(ps, node->right, flags)) return FALSE;
+        ps->program[jump].x = ps->length;
+        return TRUE;
+    case NODE_REPEAT:
+        for (int i = 0; i < node->min; i++) {
+            if (!EmitNode(ps, node->left, flags)) return FALSE;
+        }
+        if (node->max == REPEAT_FOREVER) {
+            split = Emit(ps, OP_SPLIT, 0, 0, 0);
+            if (split < 0) return FALSE;
+            ps->program[split].x = ps->length;
+            if (!EmitNode(ps, node->left, flags)) return FALSE;
+            if (Emit(ps, OP_JMP, 0, split, 0) < 0) return FALSE;
+            ps->program[split].y = ps->length;
+            return TRUE;
+        }
+        {
+            // Each optional copy can skip straight past the last one
+            int splits[MAX_REPEAT];
+            int optional = node->max - node->min;
+            for (int i = 0; i < optional; i++) {
+                splits[i] = Emit(ps, OP_SPLIT, 0, 0, 0);
+                if (splits[i] < 0) return FALSE;
+                ps->program[splits[i]].x = ps->length;
+                if (!EmitNode(ps, node->left, flags)) return FALSE;
+            }
+            for (int i = 0; i < optional; i++) ps->program[splits[i]].y = ps->length;
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+// Longest run of literal bytes in the top-level sequence. Zero-width
+// assertions don't break a run; anything optional or variable does.
+static void FindLiteral(const Parser *ps, int index, char *run, int *runLength, char *best, int *bestLength) {
+    const Node *node = &ps->nodes[index];
+    switch (node->type) {
+    case NODE_CAT:
+        FindLiteral(ps, node->left, run, runLength, best, bestLength);
+        FindLiteral(ps, node->right, run, runLength, best, bestLength);
+        return;
+    case NODE_CHAR:
+        if (node->c == '\n' || *runLength >= PATTERN_MAX_LITERAL) {
+            *runLength = 0;
+            return;
+        }
+        run[(*runLength)++] = (char)node->c;
+        if (*runLength > *bestLength) {
+            memcpy(best, run, *runLength);
+            *bestLength = *runLength;
+        }
+        return;
+    case NODE_EMPTY:
+    case NODE_BOL:
+    case NODE_EOL:
+    case NODE_WORD_BOUNDARY:
+    case NODE_NOT_WORD_BOUNDARY:
+        return;
+    default:
+        *runLength = 0;
+        return;
+    }
+}
+
+// Bytes a match can begin with, following jumps and assertions from the
+// start. A reachable match or '.' means it can begin anywhere.
+static void ComputeFirstBytes(Pattern *pattern) {
+    int *stack = (int *)malloc(pattern->length * 2 * sizeof(int));
+    unsigned char *seen = (unsigned char *)calloc(pattern->length, 1);
+    memset(pattern->first, 0, sizeof(pattern->first));
+    pattern->startsAnywhere = !stack || !seen;
+
+    int top = 0;
+    if (!pattern->startsAnywhere) stack[top++] = 0;
+    while (top > 0 && !pattern->startsAnywhere) {
+        int pc = stack[--top];
+        if (seen[pc]) continue;
+        seen[pc] = 1;
+
+        const PatternInstruction *in = &pattern->program[pc];
+        switch (in->op) {
+        case OP_CHAR:
+            SetBit(pattern->first, in->c);
+            break;
+        case OP_CLASS:
+            for (int i = 0; i < 32; i++) pattern->first[i] |= pattern->classes[in->x][i];
+            break;
+        case OP_SPLIT:
+            stack[top++] = in->y;
+            stack[top++] = in->x;
+            break;
+        case OP_JMP:
+            stack[top++] = in->x;
+            break;
+        case OP_BOL:
+        case OP_EOL:
+        case OP_WORD_BOUNDARY:
+        case OP_NOT_WORD_BOUNDARY:
+            // EOL still needs something to start on unless it matches
+            stack[top++] = pc + 1;
+            break;
+        default:
+            pattern->startsAnywhere = TRUE;
+            break;
+        }
+    }
+    free(stack);
+    free(seen);
+
+    pattern->firstByte = -1;
+    for (int c = 0; c < 256 && !pattern->startsAnywhere; c++) {
+        if (!HasBit(pattern->first, (unsigned char)c)) continue;
+        if (pattern->firstByte >= 0) {
+            pattern->firstByte = -1;
+            break;
+        }
+        pattern->firstByte = c;
+    }
+}
+
+Pattern* Pattern_Compile(const char *expression, DWORD flags, char *error, size_t errorSize) {
+    if (error && errorSize > 0) error[0] = '\0';
+    if (!expression) return NULL;
+
+    Parser *ps = (Parser *)calloc(1, sizeof(Parser));
+    Pattern *pattern = (Pattern *)calloc(1, sizeof(Pattern));
+    PatternInstruction *program = (PatternInstruction *)malloc(PATTERN_MAX_INSTRUCTIONS * sizeof(PatternInstruction));
+    if (!ps || !pattern || !program) {
+        if (error && errorSize > 0) snprintf(error, errorSize, "out of memory");
+        free(ps);
+        free(pattern);
+        free(program);
+        return NULL;
+    }
+    ps->p = expression;
+    ps->flags = flags;
+    ps->program = program;
+
+    int root = ParseAlternation(ps);
+    if (root >= 0 && *ps->p == ')') ps->error = "unmatched )";
+    if (root >= 0 && !ps->error && EmitNode(ps, root, flags)) Emit(ps, OP_MATCH, 0, 0, 0);
+
+    if (ps->error || root < 0) {
+        if (error && errorSize > 0) {
+            snprintf(error, errorSize, "%s at offset %d", ps->error ? ps->error : "syntax error",
+                     (int)(ps->p - expression));
+        }
+        free(ps->classes);
+        free(ps);
+        free(pattern);
+        free(program);
+        return NULL;
+    }
+
+    pattern->program = program;
+    pattern->length = ps->length;
+    pattern->classes = ps->classes;
+    pattern->classCount = ps->classCount;
+    pattern->flags = flags;
+
+    char run[PATTERN_MAX_LITERAL];
+    int runLength = 0;
+    FindLiteral(ps, root, run, &runLength, pattern->literal, &pattern->literalLength);
+    pattern->literal[pattern->literalLength] = '\0';
+    if (flags & PATTERN_IGNORE_CASE) {
+        for (int i = 0; i < pattern->literalLength; i++) {
+            pattern->literal[i] = (char)tolower((unsigned char)pattern->literal[i]);
+        }
+    }
+
+    ComputeFirstBytes(pattern);
+    free(ps);
+    return pattern;
+}
+
+void Pattern_Destroy(Pattern *pattern) {
+    if (!pattern) return;
+    free(pattern->program);
+    free(pattern->classes);
+    free(pattern);
+}
+
+typedef struct {
+    int pc;
+    int start;
+} Thread;
+
+typedef struct {
+    Thread *threads;            // At most one per instruction
+    int count;
+} ThreadList;
+
+typedef struct {
+    ThreadList lists[2];
+    int *marks;                 // Position + 1 a pc was last added at
+    int *stack;                 // Each instruction pushes at most two
+} MatchState;
+
+#define MATCH_STACK_BYTES 16384
+
+static BOOL AtWordBoundary(const char *line, size_t length, size_t pos) {
+    int before = pos > 0 ? (unsigned char)line[pos - 1] : -1;
+    int after = pos < length ? (unsigned char)line[pos] : -1;
+    return IsWordByte(before) != IsWordByte(after);
+}
+
+// Add a thread and everything it reaches without reading a byte, in
+// priority order, to the list for position 'pos'
+static void AddThread(const Pattern *pattern, MatchState *state, ThreadList *list, int pc, int start,
+                      const char *line, size_t length, size_t pos) {
+    int mark = (int)pos + 1;
+    int top = 0;
+    state->stack[top++] = pc;
+
+    while (top > 0) {
+        pc = state->stack[--top];
+        if (state->marks[pc] == mark) continue;
+        state->marks[pc] = mark;
+
+        const PatternInstruction *in = &pattern->program[pc];
+        switch (in->op) {
+        case OP_JMP:
+            state->stack[top++] = in->x;
+            break;
+        case OP_SPLIT:
+            state->stack[top++] = in->y;
+            state->stack[top++] = in->x;
+            break;
+        case OP_BOL:
+            if (pos == 0) state->stack[top++] = pc + 1;
+            break;
+        case OP_EOL:
+            if (pos == length) state->stack[top++] = pc + 1;
+            break;
+        case OP_WORD_BOUNDARY:
+            if (AtWordBoundary(line, length, pos)) state->stack[top++] = pc + 1;
+            break;
+        case OP_NOT_WORD_BOUNDARY:
+            if (!AtWordBoundary(line, length, pos)) state->stack[top++] = pc + 1;
+            break;
+        default:
+            list->threads[list->count].pc = pc;
+            list->threads[list->count].start = start;
+            list->count++;
+            break;
+        }
+    }
+}
+
+BOOL Pattern_MatchLine(const Pattern *pattern, const char *line, size_t length,
+                       size_t *matchStart, size_t *matchEnd) {
+    if (!pattern || !line || length >= 0x7FFFFFFF) return FALSE;
+
+    // The usual small program runs from the stack; a large one allocates
+    Thread local[MATCH_STACK_BYTES / sizeof(Thread)];
+    size_t need = pattern->length * (2 * sizeof(Thread) + 3 * sizeof(int)) + sizeof(int);
+    Thread *memory = need <= sizeof(local) ? local : (Thread *)malloc(need);
+    if (!memory) return FALSE;
+
+    MatchState stateData, *state = &stateData;
+    state->lists[0].threads = memory;
+    state->lists[1].threads = memory + pattern->length;
+    state->marks = (int *)(memory + 2 * pattern->length);
+    state->stack = state->marks + pattern->length;
+    memset(state->marks, 0, pattern->length * sizeof(int));
+
+    ThreadList *current = &state->lists[0], *next = &state->lists[1];
+    current->count = 0;
+    int foundStart = -1, foundEnd = -1;
+
+    for (size_t pos = 0; ; pos++) {
+        // Until something matches, a new attempt starts at every position;
+        // with nothing in flight, skip to a byte a match can begin with
+        if (foundStart < 0) {
+            if (current->count == 0 && !pattern->startsAnywhere) {
+                if (pattern->firstByte >= 0) {
+                    const char *hit = (const char *)memchr(line + pos, pattern->firstByte, length - pos);
+                    pos = hit ? (size_t)(hit - line) : length;
+                }
+                while (pos < length && !HasBit(pattern->first, (unsigned char)line[pos])) pos++;
+                if (pos == length) break;
+            }
+            AddThread(pattern, state, current, 0, (int)pos, line, length, pos);
+        }
+        if (current->count == 0) {
+            if (foundStart >= 0 || pos >= length) break;
+            continue;
+        }
+
+        int c = pos < length ? (unsigned char)line[pos] : -1;
+        next->count = 0;
+        for (int i = 0; i < current->count; i++) {
+            const Thread *thread = &current->threads[i];
+            const PatternInstruction *in = &pattern->program[thread->pc];
+            BOOL advance = FALSE;
+            switch (in->op) {
+            case OP_CHAR:
+                advance = c == in->c;
+                break;
+            case OP_ANY:
+                advance = c >= 0 && c != '\n';
+                break;
+            case OP_CLASS:
+                advance = c >= 0 && HasBit(pattern->classes[in->x], (unsigned char)c);
+                break;
+            case OP_MATCH:
+                // Threads after this one have lower priority
+                foundStart = thread->start;
+                foundEnd = (int)pos;
+                i = current->count;
+                break;
+            }
+            if (advance) AddThread(pattern, state, next, thread->pc + 1, thread->start, line, length, pos + 1);
+        }
+        if (pos >= length) break;
+
+        ThreadList *swap = current;
+        current = next;
+        next = swap;
+    }
+    if (memory != local) free(memory);
+
+    if (foundStart < 0) return FALSE;
+    if (matchStart) *matchStart = (size_t)foundStart;
+    if (matchEnd) *matchEnd = (size_t)foundEnd;
+    return TRUE;
+}
+
+static BOOL LiteralAt(const Pattern *pattern, const char *text) {
+    if (!(pattern->flags & PATTERN_IGNORE_CASE)) {
+        return memcmp(text, pattern->literal, pattern->literalLength) == 0;
+    }
+    for (int i = 0; i < pattern->literalLength; i++) {
+        if (tolower((unsigned char)text[i]) != (unsigned char)pattern->literal[i]) return FALSE;
+    }
+    return TRUE;
+}
+
+size_t Pattern_FindCandidate(const Pattern *pattern, const char *text, size_t length, size_t from) {
+    int n = pattern->literalLength;
+    if (n == 0) return from < length ? from : length;
+    if (from >= length || length - from < (size_t)n) return length;
+
+    BOOL ignoreCase = (pattern->flags & PATTERN_IGNORE_CASE) != 0;
+    unsigned char first = (unsigned char)pattern->literal[0];
+    unsigned char last = (unsigned char)pattern->literal[n - 1];
+    size_t pos = from;
+
+    if (!ignoreCase && n == 1) {
+        const char *hit = (const char *)memchr(text + from, first, length - from);
+        return hit ? (size_t)(hit - text) : length;
+    }
+
+#ifdef PATTERN_SSE2
+    // Compare 16 starting positions at once on the literal's first and
+    // last bytes (both cases when ignoring case); only positions where
+    // both agree are compared in full
+    __m128i firstLow = _mm_set1_epi8((char)first), firstHigh = _mm_set1_epi8((char)toupper(first));
+    __m128i lastLow = _mm_set1_epi8((char)last), lastHigh = _mm_set1_epi8((char)toupper(last));
+    for (; pos + n - 1 + 16 <= length; pos += 16) {
+        __m128i head = _mm_loadu_si128((const __m128i *)(text + pos));
+        __m128i tail = _mm_loadu_si128((const __m128i *)(text + pos + n - 1));
+        __m128i headHit = _mm_cmpeq_epi8(head, firstLow);
+        __m128i tailHit = _mm_cmpeq_epi8(tail, lastLow);
+        if (ignoreCase) {
+            headHit = _mm_or_si128(headHit, _mm_cmpeq_epi8(head, firstHigh));
+            tailHit = _mm_or_si128(tailHit, _mm_cmpeq_epi8(tail, lastHigh));
+        }
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(headHit, tailHit));
+        for (size_t bit = 0; mask; bit++, mask >>= 1) {
+            if ((mask & 1) && LiteralAt(pattern, text + pos + bit)) return pos + bit;
+        }
+    }
+#endif
+
+    for (; pos + n <= length; pos++) {
+        unsigned char c = (unsigned char)text[pos];
+        if ((c == first || (ignoreCase && tolower(c) == first)) && LiteralAt(pattern, text + pos)) return pos;
+    }
+    return length;
+}
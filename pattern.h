@@ -0,0 +1,59 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <windows.h>
+
+// Regular expressions for searching log text line by line.
+//
+// Supported: literals, '.', classes ("[a-z]", "[^0-9]"), the escapes \d
+// \w \s (and \D \W \S) inside and outside classes, \b and \B, '^' and
+// '$', groups, '|', and the repeats '*' '+' '?' and {n}, {n,}, {n,m}.
+// A pattern compiles to a small program run as a Pike VM: every possible
+// path is followed at once, one byte at a time, so matching is linear in
+// the line whatever the pattern.
+//
+// Two filters keep the VM off most of the text. Every match must contain
+// the longest literal run of the pattern's top-level sequence (the "FD-"
+// of "FD-[0-9]+"), which Pattern_FindCandidate looks for 16 bytes at a
+// time; and the VM skips ahead to the next byte that can start a match.
+
+#define PATTERN_IGNORE_CASE 0x0001      // ASCII letters match either case
+
+#define PATTERN_MAX_INSTRUCTIONS 2048
+#define PATTERN_MAX_LITERAL 64
+
+typedef struct {
+    unsigned char op;
+    unsigned char c;
+    int x;                      // Jump target, or class index
+    int y;                      // Second target of a split
+} PatternInstruction;
+
+typedef struct {
+    PatternInstruction *program;
+    int length;
+    unsigned char (*classes)[32];   // 256-bit byte sets
+    int classCount;
+    unsigned char first[32];        // Bytes a match can start with
+    BOOL startsAnywhere;            // Can match empty, or first is every byte
+    int firstByte;                  // The only byte in 'first', or -1
+    char literal[PATTERN_MAX_LITERAL + 1];  // Required in every match, "" if none
+    int literalLength;
+    DWORD flags;
+} Pattern;
+
+// NULL on a syntax error, with a message in 'error' (optional)
+Pattern* Pattern_Compile(const char *expression, DWORD flags, char *error, size_t errorSize);
+void Pattern_Destroy(Pattern *pattern);
+
+// Leftmost match within one line (no newline inside), preferring the
+// earlier alternative like Perl. Safe to call from several threads.
+BOOL Pattern_MatchLine(const Pattern *pattern, const char *line, size_t length,
+                       size_t *matchStart, size_t *matchEnd);
+
+// Offset of the next occurrence of the required literal at or after
+// 'from', or 'from' itself when the pattern has none. 'length' when no
+// later text can match. Lines without a candidate need no MatchLine.
+size_t Pattern_FindCandidate(const Pattern *pattern, const char *text, size_t length, size_t from);
+
+#endif // PATTERN_H
@@ -0,0 +1,130 @@
+#include "spans.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_DIFF_CAPACITY 100
+
+// A span still holds its word if the text wasn't edited since the check
+static int SpanMatches(const MisspelledWord *span, const char *text, size_t length) {
+    size_t wordLength = strlen(span->word);
+    return span->startPos <= span->endPos && span->endPos <= length &&
+           span->endPos - span->startPos == wordLength &&
+           memcmp(text + span->startPos, span->word, wordLength) == 0;
+}
+
+int Spans_PlanReplacement(const MisspelledWordList *list, int index, int all, const char *replacement,
+                          const char *text, size_t length, SpellCheckEdit *edit) {
+    if (!edit) return 0;
+    memset(edit, 0, sizeof(SpellCheckEdit));
+    if (!list || index < 0 || index >= list->count || !replacement || !text) return 0;
+    
+    const char *target = list->words[index].word;
+    size_t replacementLength = strlen(replacement);
+    int first = all ? 0 : index;
+    int last = all ? list->count : index + 1;
+    
+    // Nothing grows by more than the replacements, so one allocation does
+    char *out = (char *)malloc(length + (size_t)(last - first) * replacementLength + 1);
+    if (!out) return 0;
+    
+    size_t outLength = 0;
+    unsigned int copied = 0;    // Text before this is already in 'out'
+    for (int i = first; i < last; i++) {
+        const MisspelledWord *span = &list->words[i];
+        if (i != index && strcmp(span->word, target) != 0) continue;
+        if (!SpanMatches(span, text, length) || (edit->replaced > 0 && span->startPos < copied)) continue;
+        
+        if (edit->replaced == 0) edit->start = copied = span->startPos;
+        memcpy(out + outLength, text + copied, span->startPos - copied);
+        outLength += span->startPos - copied;
+        memcpy(out + outLength, replacement, replacementLength);
+        outLength += replacementLength;
+        copied = span->endPos;
+        edit->replaced++;
+    }
+    
+    if (edit->replaced == 0) {
+        free(out);
+        return 0;
+    }
+    out[outLength] = '\0';
+    edit->end = copied;
+    edit->text = out;
+    edit->length = (unsigned int)outLength;
+    return 1;
+}
+
+void Spans_FreeEdit(SpellCheckEdit *edit) {
+    if (!edit) return;
+    free(edit->text);
+    edit->text = NULL;
+}
+
+// Append one change to a diff, growing it as needed
+static int AppendChange(MisspelledDiff *diff, SpellCheckSpanChange change, const MisspelledWord *before,
+                        const MisspelledWord *after) {
+    if (diff->count >= diff->capacity) {
+        int newCapacity = diff->capacity > 0 ? diff->capacity * 2 : INITIAL_DIFF_CAPACITY;
+        MisspelledChange *newChanges = (MisspelledChange *)realloc(diff->changes,
+                                                                   newCapacity * sizeof(MisspelledChange));
+        if (!newChanges) return 0;
+        diff->changes = newChanges;
+        diff->capacity = newCapacity;
+    }
+    
+    MisspelledChange *entry = &diff->changes[diff->count++];
+    memset(entry, 0, sizeof(MisspelledChange));
+    entry->change = change;
+    if (before) {
+        entry->oldStart = before->startPos;
+        entry->oldEnd = before->endPos;
+    }
+    if (after) {
+        entry->newStart = after->startPos;
+        entry->newEnd = after->endPos;
+    }
+    return 1;
+}
+
+int Spans_Diff(const MisspelledWordList *before, const MisspelledWordList *after, MisspelledDiff *diff) {
+    if (!before || !after || !diff) return 0;
+    diff->count = 0;
+    
+    // Both lists are in text order, so one merge walk pairs them up: the
+    // same word at the same place is unchanged, the same word elsewhere has
+    // shifted, and otherwise whichever span comes first is the odd one out
+    int i = 0, j = 0;
+    int ok = 1;
+    while (ok && i < before->count && j < after->count) {
+        const MisspelledWord *old = &before->words[i];
+        const MisspelledWord *now = &after->words[j];
+        int sameWord = old->endPos - old->startPos == now->endPos - now->startPos &&
+                       strcmp(old->word, now->word) == 0;
+        if (sameWord) {
+            if (old->startPos != now->startPos) ok = AppendChange(diff, SPELLCHECK_SPAN_SHIFTED, old, now);
+            i++;
+            j++;
+        } else if (old->startPos <= now->startPos) {
+            ok = AppendChange(diff, SPELLCHECK_SPAN_REMOVED, old, NULL);
+            i++;
+        } else {
+            ok = AppendChange(diff, SPELLCHECK_SPAN_ADDED, NULL, now);
+            j++;
+        }
+    }
+    for (; ok && i < before->count; i++) {
+        ok = AppendChange(diff, SPELLCHECK_SPAN_REMOVED, &before->words[i], NULL);
+    }
+    for (; ok && j < after->count; j++) {
+        ok = AppendChange(diff, SPELLCHECK_SPAN_ADDED, NULL, &after->words[j]);
+    }
+    return ok;
+}
+
+void Spans_FreeDiff(MisspelledDiff *diff) {
+    if (!diff) return;
+    free(diff->changes);
+    diff->changes = NULL;
+    diff->count = 0;
+    diff->capacity = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef SPANS_H
+#define SPANS_H
+
+#include <stddef.h>
+
+// Misspelled spans of a checked text, edits planned against them and
+// diffs between two checks. Plain C library code, apart from the checker,
+// so it builds and is tested anywhere. Positions are byte offsets into
+// the UTF-8 text.
+
+typedef struct {
+    unsigned int startPos;
+    unsigned int endPos;
+    char word[256];
+} MisspelledWord;
+
+typedef struct {
+    MisspelledWord *words;
+    int count;
+    int capacity;
+} MisspelledWordList;
+
+// How a span differs between two checks of the same text
+typedef enum {
+    SPELLCHECK_SPAN_ADDED,
+    SPELLCHECK_SPAN_REMOVED,
+    SPELLCHECK_SPAN_SHIFTED      // Same word, now at another offset
+} SpellCheckSpanChange;
+
+typedef struct {
+    SpellCheckSpanChange change;
+    unsigned int oldStart;       // Removed and shifted spans
+    unsigned int oldEnd;
+    unsigned int newStart;       // Added and shifted spans
+    unsigned int newEnd;
+} MisspelledChange;
+
+// Caller-owned; the storage is kept from one diff to the next
+typedef struct {
+    MisspelledChange *changes;
+    int count;
+    int capacity;
+} MisspelledDiff;
+
+// One edit that replaces misspelled spans: the new content of the
+// checked text's range [start, end)
+typedef struct {
+    unsigned int start;
+    unsigned int end;
+    char *text;             // malloc'd, NUL-terminated
+    unsigned int length;
+    int replaced;           // Spans it replaces
+} SpellCheckEdit;
+
+// Build the edit that replaces span 'index' of 'list' with 'replacement',
+// or with 'all' every span holding the same word, in one pass over the
+// list; the text between replaced spans is carried over. Spans that no
+// longer match 'text', or that overlap one already replaced, are left
+// alone. Returns 0 if nothing could be replaced.
+int Spans_PlanReplacement(const MisspelledWordList *list, int index, int all, const char *replacement,
+                          const char *text, size_t length, SpellCheckEdit *edit);
+void Spans_FreeEdit(SpellCheckEdit *edit);
+
+// What changed between two span lists in text order, in one pass over
+// both: spans left where they were are not reported, so an empty diff
+// means nothing needs repainting. A word found at a new offset pairs with
+// the next unmatched span of the same word and length; pairing only
+// decides how a change is labelled, never which ranges it covers.
+// Returns 0 if the diff couldn't grow; it then holds a prefix.
+int Spans_Diff(const MisspelledWordList *before, const MisspelledWordList *after, MisspelledDiff *diff);
+void Spans_FreeDiff(MisspelledDiff *diff);
+
+#endif // SPANS_H
@@ -1,385 +1,2565 @@
 #include "spellchecker.h"
+#include "utf8.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
+#ifdef SPELLCHECK_EMBEDDED_DICTIONARY
+#include "embeddeddict.h"
+extern const EmbeddedDictionary g_embeddedDictionary;
+#endif
+
 #define INITIAL_DICT_CAPACITY 10000
 #define INITIAL_MISSPELLED_CAPACITY 100
+#define MAX_DICTIONARY_WORD 255         // Longer lines can't match a checked word
+#define LOAD_MAX_THREADS 16
+#define LOAD_MIN_CHUNK (256 * 1024)     // Smaller files are parsed on one thread
+#define SORT_MIN_PER_THREAD 16384       // Fewer entries per thread sort on one
+#define SORT_INSERTION_CUTOFF 24
+#define SORT_FIRST_BUCKETS 65536        // The first pass splits on two key bytes
+
+// The C heap, for checkers created without an allocator
+static void* HeapAllocate(void *context, size_t size, SpellCheckMemoryUse use) {
+    return malloc(size);
+}
+
+static void* HeapReallocate(void *context, void *block, size_t size, SpellCheckMemoryUse use) {
+    return realloc(block, size);
+}
+
+static void HeapRelease(void *context, void *block, SpellCheckMemoryUse use) {
+    free(block);
+}
+
+static const SpellCheckAllocator g_heapAllocator = { HeapAllocate, HeapReallocate, HeapRelease, NULL, NULL };
+
+// Memory the checker keeps comes from its allocator. A NULL checker
+// means the C heap, for what is handed to the caller.
+static void* MemAlloc(SpellChecker *sc, size_t size, SpellCheckMemoryUse use) {
+    const SpellCheckAllocator *a = sc ? &sc->allocator : &g_heapAllocator;
+    return a->allocate(a->context, size, use);
+}
+
+static void* MemCalloc(SpellChecker *sc, size_t count, size_t size, SpellCheckMemoryUse use) {
+    if (size && count > (size_t)-1 / size) return NULL;
+    void *block = MemAlloc(sc, count * size, use);
+    if (block) memset(block, 0, count * size);
+    return block;
+}
+
+static void* MemRealloc(SpellChecker *sc, void *block, size_t size, SpellCheckMemoryUse use) {
+    const SpellCheckAllocator *a = sc ? &sc->allocator : &g_heapAllocator;
+    return a->reallocate(a->context, block, size, use);
+}
+
+static void MemFree(SpellChecker *sc, void *block, SpellCheckMemoryUse use) {
+    if (!block) return;
+    const SpellCheckAllocator *a = sc ? &sc->allocator : &g_heapAllocator;
+    a->release(a->context, block, use);
+}
+
+static const char * const g_memoryUseNames[SPELLCHECK_MEMORY_USE_COUNT] = {
+    "checker", "dictionary", "frequency", "load", "check", "suggest", "usage"
+};
+
+// Header in front of every tracked block, 16 bytes so blocks keep the
+// alignment malloc gives
+typedef union {
+    struct {
+        size_t size;
+        SpellCheckMemoryUse use;
+    } info;
+    char align[16];
+} TrackedBlock;
+
+// Move 'removed' bytes out of and 'added' bytes into one set of counters.
+// Caller holds the tracker's lock.
+static void AdjustCounters(SpellCheckMemoryCounters *counters, size_t removed, size_t added) {
+    counters->liveBytes = counters->liveBytes - removed + added;
+    if (counters->liveBytes > counters->peakBytes) counters->peakBytes = counters->liveBytes;
+}
+
+// Count an allocation made inside a Check pass. Caller holds the lock.
+static void NoteCheckPathAllocation(SpellCheckMemoryTracker *tracker, size_t size, SpellCheckMemoryUse use) {
+    if ((DWORD)InterlockedCompareExchange(&tracker->checkPassThread, 0, 0) != GetCurrentThreadId()) return;
+    
+    tracker->stats.checkPassAllocations++;
+    if (tracker->reportCheckPath) {
+        char message[128];
+        snprintf(message, sizeof(message), "SpellChecker: %lu bytes (%s) allocated during a check pass\n",
+                 (unsigned long)size, g_memoryUseNames[use]);
+        OutputDebugString(message);
+    }
+}
+
+static void* TrackerAllocate(void *context, size_t size, SpellCheckMemoryUse use) {
+    SpellCheckMemoryTracker *tracker = (SpellCheckMemoryTracker *)context;
+    if (size > (size_t)-1 - sizeof(TrackedBlock)) return NULL;
+    
+    TrackedBlock *block = (TrackedBlock *)malloc(sizeof(TrackedBlock) + size);
+    if (!block) return NULL;
+    block->info.size = size;
+    block->info.use = use;
+    
+    EnterCriticalSection(&tracker->lock);
+    AdjustCounters(&tracker->stats.uses[use], 0, size);
+    AdjustCounters(&tracker->stats.total, 0, size);
+    tracker->stats.uses[use].allocations++;
+    tracker->stats.total.allocations++;
+    NoteCheckPathAllocation(tracker, size, use);
+    LeaveCriticalSection(&tracker->lock);
+    return block + 1;
+}
+
+// A block keeps the use it was allocated for
+static void* TrackerReallocate(void *context, void *block, size_t size, SpellCheckMemoryUse use) {
+    SpellCheckMemoryTracker *tracker = (SpellCheckMemoryTracker *)context;
+    if (!block) return TrackerAllocate(context, size, use);
+    if (size > (size_t)-1 - sizeof(TrackedBlock)) return NULL;
+    
+    TrackedBlock *header = (TrackedBlock *)block - 1;
+    size_t oldSize = header->info.size;
+    TrackedBlock *moved = (TrackedBlock *)realloc(header, sizeof(TrackedBlock) + size);
+    if (!moved) return NULL;
+    moved->info.size = size;
+    use = moved->info.use;
+    
+    EnterCriticalSection(&tracker->lock);
+    AdjustCounters(&tracker->stats.uses[use], oldSize, size);
+    AdjustCounters(&tracker->stats.total, oldSize, size);
+    tracker->stats.uses[use].allocations++;
+    tracker->stats.total.allocations++;
+    NoteCheckPathAllocation(tracker, size, use);
+    LeaveCriticalSection(&tracker->lock);
+    return moved + 1;
+}
 
-// Case-insensitive comparator for qsort
+static void TrackerRelease(void *context, void *block, SpellCheckMemoryUse use) {
+    SpellCheckMemoryTracker *tracker = (SpellCheckMemoryTracker *)context;
+    TrackedBlock *header = (TrackedBlock *)block - 1;
+    size_t size = header->info.size;
+    use = header->info.use;
+    free(header);
+    
+    EnterCriticalSection(&tracker->lock);
+    AdjustCounters(&tracker->stats.uses[use], size, 0);
+    AdjustCounters(&tracker->stats.total, size, 0);
+    tracker->stats.uses[use].frees++;
+    tracker->stats.total.frees++;
+    LeaveCriticalSection(&tracker->lock);
+}
+
+// Checks on other threads may start and end meanwhile; a pass ending only
+// clears the thread if it is still its own
+static void TrackerCheckPass(void *context, BOOL running) {
+    SpellCheckMemoryTracker *tracker = (SpellCheckMemoryTracker *)context;
+    LONG thread = (LONG)GetCurrentThreadId();
+    if (!running) {
+        InterlockedCompareExchange(&tracker->checkPassThread, 0, thread);
+        return;
+    }
+    InterlockedExchange(&tracker->checkPassThread, thread);
+    EnterCriticalSection(&tracker->lock);
+    tracker->stats.checkPasses++;
+    LeaveCriticalSection(&tracker->lock);
+}
+
+void SpellChecker_InitMemoryTracker(SpellCheckMemoryTracker *tracker, BOOL reportCheckPath) {
+    if (!tracker) return;
+    memset(tracker, 0, sizeof(SpellCheckMemoryTracker));
+    InitializeCriticalSection(&tracker->lock);
+    tracker->allocator.allocate = TrackerAllocate;
+    tracker->allocator.reallocate = TrackerReallocate;
+    tracker->allocator.release = TrackerRelease;
+    tracker->allocator.checkPass = TrackerCheckPass;
+    tracker->allocator.context = tracker;
+    tracker->reportCheckPath = reportCheckPath;
+}
+
+void SpellChecker_DeleteMemoryTracker(SpellCheckMemoryTracker *tracker) {
+    if (!tracker) return;
+    DeleteCriticalSection(&tracker->lock);
+}
+
+const char* SpellChecker_GetMemoryUseName(SpellCheckMemoryUse use) {
+    return use >= 0 && use < SPELLCHECK_MEMORY_USE_COUNT ? g_memoryUseNames[use] : "?";
+}
+
+void SpellChecker_GetMemoryStats(SpellCheckMemoryTracker *tracker, SpellCheckMemoryStats *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(SpellCheckMemoryStats));
+    if (!tracker) return;
+    
+    EnterCriticalSection(&tracker->lock);
+    *stats = tracker->stats;
+    LeaveCriticalSection(&tracker->lock);
+}
+
+// Free a word list from CopyWordList (below) with the same owner
+static void FreeWordList(SpellChecker *owner, char **words, int count) {
+    if (!words) return;
+    for (int i = 0; i < count; i++) {
+        MemFree(owner, words[i], SPELLCHECK_MEMORY_SUGGEST);
+    }
+    MemFree(owner, words, SPELLCHECK_MEMORY_SUGGEST);
+}
+
+// Dictionary entries are one allocation holding "folded\0display\0": the
+// case-folded form comes first so sorting and lookups are plain strcmp,
+// and the spelling as written follows for suggestions and saving
+static const char* DisplayWord(const char *entry) {
+    return entry + strlen(entry) + 1;
+}
+
+// Comparator for qsort over dictionary entries (folded, so byte order)
 // Used for sorting both main and user dictionaries
 static int DictionaryComparator(const void *a, const void *b) {
-    const char *s1 = *(const char * const *)a;
-    const char *s2 = *(const char * const *)b;
+    return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+// Folded code points of a word, at most MAX_DICTIONARY_WORD of them
+static int FoldedCodePoints(const char *word, unsigned int *out) {
+    size_t len = strlen(word);
+    size_t i = 0;
+    int count = 0;
+    while (i < len && count < MAX_DICTIONARY_WORD) {
+        unsigned int codePoint;
+        i += Utf8_Decode((const unsigned char *)word + i, len - i, &codePoint);
+        out[count++] = Utf8_FoldCodePoint(codePoint);
+    }
+    return count;
+}
+
+// Levenshtein distance in characters, ignoring case like every lookup
+static int LevenshteinDistance(const char *s1, const char *s2) {
+    unsigned int a[MAX_DICTIONARY_WORD], b[MAX_DICTIONARY_WORD];
+    int len1 = FoldedCodePoints(s1, a);
+    int len2 = FoldedCodePoints(s2, b);
+    
+    if (len1 == 0) return len2;
+    if (len2 == 0) return len1;
+    
+    // One row of the shorter word's length
+    const unsigned int *c1 = a, *c2 = b;
+    if (len2 > len1) {
+        c1 = b; c2 = a;
+        int n = len1; len1 = len2; len2 = n;
+    }
+    int d[MAX_DICTIONARY_WORD + 1];
+    
+    for (int i = 0; i <= len2; i++) {
+        d[i] = i;
+    }
+    
+    for (int i = 1; i <= len1; i++) {
+        int prev_diag = i - 1;
+        d[0] = i;
+        
+        for (int j = 1; j <= len2; j++) {
+            int cost = c1[i - 1] == c2[j - 1] ? 0 : 1;
+            int temp = d[j];
+            d[j] = (d[j] + 1 < d[j - 1] + 1) ? (d[j] + 1) : (d[j - 1] + 1);
+            d[j] = (d[j] < prev_diag + cost) ? d[j] : (prev_diag + cost);
+            prev_diag = temp;
+        }
+    }
+    
+    return d[len2];
+}
+
+// Case-folded copy of a word; FALSE if it doesn't fit
+static BOOL FoldWord(const char *word, char *folded, int foldedLen) {
+    size_t len = strlen(word);
+    if (len >= (size_t)foldedLen) return FALSE;
+    Utf8_Fold(word, len, folded);
+    return TRUE;
+}
+
+// Case-insensitive comparison of two words as written, for the paths that
+// don't have folded forms at hand (long words compare on their first 255
+// bytes)
+static int CompareFolded(const char *s1, const char *s2) {
+    char folded1[256], folded2[256];
+    size_t len1 = Utf8_TruncateLength(s1, strlen(s1), 255);
+    size_t len2 = Utf8_TruncateLength(s2, strlen(s2), 255);
+    Utf8_Fold(s1, len1, folded1);
+    Utf8_Fold(s2, len2, folded2);
+    return strcmp(folded1, folded2);
+}
+
+// Binary search for a folded word
+static BOOL BinarySearchDictionary(Dictionary *dict, const char *folded) {
+    int left = 0, right = dict->count - 1;
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        int cmp = strcmp(dict->words[mid], folded);
+        if (cmp == 0) return TRUE;
+        if (cmp < 0) left = mid + 1;
+        else right = mid - 1;
+    }
+    return FALSE;
+}
+
+// FNV-1a over a folded word
+static unsigned int FoldedHash(const char *folded) {
+    unsigned int h = 2166136261u;
+    for (; *folded; folded++) {
+        h ^= (unsigned char)*folded;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Number of words compiled into the binary (0 unless built with -Embedded)
+static unsigned int EmbeddedWordCount(void) {
+#ifdef SPELLCHECK_EMBEDDED_DICTIONARY
+    return g_embeddedDictionary.wordCount;
+#else
+    return 0;
+#endif
+}
+
+// Word stored in an embedded slot, for callers that scan every word
+static const char* EmbeddedWordAt(unsigned int slot) {
+#ifdef SPELLCHECK_EMBEDDED_DICTIONARY
+    return g_embeddedDictionary.pool + g_embeddedDictionary.offsets[slot];
+#else
+    (void)slot;
+    return NULL;
+#endif
+}
+
+// Single-probe membership test against the embedded perfect hash. The
+// pool keeps the original spelling, so the one candidate is folded to
+// compare (folding never changes the length).
+static BOOL EmbeddedContains(const char *folded) {
+#ifdef SPELLCHECK_EMBEDDED_DICTIONARY
+    const EmbeddedDictionary *ed = &g_embeddedDictionary;
+    int len = strlen(folded);
+    unsigned int bucket = EmbeddedDictHash(folded, len, 0) % ed->bucketCount;
+    unsigned int slot = EmbeddedDictHash(folded, len, ed->seeds[bucket]) % ed->wordCount;
+    if (ed->lengths[slot] != len) return FALSE;
+    
+    char candidate[256];
+    Utf8_Fold(ed->pool + ed->offsets[slot], len, candidate);
+    return memcmp(candidate, folded, len) == 0;
+#else
+    (void)folded;
+    return FALSE;
+#endif
+}
+
+// Embedded word at position 'index' in alphabetical order, for prefix scans
+static const char* EmbeddedSortedWordAt(unsigned int index) {
+#ifdef SPELLCHECK_EMBEDDED_DICTIONARY
+    return EmbeddedWordAt(g_embeddedDictionary.sortedSlots[index]);
+#else
+    (void)index;
+    return NULL;
+#endif
+}
+
+BOOL SpellChecker_HasEmbeddedDictionary(void) {
+    return EmbeddedWordCount() > 0;
+}
+
+static BOOL InDictionaryPool(const Dictionary *dict, const char *entry) {
+    for (const DictionaryPool *pool = dict->pools; pool; pool = pool->next) {
+        if (entry >= pool->data && entry < pool->data + pool->size) return TRUE;
+    }
+    return FALSE;
+}
+
+// Free one entry unless it lives in a pool
+static void FreeDictionaryEntry(SpellChecker *sc, const Dictionary *dict, char *entry) {
+    if (!InDictionaryPool(dict, entry)) MemFree(sc, entry, SPELLCHECK_MEMORY_DICTIONARY);
+}
+
+// Free every word owned by a dictionary, its pools and its pointer array
+static void FreeDictionary(SpellChecker *sc, Dictionary *dict) {
+    for (int i = 0; i < dict->count; i++) {
+        FreeDictionaryEntry(sc, dict, dict->words[i]);
+    }
+    while (dict->pools) {
+        DictionaryPool *next = dict->pools->next;
+        MemFree(sc, dict->pools->data, SPELLCHECK_MEMORY_DICTIONARY);
+        MemFree(sc, dict->pools, SPELLCHECK_MEMORY_DICTIONARY);
+        dict->pools = next;
+    }
+    MemFree(sc, dict->words, SPELLCHECK_MEMORY_DICTIONARY);
+    dict->words = NULL;
+    dict->count = 0;
+    dict->capacity = 0;
+}
+
+// Build a "folded\0display\0" entry for 'len' bytes of 'word'
+static char* NewDictionaryEntry(SpellChecker *sc, const char *word, int len, SpellCheckMemoryUse use) {
+    char *entry = (char *)MemAlloc(sc, 2 * (len + 1), use);
+    if (!entry) return NULL;
+    Utf8_Fold(word, len, entry);
+    memcpy(entry + len + 1, word, len);
+    entry[2 * len + 1] = '\0';
+    return entry;
+}
+
+// Append an entry for 'word' to a dictionary (no sorting)
+static BOOL AppendDictionaryWord(SpellChecker *sc, Dictionary *dict, const char *word, int len) {
+    if (dict->count >= dict->capacity) {
+        int newCapacity = dict->capacity > 0 ? dict->capacity * 2 : INITIAL_DICT_CAPACITY;
+        char **newWords = (char **)MemRealloc(sc, dict->words, newCapacity * sizeof(char *),
+                                              SPELLCHECK_MEMORY_DICTIONARY);
+        if (!newWords) return FALSE;
+        dict->words = newWords;
+        dict->capacity = newCapacity;
+    }
+    
+    dict->words[dict->count] = NewDictionaryEntry(sc, word, len, SPELLCHECK_MEMORY_DICTIONARY);
+    if (!dict->words[dict->count]) return FALSE;
+    dict->count++;
+    return TRUE;
+}
+
+// Entries in key order: the folded form, then the spelling as written,
+// so entries that differ only in case sort deterministically and exact
+// duplicates end up side by side
+static int CompareEntries(const char *a, const char *b) {
+    int cmp = strcmp(a, b);
+    return cmp != 0 ? cmp : strcmp(DisplayWord(a), DisplayWord(b));
+}
+
+// MSD radix sort on the key "folded\0display\0" read as one string from
+// byte 'depth' on; 'aux' is scratch of the same size. Folding keeps the
+// length, so the first NUL of every entry in a bucket is at the same
+// depth, and a second one means the entries are identical.
+static void SortEntries(char **words, char **aux, int count, int depth, BOOL inDisplay) {
+    if (count < SORT_INSERTION_CUTOFF) {
+        for (int i = 1; i < count; i++) {
+            char *entry = words[i];
+            int j = i;
+            while (j > 0 && CompareEntries(words[j - 1], entry) > 0) {
+                words[j] = words[j - 1];
+                j--;
+            }
+            words[j] = entry;
+        }
+        return;
+    }
+    
+    int counts[256] = {0}, starts[256];
+    for (int i = 0; i < count; i++) {
+        counts[(unsigned char)words[i][depth]]++;
+    }
+    int total = 0;
+    for (int b = 0; b < 256; b++) {
+        starts[b] = total;
+        total += counts[b];
+    }
+    for (int i = 0; i < count; i++) {
+        aux[starts[(unsigned char)words[i][depth]]++] = words[i];
+    }
+    memcpy(words, aux, count * sizeof(char *));
+    
+    int start = 0;
+    for (int b = 0; b < 256; start += counts[b], b++) {
+        if (counts[b] < 2) continue;
+        if (b == 0 && inDisplay) continue;
+        SortEntries(words + start, aux + start, counts[b], depth + 1, inDisplay || b == 0);
+    }
+}
+
+// First two key bytes; a one-letter word's second is its NUL
+static unsigned int FirstKeyBytes(const char *entry) {
+    return ((unsigned int)(unsigned char)entry[0] << 8) | (entry[0] ? (unsigned char)entry[1] : 0);
+}
+
+enum { SORT_COUNT, SORT_SCATTER, SORT_BUCKETS };
+
+typedef struct {
+    int phase;
+    char **words;
+    char **aux;
+    int from;                   // The thread's slice for the first pass
+    int to;
+    int *offsets;               // Its slice's bucket counts, then where they go
+    const ULONGLONG *buckets;   // Shared: first-pass buckets to finish, largest first
+    const int *bucketStarts;
+    const int *bucketCounts;
+    int bucketCount;
+    volatile LONG *nextBucket;
+} SortWorker;
+
+// One phase of the parallel sort: count or scatter a slice on the first
+// two key bytes, or finish whole buckets, claiming the next until none
+// are left
+static DWORD WINAPI SortThread(LPVOID param) {
+    SortWorker *worker = (SortWorker *)param;
+    switch (worker->phase) {
+    case SORT_COUNT:
+        for (int i = worker->from; i < worker->to; i++) {
+            worker->offsets[FirstKeyBytes(worker->words[i])]++;
+        }
+        break;
+    case SORT_SCATTER:
+        for (int i = worker->from; i < worker->to; i++) {
+            worker->aux[worker->offsets[FirstKeyBytes(worker->words[i])]++] = worker->words[i];
+        }
+        break;
+    case SORT_BUCKETS:
+        for (;;) {
+            LONG index = InterlockedIncrement(worker->nextBucket);
+            if (index >= worker->bucketCount) break;
+            int bucket = (int)(worker->buckets[index] & 0xFFFF);
+            int start = worker->bucketStarts[bucket];
+            // Sorted in place in 'aux', which holds the scattered entries
+            SortEntries(worker->aux + start, worker->words + start, worker->bucketCounts[bucket], 2,
+                        (bucket & 0xFF) == 0);
+        }
+        break;
+    }
+    return 0;
+}
+
+// Run 'proc' on every context, the first on the calling thread, and wait
+// for all of them. A thread that can't be started only costs speed.
+static void RunOnThreads(LPTHREAD_START_ROUTINE proc, void *contexts, size_t contextSize, int count) {
+    HANDLE threads[LOAD_MAX_THREADS];
+    BOOL started[LOAD_MAX_THREADS];
+    for (int i = 1; i < count; i++) {
+        threads[i] = CreateThread(NULL, 0, proc, (char *)contexts + i * contextSize, 0, NULL);
+        started[i] = threads[i] != NULL;
+    }
+    proc(contexts);
+    for (int i = 1; i < count; i++) {
+        if (started[i]) {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        } else {
+            proc((char *)contexts + i * contextSize);
+        }
+    }
+}
+
+static int LoadThreadCount(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+    if (count < 1) count = 1;
+    return count > LOAD_MAX_THREADS ? LOAD_MAX_THREADS : count;
+}
+
+// Buckets to finish as (size << 16 | bucket), largest first, so no thread
+// is left finishing a big one alone
+static int CompareBucketSizes(const void *a, const void *b) {
+    ULONGLONG x = *(const ULONGLONG *)a, y = *(const ULONGLONG *)b;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// Sort a dictionary's entries and drop exact duplicates. Large lists are
+// split on their first two key bytes by all threads, one slice each, and
+// the buckets are then finished in parallel.
+static BOOL SortDictionary(SpellChecker *sc, Dictionary *dict) {
+    int count = dict->count;
+    if (count < 2) return TRUE;
+    
+    char **aux = (char **)MemAlloc(sc, count * sizeof(char *), SPELLCHECK_MEMORY_LOAD);
+    if (!aux) return FALSE;
+    
+    int threadCount = LoadThreadCount();
+    if (threadCount > count / SORT_MIN_PER_THREAD) threadCount = count / SORT_MIN_PER_THREAD;
+    if (threadCount <= 1) {
+        SortEntries(dict->words, aux, count, 0, FALSE);
+    } else {
+        SortWorker workers[LOAD_MAX_THREADS];
+        int *offsets = (int *)MemCalloc(sc, (size_t)threadCount * SORT_FIRST_BUCKETS, sizeof(int),
+                                        SPELLCHECK_MEMORY_LOAD);
+        int *bucketStarts = (int *)MemAlloc(sc, SORT_FIRST_BUCKETS * sizeof(int), SPELLCHECK_MEMORY_LOAD);
+        int *bucketCounts = (int *)MemCalloc(sc, SORT_FIRST_BUCKETS, sizeof(int), SPELLCHECK_MEMORY_LOAD);
+        ULONGLONG *buckets = (ULONGLONG *)MemAlloc(sc, SORT_FIRST_BUCKETS * sizeof(ULONGLONG), SPELLCHECK_MEMORY_LOAD);
+        if (!offsets || !bucketStarts || !bucketCounts || !buckets) {
+            MemFree(sc, offsets, SPELLCHECK_MEMORY_LOAD);
+            MemFree(sc, bucketStarts, SPELLCHECK_MEMORY_LOAD);
+            MemFree(sc, bucketCounts, SPELLCHECK_MEMORY_LOAD);
+            MemFree(sc, buckets, SPELLCHECK_MEMORY_LOAD);
+            MemFree(sc, aux, SPELLCHECK_MEMORY_LOAD);
+            return FALSE;
+        }
+        
+        volatile LONG nextBucket = -1;
+        memset(workers, 0, sizeof(workers));
+        for (int t = 0; t < threadCount; t++) {
+            workers[t].phase = SORT_COUNT;
+            workers[t].words = dict->words;
+            workers[t].aux = aux;
+            workers[t].from = (int)((long long)count * t / threadCount);
+            workers[t].to = (int)((long long)count * (t + 1) / threadCount);
+            workers[t].offsets = offsets + (size_t)t * SORT_FIRST_BUCKETS;
+            workers[t].buckets = buckets;
+            workers[t].bucketStarts = bucketStarts;
+            workers[t].bucketCounts = bucketCounts;
+            workers[t].nextBucket = &nextBucket;
+        }
+        RunOnThreads(SortThread, workers, sizeof(SortWorker), threadCount);
+        
+        // Each slice's entries of a bucket follow the previous slice's
+        int total = 0, bucketCount = 0;
+        for (int b = 0; b < SORT_FIRST_BUCKETS; b++) {
+            bucketStarts[b] = total;
+            for (int t = 0; t < threadCount; t++) {
+                int sliceCount = workers[t].offsets[b];
+                workers[t].offsets[b] = total;
+                total += sliceCount;
+            }
+            bucketCounts[b] = total - bucketStarts[b];
+            
+            // Entries of bucket 0 are all empty, so already in order
+            if (bucketCounts[b] > 1 && b > 0xFF) buckets[bucketCount++] = (ULONGLONG)bucketCounts[b] << 16 | b;
+        }
+        qsort(buckets, bucketCount, sizeof(ULONGLONG), CompareBucketSizes);
+        
+        for (int t = 0; t < threadCount; t++) {
+            workers[t].phase = SORT_SCATTER;
+        }
+        RunOnThreads(SortThread, workers, sizeof(SortWorker), threadCount);
+        for (int t = 0; t < threadCount; t++) {
+            workers[t].phase = SORT_BUCKETS;
+            workers[t].bucketCount = bucketCount;
+        }
+        RunOnThreads(SortThread, workers, sizeof(SortWorker), threadCount);
+        memcpy(dict->words, aux, count * sizeof(char *));
+        
+        MemFree(sc, offsets, SPELLCHECK_MEMORY_LOAD);
+        MemFree(sc, bucketStarts, SPELLCHECK_MEMORY_LOAD);
+        MemFree(sc, bucketCounts, SPELLCHECK_MEMORY_LOAD);
+        MemFree(sc, buckets, SPELLCHECK_MEMORY_LOAD);
+    }
+    MemFree(sc, aux, SPELLCHECK_MEMORY_LOAD);
+    
+    int kept = 1;
+    for (int i = 1; i < count; i++) {
+        if (CompareEntries(dict->words[kept - 1], dict->words[i]) == 0) {
+            FreeDictionaryEntry(sc, dict, dict->words[i]);
+            continue;
+        }
+        dict->words[kept++] = dict->words[i];
+    }
+    dict->count = kept;
+    return TRUE;
+}
+
+// One line-aligned piece of a word file, parsed by one thread
+typedef struct {
+    SpellChecker *sc;
+    const char *text;
+    size_t length;
+    char *out;                  // Its region of the pool
+    BOOL skipComments;
+    char **entries;
+    int count;
+    int capacity;
+    BOOL failed;
+} ParseChunk;
+
+// Build an entry in the pool for every word line of the chunk. A line
+// takes at most twice its length with the newline, so a chunk starting at
+// byte n of the file writes from byte 2n of the pool without overlap.
+static DWORD WINAPI ParseChunkThread(LPVOID param) {
+    ParseChunk *chunk = (ParseChunk *)param;
+    size_t pos = 0;
+    
+    while (pos < chunk->length) {
+        const char *word = chunk->text + pos;
+        const char *newline = (const char *)memchr(word, '\n', chunk->length - pos);
+        size_t lineLength = newline ? (size_t)(newline - word) : chunk->length - pos;
+        pos += lineLength + (newline ? 1 : 0);
+        
+        // Remove trailing whitespace
+        size_t len = lineLength;
+        while (len > 0 && isspace((unsigned char)word[len - 1])) len--;
+        
+        if (len == 0 || len > MAX_DICTIONARY_WORD) continue;
+        if (chunk->skipComments && word[0] == '#') continue;
+        
+        if (chunk->count >= chunk->capacity) {
+            int newCapacity = chunk->capacity > 0 ? chunk->capacity * 2 : 1024;
+            char **newEntries = (char **)MemRealloc(chunk->sc, chunk->entries, newCapacity * sizeof(char *),
+                                                    SPELLCHECK_MEMORY_LOAD);
+            if (!newEntries) {
+                chunk->failed = TRUE;
+                return 0;
+            }
+            chunk->entries = newEntries;
+            chunk->capacity = newCapacity;
+        }
+        
+        char *entry = chunk->out;
+        Utf8_Fold(word, len, entry);
+        memcpy(entry + len + 1, word, len);
+        entry[2 * len + 1] = '\0';
+        chunk->out += 2 * (len + 1);
+        chunk->entries[chunk->count++] = entry;
+    }
+    return 0;
+}
+
+// Read a one-word-per-line file into a dictionary and sort it. Large
+// files are parsed in line-aligned chunks on several threads, into one
+// pool rather than an allocation per word.
+// Returns FALSE if the file cannot be opened or memory runs out.
+static BOOL LoadWordFile(SpellChecker *sc, Dictionary *dict, const char *filePath, BOOL skipComments) {
+    FILE *file = fopen(filePath, "rb");
+    if (!file) {
+        return FALSE;
+    }
+    
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) size = ftell(file);
+    if (size < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return FALSE;
+    }
+    char *text = (char *)MemAlloc(sc, size + 1, SPELLCHECK_MEMORY_LOAD);
+    size_t length = text ? fread(text, 1, size, file) : 0;
+    fclose(file);
+    
+    DictionaryPool *pool = (DictionaryPool *)MemCalloc(sc, 1, sizeof(DictionaryPool), SPELLCHECK_MEMORY_DICTIONARY);
+    if (pool) {
+        pool->size = 2 * length + 2;
+        pool->data = (char *)MemAlloc(sc, pool->size, SPELLCHECK_MEMORY_DICTIONARY);
+    }
+    if (!text || !pool || !pool->data) {
+        if (pool) MemFree(sc, pool->data, SPELLCHECK_MEMORY_DICTIONARY);
+        MemFree(sc, pool, SPELLCHECK_MEMORY_DICTIONARY);
+        MemFree(sc, text, SPELLCHECK_MEMORY_LOAD);
+        return FALSE;
+    }
+    
+    // Editors saving as UTF-8 may start the file with a byte order mark
+    size_t start = length >= 3 && memcmp(text, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    
+    int chunkCount = LoadThreadCount();
+    if ((size_t)chunkCount > (length - start) / LOAD_MIN_CHUNK) chunkCount = (int)((length - start) / LOAD_MIN_CHUNK);
+    if (chunkCount < 1) chunkCount = 1;
+    
+    ParseChunk chunks[LOAD_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    size_t chunkStart = start;
+    for (int c = 0; c < chunkCount; c++) {
+        size_t end = length;
+        if (c < chunkCount - 1) {
+            end = start + (length - start) / chunkCount * (c + 1);
+            if (end < chunkStart) end = chunkStart;
+            const char *newline = (const char *)memchr(text + end, '\n', length - end);
+            end = newline ? (size_t)(newline - text) + 1 : length;
+        }
+        chunks[c].sc = sc;
+        chunks[c].text = text + chunkStart;
+        chunks[c].length = end - chunkStart;
+        chunks[c].out = pool->data + 2 * chunkStart;
+        chunks[c].skipComments = skipComments;
+        chunkStart = end;
+    }
+    RunOnThreads(ParseChunkThread, chunks, sizeof(ParseChunk), chunkCount);
+    MemFree(sc, text, SPELLCHECK_MEMORY_LOAD);
+    
+    int added = 0;
+    BOOL ok = TRUE;
+    for (int c = 0; c < chunkCount; c++) {
+        if (chunks[c].failed) ok = FALSE;
+        added += chunks[c].count;
+    }
+    if (ok && dict->count + added > dict->capacity) {
+        char **newWords = (char **)MemRealloc(sc, dict->words, (dict->count + added) * sizeof(char *),
+                                              SPELLCHECK_MEMORY_DICTIONARY);
+        if (newWords) {
+            dict->words = newWords;
+            dict->capacity = dict->count + added;
+        } else {
+            ok = FALSE;
+        }
+    }
+    for (int c = 0; c < chunkCount; c++) {
+        if (ok && chunks[c].count > 0) {
+            memcpy(dict->words + dict->count, chunks[c].entries, chunks[c].count * sizeof(char *));
+            dict->count += chunks[c].count;
+        }
+        MemFree(sc, chunks[c].entries, SPELLCHECK_MEMORY_LOAD);
+    }
+    
+    // The pool belongs to the dictionary from here on, so a failed sort
+    // leaves it whole
+    if (!ok || added == 0) {
+        MemFree(sc, pool->data, SPELLCHECK_MEMORY_DICTIONARY);
+        MemFree(sc, pool, SPELLCHECK_MEMORY_DICTIONARY);
+        return ok;
+    }
+    pool->next = dict->pools;
+    dict->pools = pool;
+    
+    // Sort for binary search
+    return SortDictionary(sc, dict);
+}
+
+static int CompareFrequencies(const void *a, const void *b) {
+    return strcmp(((const WordFrequency *)a)->word, ((const WordFrequency *)b)->word);
+}
+
+static void FreeFrequencies(SpellChecker *sc, DictionarySnapshot *snap) {
+    for (int i = 0; i < snap->frequencyCount; i++) {
+        MemFree(sc, snap->frequencies[i].word, SPELLCHECK_MEMORY_FREQUENCY);
+    }
+    MemFree(sc, snap->frequencies, SPELLCHECK_MEMORY_FREQUENCY);
+    snap->frequencies = NULL;
+    snap->frequencyCount = 0;
+}
+
+// Read a frequency list into a snapshot, replacing its table. Lines are
+// "word count", or a bare word counted by its rank among the lines.
+// Words listed twice keep the larger count.
+static BOOL LoadFrequencyFile(SpellChecker *sc, DictionarySnapshot *snap, const char *filePath) {
+    FILE *file = fopen(filePath, "r");
+    if (!file) {
+        return FALSE;
+    }
+    
+    WordFrequency *entries = NULL;
+    int count = 0, capacity = 0;
+    DWORD rank = 0;
+    BOOL ok = TRUE;
+    char line[256];
+    BOOL firstLine = TRUE;
+    while (ok && fgets(line, sizeof(line), file)) {
+        char *word = line;
+        if (firstLine && memcmp(word, "\xEF\xBB\xBF", 3) == 0) word += 3;
+        firstLine = FALSE;
+        
+        int len = strlen(word);
+        while (len > 0 && isspace((unsigned char)word[len - 1])) {
+            word[--len] = '\0';
+        }
+        if (len == 0 || word[0] == '#') continue;
+        rank++;
+        
+        // A trailing number after whitespace is the count
+        DWORD frequency = SPELLCHECK_RANK_SCALE / rank;
+        int split = len;
+        while (split > 0 && isdigit((unsigned char)word[split - 1])) split--;
+        if (split < len && split > 0 && isspace((unsigned char)word[split - 1])) {
+            frequency = strtoul(word + split, NULL, 10);
+            len = split - 1;
+            while (len > 0 && isspace((unsigned char)word[len - 1])) len--;
+            if (len == 0) continue;
+        }
+        if (frequency == 0) frequency = 1;
+        
+        if (count >= capacity) {
+            int newCapacity = capacity > 0 ? capacity * 2 : INITIAL_DICT_CAPACITY;
+            WordFrequency *newEntries = (WordFrequency *)MemRealloc(sc, entries, newCapacity * sizeof(WordFrequency),
+                                                                    SPELLCHECK_MEMORY_FREQUENCY);
+            if (!newEntries) {
+                ok = FALSE;
+                break;
+            }
+            entries = newEntries;
+            capacity = newCapacity;
+        }
+        entries[count].word = (char *)MemAlloc(sc, len + 1, SPELLCHECK_MEMORY_FREQUENCY);
+        if (!entries[count].word) {
+            ok = FALSE;
+            break;
+        }
+        Utf8_Fold(word, len, entries[count].word);
+        entries[count].word[len] = '\0';
+        entries[count].count = frequency;
+        count++;
+    }
+    fclose(file);
+    
+    if (!ok) {
+        for (int i = 0; i < count; i++) MemFree(sc, entries[i].word, SPELLCHECK_MEMORY_FREQUENCY);
+        MemFree(sc, entries, SPELLCHECK_MEMORY_FREQUENCY);
+        return FALSE;
+    }
+    
+    // Sort for binary search, merging repeats
+    if (count > 0) qsort(entries, count, sizeof(WordFrequency), CompareFrequencies);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique > 0 && strcmp(entries[unique - 1].word, entries[i].word) == 0) {
+            if (entries[i].count > entries[unique - 1].count) entries[unique - 1].count = entries[i].count;
+            MemFree(sc, entries[i].word, SPELLCHECK_MEMORY_FREQUENCY);
+        } else {
+            entries[unique++] = entries[i];
+        }
+    }
     
-    while (*s1 && *s2) {
-        int c1 = tolower((unsigned char)*s1);
-        int c2 = tolower((unsigned char)*s2);
-        if (c1 != c2) return c1 - c2;
-        s1++;
-        s2++;
+    FreeFrequencies(sc, snap);
+    snap->frequencies = entries;
+    snap->frequencyCount = unique;
+    return TRUE;
+}
+
+// Frequency of a folded word in a snapshot's table (0 if not listed)
+static DWORD LookupFrequency(const DictionarySnapshot *snap, const char *folded) {
+    int left = 0, right = snap->frequencyCount - 1;
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        int cmp = strcmp(snap->frequencies[mid].word, folded);
+        if (cmp == 0) return snap->frequencies[mid].count;
+        if (cmp < 0) left = mid + 1;
+        else right = mid - 1;
+    }
+    return 0;
+}
+
+// Weights of 'count' words from a snapshot's frequency table, or NULL
+// when it has none (the index then keeps alphabetical order)
+static DWORD* LookupWeights(SpellChecker *sc, const DictionarySnapshot *snap, const char * const *words, int count) {
+    if (snap->frequencyCount == 0) return NULL;
+    
+    DWORD *weights = (DWORD *)MemAlloc(sc, (count + 1) * sizeof(DWORD), SPELLCHECK_MEMORY_SUGGEST);
+    if (!weights) return NULL;
+    for (int i = 0; i < count; i++) {
+        char folded[256];
+        weights[i] = FoldWord(words[i], folded, sizeof(folded)) ? LookupFrequency(snap, folded) : 0;
+    }
+    return weights;
+}
+
+static DictionarySnapshot* CreateSnapshot(SpellChecker *sc) {
+    DictionarySnapshot *snap = (DictionarySnapshot *)MemCalloc(sc, 1, sizeof(DictionarySnapshot),
+                                                               SPELLCHECK_MEMORY_CHECKER);
+    return snap;
+}
+
+static void DestroySnapshot(SpellChecker *sc, DictionarySnapshot *snap) {
+    if (!snap) return;
+    SuggestIndex_Destroy(snap->mainIndex);
+    SuggestIndex_Destroy(snap->embeddedIndex);
+    FreeDictionary(sc, &snap->mainDictionary);
+    for (int i = 0; i < SPELLCHECK_MAX_PROFILES; i++) {
+        FreeDictionary(sc, &snap->profileWords[i].glossary);
+        FreeDictionary(sc, &snap->profileWords[i].userDictionary);
+    }
+    FreeFrequencies(sc, snap);
+    Dawg_Destroy(snap->mainDawg);
+    MemFree(sc, snap, SPELLCHECK_MEMORY_CHECKER);
+}
+
+// Replace the sorted main word array with a DAWG. On failure the array is
+// kept, so the snapshot stays usable with the default backend.
+static void ConvertMainToDawg(SpellChecker *sc, DictionarySnapshot *snap) {
+    if (snap->mainDawg || snap->mainDictionary.count == 0) return;
+    
+    Dawg *dawg = Dawg_Build(snap->mainDictionary.words, snap->mainDictionary.count);
+    if (!dawg) return;
+    
+    snap->mainDawg = dawg;
+    FreeDictionary(sc, &snap->mainDictionary);
+}
+
+// Finish a snapshot's main dictionary for the selected backend. The
+// suggestion indexes depend on the words and frequencies, so they are
+// dropped here and built again on first use.
+static void PrepareMainDictionary(SpellChecker *sc, DictionarySnapshot *snap) {
+    SuggestIndex_Destroy(snap->mainIndex);
+    snap->mainIndex = NULL;
+    SuggestIndex_Destroy(snap->embeddedIndex);
+    snap->embeddedIndex = NULL;
+    
+    if (sc->backend == SPELLCHECK_BACKEND_DAWG) {
+        ConvertMainToDawg(sc, snap);
+    }
+}
+
+// Where AppendDawgWord puts the words it is given
+typedef struct {
+    SpellChecker *sc;
+    Dictionary *dict;
+} DawgExpansion;
+
+static BOOL AppendDawgWord(const char *word, int distance, void *context) {
+    DawgExpansion *expansion = (DawgExpansion *)context;
+    return AppendDictionaryWord(expansion->sc, expansion->dict, word, strlen(word));
+}
+
+// Turn the main DAWG back into a sorted array so more words can be merged
+static BOOL ExpandDawgToArray(SpellChecker *sc, DictionarySnapshot *snap) {
+    if (!snap->mainDawg) return TRUE;
+    
+    DawgExpansion expansion = { sc, &snap->mainDictionary };
+    Dawg_EnumeratePrefix(snap->mainDawg, "", AppendDawgWord, &expansion);
+    if (snap->mainDictionary.count != snap->mainDawg->wordCount) return FALSE;
+    
+    Dawg_Destroy(snap->mainDawg);
+    snap->mainDawg = NULL;
+    return TRUE;
+}
+
+// Enter a read-side critical section and return the current snapshot.
+// Readers only touch an interlocked counter for the epoch they observed;
+// a publisher flips the epoch and waits for the old counter to drain
+// before it frees the snapshot it replaced. Nested entries are safe.
+static DictionarySnapshot* SnapshotAcquire(SpellChecker *sc, LONG *slot) {
+    for (;;) {
+        LONG epoch = sc->epoch;
+        InterlockedIncrement(&sc->activeReaders[epoch & 1]);
+        if (epoch == sc->epoch) {
+            *slot = epoch & 1;
+            return sc->snapshot;
+        }
+        // Publisher flipped the epoch underneath us; register again
+        InterlockedDecrement(&sc->activeReaders[epoch & 1]);
+    }
+}
+
+static void SnapshotRelease(SpellChecker *sc, LONG slot) {
+    InterlockedDecrement(&sc->activeReaders[slot]);
+}
+
+// Swap in a new snapshot and reclaim the old one once no reader can
+// still see it. Callers serialize on reloadLock.
+static void PublishSnapshot(SpellChecker *sc, DictionarySnapshot *snap) {
+    snap->generation = sc->snapshot ? sc->snapshot->generation + 1 : 1;
+    DictionarySnapshot *old = (DictionarySnapshot *)InterlockedExchangePointer((PVOID volatile *)&sc->snapshot, snap);
+    
+    // Readers that entered before the flip are counted in the old slot;
+    // anyone entering after it sees the new pointer
+    LONG oldSlot = sc->epoch & 1;
+    InterlockedIncrement(&sc->epoch);
+    while (sc->activeReaders[oldSlot] != 0) {
+        Sleep(1);
+    }
+    
+    DestroySnapshot(sc, old);
+}
+
+// Remember a dictionary file and its current timestamp for hot reload
+static void TrackDictionaryFile(DictionaryFile *tracked, const char *filePath) {
+    strncpy(tracked->path, filePath, MAX_PATH - 1);
+    tracked->path[MAX_PATH - 1] = '\0';
+    
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    if (GetFileAttributesEx(filePath, GetFileExInfoStandard, &attrs)) {
+        tracked->lastWrite = attrs.ftLastWriteTime;
+        tracked->sizeLow = attrs.nFileSizeLow;
+    } else {
+        memset(&tracked->lastWrite, 0, sizeof(FILETIME));
+        tracked->sizeLow = 0;
+    }
+}
+
+// Refresh tracked timestamps; returns TRUE if any file changed
+static BOOL RefreshDictionaryFile(DictionaryFile *tracked) {
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    FILETIME lastWrite = {0};
+    DWORD sizeLow = 0;
+    
+    if (GetFileAttributesEx(tracked->path, GetFileExInfoStandard, &attrs)) {
+        lastWrite = attrs.ftLastWriteTime;
+        sizeLow = attrs.nFileSizeLow;
+    }
+    
+    if (CompareFileTime(&lastWrite, &tracked->lastWrite) == 0 && sizeLow == tracked->sizeLow) {
+        return FALSE;
+    }
+    tracked->lastWrite = lastWrite;
+    tracked->sizeLow = sizeLow;
+    return TRUE;
+}
+
+// Create spell checker instance
+SpellChecker* SpellChecker_Create(void) {
+    return SpellChecker_CreateWithAllocator(NULL);
+}
+
+SpellChecker* SpellChecker_CreateWithAllocator(const SpellCheckAllocator *allocator) {
+    if (!allocator) allocator = &g_heapAllocator;
+    SpellChecker *sc = (SpellChecker *)allocator->allocate(allocator->context, sizeof(SpellChecker),
+                                                           SPELLCHECK_MEMORY_CHECKER);
+    if (!sc) return NULL;
+    
+    memset(sc, 0, sizeof(SpellChecker));
+    sc->allocator = *allocator;
+    sc->enabled = TRUE;
+    sc->suggestionsEnabled = TRUE;
+    InitializeCriticalSection(&sc->reloadLock);
+    InitializeCriticalSection(&sc->suggestionLock);
+    
+    // Initialize dictionaries
+    sc->snapshot = CreateSnapshot(sc);
+    if (sc->snapshot) {
+        sc->snapshot->generation = 1;
+        sc->snapshot->mainDictionary.capacity = INITIAL_DICT_CAPACITY;
+        sc->snapshot->mainDictionary.words = (char **)MemAlloc(sc, INITIAL_DICT_CAPACITY * sizeof(char *),
+                                                               SPELLCHECK_MEMORY_DICTIONARY);
+    }
+    
+    int profile = SpellChecker_AddProfile(sc, "default");
+    
+    sc->misspelled.capacity = INITIAL_MISSPELLED_CAPACITY;
+    sc->misspelled.words = (MisspelledWord *)MemAlloc(sc, INITIAL_MISSPELLED_CAPACITY * sizeof(MisspelledWord),
+                                                      SPELLCHECK_MEMORY_CHECK);
+    
+    if (!sc->snapshot || !sc->snapshot->mainDictionary.words || profile != SPELLCHECK_DEFAULT_PROFILE ||
+        !sc->misspelled.words) {
+        SpellChecker_Destroy(sc);
+        return NULL;
+    }
+    
+    return sc;
+}
+
+// Destroy spell checker instance
+void SpellChecker_Destroy(SpellChecker *sc) {
+    if (!sc) return;
+    
+    SpellChecker_StopWatching(sc);
+    
+    // Stop the suggestion warm-up before the dictionaries go away
+    if (sc->warmThread) {
+        SetEvent(sc->warmStopEvent);
+        WaitForSingleObject(sc->warmThread, INFINITE);
+        CloseHandle(sc->warmThread);
+    }
+    if (sc->warmWakeEvent) CloseHandle(sc->warmWakeEvent);
+    if (sc->warmStopEvent) CloseHandle(sc->warmStopEvent);
+    for (int i = 0; i < SPELLCHECK_SUGGESTION_CACHE_SIZE; i++) {
+        FreeWordList(sc, sc->suggestionCache[i].suggestions, sc->suggestionCache[i].count);
+    }
+    
+    DestroySnapshot(sc, sc->snapshot);
+    for (int i = 0; i < sc->profileCount; i++) {
+        FreeDictionary(sc, &sc->profiles[i].addedWords);
+        FreeDictionary(sc, &sc->profiles[i].ignoredWords);
+    }
+    
+    for (int i = 0; i < sc->wordUseCapacity; i++) {
+        MemFree(sc, sc->wordUses[i].word, SPELLCHECK_MEMORY_USAGE);
+    }
+    MemFree(sc, sc->wordUses, SPELLCHECK_MEMORY_USAGE);
+    MemFree(sc, sc->usedSorted, SPELLCHECK_MEMORY_USAGE);
+    MemFree(sc, sc->recentUses, SPELLCHECK_MEMORY_USAGE);
+    SuggestIndex_Destroy(sc->usedIndex);
+    SuggestIndex_Destroy(sc->recentIndex);
+    
+    MemFree(sc, sc->misspelled.words, SPELLCHECK_MEMORY_CHECK);
+    DeleteCriticalSection(&sc->reloadLock);
+    DeleteCriticalSection(&sc->suggestionLock);
+    
+    // The checker itself came from its allocator too
+    SpellCheckAllocator allocator = sc->allocator;
+    allocator.release(allocator.context, sc, SPELLCHECK_MEMORY_CHECKER);
+}
+
+// Load dictionary from file.
+// Setup-time call: it appends to the current snapshot in place, so it must
+// not race with checks. Later changes to the file arrive via hot reload.
+BOOL SpellChecker_LoadDictionary(SpellChecker *sc, const char *filePath) {
+    if (!sc || !filePath) return FALSE;
+    
+    EnterCriticalSection(&sc->reloadLock);
+    
+    DictionarySnapshot *snap = sc->snapshot;
+    if (!ExpandDawgToArray(sc, snap) || !LoadWordFile(sc, &snap->mainDictionary, filePath, TRUE)) {
+        LeaveCriticalSection(&sc->reloadLock);
+        return FALSE;
+    }
+    
+    if (sc->dictionaryFileCount < SPELLCHECK_MAX_DICTIONARY_FILES) {
+        TrackDictionaryFile(&sc->dictionaryFiles[sc->dictionaryFileCount++], filePath);
+    }
+    
+    BOOL loaded = snap->mainDictionary.count > 0;
+    PrepareMainDictionary(sc, snap);
+    snap->generation++;
+    LeaveCriticalSection(&sc->reloadLock);
+    return loaded;
+}
+
+// Load one overlay file of the active profile into the current snapshot
+static BOOL LoadProfileFile(SpellChecker *sc, const char *filePath, BOOL glossary) {
+    if (!sc || !filePath) return FALSE;
+    
+    EnterCriticalSection(&sc->reloadLock);
+    
+    // Track the path even if the file doesn't exist yet so that creating
+    // it later is picked up by the watcher
+    int profile = sc->activeProfile;
+    TrackDictionaryFile(glossary ? &sc->profiles[profile].glossaryFile : &sc->profiles[profile].userDictionaryFile,
+                        filePath);
+    
+    BOOL ok = TRUE;
+    FILE *probe = fopen(filePath, "r");
+    if (probe) {
+        fclose(probe);
+        ProfileWords *words = &sc->snapshot->profileWords[profile];
+        ok = LoadWordFile(sc, glossary ? &words->glossary : &words->userDictionary, filePath, glossary);
+        sc->snapshot->generation++;
+    }
+    // Not an error if the file doesn't exist yet
+    
+    LeaveCriticalSection(&sc->reloadLock);
+    return ok;
+}
+
+// Load user dictionary from file (same setup-time rules as above)
+BOOL SpellChecker_LoadUserDictionary(SpellChecker *sc, const char *filePath) {
+    return LoadProfileFile(sc, filePath, FALSE);
+}
+
+BOOL SpellChecker_LoadGlossary(SpellChecker *sc, const char *filePath) {
+    return LoadProfileFile(sc, filePath, TRUE);
+}
+
+// Load word frequencies (same setup-time rules) and reorder the
+// suggestion indexes by them
+BOOL SpellChecker_LoadFrequencies(SpellChecker *sc, const char *filePath) {
+    if (!sc || !filePath) return FALSE;
+    
+    EnterCriticalSection(&sc->reloadLock);
+    
+    // Tracked even if missing, like the user dictionary
+    TrackDictionaryFile(&sc->frequencyFile, filePath);
+    
+    BOOL ok = TRUE;
+    FILE *probe = fopen(filePath, "r");
+    if (probe) {
+        fclose(probe);
+        ok = LoadFrequencyFile(sc, sc->snapshot, filePath);
+        PrepareMainDictionary(sc, sc->snapshot);
+        sc->snapshot->generation++;
+    }
+    
+    LeaveCriticalSection(&sc->reloadLock);
+    return ok;
+}
+
+// Rebuild a snapshot from the tracked files and publish it. Keeps the
+// current snapshot if a main dictionary comes back empty or unreadable,
+// which is what a half-written file usually looks like.
+BOOL SpellChecker_ReloadDictionaries(SpellChecker *sc) {
+    if (!sc) return FALSE;
+    
+    EnterCriticalSection(&sc->reloadLock);
+    
+    DictionarySnapshot *snap = CreateSnapshot(sc);
+    BOOL ok = snap != NULL;
+    
+    for (int i = 0; ok && i < sc->dictionaryFileCount; i++) {
+        ok = LoadWordFile(sc, &snap->mainDictionary, sc->dictionaryFiles[i].path, TRUE);
+    }
+    for (int i = 0; ok && i < 2 * sc->profileCount; i++) {
+        // A missing overlay just means an empty one
+        BOOL glossary = i & 1;
+        SpellCheckProfile *profile = &sc->profiles[i / 2];
+        const char *path = glossary ? profile->glossaryFile.path : profile->userDictionaryFile.path;
+        FILE *probe = path[0] ? fopen(path, "r") : NULL;
+        if (probe) {
+            fclose(probe);
+            ProfileWords *words = &snap->profileWords[i / 2];
+            ok = LoadWordFile(sc, glossary ? &words->glossary : &words->userDictionary, path, glossary);
+        }
+    }
+    if (ok && sc->frequencyFile.path[0]) {
+        // Without its frequencies the snapshot is only ranked worse
+        LoadFrequencyFile(sc, snap, sc->frequencyFile.path);
+    }
+    
+    // An empty main list is only valid when it is an overlay on the
+    // compiled-in dictionary
+    if (!ok || (snap->mainDictionary.count == 0 && sc->dictionaryFileCount > 0)) {
+        DestroySnapshot(sc, snap);
+        LeaveCriticalSection(&sc->reloadLock);
+        return FALSE;
+    }
+    
+    PrepareMainDictionary(sc, snap);
+    PublishSnapshot(sc, snap);
+    LeaveCriticalSection(&sc->reloadLock);
+    return TRUE;
+}
+
+// Switch the main dictionary representation. The tracked files are reread
+// into a snapshot of the new kind and published like any other reload.
+BOOL SpellChecker_SetBackend(SpellChecker *sc, SpellCheckBackend backend) {
+    if (!sc) return FALSE;
+    
+    EnterCriticalSection(&sc->reloadLock);
+    BOOL changed = sc->backend != backend;
+    sc->backend = backend;
+    BOOL hasFiles = sc->dictionaryFileCount > 0;
+    LeaveCriticalSection(&sc->reloadLock);
+    
+    if (!changed || !hasFiles) return TRUE;
+    return SpellChecker_ReloadDictionaries(sc);
+}
+
+// Memory held by the main dictionary in its current representation
+void SpellChecker_GetDictionaryStats(SpellChecker *sc, DictionaryStats *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(DictionaryStats));
+    if (!sc) return;
+    
+    LONG slot;
+    DictionarySnapshot *snap = SnapshotAcquire(sc, &slot);
+    if (snap->mainDawg) {
+        stats->backend = SPELLCHECK_BACKEND_DAWG;
+        stats->wordCount = snap->mainDawg->wordCount;
+        stats->bytes = Dawg_MemoryUsage(snap->mainDawg);
+    } else {
+        // Pointer array, the pools of the loaded files and any entry
+        // allocated on its own (allocator overhead not included), and the
+        // suggestion index once it has been built
+        const Dictionary *dict = &snap->mainDictionary;
+        stats->backend = SPELLCHECK_BACKEND_SORTED_ARRAY;
+        stats->wordCount = dict->count;
+        stats->bytes = dict->capacity * sizeof(char *);
+        for (const DictionaryPool *pool = dict->pools; pool; pool = pool->next) {
+            stats->bytes += pool->size;
+        }
+        for (int i = 0; i < dict->count; i++) {
+            if (!InDictionaryPool(dict, dict->words[i])) stats->bytes += 2 * (strlen(dict->words[i]) + 1);
+        }
+        stats->bytes += SuggestIndex_MemoryUsage(snap->mainIndex);
+    }
+    SnapshotRelease(sc, slot);
+}
+
+void SpellChecker_GetIndexMemory(SpellChecker *sc, SpellCheckIndexMemory *memory) {
+    if (!memory) return;
+    memset(memory, 0, sizeof(SpellCheckIndexMemory));
+    if (!sc) return;
+    
+    LONG slot;
+    DictionarySnapshot *snap = SnapshotAcquire(sc, &slot);
+    memory->dawg = Dawg_MemoryUsage(snap->mainDawg);
+    memory->mainIndex = SuggestIndex_MemoryUsage(snap->mainIndex);
+    memory->embeddedIndex = SuggestIndex_MemoryUsage(snap->embeddedIndex);
+    SnapshotRelease(sc, slot);
+    
+    EnterCriticalSection(&sc->suggestionLock);
+    memory->usedIndex = SuggestIndex_MemoryUsage(sc->usedIndex) + SuggestIndex_MemoryUsage(sc->recentIndex);
+    LeaveCriticalSection(&sc->suggestionLock);
+}
+
+// Current dictionary generation; bumps on every successful reload
+LONG SpellChecker_GetGeneration(SpellChecker *sc) {
+    if (!sc) return 0;
+    LONG slot;
+    DictionarySnapshot *snap = SnapshotAcquire(sc, &slot);
+    LONG generation = snap->generation;
+    SnapshotRelease(sc, slot);
+    return generation;
+}
+
+#define MAX_TRACKED_FILES (SPELLCHECK_MAX_DICTIONARY_FILES + 1 + 2 * SPELLCHECK_MAX_PROFILES)
+
+// Tracked file number 'i': the main dictionaries, the frequency list,
+// then each profile's user dictionary and glossary. NULL past the end.
+static DictionaryFile* TrackedFileAt(SpellChecker *sc, int i) {
+    if (i < sc->dictionaryFileCount) return &sc->dictionaryFiles[i];
+    i -= sc->dictionaryFileCount;
+    if (i == 0) return &sc->frequencyFile;
+    i--;
+    if (i >= 2 * sc->profileCount) return NULL;
+    return (i & 1) ? &sc->profiles[i / 2].glossaryFile : &sc->profiles[i / 2].userDictionaryFile;
+}
+
+// Check tracked files for changes and reload if needed
+static BOOL DictionaryFilesChanged(SpellChecker *sc) {
+    BOOL changed = FALSE;
+    DictionaryFile *tracked;
+    EnterCriticalSection(&sc->reloadLock);
+    for (int i = 0; (tracked = TrackedFileAt(sc, i)) != NULL; i++) {
+        if (tracked->path[0] && RefreshDictionaryFile(tracked)) changed = TRUE;
+    }
+    LeaveCriticalSection(&sc->reloadLock);
+    return changed;
+}
+
+// Directory part of a path ("." for bare file names)
+static void DirectoryOfPath(const char *path, char *dir, int dirLen) {
+    const char *slash = strrchr(path, '\\');
+    const char *fwd = strrchr(path, '/');
+    if (fwd > slash) slash = fwd;
+    
+    if (!slash) {
+        strncpy(dir, ".", dirLen - 1);
+    } else {
+        int len = (int)(slash - path);
+        if (len == 0) len = 1; // root
+        if (len > dirLen - 1) len = dirLen - 1;
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+    }
+    dir[dirLen - 1] = '\0';
+}
+
+// Change notifications for the directories of the tracked files, one per
+// directory. Files can be loaded after the watcher starts, so this runs on
+// every pass and only registers directories not already in 'dirs'.
+static void WatchTrackedDirectories(SpellChecker *sc, HANDLE *handles, char (*dirs)[MAX_PATH], DWORD *handleCount) {
+    DictionaryFile *tracked;
+    EnterCriticalSection(&sc->reloadLock);
+    for (int i = 0; (tracked = TrackedFileAt(sc, i)) != NULL; i++) {
+        const char *path = tracked->path;
+        if (!path[0]) continue;
+        
+        char dir[MAX_PATH];
+        DirectoryOfPath(path, dir, sizeof(dir));
+        
+        BOOL seen = FALSE;
+        for (DWORD d = 1; d < *handleCount; d++) {
+            if (_stricmp(dirs[d - 1], dir) == 0) seen = TRUE;
+        }
+        if (seen) continue;
+        
+        HANDLE change = FindFirstChangeNotification(dir, FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_FILE_NAME);
+        if (change != INVALID_HANDLE_VALUE) {
+            strcpy(dirs[*handleCount - 1], dir);
+            handles[(*handleCount)++] = change;
+        }
+    }
+    LeaveCriticalSection(&sc->reloadLock);
+}
+
+// Background watcher: waits for change notifications on the directories of
+// the tracked files (with a periodic poll for shares that never notify, or
+// directories that couldn't be watched yet), lets writers settle, then
+// rebuilds and publishes a new snapshot.
+static DWORD WINAPI DictionaryWatchThread(LPVOID param) {
+    SpellChecker *sc = (SpellChecker *)param;
+    HANDLE handles[1 + MAX_TRACKED_FILES];
+    char dirs[MAX_TRACKED_FILES][MAX_PATH];
+    DWORD handleCount = 0;
+    
+    handles[handleCount++] = sc->watchStopEvent;
+    
+    BOOL pending = FALSE;
+    for (;;) {
+        WatchTrackedDirectories(sc, handles, dirs, &handleCount);
+        
+        DWORD result = WaitForMultipleObjects(handleCount, handles, FALSE, SPELLCHECK_RELOAD_POLL_MS);
+        if (result == WAIT_OBJECT_0 || result == WAIT_FAILED) break;
+        
+        if (result > WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + handleCount) {
+            FindNextChangeNotification(handles[result - WAIT_OBJECT_0]);
+            
+            // Editors often write in several steps; let them finish
+            if (WaitForSingleObject(sc->watchStopEvent, SPELLCHECK_RELOAD_SETTLE_MS) == WAIT_OBJECT_0) break;
+        }
+        
+        // A failed rebuild (file mid-write) stays pending for the next poll
+        if (DictionaryFilesChanged(sc)) pending = TRUE;
+        if (pending && SpellChecker_ReloadDictionaries(sc)) {
+            pending = FALSE;
+            if (sc->reloadCallback) {
+                sc->reloadCallback(sc->reloadContext);
+            }
+        }
+    }
+    
+    for (DWORD h = 1; h < handleCount; h++) {
+        FindCloseChangeNotification(handles[h]);
+    }
+    return 0;
+}
+
+// Start watching the loaded dictionary files. 'callback' runs on the
+// watcher thread after each published reload.
+BOOL SpellChecker_StartWatching(SpellChecker *sc, SpellCheckerReloadCallback callback, void *context) {
+    if (!sc || sc->watchThread) return FALSE;
+    
+    sc->reloadCallback = callback;
+    sc->reloadContext = context;
+    sc->watchStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!sc->watchStopEvent) return FALSE;
+    
+    sc->watchThread = CreateThread(NULL, 0, DictionaryWatchThread, sc, 0, NULL);
+    if (!sc->watchThread) {
+        CloseHandle(sc->watchStopEvent);
+        sc->watchStopEvent = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void SpellChecker_StopWatching(SpellChecker *sc) {
+    if (!sc || !sc->watchThread) return;
+    
+    SetEvent(sc->watchStopEvent);
+    WaitForSingleObject(sc->watchThread, INFINITE);
+    CloseHandle(sc->watchThread);
+    CloseHandle(sc->watchStopEvent);
+    sc->watchThread = NULL;
+    sc->watchStopEvent = NULL;
+}
+
+// Lookup of a folded word through every layer of one profile: its
+// session lists and the snapshot's shared and per-profile words
+static BOOL IsWordCorrectIn(SpellChecker *sc, DictionarySnapshot *snap, int profile, const char *folded) {
+    SpellCheckProfile *layers = &sc->profiles[profile];
+    ProfileWords *words = &snap->profileWords[profile];
+    
+    // Check ignore list first (ignored words are treated as correct)
+    if (BinarySearchDictionary(&layers->ignoredWords, folded)) return TRUE;
+    
+    // Check main dictionary: compiled-in words, then any loaded overlay
+    if (EmbeddedContains(folded)) return TRUE;
+    if (snap->mainDawg && Dawg_Contains(snap->mainDawg, folded)) return TRUE;
+    if (BinarySearchDictionary(&snap->mainDictionary, folded)) return TRUE;
+    
+    // Then the profile's glossary and user dictionary, both as loaded and
+    // as added this session
+    if (BinarySearchDictionary(&words->glossary, folded)) return TRUE;
+    if (BinarySearchDictionary(&words->userDictionary, folded)) return TRUE;
+    if (BinarySearchDictionary(&layers->addedWords, folded)) return TRUE;
+    
+    return FALSE;
+}
+
+// Check if a word is correct
+BOOL SpellChecker_IsWordCorrect(SpellChecker *sc, const char *word) {
+    if (!sc || !word || strlen(word) == 0) return TRUE;
+    
+    char folded[256];
+    Utf8_Fold(word, Utf8_TruncateLength(word, strlen(word), 255), folded);
+    
+    LONG slot;
+    DictionarySnapshot *snap = SnapshotAcquire(sc, &slot);
+    BOOL correct = IsWordCorrectIn(sc, snap, sc->activeProfile, folded);
+    SnapshotRelease(sc, slot);
+    return correct;
+}
+
+// Append a misspelled word to a list, growing it as needed. 'owner' is
+// the checker whose own list it is, or NULL for a caller's list.
+static BOOL AppendMisspelled(SpellChecker *owner, MisspelledWordList *list, const char *word,
+                             DWORD startPos, DWORD endPos) {
+    if (list->count >= list->capacity) {
+        int newCapacity = list->capacity > 0 ? list->capacity * 2 : INITIAL_MISSPELLED_CAPACITY;
+        MisspelledWord *newWords = (MisspelledWord *)MemRealloc(owner, list->words,
+                                                                newCapacity * sizeof(MisspelledWord),
+                                                                SPELLCHECK_MEMORY_CHECK);
+        if (!newWords) return FALSE;
+        list->words = newWords;
+        list->capacity = newCapacity;
+    }
+    
+    list->words[list->count].startPos = startPos;
+    list->words[list->count].endPos = endPos;
+    strcpy(list->words[list->count].word, word);
+    list->count++;
+    return TRUE;
+}
+
+// Verdict for a folded word, from the cache when it holds a current one.
+// Only slots in the word's probe run are looked at; a miss takes the
+// first free or stale one, else the home slot.
+static BOOL IsWordCorrectCached(SpellChecker *sc, DictionarySnapshot *snap, int profile, const char *folded,
+                                size_t len) {
+    if (len > SPELLCHECK_VERDICT_MAX_WORD) return IsWordCorrectIn(sc, snap, profile, folded);
+    
+    LONG version = sc->profiles[profile].verdictVersion;    
+    unsigned int hash = FoldedHash(folded);
+    if (!hash) hash = 1;
+    VerdictCacheEntry *victim = NULL;
+    for (int i = 0; i < SPELLCHECK_VERDICT_PROBES; i++) {
+        VerdictCacheEntry *entry = &sc->verdictCache[(hash + i) & (SPELLCHECK_VERDICT_CACHE_SIZE - 1)];
+        BOOL current = entry->hash && entry->generation == snap->generation &&
+                       entry->verdictVersion == version;
+        if (current && entry->hash == hash && strcmp(entry->word, folded) == 0) {
+            sc->verdictHits++;
+            return entry->correct;
+        }
+        if (!current && !victim) victim = entry;
+    }
+    
+    sc->verdictMisses++;
+    BOOL correct = IsWordCorrectIn(sc, snap, profile, folded);
+    if (!victim) victim = &sc->verdictCache[hash & (SPELLCHECK_VERDICT_CACHE_SIZE - 1)];
+    victim->hash = hash;
+    victim->generation = snap->generation;
+    victim->verdictVersion = version;
+    victim->correct = correct;
+    memcpy(victim->word, folded, len + 1);
+    return correct;
+}
+
+// Checks one block against a pinned snapshot, through the verdict cache
+// when 'cached' (owner thread only)
+static BOOL CheckText(SpellChecker *sc, const char *text, size_t length, DWORD baseOffset,
+                      MisspelledWordList *out, BOOL cached) {
+    if (!sc || !out) return FALSE;
+    if (!text || length == 0) return TRUE;
+    
+    size_t pos = 0;
+    size_t wordStart, wordLength;
+    BOOL ok = TRUE;
+    
+    // Pin one snapshot for the whole pass so a reload mid-pass can't
+    // mix dictionary versions
+    LONG slot;
+    DictionarySnapshot *snap = SnapshotAcquire(sc, &slot);
+    int profile = sc->activeProfile;
+    SpellChecker *owner = out == &sc->misspelled ? sc : NULL;
+    
+    // Words are runs of letters in UTF-8; positions stay byte offsets
+    while (Utf8_NextWord(text, length, &pos, &wordStart, &wordLength)) {
+        char word[256];
+        char folded[256];
+        size_t wordLen = Utf8_TruncateLength(text + wordStart, wordLength, sizeof(word) - 1);
+        memcpy(word, text + wordStart, wordLen);
+        word[wordLen] = '\0';
+        Utf8_Fold(word, wordLen, folded);
+        
+        // Check spelling
+        BOOL correct = cached ? IsWordCorrectCached(sc, snap, profile, folded, wordLen) :
+                                IsWordCorrectIn(sc, snap, profile, folded);
+        if (!correct) {
+            if (!AppendMisspelled(owner, out, word, baseOffset + (DWORD)wordStart, baseOffset + (DWORD)pos)) {
+                ok = FALSE;
+                break;
+            }
+        }
+    }
+    
+    SnapshotRelease(sc, slot);
+    return ok;
+}
+
+// Check a length-delimited block of text and append misspellings to 'out'.
+// Only reads the dictionaries, so several threads may call this concurrently
+// on one SpellChecker as long as each passes its own output list.
+BOOL SpellChecker_CheckRange(SpellChecker *sc, const char *text, size_t length, DWORD baseOffset, MisspelledWordList *out) {
+    return CheckText(sc, text, length, baseOffset, out, FALSE);
+}
+
+// Extract words from text and check spelling
+void SpellChecker_Check(SpellChecker *sc, const char *text) {
+    if (!sc || !sc->enabled) {
+        if (sc) sc->misspelled.count = 0;
+        return;
+    }
+    
+    // Reset misspelled list at start of every pass
+    sc->misspelled.count = 0;
+    
+    // Handle empty text
+    if (!text || strlen(text) == 0) {
+        return;
+    }
+    
+    // The allocator may audit that a pass in the steady state allocates
+    // nothing; the list only grows while the text does
+    if (sc->allocator.checkPass) sc->allocator.checkPass(sc->allocator.context, TRUE);
+    CheckText(sc, text, strlen(text), 0, &sc->misspelled, TRUE);
+    if (sc->allocator.checkPass) sc->allocator.checkPass(sc->allocator.context, FALSE);
+}
+
+void SpellChecker_GetVerdictStats(SpellChecker *sc, VerdictCacheStats *stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(VerdictCacheStats));
+    if (!sc) return;
+    
+    stats->hits = sc->verdictHits;
+    stats->misses = sc->verdictMisses;
+    LONG generation = SpellChecker_GetGeneration(sc);
+    LONG version = sc->profiles[sc->activeProfile].verdictVersion;
+    for (int i = 0; i < SPELLCHECK_VERDICT_CACHE_SIZE; i++) {
+        VerdictCacheEntry *entry = &sc->verdictCache[i];
+        if (entry->hash && entry->generation == generation && entry->verdictVersion == version) {
+            stats->entries++;
+        }
+    }
+}
+
+// Release the storage of a caller-owned misspelled list
+void SpellChecker_FreeMisspelledList(MisspelledWordList *list) {
+    if (!list) return;
+    free(list->words);
+    list->words = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+BOOL SpellChecker_ApplyEdit(SpellChecker *sc, const SpellCheckEdit *edit) {
+    if (!sc || !edit || !edit->text) return FALSE;
+    
+    // Spans are in text order: keep those before the edit, check the new
+    // text in place of the ones inside it, and shift the rest after it
+    MisspelledWordList *list = &sc->misspelled;
+    int head = 0;
+    while (head < list->count && list->words[head].endPos <= edit->start) head++;
+    int tail = head;
+    while (tail < list->count && list->words[tail].startPos < edit->end) tail++;
+    
+    int after = list->count - tail;
+    MisspelledWord *later = NULL;
+    if (after > 0) {
+        later = (MisspelledWord *)MemAlloc(sc, after * sizeof(MisspelledWord), SPELLCHECK_MEMORY_CHECK);
+        if (!later) return FALSE;
+        memcpy(later, list->words + tail, after * sizeof(MisspelledWord));
+    }
+    
+    list->count = head;
+    BOOL ok = !sc->enabled || CheckText(sc, edit->text, edit->length, edit->start, list, TRUE);
+    
+    int newCount = list->count + after;
+    if (ok && newCount > list->capacity) {
+        MisspelledWord *newWords = (MisspelledWord *)MemRealloc(sc, list->words, newCount * sizeof(MisspelledWord),
+                                                                SPELLCHECK_MEMORY_CHECK);
+        ok = newWords != NULL;
+        if (ok) {
+            list->words = newWords;
+            list->capacity = newCount;
+        }
+    }
+    if (ok) {
+        DWORD shift = edit->length - (edit->end - edit->start);     // Wraps when the text shrank
+        for (int i = 0; i < after; i++) {
+            MisspelledWord *span = &list->words[list->count++];
+            *span = later[i];
+            span->startPos += shift;
+            span->endPos += shift;
+        }
+    }
+    
+    MemFree(sc, later, SPELLCHECK_MEMORY_CHECK);
+    return ok;
+}
+
+// Build a NULL-terminated copy of a word list, kept by 'owner' or, when
+// NULL, handed to the caller
+static char** CopyWordList(SpellChecker *owner, const char * const *words, int count) {
+    char **result = (char **)MemAlloc(owner, (count + 1) * sizeof(char *), SPELLCHECK_MEMORY_SUGGEST);
+    if (!result) return NULL;
+    
+    for (int i = 0; i < count; i++) {
+        int len = strlen(words[i]);
+        result[i] = (char *)MemAlloc(owner, len + 1, SPELLCHECK_MEMORY_SUGGEST);
+        if (!result[i]) {
+            FreeWordList(owner, result, i);
+            return NULL;
+        }
+        memcpy(result[i], words[i], len + 1);
+    }
+    result[count] = NULL;
+    return result;
+}
+
+#define MAX_SUGGESTIONS 5
+
+typedef struct {
+    const char *word;
+    int distance;
+    int uses;               // Times the user has written it
+    DWORD weight;           // Frequency from the snapshot's table
+} Suggestion;
+
+// The best candidates found so far, best first. Words from the snapshot
+// are kept by pointer, so it must be held until they are copied out;
+// transient ones (the DAWG walk's buffer, the used-word index, which
+// another search may rebuild) are copied into spare slots.
+typedef struct {
+    Suggestion items[MAX_SUGGESTIONS];
+    int count;
+    char copies[MAX_SUGGESTIONS + 1][256];
+    SpellChecker *sc;
+    DictionarySnapshot *snap;
+} SuggestionCandidates;
+
+// Closer first, then more used, then more frequent
+static BOOL RanksBefore(const Suggestion *a, const Suggestion *b) {
+    if (a->distance != b->distance) return a->distance < b->distance;
+    if (a->uses != b->uses) return a->uses > b->uses;
+    return a->weight > b->weight;
+}
+
+// A copy slot no kept candidate points into; there is always one more
+// slot than candidates
+static char* FreeCopySlot(SuggestionCandidates *found) {
+    for (int slot = 0; slot <= MAX_SUGGESTIONS; slot++) {
+        BOOL taken = FALSE;
+        for (int i = 0; i < found->count && !taken; i++) {
+            taken = found->items[i].word == found->copies[slot];
+        }
+        if (!taken) return found->copies[slot];
     }
-    return tolower((unsigned char)*s1) - tolower((unsigned char)*s2);
+    return NULL;
 }
 
-// Levenshtein distance calculation
-static int LevenshteinDistance(const char *s1, const char *s2) {
-    int len1 = strlen(s1);
-    int len2 = strlen(s2);
-    
-    if (len1 == 0) return len2;
-    if (len2 == 0) return len1;
+// Keep a candidate if it ranks among the best; on ties the earliest found
+// stays ahead
+static void AddSuggestion(SuggestionCandidates *found, const char *word, int distance, int uses, DWORD weight,
+                          BOOL transient) {
+    if (distance <= 0) return;
     
-    int *d = (int *)malloc((len2 + 1) * sizeof(int));
-    if (!d) return -1;
+    Suggestion candidate = { word, distance, uses, weight };
+    int pos = found->count;
+    while (pos > 0 && RanksBefore(&candidate, &found->items[pos - 1])) pos--;
+    if (pos >= MAX_SUGGESTIONS) return;
     
-    for (int i = 0; i <= len2; i++) {
-        d[i] = i;
+    for (int i = 0; i < found->count; i++) {
+        if (CompareFolded(found->items[i].word, word) == 0) return;
     }
     
-    for (int i = 1; i <= len1; i++) {
-        int prev_diag = i - 1;
-        d[0] = i;
-        
-        for (int j = 1; j <= len2; j++) {
-            int cost = (s1[i - 1] == s2[j - 1]) ? 0 : 1;
-            int temp = d[j];
-            d[j] = (d[j] + 1 < d[j - 1] + 1) ? (d[j] + 1) : (d[j - 1] + 1);
-            d[j] = (d[j] < prev_diag + cost) ? d[j] : (prev_diag + cost);
-            prev_diag = temp;
-        }
+    if (transient) {
+        char *copy = FreeCopySlot(found);
+        strncpy(copy, word, 255);
+        copy[255] = '\0';
+        candidate.word = copy;
     }
     
-    int result = d[len2];
-    free(d);
-    return result;
+    int last = found->count < MAX_SUGGESTIONS ? found->count : MAX_SUGGESTIONS - 1;
+    memmove(&found->items[pos + 1], &found->items[pos], (last - pos) * sizeof(Suggestion));
+    found->items[pos] = candidate;
+    if (found->count < MAX_SUGGESTIONS) found->count++;
 }
 
-// Case-insensitive string comparison
-static int strcasecmp_custom(const char *s1, const char *s2) {
-    while (*s1 && *s2) {
-        int c1 = tolower((unsigned char)*s1);
-        int c2 = tolower((unsigned char)*s2);
-        if (c1 != c2) return c1 - c2;
-        s1++;
-        s2++;
+// For the paths without a weighted index: look the frequency up
+static void OfferSuggestion(SuggestionCandidates *found, const char *word, int distance, BOOL transient) {
+    char folded[256];
+    DWORD weight = 0;
+    if (found->snap->frequencyCount > 0 && FoldWord(word, folded, sizeof(folded))) {
+        weight = LookupFrequency(found->snap, folded);
     }
-    return tolower((unsigned char)*s1) - tolower((unsigned char)*s2);
+    AddSuggestion(found, word, distance, 0, weight, transient);
 }
 
-// Binary search for dictionary lookup
-static BOOL BinarySearchDictionary(Dictionary *dict, const char *word) {
-    int left = 0, right = dict->count - 1;
-    while (left <= right) {
-        int mid = left + (right - left) / 2;
-        int cmp = strcasecmp_custom(dict->words[mid], word);
-        if (cmp == 0) return TRUE;
-        if (cmp < 0) left = mid + 1;
-        else right = mid - 1;
+// The DAWG walks in alphabetical order, so every match is offered
+static BOOL CollectDawgSuggestion(const char *word, int distance, void *context) {
+    OfferSuggestion((SuggestionCandidates *)context, word, distance, TRUE);
+    return TRUE;
+}
+
+// SuggestWordCallback for the dictionary indexes. Used words were all
+// offered before the dictionaries are scanned, so anything new here has
+// never been used.
+static BOOL OfferIndexedSuggestion(const char *word, int distance, DWORD weight, void *context) {
+    AddSuggestion((SuggestionCandidates *)context, word, distance, 0, weight, FALSE);
+    return TRUE;
+}
+
+// The usage table's entry for a folded word, or NULL. Caller holds
+// suggestionLock.
+static WordUse* FindWordUse(SpellChecker *sc, const char *folded) {
+    if (sc->wordUseCount == 0) return NULL;
+    unsigned int mask = sc->wordUseCapacity - 1;
+    for (unsigned int h = FoldedHash(folded) & mask; sc->wordUses[h].word; h = (h + 1) & mask) {
+        if (strcmp(sc->wordUses[h].word, folded) == 0) return &sc->wordUses[h];
     }
-    return FALSE;
+    return NULL;
 }
 
-// Create spell checker instance
-SpellChecker* SpellChecker_Create(void) {
-    SpellChecker *sc = (SpellChecker *)malloc(sizeof(SpellChecker));
-    if (!sc) return NULL;
+// SuggestWordCallback for the used-word indexes. Their weights are the
+// counts when they were built, so the current count is looked up instead.
+// Misspellings get used too; only known words are offered. Runs under
+// suggestionLock, which keeps the session lists it reads still.
+static BOOL OfferUsedSuggestion(const char *word, int distance, DWORD weight, void *context) {
+    SuggestionCandidates *found = (SuggestionCandidates *)context;
+    char folded[256];
+    if (distance <= 0 || !FoldWord(word, folded, sizeof(folded))) return TRUE;
+    if (!IsWordCorrectIn(found->sc, found->snap, found->sc->activeProfile, folded)) return TRUE;
     
-    memset(sc, 0, sizeof(SpellChecker));
-    sc->enabled = TRUE;
-    sc->suggestionsEnabled = TRUE;
+    const WordUse *use = FindWordUse(found->sc, folded);
+    int uses = use ? use->count : (int)weight;
+    AddSuggestion(found, word, distance, uses, LookupFrequency(found->snap, folded), TRUE);
+    return TRUE;
+}
+
+// SuggestBoundCallback: could a never-used word at least 'minDistance'
+// away and no more frequent than 'maxWeight' still displace the worst
+// candidate kept? The word itself (distance 0) never counts.
+static BOOL SuggestionCouldImprove(int minDistance, DWORD maxWeight, void *context) {
+    SuggestionCandidates *found = (SuggestionCandidates *)context;
+    if (found->count < MAX_SUGGESTIONS) return TRUE;
     
-    // Initialize dictionaries
-    sc->mainDictionary.capacity = INITIAL_DICT_CAPACITY;
-    sc->mainDictionary.words = (char **)malloc(INITIAL_DICT_CAPACITY * sizeof(char *));
+    const Suggestion *worst = &found->items[found->count - 1];
+    if (minDistance < 1) minDistance = 1;
+    if (worst->distance != minDistance) return worst->distance > minDistance;
+    return worst->uses == 0 && worst->weight < maxWeight;
+}
+
+// Suggestion index over the sorted main array, most frequent words first,
+// built on first use so loads and reloads don't pay for it
+static SuggestIndex* MainSuggestIndex(SpellChecker *sc, DictionarySnapshot *snap) {
+    int count = snap->mainDictionary.count;
+    if (snap->mainIndex || snap->mainDawg || count == 0) return snap->mainIndex;
     
-    sc->userDictionary.capacity = 1000;
-    sc->userDictionary.words = (char **)malloc(1000 * sizeof(char *));
+    // Index the spellings as written; suggestions are shown from it
+    const char **display = (const char **)MemAlloc(sc, count * sizeof(char *), SPELLCHECK_MEMORY_SUGGEST);
+    if (!display) return NULL;
+    for (int i = 0; i < count; i++) {
+        display[i] = DisplayWord(snap->mainDictionary.words[i]);
+    }
+    DWORD *weights = LookupWeights(sc, snap, display, count);
+    SuggestIndex *index = SuggestIndex_Build(display, weights, count);
+    MemFree(sc, weights, SPELLCHECK_MEMORY_SUGGEST);
+    MemFree(sc, display, SPELLCHECK_MEMORY_SUGGEST);
     
-    sc->ignoredWords.capacity = 100;
-    sc->ignoredWords.words = (char **)malloc(100 * sizeof(char *));
+    // Another thread may have built it meanwhile; keep whichever won
+    if (index && InterlockedCompareExchangePointer((PVOID volatile *)&snap->mainIndex, index, NULL) != NULL) {
+        SuggestIndex_Destroy(index);
+    }
+    return snap->mainIndex;
+}
+
+// Suggestion index over the compiled-in words, built on first use. Their
+// order depends on the snapshot's frequencies, so each snapshot has its own.
+static SuggestIndex* EmbeddedSuggestIndex(SpellChecker *sc, DictionarySnapshot *snap) {
+    unsigned int n = EmbeddedWordCount();
+    if (snap->embeddedIndex || n == 0) return snap->embeddedIndex;
     
-    sc->misspelled.capacity = INITIAL_MISSPELLED_CAPACITY;
-    sc->misspelled.words = (MisspelledWord *)malloc(INITIAL_MISSPELLED_CAPACITY * sizeof(MisspelledWord));
+    const char **words = (const char **)MemAlloc(sc, n * sizeof(char *), SPELLCHECK_MEMORY_SUGGEST);
+    if (!words) return NULL;
+    for (unsigned int i = 0; i < n; i++) {
+        words[i] = EmbeddedSortedWordAt(i);
+    }
+    DWORD *weights = LookupWeights(sc, snap, words, (int)n);
+    SuggestIndex *index = SuggestIndex_Build(words, weights, (int)n);
+    MemFree(sc, weights, SPELLCHECK_MEMORY_SUGGEST);
+    MemFree(sc, words, SPELLCHECK_MEMORY_SUGGEST);
     
-    if (!sc->mainDictionary.words || !sc->userDictionary.words || !sc->ignoredWords.words || !sc->misspelled.words) {
-        SpellChecker_Destroy(sc);
-        return NULL;
+    // Another thread may have built it meanwhile; keep whichever won
+    if (index && InterlockedCompareExchangePointer((PVOID volatile *)&snap->embeddedIndex, index, NULL) != NULL) {
+        SuggestIndex_Destroy(index);
+    }
+    return snap->embeddedIndex;
+}
+
+static int CompareWordUses(const void *a, const void *b) {
+    return strcmp(((const WordUse *)a)->word, ((const WordUse *)b)->word);
+}
+
+// Index of the first of a run of used words in folded order not below a
+// folded word or prefix
+static int LowerBoundWordUses(const WordUse *uses, int count, const char *folded) {
+    int left = 0, right = count;
+    while (left < right) {
+        int mid = left + (right - left) / 2;
+        if (strcmp(uses[mid].word, folded) < 0) left = mid + 1;
+        else right = mid;
+    }
+    return left;
+}
+
+static WordUse* FindInWordUses(WordUse *uses, int count, const char *folded) {
+    int i = LowerBoundWordUses(uses, count, folded);
+    return i < count && strcmp(uses[i].word, folded) == 0 ? &uses[i] : NULL;
+}
+
+// Suggestion index over a run of used words, weighted by their counts
+static SuggestIndex* BuildWordUseIndex(SpellChecker *sc, const WordUse *uses, int count) {
+    if (count == 0) return NULL;
+    const char **words = (const char **)MemAlloc(sc, count * sizeof(char *), SPELLCHECK_MEMORY_SUGGEST);
+    DWORD *counts = (DWORD *)MemAlloc(sc, count * sizeof(DWORD), SPELLCHECK_MEMORY_SUGGEST);
+    SuggestIndex *index = NULL;
+    if (words && counts) {
+        for (int i = 0; i < count; i++) {
+            words[i] = DisplayWord(uses[i].word);
+            counts[i] = (DWORD)uses[i].count;
+        }
+        index = SuggestIndex_Build(words, counts, count);
     }
+    MemFree(sc, words, SPELLCHECK_MEMORY_SUGGEST);
+    MemFree(sc, counts, SPELLCHECK_MEMORY_SUGGEST);
+    return index;
+}
+
+// Sort and index every used word, emptying the recent run, unless that
+// is already done. Caller holds suggestionLock.
+static BOOL BuildUsedOrder(SpellChecker *sc) {
+    if (sc->usedOrderValid) return TRUE;
     
-    return sc;
+    SuggestIndex_Destroy(sc->usedIndex);
+    SuggestIndex_Destroy(sc->recentIndex);
+    sc->usedIndex = sc->recentIndex = NULL;
+    sc->recentIndexValid = TRUE;
+    sc->recentUseCount = 0;
+    MemFree(sc, sc->usedSorted, SPELLCHECK_MEMORY_USAGE);
+    sc->usedSorted = NULL;
+    sc->usedSortedCount = 0;
+    
+    if (sc->wordUseCount > 0) {
+        WordUse *sorted = (WordUse *)MemAlloc(sc, sc->wordUseCount * sizeof(WordUse), SPELLCHECK_MEMORY_USAGE);
+        if (!sorted) return FALSE;
+        int count = 0;
+        for (int i = 0; i < sc->wordUseCapacity; i++) {
+            if (sc->wordUses[i].word) sorted[count++] = sc->wordUses[i];
+        }
+        qsort(sorted, count, sizeof(WordUse), CompareWordUses);
+        sc->usedSorted = sorted;
+        sc->usedSortedCount = count;
+        sc->usedIndex = BuildWordUseIndex(sc, sorted, count);
+    }
+    sc->usedOrderValid = TRUE;
+    return TRUE;
 }
 
-// Destroy spell checker instance
-void SpellChecker_Destroy(SpellChecker *sc) {
-    if (!sc) return;
+// The suggestion indexes over the used words: all of them as of the last
+// full build, and those added since. Caller holds suggestionLock.
+static void UsedWordIndexes(SpellChecker *sc, SuggestIndex **used, SuggestIndex **recent) {
+    *used = *recent = NULL;
+    if (!BuildUsedOrder(sc)) return;
+    if (!sc->recentIndexValid) {
+        SuggestIndex_Destroy(sc->recentIndex);
+        sc->recentIndex = BuildWordUseIndex(sc, sc->recentUses, sc->recentUseCount);
+        sc->recentIndexValid = TRUE;
+    }
+    *used = sc->usedIndex;
+    *recent = sc->recentIndex;
+}
+
+// Scan the dictionaries for words close to 'word'. Reports the generation
+// of the snapshot and the word list version it used so the result can be
+// cached against them.
+static char** ComputeSuggestions(SpellChecker *sc, const char *word, int *count, LONG *generation, LONG *listVersion) {
+    *count = 0;
+    
+    SuggestionCandidates *found = (SuggestionCandidates *)MemAlloc(sc, sizeof(SuggestionCandidates),
+                                                                   SPELLCHECK_MEMORY_SUGGEST);
+    if (!found) return NULL;
+    found->count = 0;
+    found->sc = sc;
+    int maxDistance = 2; // Only suggest words within edit distance of 2
+    
+    // Candidates point into the snapshot, so hold it until they are copied
+    LONG slot;
+    DictionarySnapshot *snap = SnapshotAcquire(sc, &slot);
+    Dictionary *mainDict = &snap->mainDictionary;
+    *generation = snap->generation;
+    found->snap = snap;
     
-    for (int i = 0; i < sc->mainDictionary.count; i++) {
-        free(sc->mainDictionary.words[i]);
+    // Words the user writes first: they rank ahead of any equally close
+    // dictionary word, so the dictionary scans only have to beat them
+    EnterCriticalSection(&sc->suggestionLock);
+    *listVersion = sc->listVersion;
+    SuggestIndex *usedIndex, *recentIndex;
+    UsedWordIndexes(sc, &usedIndex, &recentIndex);
+    if (usedIndex) {
+        SuggestIndex_FindWithinDistance(usedIndex, word, maxDistance, OfferUsedSuggestion, NULL, found);
     }
-    free(sc->mainDictionary.words);
+    if (recentIndex) {
+        SuggestIndex_FindWithinDistance(recentIndex, word, maxDistance, OfferUsedSuggestion, NULL, found);
+    }
+    LeaveCriticalSection(&sc->suggestionLock);
     
-    for (int i = 0; i < sc->userDictionary.count; i++) {
-        free(sc->userDictionary.words[i]);
+    // DAWG backend: walk the graph, pruning prefixes already too far away.
+    // The walk compares folded letters, so suggestions come back lower-case.
+    char folded[256];
+    if (snap->mainDawg && FoldWord(word, folded, sizeof(folded))) {
+        Dawg_FindWithinDistance(snap->mainDawg, folded, maxDistance, CollectDawgSuggestion, found);
     }
-    free(sc->userDictionary.words);
     
-    for (int i = 0; i < sc->ignoredWords.count; i++) {
-        free(sc->ignoredWords.words[i]);
+    // Sorted array: only the nearby length buckets, filtered on letter
+    // histograms and visited most frequent first, until nothing left in
+    // a bucket can make the cut. Brute force if the index couldn't be built.
+    SuggestIndex *mainIndex = MainSuggestIndex(sc, snap);
+    if (mainIndex) {
+        SuggestIndex_FindWithinDistance(mainIndex, word, maxDistance, OfferIndexedSuggestion,
+                                        SuggestionCouldImprove, found);
+    } else {
+        for (int i = 0; i < mainDict->count; i++) {
+            const char *candidate = DisplayWord(mainDict->words[i]);
+            int dist = LevenshteinDistance(word, candidate);
+            if (dist >= 0 && dist <= maxDistance) OfferSuggestion(found, candidate, dist, FALSE);
+        }
     }
-    free(sc->ignoredWords.words);
     
-    free(sc->misspelled.words);
-    free(sc);
-}
-
-// Load dictionary from file
-BOOL SpellChecker_LoadDictionary(SpellChecker *sc, const char *filePath) {
-    if (!sc || !filePath) return FALSE;
+    // Then the compiled-in dictionary, if any
+    SuggestIndex *embeddedIndex = EmbeddedSuggestIndex(sc, snap);
+    if (embeddedIndex) {
+        SuggestIndex_FindWithinDistance(embeddedIndex, word, maxDistance, OfferIndexedSuggestion,
+                                        SuggestionCouldImprove, found);
+    } else {
+        for (unsigned int i = 0; i < EmbeddedWordCount(); i++) {
+            const char *candidate = EmbeddedWordAt(i);
+            int dist = LevenshteinDistance(word, candidate);
+            if (dist >= 0 && dist <= maxDistance) OfferSuggestion(found, candidate, dist, FALSE);
+        }
+    }
     
-    FILE *file = fopen(filePath, "r");
-    if (!file) {
-        return FALSE;
+    // Already in rank order
+    const char *words[MAX_SUGGESTIONS];
+    for (int i = 0; i < found->count; i++) {
+        words[i] = found->items[i].word;
     }
+    char **result = CopyWordList(NULL, words, found->count);
     
-    char line[256];
-    while (fgets(line, sizeof(line), file)) {
-        // Remove trailing whitespace
-        int len = strlen(line);
-        while (len > 0 && isspace((unsigned char)line[len - 1])) {
-            line[--len] = '\0';
-        }
-        
-        if (len == 0 || line[0] == '#') continue; // Skip empty lines and comments
-        
-        // Check if we need to expand capacity
-        if (sc->mainDictionary.count >= sc->mainDictionary.capacity) {
-            sc->mainDictionary.capacity *= 2;
-            char **newWords = (char **)realloc(sc->mainDictionary.words, 
-                                              sc->mainDictionary.capacity * sizeof(char *));
-            if (!newWords) {
-                fclose(file);
-                return FALSE;
-            }
-            sc->mainDictionary.words = newWords;
+    SnapshotRelease(sc, slot);
+    if (result) *count = found->count;
+    MemFree(sc, found, SPELLCHECK_MEMORY_SUGGEST);
+    return result;
+}
+
+// Cached entry for a folded word at 'generation' and 'listVersion'.
+// Caller holds suggestionLock.
+static SuggestionCacheEntry* FindCachedSuggestions(SpellChecker *sc, const char *folded, LONG generation,
+                                                   LONG listVersion) {
+    for (int i = 0; i < SPELLCHECK_SUGGESTION_CACHE_SIZE; i++) {
+        SuggestionCacheEntry *entry = &sc->suggestionCache[i];
+        if (entry->word[0] && entry->generation == generation && entry->listVersion == listVersion &&
+            strcmp(entry->word, folded) == 0) {
+            return entry;
         }
-        
-        // Add word to dictionary
-        sc->mainDictionary.words[sc->mainDictionary.count] = (char *)malloc(len + 1);
-        if (!sc->mainDictionary.words[sc->mainDictionary.count]) {
-            fclose(file);
-            return FALSE;
+    }
+    return NULL;
+}
+
+// Store a copy of a suggestion list, replacing a stale entry if there is
+// one and the least recently used entry otherwise
+static void CacheSuggestions(SpellChecker *sc, const char *folded, LONG generation, LONG listVersion,
+                             char **suggestions, int count) {
+    char **copy = CopyWordList(sc, (const char * const *)suggestions, count);
+    if (!copy) return;
+    
+    EnterCriticalSection(&sc->suggestionLock);
+    SuggestionCacheEntry *victim = FindCachedSuggestions(sc, folded, generation, listVersion);
+    for (int i = 0; !victim && i < SPELLCHECK_SUGGESTION_CACHE_SIZE; i++) {
+        SuggestionCacheEntry *entry = &sc->suggestionCache[i];
+        if (!entry->word[0] || entry->generation != generation || entry->listVersion != listVersion) victim = entry;
+    }
+    if (!victim) {
+        victim = &sc->suggestionCache[0];
+        for (int i = 1; i < SPELLCHECK_SUGGESTION_CACHE_SIZE; i++) {
+            if (sc->suggestionCache[i].lastUse < victim->lastUse) victim = &sc->suggestionCache[i];
         }
-        strcpy(sc->mainDictionary.words[sc->mainDictionary.count], line);
-        sc->mainDictionary.count++;
     }
     
-    fclose(file);
+    FreeWordList(sc, victim->suggestions, victim->count);
+    strcpy(victim->word, folded);
+    victim->generation = generation;
+    victim->listVersion = listVersion;
+    victim->lastUse = ++sc->suggestionClock;
+    victim->suggestions = copy;
+    victim->count = count;
+    LeaveCriticalSection(&sc->suggestionLock);
+}
+
+// Get suggestions for a misspelled word, from the cache when possible
+char** SpellChecker_GetSuggestions(SpellChecker *sc, const char *word, int *count) {
+    if (!sc || !word || !count) return NULL;
+    
+    *count = 0;
+    LONG generation, listVersion;
+    char folded[256];
+    if (!FoldWord(word, folded, sizeof(folded))) {
+        return ComputeSuggestions(sc, word, count, &generation, &listVersion);
+    }
     
-    // Sort the main dictionary for binary search
-    if (sc->mainDictionary.count > 0) {
-        qsort(sc->mainDictionary.words, sc->mainDictionary.count, sizeof(char *), DictionaryComparator);
+    generation = SpellChecker_GetGeneration(sc);
+    EnterCriticalSection(&sc->suggestionLock);
+    SuggestionCacheEntry *entry = FindCachedSuggestions(sc, folded, generation, sc->listVersion);
+    if (entry) {
+        entry->lastUse = ++sc->suggestionClock;
+        char **result = CopyWordList(NULL, (const char * const *)entry->suggestions, entry->count);
+        if (result) *count = entry->count;
+        LeaveCriticalSection(&sc->suggestionLock);
+        return result;
     }
+    LeaveCriticalSection(&sc->suggestionLock);
     
-    return sc->mainDictionary.count > 0;
+    char **result = ComputeSuggestions(sc, word, count, &generation, &listVersion);
+    if (result) {
+        CacheSuggestions(sc, folded, generation, listVersion, result, *count);
+    }
+    return result;
 }
 
-// Load user dictionary from file
-BOOL SpellChecker_LoadUserDictionary(SpellChecker *sc, const char *filePath) {
-    if (!sc || !filePath) return FALSE;
+// Background thread: drain the warm queue one word at a time
+static DWORD WINAPI SuggestionWarmThread(LPVOID param) {
+    SpellChecker *sc = (SpellChecker *)param;
+    HANDLE handles[2] = { sc->warmStopEvent, sc->warmWakeEvent };
     
-    FILE *file = fopen(filePath, "r");
-    if (!file) {
-        return TRUE; // Not an error if user dict doesn't exist yet
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+        for (;;) {
+            if (WaitForSingleObject(sc->warmStopEvent, 0) == WAIT_OBJECT_0) return 0;
+            
+            char word[256];
+            EnterCriticalSection(&sc->suggestionLock);
+            BOOL pending = sc->warmHead < sc->warmCount;
+            if (pending) strcpy(word, sc->warmQueue[sc->warmHead++]);
+            LeaveCriticalSection(&sc->suggestionLock);
+            if (!pending) break;
+            
+            int count;
+            LONG generation, listVersion;
+            char **suggestions = ComputeSuggestions(sc, word, &count, &generation, &listVersion);
+            if (suggestions) {
+                CacheSuggestions(sc, word, generation, listVersion, suggestions, count);
+                SpellChecker_FreeSuggestions(suggestions, count);
+            }
+        }
     }
+    return 0;
+}
+
+// Queue the flagged words that aren't cached yet, in text order
+void SpellChecker_WarmSuggestions(SpellChecker *sc, const MisspelledWordList *list) {
+    if (!sc || !list || !sc->suggestionsEnabled) return;
     
-    char line[256];
-    while (fgets(line, sizeof(line), file)) {
-        int len = strlen(line);
-        while (len > 0 && isspace((unsigned char)line[len - 1])) {
-            line[--len] = '\0';
-        }
-        
-        if (len == 0) continue;
+    LONG generation = SpellChecker_GetGeneration(sc);
+    
+    EnterCriticalSection(&sc->suggestionLock);
+    sc->warmHead = 0;
+    sc->warmCount = 0;
+    for (int i = 0; i < list->count && sc->warmCount < SPELLCHECK_WARM_QUEUE_SIZE; i++) {
+        char folded[256];
+        if (!FoldWord(list->words[i].word, folded, sizeof(folded))) continue;
+        if (FindCachedSuggestions(sc, folded, generation, sc->listVersion)) continue;
         
-        if (sc->userDictionary.count >= sc->userDictionary.capacity) {
-            sc->userDictionary.capacity *= 2;
-            char **newWords = (char **)realloc(sc->userDictionary.words,
-                                              sc->userDictionary.capacity * sizeof(char *));
-            if (!newWords) {
-                fclose(file);
-                return FALSE;
-            }
-            sc->userDictionary.words = newWords;
-        }
+        int j;
+        for (j = 0; j < sc->warmCount && strcmp(sc->warmQueue[j], folded) != 0; j++) {}
+        if (j < sc->warmCount) continue;
+        strcpy(sc->warmQueue[sc->warmCount++], folded);
+    }
+    BOOL pending = sc->warmCount > 0;
+    LeaveCriticalSection(&sc->suggestionLock);
+    
+    if (!pending) return;
+    
+    // Started on first use; most sessions never need it
+    if (!sc->warmThread) {
+        if (!sc->warmWakeEvent) sc->warmWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (!sc->warmStopEvent) sc->warmStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (!sc->warmWakeEvent || !sc->warmStopEvent) return;
+        sc->warmThread = CreateThread(NULL, 0, SuggestionWarmThread, sc, 0, NULL);
+        if (!sc->warmThread) return;
+    }
+    SetEvent(sc->warmWakeEvent);
+}
+
+// Free suggestions array
+void SpellChecker_FreeSuggestions(char **suggestions, int count) {
+    FreeWordList(NULL, suggestions, count);
+}
+
+// Whether a word as written starts with a folded prefix
+static BOOL HasFoldedPrefix(const char *word, const char *prefix, int prefixLen) {
+    char folded[256];
+    if ((int)strlen(word) < prefixLen) return FALSE;
+    Utf8_Fold(word, prefixLen, folded);
+    return memcmp(folded, prefix, prefixLen) == 0;
+}
+
+// Index of the first entry not below a folded prefix in a sorted dictionary
+static int LowerBoundDictionary(Dictionary *dict, const char *prefix) {
+    int left = 0, right = dict->count;
+    while (left < right) {
+        int mid = left + (right - left) / 2;
+        if (strcmp(dict->words[mid], prefix) < 0) left = mid + 1;
+        else right = mid;
+    }
+    return left;
+}
+
+// Same over the embedded words in folded order
+static unsigned int LowerBoundEmbedded(const char *prefix) {
+    unsigned int left = 0, right = EmbeddedWordCount();
+    while (left < right) {
+        unsigned int mid = left + (right - left) / 2;
+        if (CompareFolded(EmbeddedSortedWordAt(mid), prefix) < 0) left = mid + 1;
+        else right = mid;
+    }
+    return left;
+}
+
+// Keep the sorted copy of a used word's count in step with the table
+static void UpdateSortedWordUse(SpellChecker *sc, const WordUse *use) {
+    if (!sc->usedOrderValid) return;
+    WordUse *copy = FindInWordUses(sc->usedSorted, sc->usedSortedCount, use->word);
+    if (!copy) copy = FindInWordUses(sc->recentUses, sc->recentUseCount, use->word);
+    if (copy) copy->count = use->count;
+}
+
+// Put a newly used word into the recent run. Once that is full the sorted
+// runs are left to be rebuilt whole when next needed.
+static void AddRecentWordUse(SpellChecker *sc, const WordUse *use) {
+    if (!sc->usedOrderValid) return;
+    if (!sc->recentUses) {
+        sc->recentUses = (WordUse *)MemAlloc(sc, SPELLCHECK_RECENT_WORD_USES * sizeof(WordUse),
+                                             SPELLCHECK_MEMORY_USAGE);
+    }
+    if (!sc->recentUses || sc->recentUseCount >= SPELLCHECK_RECENT_WORD_USES) {
+        sc->usedOrderValid = FALSE;
+        return;
+    }
+    int i = LowerBoundWordUses(sc->recentUses, sc->recentUseCount, use->word);
+    memmove(&sc->recentUses[i + 1], &sc->recentUses[i], (sc->recentUseCount - i) * sizeof(WordUse));
+    sc->recentUses[i] = *use;
+    sc->recentUseCount++;
+    sc->recentIndexValid = FALSE;
+}
+
+// Count 'uses' uses of a word in the usage table, growing it when 3/4
+// full. Entries are dictionary-style "folded\0display" strings. Caller
+// holds suggestionLock.
+static BOOL RecordOneWordUse(SpellChecker *sc, const char *word, int len, int uses) {
+    if ((sc->wordUseCount + 1) * 4 > sc->wordUseCapacity * 3) {
+        int newCapacity = sc->wordUseCapacity > 0 ? sc->wordUseCapacity * 2 : 256;
+        WordUse *newUses = (WordUse *)MemCalloc(sc, newCapacity, sizeof(WordUse), SPELLCHECK_MEMORY_USAGE);
+        if (!newUses) return FALSE;
         
-        sc->userDictionary.words[sc->userDictionary.count] = (char *)malloc(len + 1);
-        if (!sc->userDictionary.words[sc->userDictionary.count]) {
-            fclose(file);
-            return FALSE;
+        for (int i = 0; i < sc->wordUseCapacity; i++) {
+            if (!sc->wordUses[i].word) continue;
+            unsigned int h = FoldedHash(sc->wordUses[i].word) & (newCapacity - 1);
+            while (newUses[h].word) h = (h + 1) & (newCapacity - 1);
+            newUses[h] = sc->wordUses[i];
         }
-        strcpy(sc->userDictionary.words[sc->userDictionary.count], line);
-        sc->userDictionary.count++;
+        MemFree(sc, sc->wordUses, SPELLCHECK_MEMORY_USAGE);
+        sc->wordUses = newUses;
+        sc->wordUseCapacity = newCapacity;
     }
     
-    fclose(file);
+    char folded[256];
+    Utf8_Fold(word, len, folded);
     
-    // Sort the user dictionary for binary search
-    if (sc->userDictionary.count > 0) {
-        qsort(sc->userDictionary.words, sc->userDictionary.count, sizeof(char *), DictionaryComparator);
+    unsigned int mask = sc->wordUseCapacity - 1;
+    unsigned int h = FoldedHash(folded) & mask;
+    while (sc->wordUses[h].word) {
+        if (strcmp(sc->wordUses[h].word, folded) == 0) {
+            sc->wordUses[h].count += uses;
+            UpdateSortedWordUse(sc, &sc->wordUses[h]);
+            return TRUE;
+        }
+        h = (h + 1) & mask;
     }
     
+    sc->wordUses[h].word = NewDictionaryEntry(sc, word, len, SPELLCHECK_MEMORY_USAGE);
+    if (!sc->wordUses[h].word) return FALSE;
+    sc->wordUses[h].count = uses;
+    sc->wordUseCount++;
+    AddRecentWordUse(sc, &sc->wordUses[h]);
     return TRUE;
 }
 
-// Check if a word is correct
-BOOL SpellChecker_IsWordCorrect(SpellChecker *sc, const char *word) {
-    if (!sc || !word || strlen(word) == 0) return TRUE;
+// Count the words of committed text so completions and suggestions can rank them
+void SpellChecker_RecordWordUse(SpellChecker *sc, const char *text) {
+    if (!sc || !text) return;
     
-    // Check ignore list first (ignored words are treated as correct)
-    if (BinarySearchDictionary(&sc->ignoredWords, word)) return TRUE;
+    BOOL recorded = FALSE;
+    size_t length = strlen(text);
+    size_t pos = 0, wordStart, wordLength;
+    EnterCriticalSection(&sc->suggestionLock);
+    while (Utf8_NextWord(text, length, &pos, &wordStart, &wordLength)) {
+        const char *word = text + wordStart;
+        size_t wordLen = Utf8_TruncateLength(word, wordLength, 255);
+        
+        // Single letters are never worth completing
+        unsigned int first;
+        if ((size_t)Utf8_Decode((const unsigned char *)word, wordLen, &first) == wordLen) continue;
+        if (RecordOneWordUse(sc, word, (int)wordLen, 1)) recorded = TRUE;
+    }
     
-    // Check main dictionary
-    if (BinarySearchDictionary(&sc->mainDictionary, word)) return TRUE;
+    if (recorded) sc->listVersion++;
+    LeaveCriticalSection(&sc->suggestionLock);
+}
+
+void SpellChecker_RecordWordCount(SpellChecker *sc, const char *word, int count) {
+    if (!sc || !word || count <= 0) return;
     
-    // Check user dictionary
-    if (BinarySearchDictionary(&sc->userDictionary, word)) return TRUE;
+    size_t len = Utf8_TruncateLength(word, strlen(word), 255);
+    if (len == 0) return;
     
-    return FALSE;
+    EnterCriticalSection(&sc->suggestionLock);
+    if (RecordOneWordUse(sc, word, (int)len, count)) sc->listVersion++;
+    LeaveCriticalSection(&sc->suggestionLock);
 }
 
-// Extract words from text and check spelling
-void SpellChecker_Check(SpellChecker *sc, const char *text) {
-    if (!sc || !sc->enabled) {
-        if (sc) sc->misspelled.count = 0;
-        return;
-    }
-    
-    // Reset misspelled list at start of every pass
-    sc->misspelled.count = 0;
+#define COMPLETION_CANDIDATES (SPELLCHECK_MAX_COMPLETIONS * 7)
+
+// Completion candidates gathered from every word source. Words are copied
+// because the DAWG walk hands out a transient buffer; their folded keys
+// are kept alongside for dedupe and ordering.
+typedef struct {
+    char words[COMPLETION_CANDIDATES][256];
+    char keys[COMPLETION_CANDIDATES][256];
+    int uses[COMPLETION_CANDIDATES];
+    int count;
+    int k;
+    int prefixLen;
+    int added;       // Added by the source being scanned
+} CompletionCandidates;
+
+// Add a candidate unless it is a duplicate or just the prefix itself
+static BOOL AddCompletionCandidate(CompletionCandidates *found, const char *word, int uses) {
+    if ((int)strlen(word) == found->prefixLen) return FALSE;
+    if (found->count >= COMPLETION_CANDIDATES) return FALSE;
     
-    // Handle empty text
-    if (!text || strlen(text) == 0) {
-        return;
+    char *key = found->keys[found->count];
+    Utf8_Fold(word, Utf8_TruncateLength(word, strlen(word), 255), key);
+    for (int i = 0; i < found->count; i++) {
+        if (strcmp(found->keys[i], key) == 0) return FALSE;
     }
     
-    const char *ptr = text;
-    DWORD pos = 0;
-    
-    while (*ptr) {
-        // Skip non-alphabetic characters
-        while (*ptr && !isalpha((unsigned char)*ptr)) {
-            ptr++;
-            pos++;
-        }
-        
-        if (!*ptr) break;
-        
-        // Extract word
-        DWORD wordStart = pos;
-        char word[256] = {0};
-        int wordLen = 0;
-        
-        while (*ptr && isalpha((unsigned char)*ptr) && wordLen < sizeof(word) - 1) {
-            word[wordLen++] = *ptr;
-            ptr++;
-            pos++;
-        }
-        word[wordLen] = '\0';
+    strncpy(found->words[found->count], word, 255);
+    found->words[found->count][255] = '\0';
+    found->uses[found->count] = uses;
+    found->count++;
+    found->added++;
+    return TRUE;
+}
+
+static BOOL CollectDawgCompletion(const char *word, int distance, void *context) {
+    CompletionCandidates *found = (CompletionCandidates *)context;
+    AddCompletionCandidate(found, word, 0);
+    return found->added < found->k;
+}
+
+// First 'k' new words with the folded prefix from one sorted dictionary
+static void CollectDictionaryCompletions(CompletionCandidates *found, Dictionary *dict, const char *prefix) {
+    found->added = 0;
+    for (int i = LowerBoundDictionary(dict, prefix);
+         i < dict->count && found->added < found->k && strncmp(dict->words[i], prefix, found->prefixLen) == 0;
+         i++) {
+        AddCompletionCandidate(found, DisplayWord(dict->words[i]), 0);
+    }
+}
+
+// Keep the k most used known words with the folded prefix from one sorted
+// run of used words; only the run's words with the prefix are visited.
+// Caller holds suggestionLock.
+static void CollectUsedCompletions(SpellChecker *sc, DictionarySnapshot *snap, int profile,
+                                   CompletionCandidates *found, const WordUse *uses, int count, const char *prefix) {
+    int prefixLen = found->prefixLen;
+    for (int i = LowerBoundWordUses(uses, count, prefix);
+         i < count && strncmp(uses[i].word, prefix, prefixLen) == 0; i++) {
+        const WordUse *use = &uses[i];
+        if ((int)strlen(use->word) == prefixLen) continue;
         
-        // Check spelling
-        if (!SpellChecker_IsWordCorrect(sc, word)) {
-            // Add to misspelled list
-            if (sc->misspelled.count >= sc->misspelled.capacity) {
-                sc->misspelled.capacity *= 2;
-                MisspelledWord *newWords = (MisspelledWord *)realloc(sc->misspelled.words,
-                                                                     sc->misspelled.capacity * sizeof(MisspelledWord));
-                if (!newWords) return;
-                sc->misspelled.words = newWords;
+        if (found->count == found->k) {
+            int least = 0;
+            for (int j = 1; j < found->count; j++) {
+                if (found->uses[j] < found->uses[least]) least = j;
             }
+            if (use->count <= found->uses[least]) continue;
+            if (!IsWordCorrectIn(sc, snap, profile, use->word)) continue;
             
-            sc->misspelled.words[sc->misspelled.count].startPos = wordStart;
-            sc->misspelled.words[sc->misspelled.count].endPos = pos;
-            strcpy(sc->misspelled.words[sc->misspelled.count].word, word);
-            sc->misspelled.count++;
+            // Drop the least used candidate to make room
+            found->count--;
+            if (least != found->count) {
+                memcpy(found->words[least], found->words[found->count], 256);
+                memcpy(found->keys[least], found->keys[found->count], 256);
+                found->uses[least] = found->uses[found->count];
+            }
+        } else if (!IsWordCorrectIn(sc, snap, profile, use->word)) {
+            continue;
         }
+        AddCompletionCandidate(found, DisplayWord(use->word), use->count);
     }
 }
 
-// Get suggestions for a misspelled word
-char** SpellChecker_GetSuggestions(SpellChecker *sc, const char *word, int *count) {
-    if (!sc || !word || !count) return NULL;
+// Complete a prefix from the used, main, glossary and user words. Not safe to call
+// concurrently on one checker: it updates the completion cache.
+char** SpellChecker_Complete(SpellChecker *sc, const char *prefix, int k, int *count) {
+    if (!sc || !prefix || !count) return NULL;
     
     *count = 0;
+    char folded[256];
+    if (!FoldWord(prefix, folded, sizeof(folded))) return NULL;
+    prefix = folded;
+    int prefixLen = strlen(prefix);
+    if (prefixLen == 0 || k <= 0) return NULL;
+    if (k > SPELLCHECK_MAX_COMPLETIONS) k = SPELLCHECK_MAX_COMPLETIONS;
     
-    typedef struct {
-        char *word;
-        int distance;
-    } Suggestion;
-    
-    Suggestion *suggestions = (Suggestion *)malloc(10 * sizeof(Suggestion));
-    if (!suggestions) return NULL;
+    LONG slot;
+    DictionarySnapshot *snap = SnapshotAcquire(sc, &slot);
+    LONG generation = snap->generation;
+    int profile = sc->activeProfile;
     
-    int suggestCount = 0;
-    int maxDistance = 2; // Only suggest words within edit distance of 2
+    // Typing usually revisits the same few prefixes (backspace, retyping)
+    CompletionCacheEntry *cached = &sc->completionCache[FoldedHash(prefix) % SPELLCHECK_COMPLETION_CACHE_SIZE];
+    if (prefixLen < (int)sizeof(cached->prefix) && cached->k == k &&
+        cached->generation == generation && cached->listVersion == sc->listVersion &&
+        strcmp(cached->prefix, prefix) == 0) {
+        SnapshotRelease(sc, slot);
+        
+        const char *words[SPELLCHECK_MAX_COMPLETIONS];
+        for (int i = 0; i < cached->count; i++) words[i] = cached->words[i];
+        char **result = CopyWordList(NULL, words, cached->count);
+        if (result) *count = cached->count;
+        return result;
+    }
     
-    // Check main dictionary
-    for (int i = 0; i < sc->mainDictionary.count && suggestCount < 10; i++) {
-        int dist = LevenshteinDistance(word, sc->mainDictionary.words[i]);
-        if (dist > 0 && dist <= maxDistance) {
-            suggestions[suggestCount].word = sc->mainDictionary.words[i];
-            suggestions[suggestCount].distance = dist;
-            suggestCount++;
-        }
+    CompletionCandidates *found = (CompletionCandidates *)MemAlloc(sc, sizeof(CompletionCandidates),
+                                                                   SPELLCHECK_MEMORY_SUGGEST);
+    if (!found) {
+        SnapshotRelease(sc, slot);
+        return NULL;
     }
+    found->count = 0;
+    found->k = k;
+    found->prefixLen = prefixLen;
     
-    // Sort by distance
-    for (int i = 0; i < suggestCount - 1; i++) {
-        for (int j = i + 1; j < suggestCount; j++) {
-            if (suggestions[j].distance < suggestions[i].distance) {
-                Suggestion temp = suggestions[i];
-                suggestions[i] = suggestions[j];
-                suggestions[j] = temp;
-            }
-        }
+    // The k most used known words with this prefix, from both sorted runs...
+    EnterCriticalSection(&sc->suggestionLock);
+    if (BuildUsedOrder(sc)) {
+        CollectUsedCompletions(sc, snap, profile, found, sc->usedSorted, sc->usedSortedCount, prefix);
+        CollectUsedCompletions(sc, snap, profile, found, sc->recentUses, sc->recentUseCount, prefix);
     }
+    LeaveCriticalSection(&sc->suggestionLock);
     
-    // Limit to top 5 suggestions
-    if (suggestCount > 5) suggestCount = 5;
+    // ...then the first k new words of each dictionary, alphabetically.
+    // Whatever the used words displaced, k from each source is enough.
+    if (snap->mainDawg) {
+        found->added = 0;
+        Dawg_EnumeratePrefix(snap->mainDawg, prefix, CollectDawgCompletion, found);
+    }
+    CollectDictionaryCompletions(found, &snap->mainDictionary, prefix);
+    CollectDictionaryCompletions(found, &snap->profileWords[profile].glossary, prefix);
+    CollectDictionaryCompletions(found, &snap->profileWords[profile].userDictionary, prefix);
+    CollectDictionaryCompletions(found, &sc->profiles[profile].addedWords, prefix);
     
-    // Convert to result array
-    char **result = (char **)malloc((suggestCount + 1) * sizeof(char *));
-    if (!result) {
-        free(suggestions);
-        return NULL;
+    found->added = 0;
+    for (unsigned int i = LowerBoundEmbedded(prefix); i < EmbeddedWordCount() && found->added < k; i++) {
+        const char *candidate = EmbeddedSortedWordAt(i);
+        if (!HasFoldedPrefix(candidate, prefix, prefixLen)) break;
+        AddCompletionCandidate(found, candidate, 0);
     }
     
-    for (int i = 0; i < suggestCount; i++) {
-        int len = strlen(suggestions[i].word);
-        result[i] = (char *)malloc(len + 1);
-        if (!result[i]) {
-            for (int j = 0; j < i; j++) free(result[j]);
-            free(result);
-            free(suggestions);
-            return NULL;
+    SnapshotRelease(sc, slot);
+    
+    // Most used first, ties alphabetical
+    const char *ranked[COMPLETION_CANDIDATES];
+    const char *rankedKeys[COMPLETION_CANDIDATES];
+    int rankedUses[COMPLETION_CANDIDATES];
+    for (int i = 0; i < found->count; i++) {
+        int j = i;
+        while (j > 0 && (rankedUses[j - 1] < found->uses[i] ||
+                         (rankedUses[j - 1] == found->uses[i] &&
+                          strcmp(rankedKeys[j - 1], found->keys[i]) > 0))) {
+            ranked[j] = ranked[j - 1];
+            rankedKeys[j] = rankedKeys[j - 1];
+            rankedUses[j] = rankedUses[j - 1];
+            j--;
         }
-        strcpy(result[i], suggestions[i].word);
+        ranked[j] = found->words[i];
+        rankedKeys[j] = found->keys[i];
+        rankedUses[j] = found->uses[i];
     }
-    result[suggestCount] = NULL;
+    int resultCount = found->count < k ? found->count : k;
     
-    free(suggestions);
-    *count = suggestCount;
-    return result;
-}
-
-// Free suggestions array
-void SpellChecker_FreeSuggestions(char **suggestions, int count) {
-    if (!suggestions) return;
-    for (int i = 0; i < count; i++) {
-        free(suggestions[i]);
+    // Remember the answer unless a word is too long for the cache slot
+    BOOL cacheable = prefixLen < (int)sizeof(cached->prefix);
+    for (int i = 0; cacheable && i < resultCount; i++) {
+        if (strlen(ranked[i]) >= sizeof(cached->words[i])) cacheable = FALSE;
     }
-    free(suggestions);
+    if (cacheable) {
+        strcpy(cached->prefix, prefix);
+        cached->k = k;
+        cached->generation = generation;
+        cached->listVersion = sc->listVersion;
+        cached->count = resultCount;
+        for (int i = 0; i < resultCount; i++) strcpy(cached->words[i], ranked[i]);
+    }
+    
+    char **result = CopyWordList(NULL, ranked, resultCount);
+    MemFree(sc, found, SPELLCHECK_MEMORY_SUGGEST);
+    if (result) *count = resultCount;
+    return result;
 }
 
 // Get misspelled words
@@ -408,46 +2588,61 @@ BOOL SpellChecker_IsMisspelledAtPosition(SpellChecker *sc, DWORD pos, char *outW
 void SpellChecker_AddToUserDictionary(SpellChecker *sc, const char *word) {
     if (!sc || !word) return;
     
-    // Check if already in user dictionary
-    if (BinarySearchDictionary(&sc->userDictionary, word)) return;
-    
-    if (sc->userDictionary.count >= sc->userDictionary.capacity) {
-        sc->userDictionary.capacity *= 2;
-        char **newWords = (char **)realloc(sc->userDictionary.words,
-                                          sc->userDictionary.capacity * sizeof(char *));
-        if (!newWords) return;
-        sc->userDictionary.words = newWords;
-    }
-    
-    int len = strlen(word);
-    sc->userDictionary.words[sc->userDictionary.count] = (char *)malloc(len + 1);
-    if (!sc->userDictionary.words[sc->userDictionary.count]) return;
+    char folded[256];
+    if (!FoldWord(word, folded, sizeof(folded))) return;
     
-    strcpy(sc->userDictionary.words[sc->userDictionary.count], word);
-    sc->userDictionary.count++;
+    // Check if already in user dictionary (as loaded or added this session)
+    int index = sc->activeProfile;
+    SpellCheckProfile *profile = &sc->profiles[index];
+    LONG slot;
+    DictionarySnapshot *snap = SnapshotAcquire(sc, &slot);
+    BOOL known = BinarySearchDictionary(&snap->profileWords[index].userDictionary, folded);
+    SnapshotRelease(sc, slot);
+    if (known || BinarySearchDictionary(&profile->addedWords, folded)) return;
     
-    // Re-sort the user dictionary to maintain sorted order for binary search
-    if (sc->userDictionary.count > 0) {
-        qsort(sc->userDictionary.words, sc->userDictionary.count, sizeof(char *), DictionaryComparator);
+    // A suggestion warm-up may be reading the list, which moves when it grows
+    EnterCriticalSection(&sc->suggestionLock);
+    if (AppendDictionaryWord(sc, &profile->addedWords, word, strlen(word))) {
+        // Re-sort the added words to maintain sorted order for binary search
+        qsort(profile->addedWords.words, profile->addedWords.count, sizeof(char *), DictionaryComparator);
+        sc->listVersion++;
+        profile->verdictVersion = ++sc->verdictVersion;
     }
+    LeaveCriticalSection(&sc->suggestionLock);
 }
 
-// Save user dictionary to file
+// Save user dictionary to file: the loaded words merged with this
+// session's additions, in sorted order
 void SpellChecker_SaveUserDictionary(SpellChecker *sc, const char *filePath) {
     if (!sc || !filePath) return;
     
     FILE *file = fopen(filePath, "w");
     if (!file) return;
     
-    // Ensure sorted before saving
-    if (sc->userDictionary.count > 0) {
-        qsort(sc->userDictionary.words, sc->userDictionary.count, sizeof(char *), DictionaryComparator);
-    }
+    LONG slot;
+    DictionarySnapshot *snap = SnapshotAcquire(sc, &slot);
+    int profile = sc->activeProfile;
+    Dictionary *loaded = &snap->profileWords[profile].userDictionary;
+    Dictionary *added = &sc->profiles[profile].addedWords;
     
-    for (int i = 0; i < sc->userDictionary.count; i++) {
-        fprintf(file, "%s\n", sc->userDictionary.words[i]);
+    int i = 0, j = 0;
+    while (i < loaded->count || j < added->count) {
+        if (j >= added->count) {
+            fprintf(file, "%s\n", DisplayWord(loaded->words[i++]));
+        } else if (i >= loaded->count) {
+            fprintf(file, "%s\n", DisplayWord(added->words[j++]));
+        } else {
+            int cmp = strcmp(loaded->words[i], added->words[j]);
+            if (cmp <= 0) {
+                fprintf(file, "%s\n", DisplayWord(loaded->words[i++]));
+                if (cmp == 0) j++;
+            } else {
+                fprintf(file, "%s\n", DisplayWord(added->words[j++]));
+            }
+        }
     }
     
+    SnapshotRelease(sc, slot);
     fclose(file);
 }
 
@@ -455,37 +2650,95 @@ void SpellChecker_SaveUserDictionary(SpellChecker *sc, const char *filePath) {
 void SpellChecker_AddToIgnoreList(SpellChecker *sc, const char *word) {
     if (!sc || !word) return;
     
-    // Check if already in ignore list
-    if (BinarySearchDictionary(&sc->ignoredWords, word)) return;
-    
-    if (sc->ignoredWords.count >= sc->ignoredWords.capacity) {
-        sc->ignoredWords.capacity *= 2;
-        char **newWords = (char **)realloc(sc->ignoredWords.words,
-                                          sc->ignoredWords.capacity * sizeof(char *));
-        if (!newWords) return;
-        sc->ignoredWords.words = newWords;
-    }
-    
-    int len = strlen(word);
-    sc->ignoredWords.words[sc->ignoredWords.count] = (char *)malloc(len + 1);
-    if (!sc->ignoredWords.words[sc->ignoredWords.count]) return;
+    char folded[256];
+    if (!FoldWord(word, folded, sizeof(folded))) return;
     
-    strcpy(sc->ignoredWords.words[sc->ignoredWords.count], word);
-    sc->ignoredWords.count++;
+    // Check if already in ignore list
+    SpellCheckProfile *profile = &sc->profiles[sc->activeProfile];
+    if (BinarySearchDictionary(&profile->ignoredWords, folded)) return;
     
-    // Re-sort the ignore list to maintain sorted order for binary search
-    if (sc->ignoredWords.count > 0) {
-        qsort(sc->ignoredWords.words, sc->ignoredWords.count, sizeof(char *), DictionaryComparator);
+    EnterCriticalSection(&sc->suggestionLock);
+    if (AppendDictionaryWord(sc, &profile->ignoredWords, word, strlen(word))) {
+        // Re-sort the ignore list to maintain sorted order for binary search
+        qsort(profile->ignoredWords.words, profile->ignoredWords.count, sizeof(char *), DictionaryComparator);
+        sc->listVersion++;
+        profile->verdictVersion = ++sc->verdictVersion;
     }
+    LeaveCriticalSection(&sc->suggestionLock);
 }
 
 // Clear all ignored words (useful for starting a new session)
 void SpellChecker_ClearIgnoreList(SpellChecker *sc) {
     if (!sc) return;
     
-    for (int i = 0; i < sc->ignoredWords.count; i++) {
-        free(sc->ignoredWords.words[i]);
+    SpellCheckProfile *profile = &sc->profiles[sc->activeProfile];
+    EnterCriticalSection(&sc->suggestionLock);
+    for (int i = 0; i < profile->ignoredWords.count; i++) {
+        FreeDictionaryEntry(sc, &profile->ignoredWords, profile->ignoredWords.words[i]);
     }
-    sc->ignoredWords.count = 0;
+    profile->ignoredWords.count = 0;
+    sc->listVersion++;
+    profile->verdictVersion = ++sc->verdictVersion;
+    LeaveCriticalSection(&sc->suggestionLock);
+}
+
+// Add a profile with no words of its own yet. Setup-time, like loading:
+// checks may already read the profile table.
+int SpellChecker_AddProfile(SpellChecker *sc, const char *name) {
+    if (!sc || !name) return -1;
+    
+    EnterCriticalSection(&sc->reloadLock);
+    int index = sc->profileCount;
+    if (index >= SPELLCHECK_MAX_PROFILES) {
+        LeaveCriticalSection(&sc->reloadLock);
+        return -1;
+    }
+    
+    SpellCheckProfile *profile = &sc->profiles[index];
+    memset(profile, 0, sizeof(SpellCheckProfile));
+    strncpy(profile->name, name, sizeof(profile->name) - 1);
+    profile->addedWords.capacity = 100;
+    profile->addedWords.words = (char **)MemAlloc(sc, 100 * sizeof(char *), SPELLCHECK_MEMORY_DICTIONARY);
+    profile->ignoredWords.capacity = 100;
+    profile->ignoredWords.words = (char **)MemAlloc(sc, 100 * sizeof(char *), SPELLCHECK_MEMORY_DICTIONARY);
+    if (!profile->addedWords.words || !profile->ignoredWords.words) {
+        FreeDictionary(sc, &profile->addedWords);
+        FreeDictionary(sc, &profile->ignoredWords);
+        LeaveCriticalSection(&sc->reloadLock);
+        return -1;
+    }
+    
+    profile->verdictVersion = ++sc->verdictVersion;
+    sc->profileCount++;
+    LeaveCriticalSection(&sc->reloadLock);
+    return index;
+}
+
+// Index of the profile called 'name' (case-insensitive), or -1
+int SpellChecker_FindProfile(SpellChecker *sc, const char *name) {
+    if (!sc || !name) return -1;
+    for (int i = 0; i < sc->profileCount; i++) {
+        if (_stricmp(sc->profiles[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// Make 'profile' the one checks, lookups and completions go through. The
+// snapshot already holds every profile's words, so this is one store;
+// passes that already started finish with the profile they began with.
+BOOL SpellChecker_SelectProfile(SpellChecker *sc, int profile) {
+    if (!sc || profile < 0 || profile >= sc->profileCount) return FALSE;
+    if (sc->activeProfile == profile) return TRUE;
+    
+    // Warm-ups read the active profile's lists under the lock
+    EnterCriticalSection(&sc->suggestionLock);
+    InterlockedExchange(&sc->activeProfile, profile);
+    sc->listVersion++;
+    LeaveCriticalSection(&sc->suggestionLock);
+    return TRUE;
+}
+
+int SpellChecker_GetProfile(SpellChecker *sc) {
+    return sc ? sc->activeProfile : SPELLCHECK_DEFAULT_PROFILE;
 }
 
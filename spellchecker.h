@@ -2,57 +2,388 @@
 #define SPELLCHECKER_H
 
 #include <windows.h>
+#include "dawg.h"
+#include "suggestindex.h"
+#include "spans.h"
 
-typedef struct {
-    DWORD startPos;
-    DWORD endPos;
-    char word[256];
-} MisspelledWord;
+// Block holding the entries of one loaded file, freed with the dictionary
+typedef struct DictionaryPool {
+    struct DictionaryPool *next;
+    char *data;
+    size_t size;
+} DictionaryPool;
 
+// Entries are "folded\0display\0", sorted by the folded form (see
+// utf8.h) so lookups are plain byte compares. Words loaded from a file are
+// packed into its pool; words added one at a time are their own allocation.
 typedef struct {
-    MisspelledWord *words;
+    char **words;
     int count;
     int capacity;
-} MisspelledWordList;
+    DictionaryPool *pools;
+} Dictionary;
+
+#define SPELLCHECK_MAX_DICTIONARY_FILES 8
+#define SPELLCHECK_RELOAD_POLL_MS 5000
+#define SPELLCHECK_RELOAD_SETTLE_MS 250
+
+// Representation of the main dictionary. The sorted array keeps every
+// word whole, packed into its file's pool; the DAWG shares prefixes and
+// suffixes and is much smaller for large or multi-language lists.
+typedef enum {
+    SPELLCHECK_BACKEND_SORTED_ARRAY = 0,
+    SPELLCHECK_BACKEND_DAWG
+} SpellCheckBackend;
 
 typedef struct {
-    char **words;
+    SpellCheckBackend backend;
+    int wordCount;
+    size_t bytes;
+} DictionaryStats;
+
+// How common a word is, for ranking suggestions
+typedef struct {
+    char *word;             // Folded
+    DWORD count;
+} WordFrequency;
+
+#define SPELLCHECK_MAX_PROFILES 8
+#define SPELLCHECK_DEFAULT_PROFILE 0
+
+// A profile's words from its files, as last loaded
+typedef struct {
+    Dictionary glossary;         // Team glossary
+    Dictionary userDictionary;   // e.g. user_dictionary.txt
+} ProfileWords;
+
+// Immutable once published. Checks pin one snapshot for the length of a
+// pass; a hot reload builds a new one and swaps the pointer. The main
+// dictionary is the base every profile shares; each profile only adds
+// its own overlays.
+typedef struct {
+    Dictionary mainDictionary;
+    Dawg *mainDawg;              // Replaces mainDictionary with the DAWG backend
+    SuggestIndex * volatile mainIndex;      // Suggestion layout of mainDictionary, built on first use
+    SuggestIndex * volatile embeddedIndex;  // Of the compiled-in words, built on first use
+    ProfileWords profileWords[SPELLCHECK_MAX_PROFILES];
+    WordFrequency *frequencies;  // Sorted by word; ranks the suggestion indexes
+    int frequencyCount;
+    LONG generation;
+} DictionarySnapshot;
+
+typedef struct {
+    char path[MAX_PATH];
+    FILETIME lastWrite;
+    DWORD sizeLow;
+} DictionaryFile;
+
+typedef void (*SpellCheckerReloadCallback)(void *context);
+
+// What a block of the checker's memory is for
+typedef enum {
+    SPELLCHECK_MEMORY_CHECKER = 0,   // The checker and its snapshots
+    SPELLCHECK_MEMORY_DICTIONARY,    // Word entries, pools and word arrays
+    SPELLCHECK_MEMORY_FREQUENCY,     // Frequency tables
+    SPELLCHECK_MEMORY_LOAD,          // Scratch while reading and sorting files
+    SPELLCHECK_MEMORY_CHECK,         // The misspelled list and edit scratch
+    SPELLCHECK_MEMORY_SUGGEST,       // Suggestion and completion caches and scratch
+    SPELLCHECK_MEMORY_USAGE,         // Used-word counts
+    SPELLCHECK_MEMORY_USE_COUNT
+} SpellCheckMemoryUse;
+
+// Where a checker gets the memory it keeps. Called from the loader,
+// watcher and warm-up threads as well as the caller's, so the functions
+// must be thread-safe. 'reallocate' gets NULL for a new block and
+// 'release' is never passed NULL. 'checkPass' is optional: it is called
+// with TRUE and FALSE around every SpellChecker_Check pass, on the thread
+// running it.
+typedef struct {
+    void* (*allocate)(void *context, size_t size, SpellCheckMemoryUse use);
+    void* (*reallocate)(void *context, void *block, size_t size, SpellCheckMemoryUse use);
+    void (*release)(void *context, void *block, SpellCheckMemoryUse use);
+    void (*checkPass)(void *context, BOOL running);
+    void *context;
+} SpellCheckAllocator;
+
+typedef struct {
+    SIZE_T liveBytes;
+    SIZE_T peakBytes;
+    ULONGLONG allocations;       // Including growing or shrinking a block
+    ULONGLONG frees;
+} SpellCheckMemoryCounters;
+
+typedef struct {
+    SpellCheckMemoryCounters uses[SPELLCHECK_MEMORY_USE_COUNT];
+    SpellCheckMemoryCounters total;
+    ULONGLONG checkPasses;
+    ULONGLONG checkPassAllocations;  // Made inside Check passes; 0 in the steady state
+} SpellCheckMemoryStats;
+
+// Bytes held by the DAWG and the suggestion indexes. They are built by
+// their own modules on the C heap, so the tracker doesn't see them.
+typedef struct {
+    size_t dawg;
+    size_t mainIndex;
+    size_t embeddedIndex;
+    size_t usedIndex;
+} SpellCheckIndexMemory;
+
+// Allocator on the C heap that counts live and peak bytes per use, with a
+// small header on each block. With 'reportCheckPath' set, every allocation
+// made inside a Check pass is also described with OutputDebugString.
+typedef struct {
+    SpellCheckAllocator allocator;   // Pass &tracker->allocator to the checker
+    CRITICAL_SECTION lock;
+    SpellCheckMemoryStats stats;
+    volatile LONG checkPassThread;   // Thread running a Check pass, or 0; set with Interlocked*
+    BOOL reportCheckPath;
+} SpellCheckMemoryTracker;
+
+// A set of overlays on the shared dictionaries: the files loaded into
+// ProfileWords, plus the words added and ignored this session. Those two
+// lists change under suggestionLock, since suggestion warm-ups read them.
+typedef struct {
+    char name[64];
+    DictionaryFile glossaryFile;
+    DictionaryFile userDictionaryFile;
+    Dictionary addedWords;       // Added to the user dictionary this session
+    Dictionary ignoredWords;
+    LONG verdictVersion;         // Unique across profiles; bumps when its words change
+} SpellCheckProfile;
+
+#define SPELLCHECK_SUGGESTION_CACHE_SIZE 64
+#define SPELLCHECK_WARM_QUEUE_SIZE 32
+
+// Suggestions for one case-folded word at one dictionary generation and
+// word list version (used words rank them)
+typedef struct {
+    char word[256];              // Empty when the slot is free
+    LONG generation;
+    LONG listVersion;
+    DWORD lastUse;
+    char **suggestions;
     int count;
-    int capacity;
-} Dictionary;
+} SuggestionCacheEntry;
+
+#define SPELLCHECK_MAX_COMPLETIONS 8
+#define SPELLCHECK_COMPLETION_CACHE_SIZE 32
+#define SPELLCHECK_RECENT_WORD_USES 512
+
+// How often a word has been used in committed entries; ranks completions
+typedef struct {
+    char *word;
+    int count;
+} WordUse;
+
+// Top completions for one prefix, valid while the dictionary generation
+// and the session word lists are unchanged
+typedef struct {
+    char prefix[32];
+    int k;
+    LONG generation;
+    LONG listVersion;
+    int count;
+    char words[SPELLCHECK_MAX_COMPLETIONS][64];
+} CompletionCacheEntry;
+
+#define SPELLCHECK_VERDICT_CACHE_SIZE 2048     // Power of two
+#define SPELLCHECK_VERDICT_PROBES 4
+#define SPELLCHECK_VERDICT_MAX_WORD 31          // Longer words always take the full lookup
+
+// Whether one case-folded word is correct, valid for one dictionary
+// generation and one version of a profile's words
+typedef struct {
+    unsigned int hash;           // 0 when the slot is free
+    LONG generation;
+    LONG verdictVersion;
+    BOOL correct;
+    char word[SPELLCHECK_VERDICT_MAX_WORD + 1];
+} VerdictCacheEntry;
+
+typedef struct {
+    ULONGLONG hits;
+    ULONGLONG misses;
+    int entries;                 // Slots holding a current verdict
+} VerdictCacheStats;
 
 typedef struct {
     BOOL enabled;
     BOOL suggestionsEnabled;
-    Dictionary mainDictionary;
-    Dictionary userDictionary;
-    Dictionary ignoredWords;
+    SpellCheckBackend backend;
+    SpellCheckAllocator allocator;
+    DictionarySnapshot * volatile snapshot;
+    SpellCheckProfile profiles[SPELLCHECK_MAX_PROFILES];
+    int profileCount;
+    volatile LONG activeProfile;
     MisspelledWordList misspelled;
     DWORD lastCheckTime;
+    
+    // Epoch-based reclamation for snapshot swaps
+    volatile LONG epoch;
+    volatile LONG activeReaders[2];
+    
+    // Hot reload
+    CRITICAL_SECTION reloadLock;
+    DictionaryFile dictionaryFiles[SPELLCHECK_MAX_DICTIONARY_FILES];
+    int dictionaryFileCount;
+    DictionaryFile frequencyFile;
+    HANDLE watchThread;
+    HANDLE watchStopEvent;
+    SpellCheckerReloadCallback reloadCallback;
+    void *reloadContext;
+    
+    // As-you-type completion and suggestion ranking. Changed under
+    // suggestionLock, since suggestion warm-ups read it.
+    WordUse *wordUses;           // Open-addressed on the folded word
+    int wordUseCount;
+    int wordUseCapacity;
+    LONG listVersion;            // Bumps when added, ignored or used words or the profile change
+    
+    // The used words in folded order, for completions, and indexed for
+    // suggestions. Words first used since the last full build go into a
+    // small run and index of their own, so committing an entry never
+    // re-sorts the whole table; both are rebuilt once that run fills.
+    // Counts are updated in place.
+    BOOL usedOrderValid;         // FALSE until built, and once the recent run overflows
+    WordUse *usedSorted;         // Copies of the wordUses entries, folded order
+    int usedSortedCount;
+    WordUse *recentUses;         // Added since, folded order; SPELLCHECK_RECENT_WORD_USES slots
+    int recentUseCount;
+    SuggestIndex *usedIndex;     // usedSorted, for suggestions
+    SuggestIndex *recentIndex;   // recentUses, rebuilt when a word is added to them
+    BOOL recentIndexValid;
+    CompletionCacheEntry completionCache[SPELLCHECK_COMPLETION_CACHE_SIZE];
+    
+    // Verdicts of recently checked words, for Check and ApplyEdit only
+    // (they own sc->misspelled, so they already run on one thread)
+    VerdictCacheEntry verdictCache[SPELLCHECK_VERDICT_CACHE_SIZE];
+    LONG verdictVersion;         // Last version handed to a profile
+    ULONGLONG verdictHits;
+    ULONGLONG verdictMisses;
+    
+    // LRU suggestion cache, warmed in the background for flagged words
+    CRITICAL_SECTION suggestionLock;
+    SuggestionCacheEntry suggestionCache[SPELLCHECK_SUGGESTION_CACHE_SIZE];
+    DWORD suggestionClock;
+    char warmQueue[SPELLCHECK_WARM_QUEUE_SIZE][256];
+    int warmHead;
+    int warmCount;
+    HANDLE warmThread;
+    HANDLE warmWakeEvent;
+    HANDLE warmStopEvent;
 } SpellChecker;
 
-// Initialization and cleanup
+// Initialization and cleanup. Create uses the C heap; with an allocator,
+// everything the checker keeps comes from it (the DAWG and suggestion
+// indexes, being separate modules, excepted; SpellChecker_GetIndexMemory
+// reports those). Results handed to the caller stay on the C heap, since
+// they are freed without a checker.
 SpellChecker* SpellChecker_Create(void);
+SpellChecker* SpellChecker_CreateWithAllocator(const SpellCheckAllocator *allocator);
 void SpellChecker_Destroy(SpellChecker *sc);
+
+// Tracking allocator. Delete it only after every checker using it is
+// destroyed; GetMemoryStats can be called at any time.
+void SpellChecker_InitMemoryTracker(SpellCheckMemoryTracker *tracker, BOOL reportCheckPath);
+void SpellChecker_DeleteMemoryTracker(SpellCheckMemoryTracker *tracker);
+void SpellChecker_GetMemoryStats(SpellCheckMemoryTracker *tracker, SpellCheckMemoryStats *stats);
+const char* SpellChecker_GetMemoryUseName(SpellCheckMemoryUse use);
+void SpellChecker_GetIndexMemory(SpellChecker *sc, SpellCheckIndexMemory *memory);
 BOOL SpellChecker_LoadDictionary(SpellChecker *sc, const char *filePath);
 BOOL SpellChecker_LoadUserDictionary(SpellChecker *sc, const char *filePath);
 
-// Spell checking
+// TRUE when dictionary.txt was compiled in (build.ps1 -Embedded); files
+// loaded with SpellChecker_LoadDictionary then act as overlays
+BOOL SpellChecker_HasEmbeddedDictionary(void);
+
+// Team glossary of the active profile: extra accepted words, one per line
+// like the user dictionary, but never written back. Same setup-time rules;
+// a missing file is not an error and is picked up once it appears.
+BOOL SpellChecker_LoadGlossary(SpellChecker *sc, const char *filePath);
+
+// Word frequencies for ranking suggestions (optional, same setup-time
+// rules). One word per line, either "word count" or just "word" in
+// descending order of frequency, which counts as SPELLCHECK_RANK_SCALE /
+// rank. A missing file is not an error; it is reloaded with the rest.
+#define SPELLCHECK_RANK_SCALE 1000000
+BOOL SpellChecker_LoadFrequencies(SpellChecker *sc, const char *filePath);
+
+// Hot reload: watch the loaded files and publish a new snapshot when they
+// change. The callback runs on the watcher thread after each reload.
+BOOL SpellChecker_StartWatching(SpellChecker *sc, SpellCheckerReloadCallback callback, void *context);
+void SpellChecker_StopWatching(SpellChecker *sc);
+BOOL SpellChecker_ReloadDictionaries(SpellChecker *sc);
+LONG SpellChecker_GetGeneration(SpellChecker *sc);
+
+// Main dictionary backend, switchable at runtime
+BOOL SpellChecker_SetBackend(SpellChecker *sc, SpellCheckBackend backend);
+void SpellChecker_GetDictionaryStats(SpellChecker *sc, DictionaryStats *stats);
+
+// Spell checking. Text is UTF-8 (bytes that aren't fall back to
+// Latin-1); positions are byte offsets.
 void SpellChecker_Check(SpellChecker *sc, const char *text);
 BOOL SpellChecker_IsWordCorrect(SpellChecker *sc, const char *word);
 
-// User dictionary management
+// Check a length-delimited block, appending to a caller-owned list.
+// Read-only on 'sc', so worker threads can share one loaded checker.
+BOOL SpellChecker_CheckRange(SpellChecker *sc, const char *text, size_t length, DWORD baseOffset, MisspelledWordList *out);
+void SpellChecker_FreeMisspelledList(MisspelledWordList *list);
+
+// Check and ApplyEdit remember each word's verdict until the dictionaries
+// reload or a word is added or ignored, so words that repeat within and
+// across passes cost one probe. CheckRange, being shared by workers,
+// always looks words up.
+void SpellChecker_GetVerdictStats(SpellChecker *sc, VerdictCacheStats *stats);
+
+// Replacing misspellings in place. After Spans_PlanReplacement builds the
+// edit, ApplyEdit brings sc->misspelled up to date without a full check:
+// spans the edit covered are dropped, later ones shift, and only the
+// edit's new text is checked.
+BOOL SpellChecker_ApplyEdit(SpellChecker *sc, const SpellCheckEdit *edit);
+
+// Profiles layer overlays on the one main dictionary, so a profile costs
+// only its own words. A word is correct if the active profile ignores it,
+// the main dictionary has it, or its glossary or user dictionary does.
+// Profile SPELLCHECK_DEFAULT_PROFILE always exists. AddProfile is a
+// setup-time call returning the new index (-1 when full); the Load and
+// user and ignore list calls act on the active profile. SelectProfile
+// swaps one index: nothing is reloaded, and the verdicts cached for each
+// profile stay valid while it is not selected.
+int SpellChecker_AddProfile(SpellChecker *sc, const char *name);
+int SpellChecker_FindProfile(SpellChecker *sc, const char *name);
+BOOL SpellChecker_SelectProfile(SpellChecker *sc, int profile);
+int SpellChecker_GetProfile(SpellChecker *sc);
+
+// User dictionary management (active profile)
 void SpellChecker_AddToUserDictionary(SpellChecker *sc, const char *word);
 void SpellChecker_SaveUserDictionary(SpellChecker *sc, const char *filePath);
 
-// Ignore list management (session-only, not persisted)
+// Ignore list management (active profile; session-only, not persisted)
 void SpellChecker_AddToIgnoreList(SpellChecker *sc, const char *word);
 void SpellChecker_ClearIgnoreList(SpellChecker *sc);
 
-// Suggestions
+// Suggestions: the closest known words, and among equally close ones
+// those the user has written most, then the most frequent. Results are
+// cached per case-folded word until the dictionaries reload or the used
+// words change; safe to call while a warm-up is running.
 char** SpellChecker_GetSuggestions(SpellChecker *sc, const char *word, int *count);
 void SpellChecker_FreeSuggestions(char **suggestions, int count);
 
+// Compute suggestions for every word in 'list' on a background thread so
+// later GetSuggestions calls are cache hits. Replaces any pending warm-up.
+void SpellChecker_WarmSuggestions(SpellChecker *sc, const MisspelledWordList *list);
+
+// Completion: up to 'k' known words starting with 'prefix', most used
+// first, then alphabetical. Cached per prefix, cheap enough to call on
+// every keystroke. Free the result with SpellChecker_FreeSuggestions.
+char** SpellChecker_Complete(SpellChecker *sc, const char *prefix, int k, int *count);
+
+// Count the words of committed text, or 'count' uses of one word (to
+// seed the counts from earlier entries). These rank both completions and
+// suggestions; call them on the thread that calls Complete.
+void SpellChecker_RecordWordUse(SpellChecker *sc, const char *text);
+void SpellChecker_RecordWordCount(SpellChecker *sc, const char *word, int count);
+
 // Query results
 MisspelledWordList* SpellChecker_GetMisspelledWords(SpellChecker *sc);
 BOOL SpellChecker_IsMisspelledAtPosition(SpellChecker *sc, DWORD pos, char *outWord, int outWordLen);
@@ -0,0 +1,241 @@
+#include "suggestindex.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SUGGEST_INDEX_SSE2
+#endif
+
+// Survivors of the histogram filter are collected per chunk, so the
+// filter loop only streams through the histogram block
+#define FILTER_CHUNK 64
+
+// Letters in English frequency order; a letter's bin is its rank mod 16,
+// so every bin pairs a common letter with a rare one
+static const char s_frequencyOrder[] = "etaoinshrdlcumwfgypbvkjxqz";
+static unsigned char s_letterBin[256];
+static volatile LONG s_binsReady = 0;
+
+static void InitLetterBins(void) {
+    if (s_binsReady) return;
+    for (int c = 0; c < 256; c++) {
+        s_letterBin[c] = SUGGEST_INDEX_BINS - 1;
+    }
+    for (int i = 0; s_frequencyOrder[i]; i++) {
+        unsigned char bin = (unsigned char)(i % SUGGEST_INDEX_BINS);
+        s_letterBin[(unsigned char)s_frequencyOrder[i]] = bin;
+        s_letterBin[(unsigned char)toupper((unsigned char)s_frequencyOrder[i])] = bin;
+    }
+    // Every thread computes the same table, so a racing init is harmless
+    InterlockedExchange(&s_binsReady, 1);
+}
+
+static void BuildHistogram(const char *word, int len, unsigned char *histogram) {
+    memset(histogram, 0, SUGGEST_INDEX_BINS);
+    for (int i = 0; i < len; i++) {
+        unsigned char *bin = &histogram[s_letterBin[(unsigned char)word[i]]];
+        if (*bin < 255) (*bin)++;
+    }
+}
+
+// Lower bound on the edit distance between two words from their letter
+// histograms: a substitution fixes at most one surplus and one deficit,
+// an insertion or deletion only one of them
+static int HistogramBound(const unsigned char *query, const unsigned char *candidate) {
+#ifdef SUGGEST_INDEX_SSE2
+    __m128i q = _mm_loadu_si128((const __m128i *)query);
+    __m128i w = _mm_loadu_si128((const __m128i *)candidate);
+    __m128i zero = _mm_setzero_si128();
+    __m128i surplus = _mm_sad_epu8(_mm_subs_epu8(w, q), zero);
+    __m128i deficit = _mm_sad_epu8(_mm_subs_epu8(q, w), zero);
+    int over = _mm_cvtsi128_si32(surplus) + _mm_extract_epi16(surplus, 4);
+    int under = _mm_cvtsi128_si32(deficit) + _mm_extract_epi16(deficit, 4);
+#else
+    int over = 0, under = 0;
+    for (int i = 0; i < SUGGEST_INDEX_BINS; i++) {
+        int diff = candidate[i] - query[i];
+        if (diff > 0) over += diff;
+        else under -= diff;
+    }
+#endif
+    return over > under ? over : under;
+}
+
+// Case-insensitive Levenshtein distance that gives up once every entry of
+// a row exceeds 'maxDistance' (returns maxDistance + 1 then)
+static int BoundedDistance(const char *a, int lenA, const char *b, int lenB, int maxDistance) {
+    int rows[2][SUGGEST_INDEX_MAX_LENGTH + 1];
+    int *prev = rows[0], *cur = rows[1];
+
+    for (int j = 0; j <= lenB; j++) prev[j] = j;
+
+    for (int i = 1; i <= lenA; i++) {
+        int ca = tolower((unsigned char)a[i - 1]);
+        int rowMin = cur[0] = i;
+        for (int j = 1; j <= lenB; j++) {
+            int cost = ca == tolower((unsigned char)b[j - 1]) ? 0 : 1;
+            int best = prev[j - 1] + cost;
+            if (prev[j] + 1 < best) best = prev[j] + 1;
+            if (cur[j - 1] + 1 < best) best = cur[j - 1] + 1;
+            cur[j] = best;
+            if (best < rowMin) rowMin = best;
+        }
+        if (rowMin > maxDistance) return maxDistance + 1;
+
+        int *swap = prev;
+        prev = cur;
+        cur = swap;
+    }
+    return prev[lenB];
+}
+
+typedef struct {
+    DWORD weight;
+    int index;
+} WeightedWord;
+
+// Heaviest first, then in the order given
+static int CompareWeighted(const void *a, const void *b) {
+    const WeightedWord *x = (const WeightedWord *)a, *y = (const WeightedWord *)b;
+    if (x->weight != y->weight) return x->weight > y->weight ? -1 : 1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+SuggestIndex* SuggestIndex_Build(const char * const *words, const DWORD *weights, int count) {
+    InitLetterBins();
+
+    SuggestIndex *index = (SuggestIndex *)calloc(1, sizeof(SuggestIndex));
+    if (!index) return NULL;
+
+    WeightedWord *order = (WeightedWord *)malloc((count + 1) * sizeof(WeightedWord));
+    if (!order) {
+        free(index);
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        order[i].weight = weights ? weights[i] : 0;
+        order[i].index = i;
+    }
+    if (weights) qsort(order, count, sizeof(WeightedWord), CompareWeighted);
+
+    // Size every bucket first so each gets exactly one lane block
+    for (int i = 0; i < count; i++) {
+        int len = strlen(words[i]);
+        if (len > 0 && len <= SUGGEST_INDEX_MAX_LENGTH) index->buckets[len].count++;
+    }
+
+    for (int len = 1; len <= SUGGEST_INDEX_MAX_LENGTH; len++) {
+        SuggestBucket *bucket = &index->buckets[len];
+        if (bucket->count == 0) continue;
+
+        bucket->stride = (len + 1 + 3) & ~3;
+        bucket->lanes = (char *)calloc(bucket->count, bucket->stride);
+        bucket->histograms = (unsigned char *)malloc((size_t)bucket->count * SUGGEST_INDEX_BINS);
+        if (weights) bucket->weights = (DWORD *)malloc(bucket->count * sizeof(DWORD));
+        if (!bucket->lanes || !bucket->histograms || (weights && !bucket->weights)) {
+            free(order);
+            SuggestIndex_Destroy(index);
+            return NULL;
+        }
+        bucket->count = 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const char *word = words[order[i].index];
+        int len = strlen(word);
+        if (len == 0 || len > SUGGEST_INDEX_MAX_LENGTH) continue;
+
+        SuggestBucket *bucket = &index->buckets[len];
+        memcpy(bucket->lanes + (size_t)bucket->count * bucket->stride, word, len);
+        BuildHistogram(word, len, bucket->histograms + (size_t)bucket->count * SUGGEST_INDEX_BINS);
+        if (bucket->weights) bucket->weights[bucket->count] = order[i].weight;
+        bucket->count++;
+        index->wordCount++;
+    }
+
+    free(order);
+    return index;
+}
+
+void SuggestIndex_Destroy(SuggestIndex *index) {
+    if (!index) return;
+    for (int len = 0; len <= SUGGEST_INDEX_MAX_LENGTH; len++) {
+        free(index->buckets[len].lanes);
+        free(index->buckets[len].histograms);
+        free(index->buckets[len].weights);
+    }
+    free(index);
+}
+
+// Scan one bucket: filter a chunk on histograms, then verify survivors.
+// With weights, the bound is asked before each chunk about its heaviest
+// word; the rest of the bucket is lighter still.
+static BOOL ScanBucket(const SuggestBucket *bucket, int len, const char *word, int wordLen,
+                       const unsigned char *query, int maxDistance, int minDistance,
+                       SuggestWordCallback callback, SuggestBoundCallback bound, void *context) {
+    int survivors[FILTER_CHUNK];
+
+    for (int base = 0; base < bucket->count; base += FILTER_CHUNK) {
+        DWORD heaviest = bucket->weights ? bucket->weights[base] : 0;
+        if (bound && !bound(minDistance, heaviest, context)) return TRUE;
+
+        int end = base + FILTER_CHUNK < bucket->count ? base + FILTER_CHUNK : bucket->count;
+        int survivorCount = 0;
+
+        const unsigned char *histogram = bucket->histograms + (size_t)base * SUGGEST_INDEX_BINS;
+        for (int i = base; i < end; i++, histogram += SUGGEST_INDEX_BINS) {
+            if (HistogramBound(query, histogram) <= maxDistance) survivors[survivorCount++] = i;
+        }
+
+        for (int s = 0; s < survivorCount; s++) {
+            const char *candidate = bucket->lanes + (size_t)survivors[s] * bucket->stride;
+            int distance = BoundedDistance(word, wordLen, candidate, len, maxDistance);
+            if (distance > maxDistance) continue;
+
+            DWORD weight = bucket->weights ? bucket->weights[survivors[s]] : 0;
+            if (!callback(candidate, distance, weight, context)) return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+void SuggestIndex_FindWithinDistance(const SuggestIndex *index, const char *word, int maxDistance,
+                                     SuggestWordCallback callback, SuggestBoundCallback bound, void *context) {
+    if (!index || !word || !callback) return;
+
+    int wordLen = strlen(word);
+    if (wordLen == 0 || wordLen > SUGGEST_INDEX_MAX_LENGTH) return;
+
+    unsigned char query[SUGGEST_INDEX_BINS];
+    BuildHistogram(word, wordLen, query);
+
+    // Same length first, then alternately shorter and longer. A bucket
+    // 'delta' letters off can hold nothing closer than 'delta' edits.
+    for (int delta = 0; delta <= maxDistance; delta++) {
+        for (int sign = -1; sign <= 1; sign += 2) {
+            if (delta == 0 && sign > 0) break;
+
+            int len = wordLen + sign * delta;
+            if (len < 1 || len > SUGGEST_INDEX_MAX_LENGTH) continue;
+            if (index->buckets[len].count == 0) continue;
+
+            if (!ScanBucket(&index->buckets[len], len, word, wordLen, query, maxDistance, delta,
+                            callback, bound, context)) {
+                return;
+            }
+        }
+    }
+}
+
+size_t SuggestIndex_MemoryUsage(const SuggestIndex *index) {
+    if (!index) return 0;
+    size_t bytes = sizeof(SuggestIndex);
+    for (int len = 1; len <= SUGGEST_INDEX_MAX_LENGTH; len++) {
+        const SuggestBucket *bucket = &index->buckets[len];
+        bytes += (size_t)bucket->count * (bucket->stride + SUGGEST_INDEX_BINS);
+        if (bucket->weights) bytes += (size_t)bucket->count * sizeof(DWORD);
+    }
+    return bytes;
+}
@@ -0,0 +1,58 @@
+#ifndef SUGGESTINDEX_H
+#define SUGGESTINDEX_H
+
+#include <windows.h>
+
+// Suggestion-scan layout for the sorted-array dictionary.
+//
+// Words are grouped into one bucket per length. Each bucket holds its
+// words as fixed-width NUL-padded lanes in one block, and a parallel
+// block of 16-bin letter histograms. A query only visits the buckets
+// within maxDistance of its own length, and rejects most candidates from
+// the histograms alone (one SSE2 compare per word) before running the
+// exact edit distance.
+//
+// Words may carry a weight (how common they are). Each bucket then keeps
+// its words heaviest first, so a search that only wants the best few
+// candidates can stop a bucket, or skip it, once its bound callback says
+// nothing lighter could still make the cut.
+
+#define SUGGEST_INDEX_BINS 16
+#define SUGGEST_INDEX_MAX_LENGTH 255
+
+typedef struct {
+    int count;
+    int stride;                  // Lane width: length + NUL, rounded up to 4
+    char *lanes;                 // count * stride, original case
+    unsigned char *histograms;   // count * SUGGEST_INDEX_BINS
+    DWORD *weights;              // count, descending; NULL if built without
+} SuggestBucket;
+
+typedef struct {
+    SuggestBucket buckets[SUGGEST_INDEX_MAX_LENGTH + 1];
+    int wordCount;
+} SuggestIndex;
+
+// Return FALSE to stop the search
+typedef BOOL (*SuggestWordCallback)(const char *word, int distance, DWORD weight, void *context);
+
+// Asked before each bucket and each chunk of one: could any word at least
+// 'minDistance' away and no heavier than 'maxWeight' still be wanted?
+// Return FALSE to skip the rest of the bucket.
+typedef BOOL (*SuggestBoundCallback)(int minDistance, DWORD maxWeight, void *context);
+
+// Words are ordered by descending weight within each bucket, keeping the
+// order they are given in on ties ('weights' may be NULL: all equal)
+SuggestIndex* SuggestIndex_Build(const char * const *words, const DWORD *weights, int count);
+void SuggestIndex_Destroy(SuggestIndex *index);
+
+// Every word within 'maxDistance' case-insensitive edits of 'word', the
+// query's own length first, then one and two letters shorter and longer.
+// Within a bucket words come heaviest first. 'bound' is optional. Words
+// are handed out from the index and stay valid until it is destroyed.
+void SuggestIndex_FindWithinDistance(const SuggestIndex *index, const char *word, int maxDistance,
+                                     SuggestWordCallback callback, SuggestBoundCallback bound, void *context);
+
+size_t SuggestIndex_MemoryUsage(const SuggestIndex *index);
+
+#endif // SUGGESTINDEX_H
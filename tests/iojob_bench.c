@@ -0,0 +1,129 @@
+// Benchmark for IoJob_WriteFile against a plain fwrite on the calling
+// thread, and how long the UI thread goes between messages meanwhile.
+// Builds with  gcc -O2 -I. -o tests\bin\iojob_bench.exe tests/iojob_bench.c iojob.c
+//
+// Usage: iojob_bench [directory] [megabytes]
+// Writes iojob_bench.out in the directory (default current) and removes
+// it afterwards. Point it at a network share to see the difference.
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../iojob.h"
+
+#define WM_BENCHJOB (WM_APP + 1)
+#define DEFAULT_MEGABYTES 64
+#define ROUNDS 3
+
+static BOOL s_complete = FALSE;
+static BOOL s_succeeded = FALSE;
+static char s_path[MAX_PATH];
+static const char *s_data = NULL;
+static size_t s_length = 0;
+
+static LRESULT CALLBACK BenchWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    if (uMsg == WM_BENCHJOB) {
+        IoJob_Dispatch(wParam, lParam);
+        return 0;
+    }
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+static BOOL WriteProc(IoJob *job) {
+    return IoJob_WriteFile(job, s_path, s_data, s_length);
+}
+
+static void OnComplete(IoJob *job) {
+    s_complete = TRUE;
+    s_succeeded = job->succeeded;
+}
+
+static double Milliseconds(LARGE_INTEGER start, LARGE_INTEGER end, LARGE_INTEGER frequency) {
+    return (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+}
+
+// The whole write on this thread, as the UI used to do it
+static double WriteBlocking(LARGE_INTEGER frequency) {
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    FILE *f = fopen(s_path, "wb");
+    if (!f) return -1;
+    size_t written = fwrite(s_data, 1, s_length, f);
+    fclose(f);
+    QueryPerformanceCounter(&end);
+    return written == s_length ? Milliseconds(start, end, frequency) : -1;
+}
+
+// The write as a job, pumping messages meanwhile; 'longestGap' is the
+// longest the pump went without running
+static double WriteAsJob(HWND hwnd, LARGE_INTEGER frequency, double *longestGap) {
+    LARGE_INTEGER start, last, now;
+    s_complete = FALSE;
+    QueryPerformanceCounter(&start);
+    if (!IoJob_Start(hwnd, WM_BENCHJOB, WriteProc, OnComplete, NULL, NULL)) return -1;
+
+    *longestGap = 0;
+    last = start;
+    while (!s_complete) {
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) DispatchMessage(&msg);
+        QueryPerformanceCounter(&now);
+        double gap = Milliseconds(last, now, frequency);
+        if (gap > *longestGap) *longestGap = gap;
+        last = now;
+        if (!s_complete) Sleep(1);
+    }
+    QueryPerformanceCounter(&now);
+    return s_succeeded ? Milliseconds(start, now, frequency) : -1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *directory = argc > 1 ? argv[1] : ".";
+    int megabytes = argc > 2 ? atoi(argv[2]) : DEFAULT_MEGABYTES;
+    if (megabytes <= 0) megabytes = DEFAULT_MEGABYTES;
+    snprintf(s_path, sizeof(s_path), "%s\\iojob_bench.out", directory);
+
+    s_length = (size_t)megabytes * 1024 * 1024;
+    char *data = (char *)malloc(s_length);
+    if (!data) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < s_length; i++) data[i] = (char)(i * 7 + i / 1000);
+    s_data = data;
+
+    WNDCLASS wc = {0};
+    wc.lpfnWndProc = BenchWndProc;
+    wc.hInstance = GetModuleHandle(NULL);
+    wc.lpszClassName = "IoJobBench";
+    RegisterClass(&wc);
+    HWND hwnd = CreateWindowEx(0, "IoJobBench", "", 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, wc.hInstance, NULL);
+    if (!hwnd) {
+        printf("Could not create the window\n");
+        free(data);
+        return 1;
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    printf("Writing %d MB to %s, %d chunks of %d KB in flight\n", megabytes, s_path,
+           IOJOB_MAX_IN_FLIGHT, IOJOB_CHUNK_BYTES / 1024);
+    for (int round = 1; round <= ROUNDS; round++) {
+        double blocking = WriteBlocking(frequency);
+        double longestGap = 0;
+        double job = WriteAsJob(hwnd, frequency, &longestGap);
+        if (blocking < 0 || job < 0) {
+            printf("Write failed\n");
+            break;
+        }
+        // Blocking, the UI thread is stuck for the whole write
+        printf("round %d: fwrite %.1f ms (UI blocked %.1f ms), job %.1f ms (UI blocked at most %.1f ms)\n",
+               round, blocking, blocking, job, longestGap);
+    }
+
+    DeleteFile(s_path);
+    DestroyWindow(hwnd);
+    free(data);
+    return 0;
+}
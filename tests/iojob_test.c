@@ -0,0 +1,335 @@
+// Tests for iojob.c: completion, cancellation and progress callbacks
+// delivered through a window, and IoJob_WriteFile.
+// Builds with  gcc -I. tests/iojob_test.c iojob.c
+//
+// Runs in the current directory, where it writes and removes
+// iojob_test.out. Exits 0 when every check passes, 1 otherwise.
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../iojob.h"
+
+#define WM_TESTJOB (WM_APP + 1)
+#define WAIT_MS 30000                   // Longest any job may take
+#define OUTPUT_FILE "iojob_test.out"
+#define WRITE_BYTES (3 * 1024 * 1024 + 12345)
+
+static int s_checks = 0;
+static int s_failures = 0;
+
+#define CHECK(condition) Check((condition), #condition, __LINE__)
+
+static void Check(int condition, const char *text, int line) {
+    s_checks++;
+    if (!condition) {
+        printf("  line %d: %s\n", line, text);
+        s_failures++;
+    }
+}
+
+// What the callbacks saw, reset for each job
+typedef struct {
+    HANDLE release;             // The work function waits for this, if set
+    int steps;
+    const void *data;           // For IoJob_WriteFile
+    size_t length;
+    int progressCalls;
+    int completions;
+    BOOL progressAfterComplete;
+    BOOL progressInRange;       // done <= total on every call
+    BOOL succeeded;
+    BOOL cancelled;
+    char result[16];            // Copied in the completion; the job frees its own
+} JobState;
+
+static HWND s_hwnd = NULL;
+
+static LRESULT CALLBACK TestWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    if (uMsg == WM_TESTJOB) {
+        IoJob_Dispatch(wParam, lParam);
+        return 0;
+    }
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+// Pump the window's messages until the job has completed
+static BOOL PumpUntilComplete(JobState *state) {
+    DWORD start = GetTickCount();
+    while (state->completions == 0) {
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) DispatchMessage(&msg);
+        if (state->completions > 0) break;
+        if (GetTickCount() - start > WAIT_MS) return FALSE;
+        Sleep(1);
+    }
+    return TRUE;
+}
+
+static void OnProgress(IoJob *job) {
+    JobState *state = (JobState *)job->context;
+    state->progressCalls++;
+    if (state->completions > 0) state->progressAfterComplete = TRUE;
+    if (job->done > job->total) state->progressInRange = FALSE;
+}
+
+static void OnComplete(IoJob *job) {
+    JobState *state = (JobState *)job->context;
+    state->completions++;
+    state->succeeded = job->succeeded;
+    state->cancelled = job->cancelled;
+    if (job->result) strncpy(state->result, (const char *)job->result, sizeof(state->result) - 1);
+}
+
+// Report each step, then leave a result for the completion
+static BOOL StepProc(IoJob *job) {
+    JobState *state = (JobState *)job->context;
+    if (state->release) WaitForSingleObject(state->release, INFINITE);
+    for (int i = 1; i <= state->steps; i++) {
+        if (IoJob_IsCancelled(job)) return FALSE;
+        IoJob_ReportProgress(job, i, state->steps);
+    }
+    job->result = malloc(16);
+    if (job->result) strcpy((char *)job->result, "finished");
+    job->resultLength = job->result ? 8 : 0;
+    return job->result != NULL;
+}
+
+static BOOL WriteProc(IoJob *job) {
+    JobState *state = (JobState *)job->context;
+    if (state->release) WaitForSingleObject(state->release, INFINITE);
+    return IoJob_WriteFile(job, OUTPUT_FILE, state->data, state->length);
+}
+
+static void ResetState(JobState *state) {
+    memset(state, 0, sizeof(JobState));
+    state->progressInRange = TRUE;
+}
+
+static BOOL FileExists(const char *path) {
+    return GetFileAttributes(path) != INVALID_FILE_ATTRIBUTES;
+}
+
+// TRUE when 'path' holds exactly 'data'
+static BOOL FileMatches(const char *path, const void *data, size_t length) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return FALSE;
+    char *contents = (char *)malloc(length + 1);
+    size_t read = contents ? fread(contents, 1, length + 1, f) : 0;
+    fclose(f);
+    BOOL same = contents && read == length && memcmp(contents, data, length) == 0;
+    free(contents);
+    return same;
+}
+
+static char* MakeData(size_t length, int seed) {
+    char *data = (char *)malloc(length);
+    for (size_t i = 0; data && i < length; i++) data[i] = (char)(i * 7 + i / 1000 + seed);
+    return data;
+}
+
+// Completion arrives after every progress call, with the job's result
+static void TestCompletion(void) {
+    JobState state;
+    ResetState(&state);
+    state.steps = 1000;
+    IoJob *job = IoJob_Start(s_hwnd, WM_TESTJOB, StepProc, OnComplete, OnProgress, &state);
+    CHECK(job != NULL);
+    if (!job) return;
+
+    CHECK(PumpUntilComplete(&state));
+    CHECK(state.completions == 1);
+    CHECK(state.succeeded);
+    CHECK(!state.cancelled);
+    CHECK(strcmp(state.result, "finished") == 0);
+    CHECK(state.progressCalls >= 1);
+    CHECK(state.progressInRange);
+    CHECK(!state.progressAfterComplete);
+}
+
+// Progress reported while the UI isn't pumping is coalesced into one message
+static void TestProgressCoalesced(void) {
+    JobState state;
+    ResetState(&state);
+    state.steps = 1000;
+    state.release = CreateEvent(NULL, TRUE, FALSE, NULL);
+    IoJob *job = IoJob_Start(s_hwnd, WM_TESTJOB, StepProc, OnComplete, OnProgress, &state);
+    CHECK(job != NULL);
+    if (!job) {
+        CloseHandle(state.release);
+        return;
+    }
+
+    // Every step is reported before the first message is dispatched
+    SetEvent(state.release);
+    while (job->done < state.steps) Sleep(1);
+    CHECK(PumpUntilComplete(&state));
+    CHECK(state.progressCalls == 1);
+    CHECK(state.completions == 1);
+    CHECK(state.succeeded);
+    CloseHandle(state.release);
+}
+
+// A cancelled job still completes, marked cancelled
+static void TestCancel(void) {
+    JobState state;
+    ResetState(&state);
+    state.steps = 1000;
+    state.release = CreateEvent(NULL, TRUE, FALSE, NULL);
+    IoJob *job = IoJob_Start(s_hwnd, WM_TESTJOB, StepProc, OnComplete, OnProgress, &state);
+    CHECK(job != NULL);
+    if (!job) {
+        CloseHandle(state.release);
+        return;
+    }
+
+    CHECK(!IoJob_IsCancelled(job));
+    IoJob_Cancel(job);
+    CHECK(IoJob_IsCancelled(job));
+    SetEvent(state.release);
+    CHECK(PumpUntilComplete(&state));
+    CHECK(state.completions == 1);
+    CHECK(state.cancelled);
+    CHECK(!state.succeeded);
+    CHECK(state.progressCalls == 0);
+    CloseHandle(state.release);
+}
+
+// The file is written whole, through the temporary, with progress in bytes
+static void TestWriteFile(void) {
+    JobState state;
+    ResetState(&state);
+    char *data = MakeData(WRITE_BYTES, 1);
+    state.data = data;
+    state.length = WRITE_BYTES;
+    DeleteFile(OUTPUT_FILE);
+    IoJob *job = IoJob_Start(s_hwnd, WM_TESTJOB, WriteProc, OnComplete, OnProgress, &state);
+    CHECK(job != NULL);
+    if (!job) {
+        free(data);
+        return;
+    }
+
+    CHECK(PumpUntilComplete(&state));
+    CHECK(state.succeeded);
+    CHECK(state.progressCalls >= 1);
+    CHECK(state.progressInRange);
+    CHECK(FileMatches(OUTPUT_FILE, data, WRITE_BYTES));
+    CHECK(!FileExists(OUTPUT_FILE ".partial"));
+
+    // Writing again replaces the file
+    char *other = MakeData(WRITE_BYTES / 2, 2);
+    ResetState(&state);
+    state.data = other;
+    state.length = WRITE_BYTES / 2;
+    job = IoJob_Start(s_hwnd, WM_TESTJOB, WriteProc, OnComplete, NULL, &state);
+    CHECK(job != NULL);
+    if (job) {
+        CHECK(PumpUntilComplete(&state));
+        CHECK(state.succeeded);
+        CHECK(FileMatches(OUTPUT_FILE, other, WRITE_BYTES / 2));
+    }
+    free(other);
+    free(data);
+}
+
+// A cancelled write leaves the previous file as it was
+static void TestWriteFileCancelled(void) {
+    char *old = MakeData(1000, 3);
+    FILE *f = fopen(OUTPUT_FILE, "wb");
+    CHECK(f != NULL);
+    if (!f) {
+        free(old);
+        return;
+    }
+    fwrite(old, 1, 1000, f);
+    fclose(f);
+
+    JobState state;
+    ResetState(&state);
+    char *data = MakeData(WRITE_BYTES, 4);
+    state.data = data;
+    state.length = WRITE_BYTES;
+    state.release = CreateEvent(NULL, TRUE, FALSE, NULL);
+    IoJob *job = IoJob_Start(s_hwnd, WM_TESTJOB, WriteProc, OnComplete, OnProgress, &state);
+    CHECK(job != NULL);
+    if (job) {
+        IoJob_Cancel(job);
+        SetEvent(state.release);
+        CHECK(PumpUntilComplete(&state));
+        CHECK(state.cancelled);
+        CHECK(!state.succeeded);
+        CHECK(FileMatches(OUTPUT_FILE, old, 1000));
+        CHECK(!FileExists(OUTPUT_FILE ".partial"));
+    }
+    CloseHandle(state.release);
+    free(data);
+    free(old);
+    DeleteFile(OUTPUT_FILE);
+}
+
+// At shutdown: wait for the job without dispatching its completion, then free it
+static void TestWaitAndFree(void) {
+    JobState state;
+    ResetState(&state);
+    state.steps = 100;
+    state.release = CreateEvent(NULL, TRUE, FALSE, NULL);
+    IoJob *job = IoJob_Start(s_hwnd, WM_TESTJOB, StepProc, OnComplete, OnProgress, &state);
+    CHECK(job != NULL);
+    if (!job) {
+        CloseHandle(state.release);
+        return;
+    }
+
+    IoJob_Cancel(job);
+    SetEvent(state.release);
+    IoJob_Wait(job);
+    CHECK(job->cancelled);
+    IoJob_Free(job);
+    CloseHandle(state.release);
+
+    // Drop the messages the job posted; they refer to the freed job
+    MSG msg;
+    while (PeekMessage(&msg, NULL, WM_TESTJOB, WM_TESTJOB, PM_REMOVE)) {}
+    CHECK(state.completions == 0);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} Test;
+
+int main(void) {
+    WNDCLASS wc = {0};
+    wc.lpfnWndProc = TestWndProc;
+    wc.hInstance = GetModuleHandle(NULL);
+    wc.lpszClassName = "IoJobTest";
+    if (!RegisterClass(&wc)) {
+        printf("Could not register the window class\n");
+        return 1;
+    }
+    s_hwnd = CreateWindowEx(0, "IoJobTest", "", 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, wc.hInstance, NULL);
+    if (!s_hwnd) {
+        printf("Could not create the window\n");
+        return 1;
+    }
+
+    Test tests[] = {
+        { "completion", TestCompletion },
+        { "progress coalesced", TestProgressCoalesced },
+        { "cancel", TestCancel },
+        { "write file", TestWriteFile },
+        { "write file cancelled", TestWriteFileCancelled },
+        { "wait and free", TestWaitAndFree },
+    };
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        int before = s_failures;
+        tests[i].run();
+        printf("%s: %s\n", tests[i].name, s_failures == before ? "ok" : "FAILED");
+    }
+    DestroyWindow(s_hwnd);
+
+    printf("%d checks, %d failures\n", s_checks, s_failures);
+    return s_failures == 0 ? 0 : 1;
+}
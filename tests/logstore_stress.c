@@ -0,0 +1,370 @@
+// Concurrent-writer stress test for the log store.
+//
+// Usage: LogStoreStress [-p processes] [-t threads] [-n records] [directory]
+//
+// Starts 'processes' copies of itself against one fresh store, each
+// appending 'records' entries from each of 'threads' threads. Every 25th
+// body is close to LOGSTORE_MAX_BODY, so writers often find the active
+// segment nearly full at the same moment. Once they exit the store is
+// opened again and checked:
+// - every entry is there exactly once, whole, and in its writer's order
+// - no segment is larger than LOGSTORE_SEGMENT_BYTES
+// - a newest segment that did grow past the cap (as older builds let it)
+//   and ends in a torn record still opens, with the torn record cut off
+// Exits 0 when everything holds, 1 otherwise.
+
+#include <windows.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../logstore.h"
+
+#define MAX_PROCESSES 32
+#define MAX_THREADS 16
+#define BIG_EVERY 25
+
+typedef struct {
+    LogStore *store;
+    int writer;             // Process number * MAX_THREADS + thread number
+    int records;
+    BOOL ok;
+} WriterThread;
+
+typedef struct {
+    int *nextIndex;         // Per writer: index of the entry expected next
+    int writers;
+    int records;
+    int count;
+    int failures;
+} CheckState;
+
+// Body of entry 'index' from 'writer'. The prefix names it; the filler
+// after it is derived from both so a torn or mixed body is caught.
+static DWORD BodyLength(int writer, int index) {
+    if (index % BIG_EVERY == BIG_EVERY - 1) return LOGSTORE_MAX_BODY - (DWORD)((writer * 131 + index) % 4096);
+    return 24 + (DWORD)(((unsigned)writer * 7919u + (unsigned)index * 104729u) % 6000);
+}
+
+static char FillerByte(int writer, int index, DWORD pos) {
+    return (char)('a' + (writer + index + pos) % 26);
+}
+
+static DWORD MakeBody(char *body, int writer, int index) {
+    DWORD length = BodyLength(writer, index);
+    int prefix = snprintf(body, 32, "w%d #%d ", writer, index);
+    for (DWORD pos = (DWORD)prefix; pos < length; pos++) body[pos] = FillerByte(writer, index, pos);
+    return length;
+}
+
+static DWORD WINAPI WriterProc(LPVOID param) {
+    WriterThread *thread = (WriterThread *)param;
+    char *body = (char *)malloc(LOGSTORE_MAX_BODY);
+    thread->ok = body != NULL;
+    for (int i = 0; thread->ok && i < thread->records; i++) {
+        DWORD length = MakeBody(body, thread->writer, i);
+        thread->ok = LogStore_Append(thread->store, LogStore_Now(), 0, body, length);
+    }
+    free(body);
+    return 0;
+}
+
+// Child process: append from 'threads' threads through one store handle
+static int RunWriter(const char *directory, int process, int threads, int records) {
+    LogStore *store = LogStore_Open(directory);
+    if (!store) {
+        fprintf(stderr, "writer %d: cannot open the store\n", process);
+        return 1;
+    }
+
+    WriterThread workers[MAX_THREADS];
+    HANDLE handles[MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        workers[t].store = store;
+        workers[t].writer = process * MAX_THREADS + t;
+        workers[t].records = records;
+        workers[t].ok = FALSE;
+        handles[t] = CreateThread(NULL, 0, WriterProc, &workers[t], 0, NULL);
+    }
+    WaitForMultipleObjects((DWORD)threads, handles, TRUE, INFINITE);
+
+    int failed = 0;
+    for (int t = 0; t < threads; t++) {
+        CloseHandle(handles[t]);
+        if (!workers[t].ok) failed++;
+    }
+    LogStore_Close(store);
+    if (failed) fprintf(stderr, "writer %d: %d thread(s) failed to append\n", process, failed);
+    return failed ? 1 : 0;
+}
+
+static BOOL CheckRecord(const LogRecord *record, void *context) {
+    CheckState *state = (CheckState *)context;
+    int writer = -1, index = -1, prefix = 0;
+    char head[32];
+    DWORD headLength = record->length < sizeof(head) - 1 ? record->length : (DWORD)sizeof(head) - 1;
+    memcpy(head, record->body, headLength);
+    head[headLength] = '\0';
+
+    state->count++;
+    if (sscanf(head, "w%d #%d %n", &writer, &index, &prefix) != 2 || prefix == 0 ||
+        writer < 0 || writer >= state->writers) {
+        if (state->failures++ < 10) printf("  record %d: unrecognized body\n", state->count);
+        return TRUE;
+    }
+    if (index != state->nextIndex[writer]) {
+        if (state->failures++ < 10) {
+            printf("  writer %d: entry %d where %d was expected\n", writer, index, state->nextIndex[writer]);
+        }
+    }
+    state->nextIndex[writer] = index + 1;
+
+    BOOL whole = record->length == BodyLength(writer, index);
+    for (DWORD pos = (DWORD)prefix; whole && pos < record->length; pos++) {
+        whole = record->body[pos] == FillerByte(writer, index, pos);
+    }
+    if (!whole && state->failures++ < 10) printf("  writer %d: entry %d is damaged\n", writer, index);
+    return TRUE;
+}
+
+static void DeleteStoreFiles(const char *directory) {
+    char pattern[MAX_PATH];
+    snprintf(pattern, MAX_PATH, "%s\\*", directory);
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(pattern, &findData);
+    if (hFind == INVALID_HANDLE_VALUE) return;
+    do {
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        char path[MAX_PATH];
+        snprintf(path, MAX_PATH, "%s\\%s", directory, findData.cFileName);
+        DeleteFile(path);
+    } while (FindNextFile(hFind, &findData));
+    FindClose(hFind);
+}
+
+// Number of segments larger than the cap
+static int CountOversizedSegments(const char *directory, int *segments) {
+    char pattern[MAX_PATH];
+    snprintf(pattern, MAX_PATH, "%s\\seg-*.wlog", directory);
+    WIN32_FIND_DATA findData;
+    HANDLE hFind = FindFirstFile(pattern, &findData);
+    int oversized = 0;
+    *segments = 0;
+    if (hFind == INVALID_HANDLE_VALUE) return 0;
+    do {
+        ULONGLONG size = ((ULONGLONG)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+        (*segments)++;
+        if (size > LOGSTORE_SEGMENT_BYTES) {
+            printf("  %s is %llu bytes\n", findData.cFileName, (unsigned long long)size);
+            oversized++;
+        }
+    } while (FindNextFile(hFind, &findData));
+    FindClose(hFind);
+    return oversized;
+}
+
+static BOOL StartWriter(const char *directory, int process, int threads, int records, HANDLE *hProcess) {
+    char exe[MAX_PATH];
+    char commandLine[3 * MAX_PATH];
+    if (!GetModuleFileName(NULL, exe, MAX_PATH)) return FALSE;
+    snprintf(commandLine, sizeof(commandLine), "\"%s\" -writer \"%s\" %d %d %d",
+             exe, directory, process, threads, records);
+
+    STARTUPINFO startup;
+    PROCESS_INFORMATION info;
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    if (!CreateProcess(exe, commandLine, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info)) return FALSE;
+    CloseHandle(info.hThread);
+    *hProcess = info.hProcess;
+    return TRUE;
+}
+
+static BOOL TestConcurrentWriters(const char *directory, int processes, int threads, int records) {
+    printf("%d process(es) x %d thread(s) x %d entries\n", processes, threads, records);
+    CreateDirectory(directory, NULL);
+    DeleteStoreFiles(directory);
+
+    HANDLE children[MAX_PROCESSES];
+    int started = 0;
+    for (int p = 0; p < processes; p++) {
+        if (!StartWriter(directory, p, threads, records, &children[started])) {
+            printf("  cannot start writer %d (error %lu)\n", p, (unsigned long)GetLastError());
+            break;
+        }
+        started++;
+    }
+    BOOL ok = started == processes;
+    for (int p = 0; p < started; p++) {
+        DWORD exitCode = 1;
+        WaitForSingleObject(children[p], INFINITE);
+        if (!GetExitCodeProcess(children[p], &exitCode) || exitCode != 0) {
+            printf("  writer %d failed\n", p);
+            ok = FALSE;
+        }
+        CloseHandle(children[p]);
+    }
+
+    int segments = 0;
+    if (CountOversizedSegments(directory, &segments) > 0) ok = FALSE;
+
+    LogStore *store = LogStore_Open(directory);
+    if (!store) {
+        printf("  the store cannot be opened again\n");
+        return FALSE;
+    }
+
+    CheckState state;
+    memset(&state, 0, sizeof(state));
+    state.writers = processes * MAX_THREADS;
+    state.records = records;
+    state.nextIndex = (int *)calloc((size_t)state.writers, sizeof(int));
+    if (!state.nextIndex) {
+        LogStore_Close(store);
+        return FALSE;
+    }
+    LogStore_Scan(store, 0, LLONG_MAX, CheckRecord, &state);
+    LogStore_Close(store);
+
+    for (int p = 0; p < processes; p++) {
+        for (int t = 0; t < threads; t++) {
+            int writer = p * MAX_THREADS + t;
+            if (state.nextIndex[writer] != records) {
+                printf("  writer %d: %d of %d entries stored\n", writer, state.nextIndex[writer], records);
+                state.failures++;
+            }
+        }
+    }
+    free(state.nextIndex);
+    printf("  %d entries in %d segment(s)\n", state.count, segments);
+    if (state.count != processes * threads * records) state.failures++;
+    return ok && state.failures == 0;
+}
+
+static BOOL WriteAll(HANDLE hFile, const void *data, DWORD length) {
+    DWORD written = 0;
+    return WriteFile(hFile, data, length, &written, NULL) && written == length;
+}
+
+// Write by hand a newest segment past LOGSTORE_SEGMENT_BYTES + MAX_BODY
+// that ends in half a record, then open it
+static BOOL TestOversizedRecovery(const char *directory) {
+    const int records = LOGSTORE_SEGMENT_BYTES / LOGSTORE_MAX_BODY + 2;
+    printf("oversized newest segment, %d full entries and a torn one\n", records);
+    CreateDirectory(directory, NULL);
+    DeleteStoreFiles(directory);
+
+    LONGLONG now = LogStore_Now();
+    SYSTEMTIME local;
+    GetLocalTime(&local);
+    DWORD day = local.wYear * 10000 + local.wMonth * 100 + local.wDay;
+
+    char path[MAX_PATH];
+    snprintf(path, MAX_PATH, "%s\\seg-%06lu-%08lu.wlog", directory, 1UL, (unsigned long)day);
+    HANDLE hFile = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    char *body = (char *)malloc(LOGSTORE_MAX_BODY);
+    if (hFile == INVALID_HANDLE_VALUE || !body) {
+        if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+        free(body);
+        return FALSE;
+    }
+
+    LogSegmentHeader segmentHeader;
+    memset(&segmentHeader, 0, sizeof(segmentHeader));
+    memcpy(segmentHeader.magic, "WLOG", 4);
+    segmentHeader.version = 1;
+    segmentHeader.day = day;
+    BOOL ok = WriteAll(hFile, &segmentHeader, sizeof(segmentHeader));
+
+    // The checksum covers the header fields after it, then the body
+    const size_t checkedOffset = offsetof(LogRecordHeader, timestamp);
+    for (int i = 0; ok && i <= records; i++) {
+        LogRecordHeader header;
+        memset(&header, 0, sizeof(header));
+        header.length = MakeBody(body, i, BIG_EVERY - 1);
+        header.timestamp = now;
+        header.sequence = (DWORD)i + 1;
+        size_t checkedLength = sizeof(header) - checkedOffset;
+        char *checked = (char *)malloc(checkedLength + header.length);
+        if (!checked) {
+            ok = FALSE;
+            break;
+        }
+        memcpy(checked, (const char *)&header + checkedOffset, checkedLength);
+        memcpy(checked + checkedLength, body, header.length);
+        header.checksum = LogStore_Crc32(checked, checkedLength + header.length);
+        free(checked);
+
+        // The last record is torn halfway through its body
+        DWORD bodyBytes = i < records ? header.length : header.length / 2;
+        ok = WriteAll(hFile, &header, sizeof(header)) && WriteAll(hFile, body, bodyBytes);
+    }
+    CloseHandle(hFile);
+    free(body);
+    if (!ok) return FALSE;
+
+    LogStore *store = LogStore_Open(directory);
+    if (!store) {
+        printf("  the store cannot be opened\n");
+        return FALSE;
+    }
+
+    // Record i was written as writer i's one large entry
+    int nextIndex[LOGSTORE_SEGMENT_BYTES / LOGSTORE_MAX_BODY + 3];
+    for (int i = 0; i <= records; i++) nextIndex[i] = BIG_EVERY - 1;
+    CheckState state;
+    memset(&state, 0, sizeof(state));
+    state.writers = records + 1;
+    state.nextIndex = nextIndex;
+    LogStore_Scan(store, 0, LLONG_MAX, CheckRecord, &state);
+
+    // Appends go to a new segment, not the oversized one
+    char small[64];
+    int smallLength = snprintf(small, sizeof(small), "appended after recovery");
+    ok = LogStore_Append(store, now, 0, small, (DWORD)smallLength);
+    LogStore_Close(store);
+
+    int segments = 0;
+    CountOversizedSegments(directory, &segments);
+    printf("  %d entries recovered, %d segment(s) after one more append\n", state.count, segments);
+    return ok && state.count == records && state.failures == 0 && segments == 2;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 6 && strcmp(argv[1], "-writer") == 0) {
+        return RunWriter(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]));
+    }
+
+    int processes = 4, threads = 2, records = 200;
+    const char *directory = "LogStoreStress.tmp";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            processes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            records = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: LogStoreStress [-p processes] [-t threads] [-n records] [directory]\n");
+            return 2;
+        } else {
+            directory = argv[i];
+        }
+    }
+    if (processes < 1) processes = 1;
+    if (processes > MAX_PROCESSES) processes = MAX_PROCESSES;
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if (records < 1) records = 1;
+
+    BOOL ok = TestConcurrentWriters(directory, processes, threads, records);
+    printf("%s\n", ok ? "ok" : "FAILED");
+    BOOL recovered = TestOversizedRecovery(directory);
+    printf("%s\n", recovered ? "ok" : "FAILED");
+
+    if (ok && recovered) {
+        DeleteStoreFiles(directory);
+        RemoveDirectory(directory);
+    }
+    return ok && recovered ? 0 : 1;
+}
@@ -0,0 +1,297 @@
+// Unit tests for spans.c: planning replacements over misspelled spans
+// and diffing the spans of two checks.
+// Plain C; builds anywhere with  gcc -I. tests/spans_test.c spans.c
+//
+// Exits 0 when every check passes, 1 otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../spans.h"
+
+static int s_checks = 0;
+static int s_failures = 0;
+
+#define CHECK(condition) Check((condition), #condition, __LINE__)
+
+static void Check(int condition, const char *text, int line) {
+    s_checks++;
+    if (!condition) {
+        printf("  line %d: %s\n", line, text);
+        s_failures++;
+    }
+}
+
+// Spans for the words of 'text' at the given offsets, in text order
+static MisspelledWordList MakeList(const char *text, const unsigned int *starts, const unsigned int *ends, int count) {
+    MisspelledWordList list;
+    list.words = (MisspelledWord *)calloc(count > 0 ? count : 1, sizeof(MisspelledWord));
+    list.count = count;
+    list.capacity = count;
+    for (int i = 0; i < count; i++) {
+        list.words[i].startPos = starts[i];
+        list.words[i].endPos = ends[i];
+        memcpy(list.words[i].word, text + starts[i], ends[i] - starts[i]);
+    }
+    return list;
+}
+
+// 'text' with the edit applied, malloc'd
+static char* ApplyToText(const char *text, const SpellCheckEdit *edit) {
+    size_t length = strlen(text);
+    char *result = (char *)malloc(length - (edit->end - edit->start) + edit->length + 1);
+    memcpy(result, text, edit->start);
+    memcpy(result + edit->start, edit->text, edit->length);
+    strcpy(result + edit->start + edit->length, text + edit->end);
+    return result;
+}
+
+// Plan a replacement and check the text it produces
+static void CheckReplacement(const char *text, const MisspelledWordList *list, int index, int all,
+                             const char *replacement, const char *expected, int replaced) {
+    SpellCheckEdit edit;
+    int ok = Spans_PlanReplacement(list, index, all, replacement, text, strlen(text), &edit);
+    CHECK(ok == (replaced > 0));
+    CHECK(edit.replaced == replaced);
+    if (ok) {
+        char *result = ApplyToText(text, &edit);
+        if (strcmp(result, expected) != 0) printf("  got \"%s\", expected \"%s\"\n", result, expected);
+        CHECK(strcmp(result, expected) == 0);
+        CHECK(edit.length == strlen(edit.text));
+        free(result);
+    }
+    Spans_FreeEdit(&edit);
+    CHECK(edit.text == NULL);
+}
+
+static void TestReplaceOne(void) {
+    const char *text = "teh cat and teh dog";
+    unsigned int starts[] = { 0, 12 }, ends[] = { 3, 15 };
+    MisspelledWordList list = MakeList(text, starts, ends, 2);
+    CheckReplacement(text, &list, 1, 0, "the", "teh cat and the dog", 1);
+
+    // The edit covers just the span
+    SpellCheckEdit edit;
+    Spans_PlanReplacement(&list, 1, 0, "the", text, strlen(text), &edit);
+    CHECK(edit.start == 12 && edit.end == 15);
+    Spans_FreeEdit(&edit);
+    free(list.words);
+}
+
+static void TestReplaceAll(void) {
+    const char *text = "teh cat, teh dog, a bird, teh end";
+    unsigned int starts[] = { 0, 9, 18, 26 }, ends[] = { 3, 12, 19, 29 };
+    MisspelledWordList list = MakeList(text, starts, ends, 4);
+    CheckReplacement(text, &list, 1, 1, "the", "the cat, the dog, a bird, the end", 3);
+    CheckReplacement(text, &list, 0, 1, "", " cat,  dog, a bird,  end", 3);
+    CheckReplacement(text, &list, 2, 1, "an", "teh cat, teh dog, an bird, teh end", 1);
+
+    // One edit from the first replaced span to the end of the last
+    SpellCheckEdit edit;
+    Spans_PlanReplacement(&list, 3, 1, "the", text, strlen(text), &edit);
+    CHECK(edit.start == 0 && edit.end == 29);
+    Spans_FreeEdit(&edit);
+    free(list.words);
+}
+
+static void TestReplaceAdjacent(void) {
+    const char *text = "tehteh teh";
+    unsigned int starts[] = { 0, 3, 7 }, ends[] = { 3, 6, 10 };
+    MisspelledWordList list = MakeList(text, starts, ends, 3);
+    CheckReplacement(text, &list, 0, 1, "the", "thethe the", 3);
+    CheckReplacement(text, &list, 1, 1, "a", "aa a", 3);
+    CheckReplacement(text, &list, 1, 0, "the", "tehthe teh", 1);
+    free(list.words);
+}
+
+static void TestReplaceOverlapping(void) {
+    // Two spans of the same word over shared bytes: only the first is
+    // replaced, since the second's text is gone once it is
+    const char *text = "aaaa aaa";
+    unsigned int starts[] = { 0, 1, 5 }, ends[] = { 3, 4, 8 };
+    MisspelledWordList list = MakeList(text, starts, ends, 3);
+    CheckReplacement(text, &list, 0, 1, "b", "ba b", 2);
+    CheckReplacement(text, &list, 1, 1, "b", "ba b", 2);
+    CheckReplacement(text, &list, 1, 0, "b", "ab aaa", 1);
+    free(list.words);
+}
+
+static void TestStaleSpans(void) {
+    // The text changed after the check: spans that no longer hold their
+    // word are skipped, and with none left there is no edit
+    const char *checked = "teh cat teh";
+    const char *text = "the cat teh";
+    unsigned int starts[] = { 0, 8 }, ends[] = { 3, 11 };
+    MisspelledWordList list = MakeList(checked, starts, ends, 2);
+    CheckReplacement(text, &list, 0, 1, "the", "the cat the", 1);
+    CheckReplacement(text, &list, 0, 0, "the", "", 0);
+    CheckReplacement("teh", &list, 1, 0, "the", "", 0);
+    free(list.words);
+}
+
+static void TestBadArguments(void) {
+    const char *text = "teh";
+    unsigned int starts[] = { 0 }, ends[] = { 3 };
+    MisspelledWordList list = MakeList(text, starts, ends, 1);
+    SpellCheckEdit edit;
+    CHECK(!Spans_PlanReplacement(&list, 1, 0, "the", text, 3, &edit) && edit.text == NULL && edit.replaced == 0);
+    CHECK(!Spans_PlanReplacement(&list, -1, 1, "the", text, 3, &edit) && edit.text == NULL);
+    CHECK(!Spans_PlanReplacement(NULL, 0, 0, "the", text, 3, &edit) && edit.text == NULL);
+    CHECK(!Spans_PlanReplacement(&list, 0, 0, NULL, text, 3, &edit) && edit.text == NULL);
+    CHECK(!Spans_PlanReplacement(&list, 0, 0, "the", text, 3, NULL));
+    free(list.words);
+}
+
+// Spans given as word and start; each ends after its word
+static MisspelledWordList MakeSpans(const char * const *words, const unsigned int *starts, int count) {
+    MisspelledWordList list;
+    list.words = (MisspelledWord *)calloc(count > 0 ? count : 1, sizeof(MisspelledWord));
+    list.count = count;
+    list.capacity = count;
+    for (int i = 0; i < count; i++) {
+        list.words[i].startPos = starts[i];
+        list.words[i].endPos = starts[i] + (unsigned int)strlen(words[i]);
+        strcpy(list.words[i].word, words[i]);
+    }
+    return list;
+}
+
+static int IsChange(const MisspelledChange *change, SpellCheckSpanChange kind, unsigned int oldStart,
+                    unsigned int oldEnd, unsigned int newStart, unsigned int newEnd) {
+    return change->change == kind && change->oldStart == oldStart && change->oldEnd == oldEnd &&
+           change->newStart == newStart && change->newEnd == newEnd;
+}
+
+static void TestDiffEmpty(void) {
+    MisspelledDiff diff = { NULL, 0, 0 };
+    const char *words[] = { "teh", "recieve" };
+    unsigned int starts[] = { 0, 10 };
+    MisspelledWordList none = MakeSpans(words, starts, 0);
+    MisspelledWordList spans = MakeSpans(words, starts, 2);
+    MisspelledWordList same = MakeSpans(words, starts, 2);
+
+    CHECK(Spans_Diff(&none, &none, &diff) && diff.count == 0);
+    CHECK(Spans_Diff(&spans, &same, &diff) && diff.count == 0);
+    Spans_FreeDiff(&diff);
+    CHECK(diff.changes == NULL && diff.count == 0 && diff.capacity == 0);
+    free(none.words);
+    free(spans.words);
+    free(same.words);
+}
+
+static void TestDiffAddedRemoved(void) {
+    MisspelledDiff diff = { NULL, 0, 0 };
+    const char *beforeWords[] = { "teh", "recieve" };
+    unsigned int beforeStarts[] = { 0, 10 };
+    const char *afterWords[] = { "recieve", "wierd" };
+    unsigned int afterStarts[] = { 10, 20 };
+    MisspelledWordList before = MakeSpans(beforeWords, beforeStarts, 2);
+    MisspelledWordList after = MakeSpans(afterWords, afterStarts, 2);
+    MisspelledWordList none = MakeSpans(beforeWords, beforeStarts, 0);
+
+    // "teh" fixed, "wierd" typed, "recieve" untouched
+    CHECK(Spans_Diff(&before, &after, &diff) && diff.count == 2);
+    CHECK(diff.count == 2 && IsChange(&diff.changes[0], SPELLCHECK_SPAN_REMOVED, 0, 3, 0, 0));
+    CHECK(diff.count == 2 && IsChange(&diff.changes[1], SPELLCHECK_SPAN_ADDED, 0, 0, 20, 25));
+
+    // Everything appears, then everything goes
+    CHECK(Spans_Diff(&none, &before, &diff) && diff.count == 2);
+    CHECK(diff.count == 2 && IsChange(&diff.changes[0], SPELLCHECK_SPAN_ADDED, 0, 0, 0, 3));
+    CHECK(diff.count == 2 && IsChange(&diff.changes[1], SPELLCHECK_SPAN_ADDED, 0, 0, 10, 17));
+    CHECK(Spans_Diff(&before, &none, &diff) && diff.count == 2);
+    CHECK(diff.count == 2 && IsChange(&diff.changes[1], SPELLCHECK_SPAN_REMOVED, 10, 17, 0, 0));
+
+    // A different word at the same place is a removal and an addition
+    const char *otherWords[] = { "thw", "recieve" };
+    MisspelledWordList other = MakeSpans(otherWords, beforeStarts, 2);
+    CHECK(Spans_Diff(&before, &other, &diff) && diff.count == 2);
+    CHECK(diff.count == 2 && IsChange(&diff.changes[0], SPELLCHECK_SPAN_REMOVED, 0, 3, 0, 0));
+    CHECK(diff.count == 2 && IsChange(&diff.changes[1], SPELLCHECK_SPAN_ADDED, 0, 0, 0, 3));
+
+    Spans_FreeDiff(&diff);
+    free(before.words);
+    free(after.words);
+    free(none.words);
+    free(other.words);
+}
+
+static void TestDiffShifted(void) {
+    MisspelledDiff diff = { NULL, 0, 0 };
+    const char *words[] = { "teh", "recieve", "wierd" };
+    unsigned int beforeStarts[] = { 0, 10, 20 };
+    unsigned int afterStarts[] = { 0, 14, 24 };     // Four bytes typed after "teh"
+    MisspelledWordList before = MakeSpans(words, beforeStarts, 3);
+    MisspelledWordList after = MakeSpans(words, afterStarts, 3);
+
+    CHECK(Spans_Diff(&before, &after, &diff) && diff.count == 2);
+    CHECK(diff.count == 2 && IsChange(&diff.changes[0], SPELLCHECK_SPAN_SHIFTED, 10, 17, 14, 21));
+    CHECK(diff.count == 2 && IsChange(&diff.changes[1], SPELLCHECK_SPAN_SHIFTED, 20, 25, 24, 29));
+
+    // Text deleted in front shifts spans back
+    CHECK(Spans_Diff(&after, &before, &diff) && diff.count == 2);
+    CHECK(diff.count == 2 && IsChange(&diff.changes[0], SPELLCHECK_SPAN_SHIFTED, 14, 21, 10, 17));
+
+    // A repeated word pairs with its next unmatched copy
+    const char *repeated[] = { "teh", "teh" };
+    unsigned int repeatedBefore[] = { 0, 8 }, repeatedAfter[] = { 4, 12 };
+    MisspelledWordList twice = MakeSpans(repeated, repeatedBefore, 2);
+    MisspelledWordList moved = MakeSpans(repeated, repeatedAfter, 2);
+    CHECK(Spans_Diff(&twice, &moved, &diff) && diff.count == 2);
+    CHECK(diff.count == 2 && IsChange(&diff.changes[0], SPELLCHECK_SPAN_SHIFTED, 0, 3, 4, 7));
+    CHECK(diff.count == 2 && IsChange(&diff.changes[1], SPELLCHECK_SPAN_SHIFTED, 8, 11, 12, 15));
+
+    Spans_FreeDiff(&diff);
+    free(before.words);
+    free(after.words);
+    free(twice.words);
+    free(moved.words);
+}
+
+static void TestDiffReusesStorage(void) {
+    // Enough changes to grow the diff, then a smaller one in the same storage
+    enum { COUNT = 1000 };
+    MisspelledDiff diff = { NULL, 0, 0 };
+    const char *words[COUNT];
+    unsigned int starts[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        words[i] = "teh";
+        starts[i] = (unsigned int)i * 4;
+    }
+    MisspelledWordList none = MakeSpans(words, starts, 0);
+    MisspelledWordList many = MakeSpans(words, starts, COUNT);
+    CHECK(Spans_Diff(&none, &many, &diff) && diff.count == COUNT);
+    CHECK(diff.count == COUNT && IsChange(&diff.changes[COUNT - 1], SPELLCHECK_SPAN_ADDED, 0, 0, 3996, 3999));
+    MisspelledChange *changes = diff.changes;
+    int capacity = diff.capacity;
+    CHECK(Spans_Diff(&many, &many, &diff) && diff.count == 0);
+    CHECK(diff.changes == changes && diff.capacity == capacity);
+    CHECK(!Spans_Diff(NULL, &many, &diff));
+    Spans_FreeDiff(&diff);
+    free(none.words);
+    free(many.words);
+}
+
+int main(void) {
+    struct {
+        const char *name;
+        void (*run)(void);
+    } tests[] = {
+        { "replace one", TestReplaceOne },
+        { "replace all", TestReplaceAll },
+        { "replace adjacent spans", TestReplaceAdjacent },
+        { "replace overlapping spans", TestReplaceOverlapping },
+        { "skip stale spans", TestStaleSpans },
+        { "bad arguments", TestBadArguments },
+        { "empty diff", TestDiffEmpty },
+        { "diff added and removed", TestDiffAddedRemoved },
+        { "diff shifted", TestDiffShifted },
+        { "diff reuses its storage", TestDiffReusesStorage },
+    };
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        int before = s_failures;
+        tests[i].run();
+        printf("%-28s %s\n", tests[i].name, s_failures == before ? "ok" : "FAILED");
+    }
+    printf("%d checks, %d failed\n", s_checks, s_failures);
+    return s_failures == 0 ? 0 : 1;
+}
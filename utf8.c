@@ -0,0 +1,257 @@
+#include "utf8.h"
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define UTF8_SSE2
+#endif
+
+// Sequence length by the lead byte's high nibble (0: continuation byte)
+static const unsigned char s_sequenceLength[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 2, 2, 3, 4
+};
+
+// Smallest code point each sequence length may encode (rejects overlongs)
+static const unsigned int s_minimumCodePoint[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+
+// Letters outside ASCII, sorted. Broad script blocks rather than exact
+// Unicode categories; combining marks count so decomposed accents stay
+// inside their word.
+static const unsigned int s_letterRanges[][2] = {
+    { 0x00AA, 0x00AA }, { 0x00B5, 0x00B5 }, { 0x00BA, 0x00BA },
+    { 0x00C0, 0x00D6 }, { 0x00D8, 0x00F6 }, { 0x00F8, 0x02AF },   // Latin-1, Extended-A/B, IPA
+    { 0x0300, 0x036F },                                           // Combining diacritics
+    { 0x0370, 0x0373 }, { 0x0376, 0x0377 }, { 0x037B, 0x037D },
+    { 0x0386, 0x0386 }, { 0x0388, 0x03FF },                       // Greek
+    { 0x0400, 0x0481 }, { 0x048A, 0x052F },                       // Cyrillic
+    { 0x0531, 0x0556 }, { 0x0561, 0x0587 },                       // Armenian
+    { 0x05D0, 0x05EA },                                           // Hebrew
+    { 0x0620, 0x064A }, { 0x0671, 0x06D3 },                       // Arabic
+    { 0x0900, 0x0DFF },                                           // Indic scripts
+    { 0x0E01, 0x0E3A }, { 0x0E40, 0x0E4E },                       // Thai
+    { 0x1E00, 0x1FFF },                                           // Latin Additional, Greek Extended
+    { 0x3041, 0x3096 }, { 0x30A1, 0x30FA },                       // Kana
+    { 0x4E00, 0x9FFF },                                           // CJK ideographs
+    { 0xAC00, 0xD7A3 },                                           // Hangul
+};
+
+int Utf8_Decode(const unsigned char *s, size_t len, unsigned int *codePoint) {
+    unsigned char lead = s[0];
+    int n = s_sequenceLength[lead >> 4];
+    if (n == 1) {
+        *codePoint = lead;
+        return 1;
+    }
+
+    if (n > 1 && (size_t)n <= len && lead < 0xF5) {
+        unsigned int value = lead & (0x7F >> n);
+        int i;
+        for (i = 1; i < n && (s[i] & 0xC0) == 0x80; i++) {
+            value = (value << 6) | (s[i] & 0x3F);
+        }
+        if (i == n && value >= s_minimumCodePoint[n] && value <= 0x10FFFF &&
+            (value < 0xD800 || value > 0xDFFF)) {
+            *codePoint = value;
+            return n;
+        }
+    }
+
+    // Not valid UTF-8: take the byte as Latin-1
+    *codePoint = lead;
+    return 1;
+}
+
+static int EncodedLength(unsigned int codePoint) {
+    if (codePoint < 0x80) return 1;
+    if (codePoint < 0x800) return 2;
+    if (codePoint < 0x10000) return 3;
+    return 4;
+}
+
+static void Encode(unsigned int codePoint, char *out) {
+    switch (EncodedLength(codePoint)) {
+    case 1:
+        out[0] = (char)codePoint;
+        break;
+    case 2:
+        out[0] = (char)(0xC0 | (codePoint >> 6));
+        out[1] = (char)(0x80 | (codePoint & 0x3F));
+        break;
+    case 3:
+        out[0] = (char)(0xE0 | (codePoint >> 12));
+        out[1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codePoint & 0x3F));
+        break;
+    default:
+        out[0] = (char)(0xF0 | (codePoint >> 18));
+        out[1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out[3] = (char)(0x80 | (codePoint & 0x3F));
+        break;
+    }
+}
+
+int Utf8_IsLetter(unsigned int codePoint) {
+    if (codePoint < 0x80) {
+        return (codePoint >= 'A' && codePoint <= 'Z') || (codePoint >= 'a' && codePoint <= 'z');
+    }
+
+    int left = 0, right = (int)(sizeof(s_letterRanges) / sizeof(s_letterRanges[0])) - 1;
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        if (codePoint < s_letterRanges[mid][0]) right = mid - 1;
+        else if (codePoint > s_letterRanges[mid][1]) left = mid + 1;
+        else return 1;
+    }
+    return 0;
+}
+
+// Simple one-to-one folding for the scripts above. Every mapping keeps the
+// encoded length, which is what lets Utf8_Fold work in place.
+unsigned int Utf8_FoldCodePoint(unsigned int codePoint) {
+    unsigned int c = codePoint;
+    if (c < 0x80) return (c >= 'A' && c <= 'Z') ? c + 0x20 : c;
+    if (c >= 0xC0 && c <= 0xDE && c != 0xD7) return c + 0x20;
+    if (c == 0x130 || c == 0x131) return c;                      // Turkish dotted/dotless i
+    if (c >= 0x100 && c <= 0x137) return c | 1;                  // Even upper, odd lower
+    if (c >= 0x139 && c <= 0x148) return c + (c & 1);            // Odd upper, even lower
+    if (c >= 0x14A && c <= 0x177) return c | 1;
+    if (c == 0x178) return 0xFF;
+    if (c >= 0x179 && c <= 0x17E) return c + (c & 1);
+    if (c == 0x386) return 0x3AC;                                // Greek with tonos
+    if (c >= 0x388 && c <= 0x38A) return c + 0x25;
+    if (c == 0x38C) return 0x3CC;
+    if (c == 0x38E || c == 0x38F) return c + 0x3F;
+    if (c >= 0x391 && c <= 0x3AB && c != 0x3A2) return c + 0x20; // Greek
+    if (c == 0x3C2) return 0x3C3;                                // Final sigma
+    if (c >= 0x400 && c <= 0x40F) return c + 0x50;               // Cyrillic
+    if (c >= 0x410 && c <= 0x42F) return c + 0x20;
+    if (c >= 0x460 && c <= 0x481) return c | 1;
+    if (c >= 0x48A && c <= 0x4BF) return c | 1;
+    if (c >= 0x531 && c <= 0x556) return c + 0x30;               // Armenian
+    return c;
+}
+
+#ifdef UTF8_SSE2
+// Bit i set when byte i of the block is an ASCII letter. Bytes >= 0x80
+// never match.
+static int AsciiLetterMask(__m128i block) {
+    __m128i lowered = _mm_or_si128(block, _mm_set1_epi8(0x20));
+    __m128i shifted = _mm_add_epi8(lowered, _mm_set1_epi8((char)(0x80 - 'a')));
+    return _mm_movemask_epi8(_mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(0x80 + 26))));
+}
+#endif
+
+void Utf8_Fold(const char *word, size_t len, char *out) {
+    size_t i = 0;
+    while (i < len) {
+#ifdef UTF8_SSE2
+        // Plain ASCII blocks: lower-case 16 bytes at once
+        if (i + 16 <= len) {
+            __m128i block = _mm_loadu_si128((const __m128i *)(word + i));
+            if (!_mm_movemask_epi8(block)) {
+                __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('A' - 1)),
+                                              _mm_cmplt_epi8(block, _mm_set1_epi8('Z' + 1)));
+                block = _mm_add_epi8(block, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+                _mm_storeu_si128((__m128i *)(out + i), block);
+                i += 16;
+                continue;
+            }
+        }
+#endif
+        unsigned char c = (unsigned char)word[i];
+        if (c < 0x80) {
+            out[i++] = (char)((c >= 'A' && c <= 'Z') ? c + 0x20 : c);
+            continue;
+        }
+
+        unsigned int codePoint;
+        int n = Utf8_Decode((const unsigned char *)word + i, len - i, &codePoint);
+        unsigned int folded = Utf8_FoldCodePoint(codePoint);
+        if (n == 1) {
+            // Latin-1 byte: fold within the byte
+            out[i] = (char)(folded <= 0xFF ? folded : c);
+        } else if (folded != codePoint && EncodedLength(folded) == n) {
+            Encode(folded, out + i);
+        } else {
+            memmove(out + i, word + i, n);
+        }
+        i += n;
+    }
+    out[len] = '\0';
+}
+
+// Byte length of the character at text[i]; '*isLetter' says if it is one
+static int CharAt(const char *text, size_t i, size_t length, int *isLetter) {
+    unsigned char c = (unsigned char)text[i];
+    if (c < 0x80) {
+        *isLetter = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+        return 1;
+    }
+    unsigned int codePoint;
+    int n = Utf8_Decode((const unsigned char *)text + i, length - i, &codePoint);
+    *isLetter = Utf8_IsLetter(codePoint);
+    return n;
+}
+
+int Utf8_NextWord(const char *text, size_t length, size_t *pos, size_t *wordStart, size_t *wordLength) {
+    size_t i = *pos;
+    int isLetter = 0;
+
+    // Skip to the first letter
+    while (i < length) {
+#ifdef UTF8_SSE2
+        if (i + 16 <= length) {
+            __m128i block = _mm_loadu_si128((const __m128i *)(text + i));
+            int stop = AsciiLetterMask(block) | _mm_movemask_epi8(block);
+            if (!stop) {
+                i += 16;
+                continue;
+            }
+            i += __builtin_ctz(stop);
+        }
+#endif
+        int n = CharAt(text, i, length, &isLetter);
+        if (isLetter) break;
+        i += n;
+    }
+    if (i >= length) {
+        *pos = length;
+        return 0;
+    }
+
+    // Then to the end of the word
+    size_t start = i;
+    while (i < length) {
+#ifdef UTF8_SSE2
+        if (i + 16 <= length) {
+            __m128i block = _mm_loadu_si128((const __m128i *)(text + i));
+            int letters = AsciiLetterMask(block);
+            if (letters == 0xFFFF) {
+                i += 16;
+                continue;
+            }
+            i += __builtin_ctz(~letters & 0xFFFF);
+        }
+#endif
+        int n = CharAt(text, i, length, &isLetter);
+        if (!isLetter) break;
+        i += n;
+    }
+
+    *wordStart = start;
+    *wordLength = i - start;
+    *pos = i;
+    return 1;
+}
+
+size_t Utf8_TruncateLength(const char *word, size_t length, size_t maxLength) {
+    if (length <= maxLength) return length;
+
+    // If the first byte left out continues a sequence, drop its lead too
+    size_t cut = maxLength;
+    for (int k = 0; k < 3 && cut > 0 && ((unsigned char)word[cut] & 0xC0) == 0x80; k++) {
+        cut--;
+    }
+    return cut;
+}
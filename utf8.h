@@ -0,0 +1,32 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+
+// UTF-8 word splitting and simple case folding, shared by the spell
+// checker and the dictgen build tool (so it sticks to the C library).
+//
+// Bytes that don't form a valid UTF-8 sequence decode as Latin-1, so text
+// in the ANSI code page (older word files, say) still splits into whole
+// words. Folding maps each letter to its lower-case form and never
+// changes a word's length in bytes.
+
+// Decode the code point at 's' (at most 'len' bytes available); returns
+// the number of bytes consumed, always at least 1
+int Utf8_Decode(const unsigned char *s, size_t len, unsigned int *codePoint);
+
+int Utf8_IsLetter(unsigned int codePoint);
+unsigned int Utf8_FoldCodePoint(unsigned int codePoint);
+
+// Fold 'len' bytes of 'word' into 'out' and NUL-terminate it; 'out' needs
+// len + 1 bytes and may be the same buffer as 'word'
+void Utf8_Fold(const char *word, size_t len, char *out);
+
+// Find the next word at or after '*pos' in text[0..length). On success
+// sets the word's byte range, advances '*pos' past it and returns 1.
+int Utf8_NextWord(const char *text, size_t length, size_t *pos, size_t *wordStart, size_t *wordLength);
+
+// Largest length <= maxLength that doesn't cut a multibyte sequence
+size_t Utf8_TruncateLength(const char *word, size_t length, size_t maxLength);
+
+#endif // UTF8_H